@@ -0,0 +1,74 @@
+/**
+ * @file adc_calibration.h
+ * @brief Runtime calibration of the battery voltage / current measurement, stored in flash
+ *
+ * The board specific coefficients (voltage scale and offset, current scale and offset)
+ * live in the last 1k flash page (CALIBRATION region of STM32F103XX_FLASH.ld) and are
+ * loaded once at boot into the Q16 multipliers of BatteryMeasurement. The per-result
+ * path keeps its one multiply per channel - no branches, no divisions for calibration.
+ *
+ * Procedure (debug UART "cal ..." commands or CRSF switch, see user_main.cpp):
+ * - voltage, two point: apply a known voltage, adc_calibration_voltage_point(1, mV),
+ *   apply a second one (as far apart as possible), adc_calibration_voltage_point(2, mV)
+ *   -> scale and offset from the two filtered readings
+ * - current offset: no load, adc_calibration_zero_current()
+ * - adc_calibration_save() writes the record (magic, version, CRC32, see flash_record.h)
+ *
+ * Erasing / programming a flash page stalls the CPU for 20..40ms. The servo timers keep
+ * running and the CRSF UART receives into its circular DMA buffer (UART_CRSF_RX_FIFO_SIZE,
+ * uart_config.h), so no CRSF byte is lost; the frames are processed after the stall and
+ * the outputs hold their last pulse meanwhile. The CRSF switch and the console commands
+ * therefore write the record right away, with the link up. Calibrate on the ground only.
+ *
+ * Usage:
+ * 1. adc_calibration_load() once in user_init(), defaults stay if no valid record exists
+ * 2. calibration commands at runtime, then adc_calibration_save()
+ */
+
+#ifndef ADC_CALIBRATION_H
+#define ADC_CALIBRATION_H
+
+#include "main.h"
+#include <stdint.h>
+#include "battery_measurement.h"
+
+#define ADC_CALIBRATION_MAGIC 0x43414C31UL  // "CAL1"
+#define ADC_CALIBRATION_VERSION 1
+#define ADC_CALIBRATION_MIN_SPAN_MV 2000    // minimum distance of the two voltage points
+#define ADC_CAL_CRSF_CHANNEL 0              // 1..16: switch channel for the zero current calibration, 0 = off
+#define ADC_CAL_CRSF_HOLD_MS 3000           // switch high time before the calibration runs
+
+#ifdef __cplusplus
+
+/**
+ * @brief Load the stored calibration into the battery measurement
+ * @return true if a valid record was found, false = compiled defaults are used
+ */
+bool adc_calibration_load(BatteryMeasurement &battery);
+
+/**
+ * @brief Write the active calibration of the battery measurement to flash
+ */
+HAL_StatusTypeDef adc_calibration_save(const BatteryMeasurement &battery);
+
+/**
+ * @brief Restore the compiled defaults and erase the stored record
+ */
+HAL_StatusTypeDef adc_calibration_defaults(BatteryMeasurement &battery);
+
+/**
+ * @brief Record one point of the two point voltage calibration
+ * @param point: 1 or 2 - point 2 computes and applies scale / offset
+ * @param voltage_mV: voltage applied to the battery input
+ * @return false if the point is invalid (no point 1, span too small, scale out of range)
+ */
+bool adc_calibration_voltage_point(BatteryMeasurement &battery, uint8_t point, int32_t voltage_mV);
+
+/**
+ * @brief Take the actual current reading as zero (no load connected)
+ */
+bool adc_calibration_zero_current(BatteryMeasurement &battery);
+
+#endif // __cplusplus
+
+#endif // ADC_CALIBRATION_H
@@ -0,0 +1,101 @@
+/**
+ * @file adc_sampler.h
+ * @brief Scan mode ADC with circular DMA and software oversampling / decimation
+ *
+ * The F103 ADC has no hardware oversampling. ADC1 runs the regular scan (VBAT on IN4,
+ * current on IN5) in timer triggered bursts (adc_trigger.h) and the DMA writes every
+ * conversion into a circular block buffer - the CPU is not involved per sample. The DMA half transfer
+ * and transfer complete interrupts hand over one half of the buffer (block) at a time,
+ * the block is summed into one accumulator per channel while the DMA fills the other
+ * half.
+ *
+ * VREFINT and the internal temperature sensor are converted as injected group directly
+ * after every regular burst (JAUTO). Their data registers are read once per block, so
+ * they add no per-sample work and no DMA traffic. They are averaged over the blocks of
+ * one result and published with the same scale as the regular channels.
+ *
+ * After 'decimation' scans (4..256, power of two) the sums are published as one result
+ * per channel, scaled to ADC_SAMPLER_RESULT_SHIFT extra bits independent of the
+ * decimation ratio (default: 12bit counts << 4 = 0..65520, the former 16x oversampling
+ * scale). Results are published at a fixed rate of scan rate / decimation:
+ *   8 scans every 2.5ms = 3200 scans/s, 64x decimation -> one result every 20ms
+ *
+ * Usage:
+ * 1. setDecimation() (optional, default ADC_SAMPLER_DECIMATION)
+ * 2. start() after HAL_ADCEx_Calibration_Start()
+ * 3. onTransfer() from HAL_ADC_ConvHalfCpltCallback() / HAL_ADC_ConvCpltCallback()
+ * 4. getResult() in the main loop
+ */
+
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include "main.h"
+#include <stdint.h>
+
+#define ADC_SAMPLER_CHANNELS 2              // regular scan ranks: 0 = VBAT (IN4), 1 = current (IN5)
+#define ADC_SAMPLER_AUX_CHANNELS 2          // injected ranks: VREFINT (IN17), temperature sensor (IN16)
+#define ADC_SAMPLER_RESULTS (ADC_SAMPLER_CHANNELS + ADC_SAMPLER_AUX_CHANNELS)
+#define ADC_SAMPLER_VREFINT ADC_SAMPLER_CHANNELS          // result index of VREFINT
+#define ADC_SAMPLER_TEMPERATURE (ADC_SAMPLER_CHANNELS + 1)  // result index of the temperature sensor
+#define ADC_SAMPLER_MAX_BLOCK_SCANS 64      // scans per DMA half buffer
+#define ADC_SAMPLER_RESULT_SHIFT 4          // result = ADC counts << 4 (0..65520)
+#define ADC_SAMPLER_DECIMATION 64           // default scans per result (4..256, power of two)
+
+#ifdef __cplusplus
+
+class AdcSampler {
+public:
+    AdcSampler();
+
+    /**
+     * @brief Set the number of scans summed into one result
+     * @param ratio: 4..256, power of two - only while the sampler is stopped
+     * @return false if the ratio is invalid or the sampler is running
+     */
+    bool setDecimation(uint16_t ratio);
+    uint16_t getDecimation(void) const { return m_decimation; }
+
+    /**
+     * @brief Start the continuous scan into the circular DMA buffer
+     * @param hadc: ADC configured for ADC_SAMPLER_CHANNELS scan ranks with circular DMA
+     */
+    bool start(ADC_HandleTypeDef *hadc);
+
+    /**
+     * @brief Accumulate one DMA block - call from the ADC half / full transfer callbacks
+     * @param second_half: false = half transfer (first block), true = transfer complete
+     * @return true if a new result has been published
+     */
+    bool onTransfer(bool second_half);
+
+    /**
+     * @brief Copy the latest published result of all channels (consistent set)
+     * @param results: ADC_SAMPLER_RESULTS values in ADC counts << ADC_SAMPLER_RESULT_SHIFT,
+     *                 regular channels first, then VREFINT and temperature
+     * @return sequence number of the result, 0 = nothing published yet
+     */
+    uint32_t getResult(uint16_t *results) const;
+
+    uint32_t getSequence(void) const { return m_sequence; }
+
+private:
+    volatile uint16_t m_buffer[2 * ADC_SAMPLER_MAX_BLOCK_SCANS * ADC_SAMPLER_CHANNELS];
+    ADC_HandleTypeDef *m_hadc;
+    uint16_t m_decimation;
+    uint16_t m_blockScans;                  // scans per DMA half buffer
+    uint8_t m_blocksPerResult;
+    uint8_t m_blockCount;
+    int8_t m_shift;                         // log2(decimation) - ADC_SAMPLER_RESULT_SHIFT
+    int8_t m_auxShift;                      // log2(blocks per result) - ADC_SAMPLER_RESULT_SHIFT
+    uint32_t m_accu[ADC_SAMPLER_RESULTS];
+
+    // double buffered results - the ISR writes the unpublished half, then flips the index
+    volatile uint16_t m_result[2][ADC_SAMPLER_RESULTS];
+    volatile uint8_t m_published;
+    volatile uint32_t m_sequence;
+};
+
+#endif // __cplusplus
+
+#endif // ADC_SAMPLER_H
@@ -0,0 +1,66 @@
+/**
+ * @file adc_trigger.h
+ * @brief Timer triggered ADC scans, phase locked to the servo PWM frame
+ *
+ * TIM4 runs as a further trigger slave of TIM1 (ITR0, see servo_timer_sync.h) with the
+ * same 1us tick. Every ADC_TRIGGER_PERIOD_US the rising edge of OC4REF (PWM2 mode, CCR4 =
+ * ADC_TRIGGER_PHASE_US) starts one burst of ADC_TRIGGER_BURST_SCANS regular scans (VBAT,
+ * current, VBAT, current, ...). The F1 ADC needs CC4E for the T4_CC4 trigger; TIM4 is
+ * remapped to the unbonded PD12..PD15 so that PB9 stays I2C1 SDA. The sample instants
+ * are therefore fixed relative to the servo pulses instead of being spread randomly by a
+ * free running ADC.
+ * VREFINT and the temperature sensor follow each burst as auto injected group.
+ *
+ * Quiet window: with the trigger period equal to the servo group stagger (2500us) every
+ * servo pulse starts at phase 0 of a trigger period and ends before
+ * BOARD_SERVO_PULSE_MAX_US. A burst placed behind that (default 2300us, 8 scans x 14us
+ * + 42us injected) never sees a servo pulse edge. ADC_TRIGGER_QUIET_WINDOW checks this
+ * at compile time; test/test_adc_trigger_phase.cpp sweeps the phase on a synthetic servo
+ * load (edge ringing, drive current, noise) and compares it with free running scans.
+ *
+ * Defaults: 8 scans every 2.5ms = 3200 scans/s, 64x decimation in the AdcSampler ->
+ * one result per 20ms servo frame.
+ *
+ * TIM4 is also the default PPM timer - with PPM_OUTPUT_ENABLED the ADC falls back to
+ * free running continuous scans.
+ *
+ * Usage:
+ * 1. adc_trigger_init() after servo_timers_sync_init(), before the ADC DMA is started
+ * 2. adc_trigger_start() - the bursts begin when TIM1 is enabled (servo_timers_run())
+ */
+
+#ifndef ADC_TRIGGER_H
+#define ADC_TRIGGER_H
+
+#include "main.h"
+#include <stdint.h>
+
+#define ADC_TRIGGER_PERIOD_US 2500          // must divide SERVO_TIMER_PERIOD_US
+#define ADC_TRIGGER_PHASE_US 2300           // start of the burst inside the trigger period
+#define ADC_TRIGGER_BURST_SCANS 8           // scans per trigger (max. 8 with 2 channels = 16 ranks)
+#define ADC_TRIGGER_SCAN_US 14              // 2 x (71.5 + 12.5) cycles at 12MHz ADC clock
+#define ADC_TRIGGER_INJECTED_US 42          // VREFINT + temperature: 2 x (239.5 + 12.5) cycles (>= 17.1us sampling)
+#define ADC_TRIGGER_QUIET_WINDOW 1          // 1 = burst must not overlap any servo pulse edge
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Extend the regular sequence to the burst length, add VREFINT / temperature as
+ *        auto injected group and set up TIM4 as trigger source
+ * @param hadc: ADC with the 2 channel scan of MX_ADC1_Init (external trigger T4_CC4)
+ * @return HAL_OK if ADC and timer accepted the configuration
+ */
+HAL_StatusTypeDef adc_trigger_init(ADC_HandleTypeDef *hadc);
+
+/**
+ * @brief Arm the trigger timer - it starts together with TIM1
+ */
+void adc_trigger_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_TRIGGER_H
@@ -0,0 +1,84 @@
+/**
+ * @file altitude_fusion.h
+ * @brief Complementary baro / GNSS fusion: drift corrected MSL altitude, baro vertical speed
+ *
+ * The barometric altitude (standard atmosphere, VarioEstimator output) is smooth and
+ * fast but carries an offset to MSL that changes with the weather (QNH) and the sensor
+ * temperature. The GNSS altitude has no drift but several meters of noise and arrives
+ * at 2..10Hz with latency. The fusion keeps the baro path for the dynamics and
+ * estimates only the slow offset from the GNSS epochs:
+ *   altitude_MSL = baro_altitude - offset
+ *   vario        = baro vario (no GNSS latency in the vertical speed)
+ *
+ * The offset is a one state Kalman filter with a random walk of FUSION_OFFSET_DRIFT
+ * m/sqrt(s) between epochs and the vertical accuracy of the fix as measurement noise.
+ * The baro altitude is extrapolated with the vario to the epoch timestamp before the
+ * difference is taken. Epochs further than FUSION_GATE sigma away are rejected, after
+ * FUSION_MAX_REJECTS rejected epochs in a row the offset restarts at the measurement.
+ *
+ * Usage:
+ * 1. updateBaro() with every filtered baro sample
+ * 2. updateGnss() once per new 3D fix epoch
+ * 3. getAltitudeMSL() / getVario(), hasGnss() = offset is GNSS referenced
+ */
+
+#ifndef ALTITUDE_FUSION_H
+#define ALTITUDE_FUSION_H
+
+#include <stdint.h>
+
+#define FUSION_OFFSET_DRIFT 0.05f           // m/sqrt(s), ~3m per hour of weather change
+#define FUSION_GNSS_NOISE 4.0f              // m, used if the fix reports no vertical accuracy
+#define FUSION_GATE 5.0f                    // innovation limit in standard deviations
+#define FUSION_MAX_REJECTS 5                // rejected epochs in a row before the offset restarts
+#define FUSION_MAX_EXTRAPOLATION_US 500000  // epochs older / newer than this vs. the baro sample are dropped
+
+#ifdef __cplusplus
+
+class AltitudeFusion {
+public:
+    AltitudeFusion();
+
+    void reset(void);
+
+    /**
+     * @brief New baro sample - updates the fused altitude
+     * @param altitude_m: filtered baro altitude (standard atmosphere)
+     * @param vario_mps: baro vertical speed
+     * @param timestamp_us: time of the sample (timebase_micros() domain)
+     */
+    void updateBaro(float altitude_m, float vario_mps, uint32_t timestamp_us);
+
+    /**
+     * @brief New GNSS epoch with a 3D fix - corrects the baro offset
+     * @param msl_m: GNSS altitude above mean sea level
+     * @param accuracy_m: vertical accuracy estimate, <= 0 = FUSION_GNSS_NOISE
+     * @param timestamp_us: time of the epoch (timebase_micros() domain)
+     * @return false if the epoch was not used (no baro yet, too old, outlier)
+     */
+    bool updateGnss(float msl_m, float accuracy_m, uint32_t timestamp_us);
+
+    float getAltitudeMSL(void) const { return m_altitude; }
+    float getVario(void) const { return m_vario; }
+    float getOffset(void) const { return m_offset; }
+    float getOffsetStd(void) const;
+    bool hasGnss(void) const { return m_gnssValid; }
+
+private:
+    float m_baroAltitude;
+    float m_vario;
+    uint32_t m_baroTimestamp_us;
+    bool m_baroValid;
+
+    float m_offset;                         // baro - MSL
+    float m_p;                              // offset variance
+    uint32_t m_gnssTimestamp_us;
+    uint8_t m_rejects;
+    bool m_gnssValid;
+
+    float m_altitude;                       // fused MSL
+};
+
+#endif // __cplusplus
+
+#endif // ALTITUDE_FUSION_H
@@ -0,0 +1,42 @@
+/**
+ * @file baro_altitude.h
+ * @brief Pressure -> altitude (standard atmosphere) without powf
+ *
+ * h = 44330m * (1 - (p / 101325Pa)^0.1903) costs a soft-float powf() (log + exp,
+ * thousands of cycles) per sample on the Cortex-M3. Here h(p) is tabulated every
+ * 512Pa from 300hPa to 1114hPa and interpolated with a second order (Newton forward
+ * difference) polynomial through three neighbouring points - integer only, no
+ * division. The interpolation error is below 4mm over 300..1100hPa (test_baro_altitude
+ * against the formula), the table takes 640 bytes of flash.
+ *
+ * Pressures outside the table are clamped to its ends.
+ *
+ * Usage:
+ *   altitude_mm = baro_altitude_mm(sample.pressure_q8);
+ */
+
+#ifndef BARO_ALTITUDE_H
+#define BARO_ALTITUDE_H
+
+#include <stdint.h>
+
+#define BARO_ALTITUDE_P_MIN_PA 30000        // first table point
+#define BARO_ALTITUDE_STEP_SHIFT 9          // 512Pa between the table points
+#define BARO_ALTITUDE_POINTS 160            // up to 111408Pa
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Standard atmosphere altitude (QNE, 1013.25hPa)
+ * @param pressure_q8: static pressure in Pa << 8
+ * @return altitude in mm
+ */
+int32_t baro_altitude_mm(int32_t pressure_q8);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BARO_ALTITUDE_H
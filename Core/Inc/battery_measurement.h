@@ -0,0 +1,120 @@
+/**
+ * @file battery_measurement.h
+ * @brief Fixed point ADC -> battery voltage / current conversion with integer IIR filter
+ *
+ * The Cortex-M3 has no FPU - every float multiply or divide is a soft-float library call.
+ * All scale factors (reference voltage, 12bit range, AdcSampler result scale, divider,
+ * shunt, gain) are folded at compile time into one Q16 multiplier per channel. The
+ * per-result work is one IIR step and one 32x32->64 bit multiply per channel:
+ *
+ *   filt_q8 += (result << 8 - filt_q8) * alpha_q16 >> 16
+ *   mV       = filt_q8 * scale_q16 >> 24
+ *
+ * Supply compensation: the scale constants assume VDDA = BAT_ADC_VREF_MV. Once per result
+ * the filtered VREFINT reading gives the real VDDA as ratio nominal / measured, the scale
+ * multipliers are corrected with it (one division per result, none per channel). The
+ * F103 has no factory VREFINT calibration (1.16 .. 1.24V), the static part of that error
+ * is removed by the gain calibration, regulator drift and ripple are removed by VREFINT.
+ *
+ * The internal temperature sensor is converted ratiometric to VREFINT as well
+ * (V25 = 1.43V, 4.3mV/C typical - board temperature, +-1.5C offset between chips), at
+ * the cost of two more integer divisions per result.
+ *
+ * test/test_battery_measurement.cpp compares the pipeline with the former float code,
+ * the "bench" console command measures both in cycles on the target.
+ *
+ * The BAT_* scale / offset constants are the defaults. A board specific calibration
+ * (adc_calibration.h) replaces them once at boot via setCalibration().
+ *
+ * Usage:
+ * 1. setCalibration() if a stored calibration exists
+ * 2. update() with every new AdcSampler result
+ * 3. getVoltage_mV() / getCurrent_mA()
+ */
+
+#ifndef BATTERY_MEASUREMENT_H
+#define BATTERY_MEASUREMENT_H
+
+#include <stdint.h>
+#include "adc_sampler.h"
+
+#define BAT_ADC_VREF_MV 3300.0              // ADC reference (VDDA)
+#define BAT_ADC_FULL_SCALE 4095.0
+#define BAT_VOLTAGE_DIVIDER 11.0            // 10k and 1k resistors
+#define BAT_SHUNT_RESISTOR_OHMS 0.066
+#define BAT_ADC_GAIN 1.01
+#define BAT_VOLTAGE_OFFSET_MV 0
+#define BAT_CURRENT_OFFSET_MA 15
+#define BAT_IIR_ALPHA 0.239057              // IIR filter alpha coefficient (for Sample_frequency/20 cutoff)
+
+#define BAT_VREFINT_MV 1200                 // internal reference, STM32F103 typical
+#define BAT_TEMP_V25_01MV 14300             // temperature sensor voltage at 25C in 0.1mV
+#define BAT_TEMP_SLOPE_01MV 43              // 4.3mV/C in 0.1mV
+
+#define BAT_ADC_CHANNEL_VOLTAGE 0           // AdcSampler result index
+#define BAT_ADC_CHANNEL_CURRENT 1
+
+#ifdef __cplusplus
+
+// ADC LSB of one AdcSampler result in mV at the divider input / mA through the shunt, Q16
+static constexpr uint32_t BAT_VOLTAGE_SCALE_Q16 = (uint32_t)(BAT_ADC_VREF_MV / BAT_ADC_FULL_SCALE / (1 << ADC_SAMPLER_RESULT_SHIFT)
+                                                            * BAT_VOLTAGE_DIVIDER * BAT_ADC_GAIN * 65536.0 + 0.5);
+static constexpr uint32_t BAT_CURRENT_SCALE_Q16 = (uint32_t)(BAT_ADC_VREF_MV / BAT_ADC_FULL_SCALE / (1 << ADC_SAMPLER_RESULT_SHIFT)
+                                                            / BAT_SHUNT_RESISTOR_OHMS * BAT_ADC_GAIN * 65536.0 + 0.5);
+static constexpr int32_t BAT_IIR_ALPHA_Q16 = (int32_t)(BAT_IIR_ALPHA * 65536.0 + 0.5);
+// VREFINT result expected at VDDA = BAT_ADC_VREF_MV
+static constexpr uint32_t BAT_VREFINT_NOMINAL = (uint32_t)(BAT_VREFINT_MV / BAT_ADC_VREF_MV * BAT_ADC_FULL_SCALE
+                                                          * (1 << ADC_SAMPLER_RESULT_SHIFT) + 0.5);
+
+struct BatteryCalibration {
+    uint32_t voltageScale_q16;              // mV per ADC result LSB, Q16
+    int32_t  voltageOffset_mV;
+    uint32_t currentScale_q16;              // mA per ADC result LSB, Q16
+    int32_t  currentOffset_mA;
+};
+
+class BatteryMeasurement {
+public:
+    BatteryMeasurement();
+
+    /**
+     * @brief Filter and convert one AdcSampler result (integer only)
+     * @param adc_results: ADC_SAMPLER_RESULTS values in ADC counts << ADC_SAMPLER_RESULT_SHIFT
+     */
+    void update(const uint16_t *adc_results);
+
+    int32_t getVoltage_mV(void) const { return m_voltage_mV; }
+    int32_t getCurrent_mA(void) const { return m_current_mA; }
+    int32_t getVdda_mV(void) const { return m_vdda_mV; }
+    int16_t getTemperature_dC(void) const { return m_temperature_dC; }   // 0.1 C
+
+    void setCalibration(const BatteryCalibration &calibration);
+    BatteryCalibration getCalibration(void) const;
+    static BatteryCalibration defaultCalibration(void);
+
+    // filtered, supply corrected ADC results << 8 - input of the calibration procedure
+    int32_t getVoltageRaw_q8(void) const { return (int32_t)(((int64_t)m_voltage_q8 * m_ratio_q16) >> 16); }
+    int32_t getCurrentRaw_q8(void) const { return (int32_t)(((int64_t)m_current_q8 * m_ratio_q16) >> 16); }
+
+private:
+    int32_t m_voltage_q8;                   // filtered ADC result << 8
+    int32_t m_current_q8;
+    int32_t m_vref_q8;
+    int32_t m_temperature_q8;
+    bool m_hasSample;
+
+    uint32_t m_voltageScale_q16;
+    uint32_t m_currentScale_q16;
+    int32_t m_voltageOffset_mV;
+    int32_t m_currentOffset_mA;
+
+    int32_t m_voltage_mV;
+    int32_t m_current_mA;
+    int32_t m_vdda_mV;
+    uint32_t m_ratio_q16;                   // VDDA / BAT_ADC_VREF_MV
+    int16_t m_temperature_dC;
+};
+
+#endif // __cplusplus
+
+#endif // BATTERY_MEASUREMENT_H
@@ -0,0 +1,84 @@
+/**
+ * @file battery_monitor.h
+ * @brief Coulomb counter, state of charge estimate and CRSF BATTERY_SENSOR (0x08) frame
+ *
+ * Fed with every BatteryMeasurement result:
+ * - consumed capacity: current * dt is integrated in mA*us (64 bit) with dt from the
+ *   monotonic microsecond timebase, whole mAh are carried out incrementally - no division
+ *   in the hot path
+ * - remaining: the pack voltage is compensated for the sag under load
+ *   (V + I * BAT_INTERNAL_RESISTANCE_MOHM) and mapped per cell through a LiPo resting
+ *   voltage -> state of charge LUT, then low pass filtered
+ * - cell count: BAT_CELL_COUNT or detected from the first valid voltage
+ *
+ * All values are integer (mV, mA, mAh, %).
+ *
+ * Usage:
+ * 1. update() with every new voltage / current result and timebase_micros()
+ * 2. encodeCrsfFrame() to build the BATTERY_SENSOR telemetry payload
+ */
+
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BAT_CELL_COUNT 0                    // 0 = detect from the voltage at power up
+#define BAT_CELL_MAX_MV 4350                // used for the cell count detection (HV LiPo)
+#define BAT_MIN_VALID_MV 2000               // below: no battery connected (USB powered)
+#define BAT_INTERNAL_RESISTANCE_MOHM 30     // whole pack incl. wiring, for the sag compensation
+#define BAT_MAX_DT_US 1000000               // longer gaps are not integrated (debugger halt)
+
+#define CRSF_FRAMETYPE_BATTERY_SENSOR_ID 0x08
+#define CRSF_BATTERY_SENSOR_PAYLOAD_SIZE 8
+
+#ifdef __cplusplus
+
+class BatteryMonitor {
+public:
+    BatteryMonitor();
+
+    /**
+     * @brief Integrate the current and update the state of charge
+     * @param now_us: monotonic microseconds (timebase_micros())
+     */
+    void update(int32_t voltage_mV, int32_t current_mA, uint32_t now_us);
+
+    /**
+     * @brief Start a new pack: consumed capacity 0, cell count detected again
+     */
+    void reset(void);
+
+    int32_t getVoltage_mV(void) const { return m_voltage_mV; }
+    int32_t getCurrent_mA(void) const { return m_current_mA; }
+    uint32_t getConsumed_mAh(void) const { return m_consumed_mAh; }
+    uint8_t getRemaining_pct(void) const { return (uint8_t)((m_remaining_q8 + 128) >> 8); }
+    uint8_t getCellCount(void) const { return m_cells; }
+    int32_t getCellVoltage_mV(void) const { return m_cells ? m_voltage_mV / m_cells : 0; }
+
+    /**
+     * @brief Build the CRSF BATTERY_SENSOR payload (big endian)
+     * @param payload: CRSF_BATTERY_SENSOR_PAYLOAD_SIZE bytes:
+     *                 voltage 0.1V (u16), current 0.1A (u16), capacity mAh (u24), remaining % (u8)
+     * @return payload size
+     */
+    size_t encodeCrsfFrame(uint8_t *payload) const;
+
+private:
+    int32_t m_voltage_mV;
+    int32_t m_current_mA;
+    uint64_t m_charge_mAus;                 // below one mAh
+    uint32_t m_consumed_mAh;
+    uint32_t m_lastUpdate_us;
+    uint16_t m_remaining_q8;                // % << 8
+    uint8_t m_cells;
+    bool m_hasUpdate;
+    bool m_hasSoc;
+
+    static uint16_t socFromCell_q8(int32_t cell_mV);
+};
+
+#endif // __cplusplus
+
+#endif // BATTERY_MONITOR_H
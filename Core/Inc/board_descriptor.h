@@ -0,0 +1,194 @@
+/**
+ * @file board_descriptor.h
+ * @brief Compile-time description of the servo outputs of a board
+ *
+ * A board lists its servo outputs as ServoOut<timer, channel> types:
+ *
+ *   typedef ServoOutputList< ServoOut<2,1>, ServoOut<2,2>, ServoOut<3,1>, ... > BoardServoOutputs;
+ *
+ * The list is checked at compile time (timer configured for servo PWM in this firmware,
+ * channel 1..4, no timer channel used twice) and generates the output code:
+ * - start():  starts all PWM channels, the slave timers first and TIM1 (sync master) last
+ * - update(): writes the compare registers grouped per timer. Each group is written with
+ *             the timer update event disabled (UDIS), so all channels of one timer switch
+ *             to their new values together at the next period. There is no table lookup
+ *             or pointer indirection per channel - every write is a store to a fixed
+ *             register address.
+ *
+ * The CCRx preload is enabled by HAL_TIM_PWM_ConfigChannel() in the MX_TIMx_Init code, so
+ * new values never cut into a running pulse.
+ *
+ * Adding a board: one header in Core/Inc/boards/ with the LED pin, BOARD_NUM_PWM_CHANNELS
+ * and the BoardServoOutputs list, selected via BOARD_HEADER in user_main.h.
+ */
+
+#ifndef BOARD_DESCRIPTOR_H
+#define BOARD_DESCRIPTOR_H
+
+#include "main.h"
+#include <stdint.h>
+
+#define BOARD_SERVO_PULSE_MIN_US 750
+#define BOARD_SERVO_PULSE_MAX_US 2250
+
+#ifdef __cplusplus
+
+extern TIM_HandleTypeDef htim1;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim3;
+
+// ============================================================================
+// Timers available for servo outputs (set up for 50Hz PWM by MX_TIMx_Init)
+// ============================================================================
+
+template <uint8_t TimerId> struct ServoTimer {
+    static const bool available = false;
+};
+
+template <> struct ServoTimer<1> {
+    static const bool available = true;
+    static const bool isSyncMaster = true;      // TIM1 releases TIM2/TIM3, see servo_timer_sync.h
+    static TIM_TypeDef* regs() { return TIM1; }
+    static TIM_HandleTypeDef* handle() { return &htim1; }
+};
+
+template <> struct ServoTimer<2> {
+    static const bool available = true;
+    static const bool isSyncMaster = false;
+    static TIM_TypeDef* regs() { return TIM2; }
+    static TIM_HandleTypeDef* handle() { return &htim2; }
+};
+
+template <> struct ServoTimer<3> {
+    static const bool available = true;
+    static const bool isSyncMaster = false;
+    static TIM_TypeDef* regs() { return TIM3; }
+    static TIM_HandleTypeDef* handle() { return &htim3; }
+};
+
+// ============================================================================
+// One servo output = one timer channel
+// ============================================================================
+
+template <uint8_t TimerId, uint8_t Channel> struct ServoOut {
+    static_assert(ServoTimer<TimerId>::available, "ServoOut: timer is not set up for servo PWM on this MCU (STM32F103: TIM1..TIM3)");
+    static_assert(Channel >= 1 && Channel <= 4, "ServoOut: timer channel must be 1..4");
+
+    static const uint8_t timer = TimerId;
+    static const uint8_t channel = Channel;
+
+    static void start() {
+        HAL_TIM_PWM_Start(ServoTimer<TimerId>::handle(), (Channel - 1) * 4U);   // TIM_CHANNEL_1..4
+    }
+
+    static void write(uint16_t pulse_us) {
+        if (pulse_us < BOARD_SERVO_PULSE_MIN_US) pulse_us = BOARD_SERVO_PULSE_MIN_US;
+        if (pulse_us > BOARD_SERVO_PULSE_MAX_US) pulse_us = BOARD_SERVO_PULSE_MAX_US;
+        (&ServoTimer<TimerId>::regs()->CCR1)[Channel - 1] = pulse_us;          // CCR1..CCR4 are consecutive
+    }
+};
+
+// ============================================================================
+// Compile-time helpers over the output list
+// ============================================================================
+
+namespace board_detail {
+
+// true if Out uses the same timer channel as one of Others
+template <typename Out, typename... Others> struct SameChannel;
+template <typename Out> struct SameChannel<Out> {
+    static const bool value = false;
+};
+template <typename Out, typename First, typename... Rest> struct SameChannel<Out, First, Rest...> {
+    static const bool value = (Out::timer == First::timer && Out::channel == First::channel) || SameChannel<Out, Rest...>::value;
+};
+
+template <typename... Outs> struct AllUnique;
+template <> struct AllUnique<> {
+    static const bool value = true;
+};
+template <typename First, typename... Rest> struct AllUnique<First, Rest...> {
+    static const bool value = !SameChannel<First, Rest...>::value && AllUnique<Rest...>::value;
+};
+
+template <uint8_t TimerId, typename... Outs> struct CountOnTimer;
+template <uint8_t TimerId> struct CountOnTimer<TimerId> {
+    static const uint8_t value = 0;
+};
+template <uint8_t TimerId, typename First, typename... Rest> struct CountOnTimer<TimerId, First, Rest...> {
+    static const uint8_t value = (First::timer == TimerId ? 1 : 0) + CountOnTimer<TimerId, Rest...>::value;
+};
+
+// compile-time selected write / start of a single output
+template <bool Selected> struct IfSelected {
+    template <typename Out> static void write(uint16_t) {}
+    template <typename Out> static void start() {}
+};
+template <> struct IfSelected<true> {
+    template <typename Out> static void write(uint16_t pulse_us) { Out::write(pulse_us); }
+    template <typename Out> static void start() { Out::start(); }
+};
+
+// all outputs of one timer, Index = position of the first output in the values array
+template <uint8_t TimerId, uint8_t Index, typename... Outs> struct TimerGroup;
+template <uint8_t TimerId, uint8_t Index> struct TimerGroup<TimerId, Index> {
+    static void write(const uint16_t *) {}
+    static void start() {}
+};
+template <uint8_t TimerId, uint8_t Index, typename First, typename... Rest> struct TimerGroup<TimerId, Index, First, Rest...> {
+    static void write(const uint16_t *values) {
+        IfSelected<First::timer == TimerId>::template write<First>(values[Index]);
+        TimerGroup<TimerId, Index + 1, Rest...>::write(values);
+    }
+    static void start() {
+        IfSelected<First::timer == TimerId>::template start<First>();
+        TimerGroup<TimerId, Index + 1, Rest...>::start();
+    }
+};
+
+// group write with the update event held back - only emitted for timers that have outputs
+template <bool Used, uint8_t TimerId, typename... Outs> struct TimerUpdate {
+    static void write(const uint16_t *) {}
+};
+template <uint8_t TimerId, typename... Outs> struct TimerUpdate<true, TimerId, Outs...> {
+    static void write(const uint16_t *values) {
+        TIM_TypeDef *tim = ServoTimer<TimerId>::regs();
+        tim->CR1 |= TIM_CR1_UDIS;
+        TimerGroup<TimerId, 0, Outs...>::write(values);
+        tim->CR1 &= ~TIM_CR1_UDIS;
+    }
+};
+
+} // namespace board_detail
+
+template <typename... Outs> struct ServoOutputList {
+    static const uint8_t size = sizeof...(Outs);
+    static_assert(sizeof...(Outs) > 0, "ServoOutputList: board without servo outputs");
+    static_assert(board_detail::AllUnique<Outs...>::value, "ServoOutputList: a timer channel is assigned to more than one servo output");
+
+    template <uint8_t TimerId> struct uses {
+        static const bool value = board_detail::CountOnTimer<TimerId, Outs...>::value > 0;
+    };
+
+    /**
+     * @brief Start the PWM of all outputs - slave timers first, the sync master TIM1 last
+     */
+    static void start() {
+        board_detail::TimerGroup<2, 0, Outs...>::start();
+        board_detail::TimerGroup<3, 0, Outs...>::start();
+        board_detail::TimerGroup<1, 0, Outs...>::start();
+    }
+
+    /**
+     * @brief Write new pulse lengths, values[i] belongs to the i-th output of the list
+     */
+    static void update(const uint16_t *values) {
+        board_detail::TimerUpdate<uses<1>::value, 1, Outs...>::write(values);
+        board_detail::TimerUpdate<uses<2>::value, 2, Outs...>::write(values);
+        board_detail::TimerUpdate<uses<3>::value, 3, Outs...>::write(values);
+    }
+};
+
+#endif // __cplusplus
+
+#endif // BOARD_DESCRIPTOR_H
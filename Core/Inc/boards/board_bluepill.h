@@ -0,0 +1,22 @@
+/**
+ * @file board_bluepill.h
+ * @brief BluePill (STM32F103C8) or other custom board - adjust the servo outputs to your wiring
+ */
+
+#ifndef BOARD_BLUEPILL_H
+#define BOARD_BLUEPILL_H
+
+#include "board_descriptor.h"
+
+#define BOARD_NAME "BluePill"
+#define BOARD_LED_GPIO_Port GPIOB
+#define BOARD_LED_Pin GPIO_PIN_2
+#define BOARD_NUM_PWM_CHANNELS 10
+
+#ifdef __cplusplus
+//   Servo Channel number         1              2              3              4              5              6              7              8              9              10
+typedef ServoOutputList<ServoOut<2,1>, ServoOut<2,2>, ServoOut<3,1>, ServoOut<3,2>, ServoOut<3,3>, ServoOut<3,4>, ServoOut<1,1>, ServoOut<1,2>, ServoOut<1,3>, ServoOut<1,4> > BoardServoOutputs;
+static_assert(BoardServoOutputs::size == BOARD_NUM_PWM_CHANNELS, "BluePill: BOARD_NUM_PWM_CHANNELS does not match the output list");
+#endif
+
+#endif // BOARD_BLUEPILL_H
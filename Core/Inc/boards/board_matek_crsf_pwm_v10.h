@@ -0,0 +1,27 @@
+/**
+ * @file board_matek_crsf_pwm_v10.h
+ * @brief MatekSys CRSF_PWM_V10 servo output mapping
+ *
+ * Servo 3 of the Matek board is wired to TIM16 CH1. TIM16 does not exist on the
+ * STM32F103 this firmware is built for, so this board does not compile here. It
+ * fails in ServoOut with "timer is not set up for servo PWM" and needs a port of the
+ * timer setup first.
+ */
+
+#ifndef BOARD_MATEK_CRSF_PWM_V10_H
+#define BOARD_MATEK_CRSF_PWM_V10_H
+
+#include "board_descriptor.h"
+
+#define BOARD_NAME "MatekSys CRSF_PWM_V10"
+#define BOARD_LED_GPIO_Port GPIOC
+#define BOARD_LED_Pin GPIO_PIN_14
+#define BOARD_NUM_PWM_CHANNELS 10
+
+#ifdef __cplusplus
+//   Servo Channel number         1              2              3               4              5              6              7              8              9              10
+typedef ServoOutputList<ServoOut<2,1>, ServoOut<2,2>, ServoOut<16,1>, ServoOut<2,3>, ServoOut<3,4>, ServoOut<3,3>, ServoOut<3,2>, ServoOut<3,1>, ServoOut<1,1>, ServoOut<1,2> > BoardServoOutputs;
+static_assert(BoardServoOutputs::size == BOARD_NUM_PWM_CHANNELS, "Matek CRSF_PWM_V10: BOARD_NUM_PWM_CHANNELS does not match the output list");
+#endif
+
+#endif // BOARD_MATEK_CRSF_PWM_V10_H
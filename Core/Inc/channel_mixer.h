@@ -0,0 +1,91 @@
+/**
+ * @file channel_mixer.h
+ * @brief CRSF channel -> servo output mixer with reverse, subtrim, endpoints and expo
+ *
+ * Every output takes one or two CRSF channels (e.g. elevon / V-tail mixes), weights
+ * them and maps the result through a per-output lookup table. The LUT holds the
+ * complete output curve (expo, reverse, endpoints, subtrim and pulse clamp) and is
+ * recalculated only when the configuration of that output changes.
+ *
+ * The per-frame work in process() is integer only: two multiplies for the mix and
+ * one linear interpolation between two LUT points per output.
+ *
+ * Usage:
+ * 1. setDefaults() - 1:1 routing CRSF channel n+1 -> output n, no curves
+ * 2. configure() the outputs that need more than that
+ * 3. process() on every servo update with the latest CRSF channel values in us
+ */
+
+#ifndef CHANNEL_MIXER_H
+#define CHANNEL_MIXER_H
+
+#include <stdint.h>
+
+#define MIXER_NUM_INPUTS 16     // CRSF channels
+#define MIXER_NUM_OUTPUTS 10    // servo outputs (>= num_PWM_channels)
+
+#define MIXER_CENTER_US 1500
+#define MIXER_OUTPUT_MIN_US 750    // same pulse limits as BOARD_SERVO_PULSE_MIN/MAX_US
+#define MIXER_OUTPUT_MAX_US 2250
+
+#define MIXER_LUT_SHIFT 4                                  // 16us input step between LUT points
+#define MIXER_LUT_RANGE 512                                // LUT covers -512 .. +512us around center
+#define MIXER_LUT_SIZE ((2 * MIXER_LUT_RANGE >> MIXER_LUT_SHIFT) + 1)
+
+#ifdef __cplusplus
+
+struct MixerOutputConfig {
+    uint8_t sourceA;        // CRSF channel 1..16
+    int8_t  weightA;        // -100 .. 100 %
+    uint8_t sourceB;        // CRSF channel 1..16, 0 = no second input
+    int8_t  weightB;        // -100 .. 100 %
+    bool    reverse;
+    int16_t subtrim;        // us, added to the output center
+    uint8_t endpointLow;    // travel below center in % (100 = 1:1), 0..150
+    uint8_t endpointHigh;   // travel above center in % (100 = 1:1), 0..150
+    uint8_t expo;           // 0 = linear .. 100 = pure cubic
+};
+
+class ChannelMixer {
+public:
+    ChannelMixer();
+
+    /**
+     * @brief Reset all outputs to 1:1 routing (CRSF channel n+1 -> output n) without curves
+     */
+    void setDefaults(void);
+
+    /**
+     * @brief Set the configuration of one output and rebuild its lookup table
+     * @return false if output or source channels are out of range
+     *
+     * Example elevon on outputs 0/1 with aileron on CH1 and elevator on CH2:
+     *   {1, 50, 2, 50, ...} and {1, -50, 2, 50, ...}
+     */
+    bool configure(uint8_t output, const MixerOutputConfig &config);
+
+    const MixerOutputConfig& getConfig(uint8_t output) const { return m_config[output]; }
+
+    /**
+     * @brief Mix the CRSF channels into servo pulse lengths (integer only)
+     * @param channels_us: MIXER_NUM_INPUTS CRSF channel values in us, index 0 = CH1
+     * @param outputs_us: num_outputs pulse lengths in us
+     */
+    void process(const uint16_t *channels_us, uint16_t *outputs_us, uint8_t num_outputs) const;
+
+private:
+    MixerOutputConfig m_config[MIXER_NUM_OUTPUTS];
+
+    // precomputed per output - only touched by configure()
+    uint8_t m_indexA[MIXER_NUM_OUTPUTS];
+    uint8_t m_indexB[MIXER_NUM_OUTPUTS];
+    int16_t m_weightA_q7[MIXER_NUM_OUTPUTS];   // 128 = 100 %
+    int16_t m_weightB_q7[MIXER_NUM_OUTPUTS];
+    int16_t m_lut[MIXER_NUM_OUTPUTS][MIXER_LUT_SIZE];
+
+    void buildLUT(uint8_t output);
+};
+
+#endif // __cplusplus
+
+#endif // CHANNEL_MIXER_H
@@ -0,0 +1,57 @@
+/**
+ * @file flash_record.h
+ * @brief CRC protected record in a flash page reserved by the linker script
+ *
+ * Layout from the start of the page, programmed in words: magic, version, payload,
+ * CRC32 (IEEE, over magic, version and payload). A record is valid if magic, version
+ * and CRC match - an erased page (all 0xFF), an older layout or an interrupted write
+ * are rejected and the caller keeps its defaults.
+ *
+ * Erasing / programming the page stalls the CPU for 20..40ms (no interrupt runs, flash
+ * is not readable meanwhile, DMA transfers continue). Callers decide when that is
+ * acceptable, see adc_calibration.h and gnss_cache.h.
+ *
+ * Usage:
+ * 1. extern "C" const uint32_t _xxx_start[]; from the linker script region
+ * 2. flash_record_read() at boot, flash_record_write() / flash_record_erase() at runtime
+ */
+
+#ifndef FLASH_RECORD_H
+#define FLASH_RECORD_H
+
+#include "main.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_RECORD_OVERHEAD 12            // magic, version, CRC
+#define FLASH_RECORD_MAX_PAYLOAD (FLASH_PAGE_SIZE - FLASH_RECORD_OVERHEAD)
+
+#ifdef __cplusplus
+
+/**
+ * @brief CRC32 (IEEE 802.3, reflected, init and final XOR 0xFFFFFFFF)
+ */
+uint32_t flash_record_crc32(const void *data, size_t length);
+
+/**
+ * @brief Copy the payload of a valid record
+ * @param page: start of the flash page
+ * @param size: payload size, multiple of 4, <= FLASH_RECORD_MAX_PAYLOAD
+ * @return false if there is no valid record, payload unchanged
+ */
+bool flash_record_read(const uint32_t *page, uint32_t magic, uint32_t version, void *payload, size_t size);
+
+/**
+ * @brief Erase the page and program the record
+ */
+HAL_StatusTypeDef flash_record_write(const uint32_t *page, uint32_t magic, uint32_t version, const void *payload,
+                                     size_t size);
+
+/**
+ * @brief Erase the page - no valid record until the next write
+ */
+HAL_StatusTypeDef flash_record_erase(const uint32_t *page);
+
+#endif // __cplusplus
+
+#endif // FLASH_RECORD_H
@@ -0,0 +1,73 @@
+/**
+ * @file gnss_cache.h
+ * @brief GNSS warm start record in flash: last good position, UTC time and clock state
+ *
+ * Without backup power the u-blox module loses its position and time and every boot is
+ * a cold start. The firmware keeps the last good fix in its own flash page (GNSS_CACHE
+ * region of STM32F103XX_FLASH.ld, next to the ADC calibration; record format in
+ * flash_record.h) and hands it to the GNSS wrapper, which sends it as UBX-MGA-INI
+ * aiding after the bring-up. The PPS clock error is stored with it, so the disciplined
+ * clock starts with the known crystal offset.
+ *
+ * The record is written at most once per boot (gnss_cache_task()): 3D fix with valid
+ * time, hAcc <= GNSS_CACHE_MAX_HACC_MM, on the ground (speed <= GNSS_CACHE_MAX_SPEED_MMS)
+ * and held for GNSS_CACHE_SAVE_DELAY_MS - typically half a minute after the boot, before
+ * the take-off. Erasing / programming the page stalls the CPU for 20..40ms, the same as
+ * the ADC calibration save: the CRSF bytes wait in the circular RX DMA buffer, the
+ * outputs hold their last pulse, a GNSS epoch may be lost. The link state does not
+ * matter, the record is written while the transmitter is on. One write per boot keeps
+ * the flash within its 10k erase cycles for the life of the board.
+ *
+ * Usage:
+ * 1. gnss_cache_load() before the GNSS bring-up, setWarmStart() / presetFrequency()
+ * 2. gnss_cache_task() with every new epoch
+ */
+
+#ifndef GNSS_CACHE_H
+#define GNSS_CACHE_H
+
+#include "main.h"
+#include <stdint.h>
+
+#define GNSS_CACHE_MAGIC 0x474E5331UL      // "GNS1"
+#define GNSS_CACHE_VERSION 1
+#define GNSS_CACHE_MAX_HACC_MM 10000        // position good enough to be stored
+#define GNSS_CACHE_MAX_SPEED_MMS 1000       // stored on the ground only (flash write stall)
+#define GNSS_CACHE_SAVE_DELAY_MS 30000      // fix held this long before the record is written
+
+#ifdef __cplusplus
+#include "ublox_gnss_wrapper.h"
+
+struct GnssCacheData {
+    GnssWarmStart warmStart;
+    int32_t clockError_ppb;                 // PpsClock frequency error
+    uint8_t clockValid;                     // clockError_ppb is from a locked PpsClock
+    uint8_t reserved[3];
+};
+
+/**
+ * @brief Read the stored record
+ * @return false if there is no valid record (erased page, old version, CRC error)
+ */
+bool gnss_cache_load(GnssCacheData *data);
+
+/**
+ * @brief Write the record to flash
+ */
+HAL_StatusTypeDef gnss_cache_save(const GnssCacheData &data);
+
+/**
+ * @brief Erase the stored record - the next boot is a cold start
+ */
+HAL_StatusTypeDef gnss_cache_erase(void);
+
+/**
+ * @brief Save policy: call with every new epoch, writes the record once per boot
+ * @param clockError_ppb: PpsClock frequency error, used if clockValid
+ * @return true if the record was written by this call
+ */
+bool gnss_cache_task(const GnssSnapshot &gnss, uint32_t now_ms, int32_t clockError_ppb, bool clockValid);
+
+#endif // __cplusplus
+
+#endif // GNSS_CACHE_H
@@ -0,0 +1,66 @@
+/**
+ * @file ground_calibration.h
+ * @brief Ground level reference for AGL altitude, ends on convergence instead of a fixed count
+ *
+ * Running mean and variance of the barometric altitude (Welford). The calibration is
+ * complete as soon as the standard error of the mean sqrt(var / n) drops below
+ * GROUND_CAL_MAX_SEM_M with at least GROUND_CAL_MIN_SAMPLES samples - typically 1..3s
+ * at 8Hz. A disturbed start (handling, wind) is closed after GROUND_CAL_MAX_SAMPLES
+ * with the mean so far. The first GROUND_CAL_SKIP_SAMPLES after a (re)start are
+ * skipped, they still contain the sensor start up.
+ *
+ * rezero() starts a new calibration in the background: the previous ground altitude
+ * stays in use until the new one is complete, AGL does not jump meanwhile.
+ *
+ * Usage:
+ * 1. update() with every altitude sample
+ * 2. isReady() - a ground altitude exists, AGL values / telemetry are valid
+ * 3. getGroundAltitude(); rezero() restarts the calibration (CLI / CRSF switch),
+ *    isCalibrating() until it is complete
+ */
+
+#ifndef GROUND_CALIBRATION_H
+#define GROUND_CALIBRATION_H
+
+#include <stdint.h>
+
+#define GROUND_CAL_SKIP_SAMPLES 2
+#define GROUND_CAL_MIN_SAMPLES 8            // 1s at 8Hz
+#define GROUND_CAL_MAX_SAMPLES 80           // 10s at 8Hz
+#define GROUND_CAL_MAX_SEM_M 0.05f          // standard error of the mean for "converged"
+#define GROUND_CAL_CRSF_CHANNEL 0           // 1..16: re-zero switch channel, 0 = off
+#define GROUND_CAL_CRSF_HOLD_MS 1000        // switch high time before the re-zero starts
+
+#ifdef __cplusplus
+
+class GroundCalibration {
+public:
+    GroundCalibration();
+
+    void rezero(void);
+
+    /**
+     * @brief Add one altitude sample while calibrating
+     * @return true when this sample completed the calibration
+     */
+    bool update(float altitude_m);
+
+    bool isReady(void) const { return m_ready; }
+    bool isCalibrating(void) const { return m_calibrating; }
+    float getGroundAltitude(void) const { return m_ground; }
+    uint16_t getSampleCount(void) const { return m_count; }     // of the running / last calibration
+    float getStandardError(void) const;
+
+private:
+    uint8_t m_skip;
+    uint16_t m_count;
+    float m_mean;
+    float m_m2;                             // sum of squared deviations
+    float m_ground;                         // last completed calibration
+    bool m_calibrating;
+    bool m_ready;
+};
+
+#endif // __cplusplus
+
+#endif // GROUND_CALIBRATION_H
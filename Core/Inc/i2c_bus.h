@@ -0,0 +1,203 @@
+/**
+ * @file i2c_bus.h
+ * @brief Interrupt driven I2C transaction queue with per-device scheduling and statistics
+ *
+ * Sensor accesses are described by I2cTransaction descriptors (write, read or
+ * write-read with repeated START) and handed to the bus with submit(). The queue holds
+ * I2C_BUS_QUEUE_SIZE descriptors; the transfers run back to back from the HAL I2C
+ * interrupt callbacks, including the START of the next queued transaction on a free
+ * bus. The main loop never waits on the bus - completion is reported through the
+ * descriptor status and an optional callback, which runs in interrupt context and must
+ * be short.
+ *
+ * Starting a transfer: the next descriptor is claimed with interrupts disabled, the HAL
+ * start function is called with interrupts enabled and only on a free bus. The HAL
+ * itself polls the BUSY flag for up to 25ms before a START; instead the bus waits at most
+ * I2C_BUS_STOP_WAIT_US for the STOP of the previous transfer and otherwise leaves the
+ * START to schedule(). In interrupt context it does not wait at all: a START that follows
+ * a transfer with STOP is issued by the next schedule() (the repeated START of a
+ * write-read needs no free bus and still follows from the interrupt).
+ *
+ * Timeout: a transaction that has not completed - or could not even start because BUSY
+ * stays set - I2C_BUS_TIMEOUT_US after its claim or START ends with I2C_STATUS_TIMEOUT.
+ * The bus is then recovered like the Arduino cores do it: up to 9 SCL clocks by GPIO
+ * until the slave releases SDA, a STOP, and a peripheral reset (F103 BUSY flag errata).
+ *
+ * Devices that are read at a fixed rate are registered with addPeriodic(): schedule()
+ * (main loop) re-submits the descriptor every period_us as soon as the previous
+ * transaction of that device has completed, so a slow device can not pile up the queue.
+ * setPeriodicEnabled() suspends a slot while its device is not usable (bring-up, retry).
+ *
+ * Statistics: every transaction records its latency (submit -> done) and bus time
+ * (START -> done) in us, the bus keeps counters, the maximum latency and the busy time
+ * for the utilisation since resetStats().
+ *
+ * The descriptors and their buffers are owned by the caller and must stay valid until
+ * the status is no longer I2C_STATUS_QUEUED / I2C_STATUS_BUSY. The bus owns the HAL
+ * handle; nothing else may start transfers on it. Arduino code uses Wire
+ * (stm32_arduino_compatibility.h), a blocking facade that submits to this bus.
+ *
+ * Transfers use the HAL interrupt mode, not DMA: sensor transactions are a few bytes (the
+ * SPL06 coefficient block with 18 bytes is the longest), and I2C1_RX is DMA1 Channel 7,
+ * which the PPM output (TIM4_UP) and SBUS on USART2 use. USART2 itself runs without DMA.
+ *
+ * Host test: test/test_i2c_bus.cpp on the HAL I2C mock in test/host/i2c_mock.h.
+ *
+ * Usage:
+ * 1. addPeriodic() for cyclic reads, submit() for single transactions
+ * 2. schedule() from the main loop (periodic submits, transfer timeout)
+ * 3. onTransferDone() from the HAL I2C callbacks
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "main.h"
+#include <stdint.h>
+
+#define I2C_BUS_QUEUE_SIZE 8                // pending transactions (power of two)
+#define I2C_BUS_MAX_PERIODIC 4              // devices with periodic transactions
+#define I2C_BUS_TIMEOUT_US 5000             // transfer time limit before the bus is reset
+#define I2C_BUS_STOP_WAIT_US 25             // main loop wait for BUSY to clear before a START (2.5 bit times at 100kHz)
+#define I2C_BUS_MIN_CLOCK_HZ 10000
+#define I2C_BUS_MAX_CLOCK_HZ 400000         // F1 fast mode
+
+// pins of hi2c1 for the bus recovery (I2C1 remapped, see stm32f1xx_hal_msp.c)
+#define I2C_BUS_SCL_GPIO_Port GPIOB
+#define I2C_BUS_SCL_Pin GPIO_PIN_8
+#define I2C_BUS_SDA_GPIO_Port GPIOB
+#define I2C_BUS_SDA_Pin GPIO_PIN_9
+
+#ifdef __cplusplus
+
+enum I2cStatus : uint8_t {
+    I2C_STATUS_IDLE = 0,                    // never submitted
+    I2C_STATUS_QUEUED,
+    I2C_STATUS_BUSY,
+    I2C_STATUS_DONE,
+    I2C_STATUS_NACK,
+    I2C_STATUS_ERROR,                       // bus error, arbitration lost, HAL refused the start
+    I2C_STATUS_TIMEOUT
+};
+
+struct I2cTransaction;
+typedef void (*I2cCallback)(I2cTransaction *transaction);
+
+struct I2cTransaction {
+    uint8_t address;                        // 7 bit device address
+    const uint8_t *txData;                  // e.g. register address, nullptr / 0 = read only
+    uint8_t txLength;
+    uint8_t *rxData;                        // nullptr / 0 = write only
+    uint8_t rxLength;
+    I2cCallback callback;                   // optional, interrupt context
+    void *context;                          // free for the callback
+
+    volatile I2cStatus status;
+    uint32_t submit_us;
+    uint32_t start_us;
+    uint32_t latency_us;                    // submit -> done
+    uint32_t busTime_us;                    // START -> done
+};
+
+struct I2cBusStats {
+    uint32_t transactions;
+    uint32_t errors;                        // NACK, bus errors and timeouts
+    uint32_t timeouts;
+    uint32_t queueFull;                     // rejected submits
+    uint32_t maxLatency_us;
+    uint32_t busy_us;                       // summed bus time
+    uint32_t elapsed_us;                    // since resetStats()
+};
+
+class I2cBus {
+public:
+    explicit I2cBus(I2C_HandleTypeDef *hi2c);
+
+    /**
+     * @brief Queue a transaction (NON-BLOCKING), starts it right away if the bus is idle
+     * @return false if the queue is full or the descriptor is still pending
+     */
+    bool submit(I2cTransaction *transaction);
+
+    /**
+     * @brief Submit a transaction every period_us from schedule()
+     * @return false if all I2C_BUS_MAX_PERIODIC slots are used
+     */
+    bool addPeriodic(I2cTransaction *transaction, uint32_t period_us);
+
+    /**
+     * @brief Suspend / resume the periodic submits of a descriptor registered with addPeriodic()
+     * @note A transaction already queued still completes; resuming submits on the next schedule()
+     */
+    void setPeriodicEnabled(I2cTransaction *transaction, bool enabled);
+
+    /**
+     * @brief Give up a pending transaction with I2C_STATUS_TIMEOUT (main loop)
+     *
+     * A queued descriptor is dropped from the queue, a running transfer is aborted and
+     * the bus recovered like after a timeout. The descriptor is free again afterwards.
+     * @return false if the transaction was not pending
+     */
+    bool cancel(I2cTransaction *transaction);
+
+    /**
+     * @brief Re-initialise the peripheral with a new SCL clock (main loop)
+     * @param clock_hz: 100000 standard mode, 400000 fast mode (clamped to 10kHz..400kHz)
+     * @return false if a transaction is pending or the HAL refused the configuration
+     */
+    bool setClock(uint32_t clock_hz);
+
+    /**
+     * @brief Main loop hook: periodic submits, deferred START, timeout and bus recovery
+     * @param now_us: timebase_micros()
+     */
+    void schedule(uint32_t now_us);
+
+    /**
+     * @brief Transfer complete / error - call from the HAL I2C callbacks
+     */
+    void onTransferDone(I2C_HandleTypeDef *hi2c, bool error);
+
+    bool isIdle(void) const { return m_current == nullptr && m_head == m_tail; }
+    void getStats(I2cBusStats *stats, uint32_t now_us) const;
+    void resetStats(uint32_t now_us);
+
+    /**
+     * @brief Bus utilisation since resetStats() in 0.1%
+     */
+    uint16_t getUtilisation_permille(uint32_t now_us) const;
+
+private:
+    struct Periodic {
+        I2cTransaction *transaction;
+        uint32_t period_us;
+        uint32_t next_us;
+        bool enabled;
+    };
+
+    void startNext(void);
+    void startCurrent(void);
+    bool waitBusFree(void) const;
+    void finish(I2cStatus status);
+    void complete(I2cStatus status);
+    void abort(I2cTransaction *transaction);
+    void recoverBus(void);
+
+    I2C_HandleTypeDef *m_hi2c;
+    I2cTransaction *m_queue[I2C_BUS_QUEUE_SIZE];
+    volatile uint8_t m_head;                // written by submit()
+    volatile uint8_t m_tail;                // written by the interrupt
+    I2cTransaction *volatile m_current;
+    volatile bool m_rxPhase;                // write-read: write done, read running
+    volatile bool m_startPending;           // m_current claimed, START not issued yet
+
+    Periodic m_periodic[I2C_BUS_MAX_PERIODIC];
+    uint8_t m_numPeriodic;
+
+    I2cBusStats m_stats;
+    uint32_t m_statsStart_us;
+};
+
+#endif // __cplusplus
+
+#endif // I2C_BUS_H
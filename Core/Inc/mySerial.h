@@ -6,12 +6,24 @@
 #include "stm32f1xx_hal.h"
 #include <cstddef>
 
+struct SerialStats {
+    uint32_t rxBytes;           // bytes received by the RX interrupt / the RX DMA
+    uint32_t rxOverflows;       // bytes lost because the RX FIFO was full (oldest dropped), interrupt mode only
+    uint32_t overrunErrors;     // UART ORE: byte lost in hardware, RX interrupt served too late
+    uint32_t framingErrors;     // UART FE: baud rate mismatch or line noise
+    uint32_t noiseErrors;       // UART NE
+};
+
 class mySerial {
 public:
     mySerial();
     ~mySerial();
 
-    void init(UART_HandleTypeDef *huart, size_t fifo_buffer_size = 256, size_t tx_UART_buffer_size = 4);
+    // rx_dma: DMA1 channel of the UART RX request - the RX FIFO becomes a circular DMA buffer,
+    // bytes keep arriving while the CPU is stalled (flash erase), nullptr = one RX interrupt per byte
+    // rx_fifo_size: 0 = fifo_buffer_size (TX and RX FIFO the same size)
+    void init(UART_HandleTypeDef *huart, size_t fifo_buffer_size = 256, size_t tx_UART_buffer_size = 4,
+              DMA_Channel_TypeDef *rx_dma = nullptr, size_t rx_fifo_size = 0);
   
     size_t write(const uint8_t *input_array, size_t len);
  	size_t read(uint8_t *output_array, size_t len);
@@ -19,6 +31,7 @@ public:
     size_t available();
 	size_t fifo_reset(void);
 	int8_t restart_RX();
+    int8_t setBaudRate(uint32_t baudrate);  // re-init the UART at a new baud rate, clears both FIFOs and re-arms RX
 	int8_t receive();// re-arm UART RX interrupt for next byte - should be called in UART RX callback after processing the received byte to ensure continuous reception
     int8_t send();
     int8_t flush(uint32_t flush_timeout);    // Flush the TX FIFO and wait until all data is sent and the UART is ready for next transmission
@@ -27,10 +40,14 @@ public:
     bool is_idle_TX();  // check if UART transmission is idle
     bool is_idle_RX();  // check if UART not waiting for data -> might require restart_RX() to re-arm UART RX interrupt
     bool isInitialized() const { return m_initialized; }  // check if init() has been called
+    void onError();     // for the UART error callback: count the error and re-arm RX if the HAL stopped reception
+    const SerialStats &getStats() const { return m_stats; }
+    void resetStats();
 	uint8_t* get_uart_rx_buffer();
 
 private:
     UART_HandleTypeDef *m_huart;
+    DMA_Channel_TypeDef *m_rx_dma = nullptr;
     bool m_huart_tx_ready, m_huart_rx_ready;
     bool m_initialized = false;  // guard against uninitialized usage
 	const bool m_isTX=1;
@@ -38,6 +55,7 @@ private:
     uint8_t *m_tx_fifo;
     uint8_t *m_rx_fifo;
     size_t m_fifo_size;
+    size_t m_rx_fifo_size;
     size_t m_tx_fifo_head;
     size_t m_tx_fifo_tail;
     size_t m_rx_fifo_head;
@@ -47,12 +65,15 @@ private:
     size_t m_uart_tx_buffer_size;
 	size_t m_uart_rx_buffer_size=1;
     uint32_t m_flush_timeout = 1000; // default flush timeout in milliseconds
+    SerialStats m_stats = SerialStats();
 
     size_t fifo_free_space(bool m_isTX) ;
     size_t fifo_data_length(bool m_isTX) ;
 
     void fifo_push(bool isTX, uint8_t c);
     uint8_t fifo_pop(bool isTX);
+    void start_RX();            // interrupt: receive the next byte, DMA: restart the circular transfer
+    void update_RX_DMA();       // RX FIFO head from the DMA transfer counter
     int8_t updateSerial();
     
 
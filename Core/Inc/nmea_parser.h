@@ -0,0 +1,143 @@
+/**
+ * @file nmea_parser.h
+ * @brief Streaming NMEA 0183 sentence parser and GGA / RMC / VTG decoder
+ *
+ * Byte wise state machine for "$<address>,<field>,...*hh<CR><LF>" without heap or
+ * Arduino shims. The characters between '$' and '*' are stored in a fixed buffer and
+ * XOR-ed along the way; each ',' is replaced by a terminator in place, so the fields
+ * are C strings inside the buffer and only their start offsets are kept. parse()
+ * returns true for a complete sentence with a valid checksum. Sentences without a
+ * checksum, longer than NMEA_MAX_SENTENCE or with more than NMEA_MAX_FIELDS fields are
+ * dropped; a '$' inside a sentence starts a new one.
+ *
+ * The sentence type is the formatter of the address field, the talker is ignored
+ * (GPGGA, GNGGA, GLGGA, ... are all GGA). Decoding is integer only:
+ * - ddmm.mmmmm / dddmm.mmmmm + hemisphere -> degrees * 10^-7 (7 minute decimals kept,
+ *   rounded on the division by 60)
+ * - speed in knots -> mm/s, course -> degrees * 10^-5, altitude -> mm, DOP -> 0.01
+ * - hhmmss.sss -> ms of the UTC day, ddmmyy -> year / month / day
+ * Empty fields (no fix yet) leave the corresponding "valid" flag false.
+ * The host test test/test_nmea_parser.cpp checks the reference sentences of NMEA 0183
+ * and the u-blox documentation and the wrapper's NMEA fallback.
+ *
+ * Usage:
+ * 1. parse() for every received byte
+ * 2. on true: getType(), then decodeGga() / decodeRmc() / decodeVtg()
+ */
+
+#ifndef NMEA_PARSER_H
+#define NMEA_PARSER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NMEA_MAX_SENTENCE 96                // '$' to <LF>; NMEA 0183 allows 82, some receivers exceed it
+#define NMEA_MAX_FIELDS 24                  // address field included; GSV / GSA are the longest
+
+#ifdef __cplusplus
+
+enum NmeaSentence : uint8_t {
+    NMEA_OTHER,
+    NMEA_GGA,
+    NMEA_RMC,
+    NMEA_VTG
+};
+
+struct NmeaGga {
+    uint32_t time_ms;                       // UTC time of day of the fix
+    int32_t lat, lon;                       // deg * 1e-7
+    int32_t altitudeMSL;                    // mm
+    uint16_t hDOP;                          // 0.01
+    uint8_t quality;                        // 0 none, 1 GPS, 2 DGPS, 4 RTK fixed, 5 RTK float, 6 dead reckoning
+    uint8_t numSV;
+    bool timeValid;
+    bool positionValid;
+    bool altitudeValid;
+    bool hDOPValid;
+};
+
+struct NmeaRmc {
+    uint32_t time_ms;                       // UTC time of day of the fix
+    int32_t lat, lon;                       // deg * 1e-7
+    int32_t speed;                          // mm/s over ground
+    int32_t course;                         // deg * 1e-5, course over ground
+    uint16_t year;
+    uint8_t month, day;
+    char mode;                              // NMEA 2.3+: 'A' autonomous, 'D' differential, 'E' estimated, 'N' no fix; 0 if absent
+    bool active;                            // status 'A'
+    bool timeValid;
+    bool dateValid;
+    bool positionValid;
+    bool speedValid;
+    bool courseValid;
+};
+
+struct NmeaVtg {
+    int32_t speed;                          // mm/s over ground
+    int32_t course;                         // deg * 1e-5, true course over ground
+    char mode;                              // as NmeaRmc::mode
+    bool speedValid;
+    bool courseValid;
+};
+
+struct NmeaParserStats {
+    uint32_t sentences;                     // valid sentences of any type
+    uint32_t checksumErrors;
+    uint32_t dropped;                       // too long, too many fields, no checksum, invalid character
+};
+
+class NmeaParser {
+public:
+    NmeaParser();
+
+    void reset(void);
+
+    /**
+     * @brief Feed one received byte
+     * @return true if it completed a sentence with a valid checksum
+     */
+    bool parse(uint8_t byte);
+
+    /**
+     * @brief Type of the last sentence, from the formatter of its address field
+     */
+    NmeaSentence getType(void) const;
+
+    uint8_t getFieldCount(void) const { return m_fieldCount; }
+
+    /**
+     * @brief Field of the last sentence as C string, "" beyond the last field
+     * @param index: 0 = address field ("GPGGA")
+     */
+    const char *getField(uint8_t index) const;
+
+    // decode the last sentence, false if it is not this type or too short
+    bool decodeGga(NmeaGga *gga) const;
+    bool decodeRmc(NmeaRmc *rmc) const;
+    bool decodeVtg(NmeaVtg *vtg) const;
+
+    const NmeaParserStats &getStats(void) const { return m_stats; }
+
+private:
+    enum State : uint8_t {
+        STATE_START,
+        STATE_DATA,
+        STATE_CK_1,
+        STATE_CK_2
+    };
+
+    void drop(void);
+
+    State m_state;
+    uint8_t m_length;
+    uint8_t m_fieldCount;
+    uint8_t m_checksum;
+    uint8_t m_received;
+    uint8_t m_fields[NMEA_MAX_FIELDS];      // start offsets in m_buffer
+    char m_buffer[NMEA_MAX_SENTENCE];       // between '$' and '*', ',' replaced by '\0'
+    NmeaParserStats m_stats;
+};
+
+#endif // __cplusplus
+
+#endif // NMEA_PARSER_H
@@ -0,0 +1,81 @@
+/**
+ * @file output_filter.h
+ * @brief Per-channel servo output filter: inter-frame interpolation and slew rate limit
+ *
+ * The servo outputs are updated every ms, the CRSF frames arrive every 2..20ms (or
+ * less often on a lossy link). Each output channel can run in one of three modes:
+ * - OUTPUT_FILTER_NONE:        output jumps to the new frame value (no added latency,
+ *                              default - use for primary control surfaces)
+ * - OUTPUT_FILTER_INTERPOLATE: linear ramp from the current output to the new frame
+ *                              value over one measured frame interval
+ * - OUTPUT_FILTER_SLEW:        output moves towards the frame value with a maximum
+ *                              speed in us per second (gear, flaps, ...)
+ *
+ * All state is Q16 fixed point (us << 16), no float and no division in update().
+ *
+ * Usage:
+ * 1. setMode() for the channels that need filtering
+ * 2. newFrame() whenever a new CRSF channel frame has been mixed
+ * 3. update() on every servo output update
+ */
+
+#ifndef OUTPUT_FILTER_H
+#define OUTPUT_FILTER_H
+
+#include <stdint.h>
+
+#define OUTPUT_FILTER_CHANNELS 10               // >= num_PWM_channels
+#define OUTPUT_FILTER_MAX_FRAME_MS 50           // limit of the frame interval estimate
+#define OUTPUT_FILTER_DEFAULT_FRAME_MS 20
+
+#ifdef __cplusplus
+
+enum OutputFilterMode : uint8_t {
+    OUTPUT_FILTER_NONE = 0,
+    OUTPUT_FILTER_INTERPOLATE,
+    OUTPUT_FILTER_SLEW
+};
+
+class OutputFilter {
+public:
+    OutputFilter();
+
+    /**
+     * @brief Select the filter mode of one output channel
+     * @param slew_us_per_s: max. output speed for OUTPUT_FILTER_SLEW (e.g. 500 = 1000us travel in 2s)
+     * @return false if channel is out of range
+     */
+    bool setMode(uint8_t channel, OutputFilterMode mode, uint16_t slew_us_per_s = 0);
+
+    /**
+     * @brief Load the targets of a new CRSF frame (call once per received frame)
+     * @param targets_us: mixed output values of the new frame in us
+     * @param now_ms: current time in ms (HAL_GetTick)
+     */
+    void newFrame(const uint16_t *targets_us, uint8_t num_channels, uint32_t now_ms);
+
+    /**
+     * @brief Advance all channels to now_ms and return the filtered outputs
+     */
+    void update(uint16_t *outputs_us, uint8_t num_channels, uint32_t now_ms);
+
+    uint32_t getFrameInterval(void) const { return m_frameInterval; }
+
+private:
+    OutputFilterMode m_mode[OUTPUT_FILTER_CHANNELS];
+    int32_t m_slewStep_q16[OUTPUT_FILTER_CHANNELS];     // max. change per ms
+    int32_t m_output_q16[OUTPUT_FILTER_CHANNELS];       // current output
+    int32_t m_start_q16[OUTPUT_FILTER_CHANNELS];        // output at frame arrival
+    int32_t m_rampStep_q16[OUTPUT_FILTER_CHANNELS];     // interpolation step per ms
+    int32_t m_target_q16[OUTPUT_FILTER_CHANNELS];
+
+    uint32_t m_frameTime;        // ms of the last newFrame()
+    uint32_t m_lastUpdate;       // ms of the last update()
+    uint32_t m_frameInterval;    // filtered frame interval in ms
+    bool m_hasFrame;
+    bool m_hasInterval;
+};
+
+#endif // __cplusplus
+
+#endif // OUTPUT_FILTER_H
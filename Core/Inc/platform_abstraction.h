@@ -39,6 +39,7 @@ public:
     int read() override;
     size_t write(uint8_t b) override;
     size_t write(const uint8_t *buf, size_t len) override;
+    bool setBaudRate(uint32_t baudrate) override;
     
     // Access to underlying mySerial for advanced operations
     mySerial* getSerial() { return _serial; }
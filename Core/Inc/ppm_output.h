@@ -0,0 +1,73 @@
+/**
+ * @file ppm_output.h
+ * @brief PPM (CPPM) frame encoder and DMA driven PPM generator
+ *
+ * The PPM signal is generated by a timer in PWM mode: the compare value is the fixed
+ * mark pulse, the auto reload value is the length of the current slot. A circular DMA
+ * channel triggered by the timer update event loads the next slot length into ARR,
+ * so the timer runs through the frame on its own. setChannels() only rewrites the
+ * slot table in RAM.
+ *
+ * With ARR preload enabled the value written at update n is used for slot n+1 - the
+ * slot table is therefore sent rotated by one, which does not matter for a repeating
+ * frame.
+ *
+ * Default resources: TIM4 CH4 on PB9 with TIM4_UP on DMA1 Channel 7. PB9 is shared
+ * with the (remapped) I2C1 SDA - only enable PPM_OUTPUT_ENABLED when the baro sensor
+ * is not used.
+ */
+
+#ifndef PPM_OUTPUT_H
+#define PPM_OUTPUT_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define PPM_OUTPUT_ENABLED 0            // 1 = generate PPM on PPM_TIM / PPM_TIM_CHANNEL
+
+#define PPM_TIM TIM4
+#define PPM_TIM_CHANNEL TIM_CHANNEL_4
+#define PPM_DMA_CHANNEL DMA1_Channel7   // TIM4_UP request
+#define PPM_GPIO_PORT GPIOB
+#define PPM_GPIO_PIN GPIO_PIN_9
+
+#define PPM_NUM_CHANNELS 8
+#define PPM_FRAME_US 22500              // complete frame incl. sync gap
+#define PPM_MARK_US 300                 // pulse between the channels
+#define PPM_MIN_SYNC_US 4000            // sync gap is never shorter than this
+
+#ifdef __cplusplus
+
+/**
+ * @brief Build the timer slot table (ARR values, 1 tick = 1us) of one PPM frame
+ * @param slots: output table of num_channels+1 entries, the last one is the sync gap
+ * @param channels_us: channel values in us (clamped to 800..2200us)
+ * @return number of slots written (num_channels+1)
+ */
+size_t ppm_encode_frame(uint16_t *slots, const uint16_t *channels_us, uint8_t num_channels);
+
+class PpmOutput {
+public:
+    PpmOutput();
+
+    /**
+     * @brief Configure the timer, the output compare channel and the circular update DMA
+     * @param htim: handle with Instance set to the PPM timer (is initialised here)
+     * @param invert: false = positive mark pulses, true = inverted signal
+     */
+    bool init(TIM_HandleTypeDef *htim, uint32_t tim_channel, DMA_Channel_TypeDef *dma_update, bool invert = false);
+
+    /**
+     * @brief Update the slot table from new channel values - picked up by the DMA from the next slot on
+     */
+    void setChannels(const uint16_t *channels_us, uint8_t num_channels);
+
+private:
+    TIM_HandleTypeDef *m_htim;
+    uint16_t m_slots[PPM_NUM_CHANNELS + 1];
+};
+
+#endif // __cplusplus
+
+#endif // PPM_OUTPUT_H
@@ -0,0 +1,151 @@
+/**
+ * @file pps_clock.h
+ * @brief GNSS timepulse (PPS) capture and a disciplined clock: timebase_micros() -> GPS time
+ *
+ * The u-blox TIMEPULSE output (default 1Hz, rising edge at the top of the GNSS second)
+ * is wired to PPS_GPIO_PIN. All timer channels of the STM32F103 are used by the servo
+ * outputs, the ADC trigger and the UART / I2C pins, so the edge is captured by the EXTI
+ * interrupt instead of a timer input capture: the handler reads DWT->CYCCNT as its
+ * first instruction (72MHz, 13.9ns resolution, constant entry latency subtracted) and
+ * converts it with timebase_at_cycles(). Jitter comes from interrupts of the same
+ * priority that are running at the edge (a few us at most), the loop filter averages it.
+ *
+ * The GNSS second of a pulse is taken from the next NAV-PVT epoch: the epoch belongs to
+ * the second of the pulse if it was received between 0 and PPS_MAX_EPOCH_LATENCY_MS
+ * after its own epoch time (pulse + iTOW % 1000).
+ *
+ * Loop filter, per labeled pulse n seconds after the previous one:
+ *   predicted = anchor + n * (1s + frequency error)       (local time of the pulse)
+ *   residual  = captured - predicted
+ *   anchor    = predicted + residual / 2^PPS_PHASE_SHIFT
+ *   frequency += residual / 2^PPS_FREQ_SHIFT / n
+ * The first two pulses set anchor and frequency directly (the first one only with
+ * presetFrequency()). Residuals above
+ * PPS_MAX_RESIDUAL_NS are rejected, PPS_MAX_REJECTS in a row restart the acquisition.
+ * Between pulses (and in holdover) the conversion extrapolates with the frequency error.
+ *
+ * Usage:
+ * 1. pps_capture_init() once in user_init(), after timebase_init()
+ * 2. pps_capture_read() in the main loop -> PpsClock::addPulse()
+ * 3. PpsClock::addEpoch() for every NAV-PVT epoch with a valid fix
+ * 4. toGnssTime() for any timebase_micros() timestamp, toGnssInterval() / getFrequencyError_ppb()
+ *    to correct durations measured with the local clock
+ */
+
+#ifndef PPS_CLOCK_H
+#define PPS_CLOCK_H
+
+#include "main.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PPS_GPIO_PORT GPIOB
+#define PPS_GPIO_PIN GPIO_PIN_5             // free on both boards, EXTI line 5
+#define PPS_EXTI_IRQn EXTI9_5_IRQn
+#define PPS_IRQ_PRIORITY 0                  // highest preemption level, shared with ADC DMA / I2C / CRSF UART
+#define PPS_CAPTURE_LATENCY_CYCLES 14       // edge -> CYCCNT read: synchroniser, 12 cycle stacking, first load
+
+#define PPS_MAX_EPOCH_LATENCY_MS 500        // epoch reception after its epoch time, for labeling a pulse
+#define PPS_MAX_GAP_S 8                     // longer without a usable pulse: acquisition restarts, not locked
+#define PPS_MAX_FREQ_ERROR_PPB 200000       // local clock vs. GNSS, crystal + tolerance
+#define PPS_MAX_RESIDUAL_NS 20000           // larger pulse residuals are rejected as glitches
+#define PPS_MAX_REJECTS 4                   // rejected pulses in a row before the acquisition restarts
+#define PPS_PHASE_SHIFT 2                   // phase gain 1/4
+#define PPS_FREQ_SHIFT 4                    // frequency gain 1/16
+#define PPS_LOCK_NS 5000                    // residual limit for "locked"
+#define PPS_LOCK_PULSES 4                   // pulses in a row within PPS_LOCK_NS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configure PPS_GPIO_PIN as rising edge EXTI input and enable its interrupt
+ */
+void pps_capture_init(void);
+
+/**
+ * @brief Get the last captured pulse, once per pulse
+ * @param timestamp_us: output, timebase_micros() at the edge
+ * @param fraction_ns: output, sub-microsecond part
+ * @return true if a pulse arrived since the last call
+ */
+bool pps_capture_read(uint32_t *timestamp_us, uint16_t *fraction_ns);
+
+#ifdef __cplusplus
+}
+
+struct PpsClockStats {
+    uint32_t pulses;                        // captured
+    uint32_t used;                          // labeled and accepted by the loop filter
+    uint32_t unlabeled;                     // no matching epoch in time
+    uint32_t rejected;                      // residual above PPS_MAX_RESIDUAL_NS
+    uint32_t restarts;
+    int32_t lastResidual_ns;
+};
+
+class PpsClock {
+public:
+    PpsClock();
+
+    void reset(void);
+
+    /**
+     * @brief Start value of the frequency error (stored from an earlier run) - the first
+     *        acquisition skips the frequency measurement over two pulses
+     */
+    void presetFrequency(int32_t frequency_ppb);
+
+    /**
+     * @brief Captured timepulse edge - labeled by the next addEpoch()
+     */
+    void addPulse(uint32_t timestamp_us, uint16_t fraction_ns);
+
+    /**
+     * @brief NAV-PVT epoch with a valid fix
+     * @param iTOW: GPS time of week of the epoch, ms
+     * @param timestamp_us: reception of the epoch (timebase_micros())
+     */
+    void addEpoch(uint32_t iTOW, uint32_t timestamp_us);
+
+    /**
+     * @brief Convert a timebase_micros() timestamp to GPS time of week
+     * @param timestamp_us: within +-35 minutes of the last pulse
+     * @param tow_ns: output, GPS time of week in ns
+     * @return false before the first labeled pulse
+     */
+    bool toGnssTime(uint32_t timestamp_us, uint64_t *tow_ns) const;
+
+    /**
+     * @brief Local duration corrected by the frequency error (GNSS microseconds)
+     */
+    uint32_t toGnssInterval(uint32_t interval_us) const;
+
+    int32_t getFrequencyError_ppb(void) const { return m_frequency_ppb; }   // > 0: local clock fast
+    bool isLocked(void) const { return m_lockCount >= PPS_LOCK_PULSES; }
+    const PpsClockStats &getStats(void) const { return m_stats; }
+
+private:
+    void discipline(uint32_t tow_ms);
+    void restart(uint32_t tow_ms);
+
+    uint32_t m_pulseUs;
+    uint16_t m_pulseNs;
+    bool m_pulsePending;
+
+    uint32_t m_anchorUs;                    // filtered local time of the GNSS second m_anchorTow_ms
+    uint16_t m_anchorNs;
+    uint32_t m_anchorTow_ms;
+    bool m_anchorValid;
+    bool m_frequencyValid;
+    bool m_frequencyPreset;
+    int32_t m_frequency_ppb;
+    uint8_t m_rejects;
+    uint8_t m_lockCount;
+
+    PpsClockStats m_stats;
+};
+
+#endif // __cplusplus
+
+#endif // PPS_CLOCK_H
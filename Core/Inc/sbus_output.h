@@ -0,0 +1,85 @@
+/**
+ * @file sbus_output.h
+ * @brief SBUS frame encoder and DMA driven SBUS transmitter
+ *
+ * Re-emits the CRSF channels as SBUS (100000 baud, 8E2) for legacy flight controllers
+ * and gimbals. The frame is packed in software and handed to a DMA channel that
+ * feeds the UART TX register - no interrupts and no CPU time per byte.
+ *
+ * Note: SBUS is an inverted signal. The STM32F1 USART can not invert its TX line,
+ * an external inverter (single transistor or 74HC04) is required.
+ *
+ * Usage:
+ * 1. assign a free UART with UART_ROLE_SBUS in uart_config.h
+ * 2. init() once - reconfigures the UART to 100000 8E2 and sets up the TX DMA channel
+ * 3. send() every SBUS_FRAME_INTERVAL_MS with the current channel values in us
+ */
+
+#ifndef SBUS_OUTPUT_H
+#define SBUS_OUTPUT_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define SBUS_BAUDRATE 100000
+#define SBUS_FRAME_SIZE 25
+#define SBUS_NUM_CHANNELS 16
+#define SBUS_HEADER 0x0F
+#define SBUS_FOOTER 0x00
+#define SBUS_FRAME_INTERVAL_MS 14   // 14ms = standard, 7ms = high speed mode
+
+// flags byte (frame byte 23)
+#define SBUS_FLAG_CH17 0x01
+#define SBUS_FLAG_CH18 0x02
+#define SBUS_FLAG_FRAME_LOST 0x04
+#define SBUS_FLAG_FAILSAFE 0x08
+
+#ifdef __cplusplus
+
+/**
+ * @brief Convert a pulse length in us to the 11 bit SBUS value (988us = 172, 1500us = 992, 2012us = 1811)
+ *
+ * Rounded down, 0 at or below 880us, 2047 from 2160us.
+ */
+uint16_t sbus_us_to_value(uint16_t us);
+
+/**
+ * @brief Pack 16 channels and the flags into a 25 byte SBUS frame
+ * @param frame: output buffer of SBUS_FRAME_SIZE bytes
+ * @param channels_us: SBUS_NUM_CHANNELS channel values in us
+ * @return number of bytes written (SBUS_FRAME_SIZE)
+ */
+size_t sbus_encode_frame(uint8_t *frame, const uint16_t *channels_us, uint8_t flags);
+
+class SbusOutput {
+public:
+    SbusOutput();
+
+    /**
+     * @brief Reconfigure the UART for SBUS and prepare the TX DMA channel
+     * @param huart: UART used for SBUS (TX only)
+     * @param dma_tx: DMA1 channel of the UART TX request (USART1: Ch4, USART2: Ch7, USART3: Ch2)
+     * @return true if the UART could be reconfigured
+     */
+    bool init(UART_HandleTypeDef *huart, DMA_Channel_TypeDef *dma_tx);
+
+    /**
+     * @brief Pack a new frame and start its DMA transfer (NON-BLOCKING)
+     * @return false if not initialised or the previous frame is still on the wire
+     */
+    bool send(const uint16_t *channels_us, uint8_t flags);
+
+    bool isBusy(void) const;
+    uint32_t getFrameCount(void) const { return m_frameCount; }
+
+private:
+    UART_HandleTypeDef *m_huart;
+    DMA_Channel_TypeDef *m_dma;
+    uint8_t m_frame[SBUS_FRAME_SIZE];
+    uint32_t m_frameCount;
+};
+
+#endif // __cplusplus
+
+#endif // SBUS_OUTPUT_H
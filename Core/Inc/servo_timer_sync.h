@@ -0,0 +1,69 @@
+/**
+ * @file servo_timer_sync.h
+ * @brief Master/slave synchronisation of the servo PWM timers TIM1/TIM2/TIM3
+ *
+ * TIM1 is the master: its counter enable is routed to TRGO and TIM2/TIM3 run in
+ * trigger slave mode on ITR0 (= TIM1 on the STM32F103). The slave counters are
+ * preloaded before the master starts, so every timer keeps a fixed phase offset
+ * to TIM1 for the whole runtime.
+ *
+ * With the default offsets the servo pulses of the three timer groups do not
+ * overlap (max. pulse length is 2250us), which spreads the servo inrush current
+ * on the BEC rail (and on the current shunt) over three separate windows.
+ * test/test_servo_stagger.cpp compares peak current, rail ripple and bat_current noise
+ * of a simulated load in phase and staggered.
+ *
+ * Usage:
+ * 1. Call servo_timers_sync_init() once in user_init() (after the MX_TIMx_Init calls)
+ * 2. servo_timers_run() to start the synchronised counters (no pulses yet, the ADC
+ *    trigger of adc_trigger.h runs with them)
+ * 3. Start the PWM outputs with servo_timers_start() instead of HAL_TIM_PWM_Start()
+ */
+
+#ifndef SERVO_TIMER_SYNC_H
+#define SERVO_TIMER_SYNC_H
+
+#include "main.h"
+#include <stdint.h>
+
+// Servo frame period in timer ticks (1 tick = 1us with prescaler 72-1)
+#define SERVO_TIMER_PERIOD_US 20000
+
+// Phase offset of the slave timers to TIM1 in us (0 .. SERVO_TIMER_PERIOD_US-1)
+// set both to 0 for all pulses starting at the same time (in sync)
+#define SERVO_PHASE_TIM2_US 2500
+#define SERVO_PHASE_TIM3_US 5000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configure TIM1 as master and TIM2/TIM3 as triggered slaves with phase offset
+ * @param tim2_phase_us: delay of the TIM2 pulses after the TIM1 pulses in us
+ * @param tim3_phase_us: delay of the TIM3 pulses after the TIM1 pulses in us
+ * @return HAL_OK if all timers accepted the configuration
+ *
+ * Must be called while the timers are still stopped.
+ */
+HAL_StatusTypeDef servo_timers_sync_init(uint16_t tim2_phase_us, uint16_t tim3_phase_us);
+
+/**
+ * @brief Enable TIM1 - releases all slave timers with their phase offset, outputs stay off
+ */
+void servo_timers_run(void);
+
+/**
+ * @brief Start all PWM channels of the board (BoardServoOutputs)
+ *
+ * The slave channels are armed first, the TIM1 channels last - enabling TIM1
+ * releases the slave counters with their preloaded phase offset (if servo_timers_run()
+ * has not done that already).
+ */
+void servo_timers_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERVO_TIMER_SYNC_H
@@ -0,0 +1,117 @@
+/**
+ * @file spl06_async.h
+ * @brief Non-blocking SPL06-001 barometer driver on the I2cBus transaction queue
+ *
+ * The sensor runs in background mode (continuous pressure and temperature
+ * measurements). The driver never waits on the bus: bring-up (product ID, coefficient
+ * ready, 18 byte coefficient block, configuration) is a state machine advanced by
+ * update() from the main loop with one queued transaction at a time, afterwards one
+ * periodic 6 byte burst read of PSR_B2..TMP_B0 (registers 0x00..0x05) per sample.
+ *
+ * Compensation (datasheet chapter 4.9) in 64 bit integer math, the scaled raw values
+ * Praw/kP and Traw/kT in Q20:
+ *   Pcomp = c00 + Praw_sc*(c10 + Praw_sc*(c20 + Praw_sc*c30))
+ *         + Traw_sc*(c01 + Praw_sc*(c11 + Praw_sc*c21))
+ *   Tcomp = c0/2 + c1*Traw_sc
+ * The one division per raw value uses the oversampling scale factor kP / kT.
+ *
+ * Every sample carries the time of its burst read (timebase_micros()) and a sequence
+ * number. Without a sensor the driver retries the bring-up every SPL06_RETRY_US; the
+ * periodic burst is suspended on the bus until the sensor is running again.
+ *
+ * Usage:
+ * 1. begin() once, after the I2C peripheral is initialised
+ * 2. update() from the main loop (after I2cBus::schedule())
+ * 3. getSample() - sequence changes with every new sample
+ */
+
+#ifndef SPL06_ASYNC_H
+#define SPL06_ASYNC_H
+
+#include "main.h"
+#include <stdint.h>
+#include "i2c_bus.h"
+
+#define SPL06_I2C_ADDRESS 0x76              // SDO low, 0x77 with SDO high
+#define SPL06_PRODUCT_ID 0x10
+#define SPL06_PRESSURE_OVERSAMPLING 4       // PM_PRC code: 4 = 16x (27.6ms per measurement)
+#define SPL06_TEMPERATURE_OVERSAMPLING 0    // TMP_PRC code: 0 = single (3.6ms)
+#define SPL06_MEASUREMENT_RATE 4            // PM_RATE / TMP_RATE code: 4 = 16 per second
+#define SPL06_READ_PERIOD_US 125000         // burst read period (8Hz)
+#define SPL06_RETRY_US 1000000              // bring-up retry after a failure
+#define SPL06_MAX_READ_ERRORS 8             // consecutive failed bursts before a new bring-up
+
+#ifdef __cplusplus
+
+struct Spl06Sample {
+    int32_t pressure_q8;                    // Pa << 8
+    int16_t temperature_cC;                 // 0.01 C
+    uint32_t timestamp_us;                  // start of the burst read
+    uint32_t sequence;                      // 0 = no sample yet
+};
+
+class Spl06Async {
+public:
+    Spl06Async(I2cBus *bus, uint8_t address = SPL06_I2C_ADDRESS);
+
+    void begin(void);
+
+    /**
+     * @brief Advance the bring-up, convert a completed burst read (NON-BLOCKING)
+     * @param now_us: timebase_micros()
+     */
+    void update(uint32_t now_us);
+
+    bool isRunning(void) const { return m_state == STATE_RUNNING; }
+    void getSample(Spl06Sample *sample) const { *sample = m_sample; }
+    uint32_t getSequence(void) const { return m_sample.sequence; }
+    uint32_t getErrorCount(void) const { return m_errors; }
+
+private:
+    enum State : uint8_t {
+        STATE_IDLE,
+        STATE_PROBE,                        // PRODUCT_ID (0x0D)
+        STATE_WAIT_READY,                   // MEAS_CFG (0x08) COEF_RDY + SENSOR_RDY
+        STATE_READ_COEF,                    // COEF (0x10..0x21)
+        STATE_READ_COEF_SOURCE,             // COEF_SRCE (0x28) - temperature sensor of the coefficients
+        STATE_CONFIGURE,                    // PRS_CFG, TMP_CFG, CFG_REG, MEAS_CFG
+        STATE_RUNNING,
+        STATE_FAILED                        // wait SPL06_RETRY_US
+    };
+
+    void startRead(uint8_t reg, uint8_t length);
+    void startWrite(uint8_t reg, uint8_t value);
+    void transactionDone(uint32_t now_us);
+    void parseCoefficients(void);
+    void compensate(const uint8_t *raw, uint32_t timestamp_us);
+    void fail(uint32_t now_us);
+    static void onBurstRead(I2cTransaction *transaction);
+
+    I2cBus *m_bus;
+    uint8_t m_address;
+    State m_state;
+    uint8_t m_configStep;
+    uint8_t m_coefSource;
+    uint32_t m_waitUntil_us;
+    volatile uint32_t m_readErrors;         // consecutive failed bursts, written by the callback
+    uint32_t m_errors;
+    bool m_periodicAdded;
+
+    I2cTransaction m_setup;                 // bring-up transactions, one at a time
+    uint8_t m_setupTx[2];
+    uint8_t m_setupRx[18];
+
+    I2cTransaction m_burst;                 // periodic PSR + TMP burst
+    uint8_t m_burstReg;
+    uint8_t m_burstRx[6];
+    uint8_t m_raw[6];                       // copy of the last burst, written by the callback
+    volatile uint32_t m_rawTimestamp_us;
+    volatile bool m_rawReady;
+
+    int32_t m_c0, m_c1, m_c00, m_c10, m_c01, m_c11, m_c20, m_c21, m_c30;
+    Spl06Sample m_sample;
+};
+
+#endif // __cplusplus
+
+#endif // SPL06_ASYNC_H
@@ -6,7 +6,7 @@
  * with STM32 HAL without the Arduino framework. It includes:
  * - Basic type definitions
  * - Stream class for serial communication
- * - Stub classes for Wire (I2C) and SPI
+ * - TwoWire (I2C) on the I2cBus, stub class for SPI
  * - Timing functions (millis, micros, delay)
  */
 
@@ -23,6 +23,7 @@
 #ifdef __cplusplus
 #include <cstdio>
 #include <cstdarg>
+#include "i2c_bus.h"
 #endif
 
 // ============================================================================
@@ -62,7 +63,8 @@ uint32_t millis(void);
 
 /**
  * @brief Get microseconds since system start
- * Derived from core clock and HAL timer
+ * Derived from core clock and HAL timer (SysTick), free running with the crystal.
+ * Timestamps that are converted to GNSS time use timebase_micros() and PpsClock.
  */
 uint32_t micros(void);
 
@@ -118,6 +120,12 @@ public:
      */
     virtual void flush(void) {}
     
+    /**
+     * @brief Change the baud rate of the underlying UART (pending data is dropped)
+     * @return false if the port does not support it
+     */
+    virtual bool setBaudRate(uint32_t baudrate) { (void)baudrate; return false; }
+    
     /**
      * @brief Read data into buffer (non-blocking)
      */
@@ -280,31 +288,71 @@ extern STM32Serial* GetSerialRef(void);
 // Wire (I2C) Stub Class
 // ============================================================================
 
+#define WIRE_BUFFER_SIZE 32                 // Arduino default, max. bytes per transmission / requestFrom
+#define WIRE_DEFAULT_TIMEOUT_US 25000       // blocking facade timeout per transfer, incl. the queue wait
+
+/**
+ * @brief Arduino TwoWire as a thin blocking facade over the I2cBus (i2c_bus.h)
+ *
+ * Each transfer becomes one I2cTransaction: submitted to the bus, then the facade waits
+ * for its status and keeps calling I2cBus::schedule() meanwhile (deferred START, bus
+ * timeout). After setWireTimeout() without a final status the transaction is cancelled,
+ * a running transfer ends with the bus recovery of the I2cBus. Main loop only.
+ *
+ * endTransmission(false) does not put anything on the bus yet: the following
+ * requestFrom() to the same address runs as one write-read transaction with a repeated
+ * START - the usual "write register address, read registers" sequence of sensor
+ * libraries. A write NACK of that sequence shows up as requestFrom() returning 0.
+ *
+ * endTransmission() results: 0 ok, 1 data too long, 2 NACK (the bus does not tell
+ * address and data NACK apart), 4 other error, 5 timeout
+ */
 class TwoWire {
 public:
-    TwoWire() {}
-    TwoWire(int sda, int scl) { (void)sda; (void)scl; }  // Constructor for compatibility with SPL06
+    TwoWire();                              // on the firmware I2cBus of hi2c1
+    TwoWire(int sda, int scl);              // pins are fixed by the I2C handle, kept for SPL06 compatibility
+    explicit TwoWire(I2cBus *bus);
     virtual ~TwoWire() {}
-    
-    // Stub methods - I2C not supported, only serial
-    void begin(uint8_t address = 0) {}
-    void begin(int sda, int scl) {}
+
+    void begin(uint8_t address = 0) { (void)address; }     // slave mode is not supported
+    void begin(int sda, int scl) { (void)sda; (void)scl; }
     void end() {}
-    void setClock(uint32_t freq) {}
-    void setClockStretchLimit(uint32_t limit) {}
-    
-    // Not implemented for STM32 UART-only operation
-    uint8_t requestFrom(uint8_t address, uint8_t quantity) { return 0; }
-    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) { return 0; }
-    void beginTransmission(uint8_t address) {}
-    uint8_t endTransmission(void) { return 4; }
-    uint8_t endTransmission(uint8_t sendStop) { return 4; }
-    size_t write(uint8_t data) { return 0; }
-    size_t write(const uint8_t *data, size_t quantity) { return 0; }
-    int read(void) { return -1; }
-    int available(void) { return 0; }
-    int peek(void) { return -1; }
+    void setClock(uint32_t freq);           // 100000 or 400000 (values in between are accepted)
+    void setClockStretchLimit(uint32_t limit) { (void)limit; }
+    void setWireTimeout(uint32_t timeout_us = WIRE_DEFAULT_TIMEOUT_US, bool reset_with_timeout = true);
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) { return requestFrom(address, quantity, (uint8_t)1); }
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop);
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(void) { return endTransmission((uint8_t)1); }
+    uint8_t endTransmission(uint8_t sendStop);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t quantity);
+    int read(void);
+    int available(void);
+    int peek(void);
     void flush(void) {}
+
+    bool getWireTimeoutFlag(void) const { return m_timeoutFlag; }
+    void clearWireTimeoutFlag(void) { m_timeoutFlag = false; }
+
+private:
+    uint8_t transfer(uint8_t txLength, uint8_t rxLength);
+    uint8_t flushPendingWrite(void);
+
+    I2cBus *m_bus;
+    uint32_t m_timeout_us;
+    bool m_timeoutFlag;
+    uint8_t m_txAddress;
+    uint8_t m_txBuffer[WIRE_BUFFER_SIZE];
+    uint8_t m_txLength;
+    bool m_transmitting;
+    bool m_overflow;
+    bool m_writePending;                    // endTransmission(false): joins the next requestFrom()
+    uint8_t m_rxBuffer[WIRE_BUFFER_SIZE];
+    uint8_t m_rxLength;
+    uint8_t m_rxIndex;
+    I2cTransaction m_transaction;
 };
 
 extern TwoWire Wire;
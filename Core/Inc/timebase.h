@@ -0,0 +1,51 @@
+/**
+ * @file timebase.h
+ * @brief Monotonic microsecond timebase from the Cortex-M3 DWT cycle counter
+ *
+ * The 32bit DWT->CYCCNT runs with the core clock (72MHz) and wraps after ~59s. Each
+ * call of timebase_micros() adds the cycles since the previous call to a microsecond
+ * counter, carrying the sub-microsecond remainder - no 64 bit division and no drift.
+ * The returned value wraps after ~71 minutes, differences (now - last) are wrap safe.
+ *
+ * timebase_micros() must be called at least every 59s (the ADC / telemetry tasks do).
+ *
+ * Usage:
+ * 1. timebase_init() once in user_init()
+ * 2. timebase_micros() from main loop or interrupt context
+ * 3. timebase_at_cycles() to convert a captured cycle count (sub-microsecond timestamps)
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "main.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enable the DWT cycle counter and reset the microsecond count
+ */
+void timebase_init(void);
+
+/**
+ * @brief Microseconds since timebase_init() (monotonic, wraps at 2^32)
+ */
+uint32_t timebase_micros(void);
+
+/**
+ * @brief Timebase value of a DWT->CYCCNT reading taken earlier (e.g. first thing in an
+ *        interrupt handler), for timestamps with cycle resolution
+ * @param cycles: DWT->CYCCNT at the event, within +-29s of the last timebase_micros() call
+ * @param fraction_ns: output, sub-microsecond part 0..999ns, may be NULL
+ * @return timebase_micros() value at the event
+ */
+uint32_t timebase_at_cycles(uint32_t cycles, uint16_t *fraction_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMEBASE_H
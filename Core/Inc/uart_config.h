@@ -2,6 +2,7 @@
 #define UART_CONFIG_H
 
 #include "main.h"
+#include "ppm_output.h"   // PPM_OUTPUT_ENABLED for the DMA check below
 
 // Role identifiers
 #define UART_ROLE_NONE 0
@@ -13,6 +14,7 @@
 #define UART_ROLE_DEBUG UART_ROLE_USART2
 #define UART_ROLE_GNSS UART_ROLE_USART3
 #define UART_ROLE_CRSF UART_ROLE_USART1
+#define UART_ROLE_SBUS UART_ROLE_NONE   // SBUS output (TX only) - needs a UART not used by another role
 
 // Buffer sizing per role
 #define UART_DEBUG_FIFO_SIZE 256
@@ -22,6 +24,7 @@
 #define UART_GNSS_TX_BUF_SIZE 8
 
 #define UART_CRSF_FIFO_SIZE 256
+#define UART_CRSF_RX_FIFO_SIZE 2048     // circular RX DMA buffer: 48ms of a saturated 420k line, > 40ms flash erase stall
 #define UART_CRSF_TX_BUF_SIZE 64
 
 // UART handles provided by CubeMX
@@ -59,19 +62,48 @@ extern UART_HandleTypeDef huart3;
 #define UART_GNSS_INSTANCE ((USART_TypeDef *)0)
 #endif
 
-// CRSF UART mapping
+// CRSF UART mapping (incl. the DMA1 channel of the UART RX request)
 #if UART_ROLE_CRSF == UART_ROLE_USART1
 #define UART_CRSF_HANDLE (&huart1)
 #define UART_CRSF_INSTANCE USART1
+#define UART_CRSF_RX_DMA DMA1_Channel5
 #elif UART_ROLE_CRSF == UART_ROLE_USART2
 #define UART_CRSF_HANDLE (&huart2)
 #define UART_CRSF_INSTANCE USART2
+#define UART_CRSF_RX_DMA DMA1_Channel6
 #elif UART_ROLE_CRSF == UART_ROLE_USART3
 #define UART_CRSF_HANDLE (&huart3)
 #define UART_CRSF_INSTANCE USART3
+#define UART_CRSF_RX_DMA DMA1_Channel3
 #else
 #define UART_CRSF_HANDLE ((UART_HandleTypeDef *)0)
 #define UART_CRSF_INSTANCE ((USART_TypeDef *)0)
+#define UART_CRSF_RX_DMA ((DMA_Channel_TypeDef *)0)
+#endif
+
+// SBUS UART mapping (incl. the DMA1 channel of the UART TX request)
+#if UART_ROLE_SBUS == UART_ROLE_USART1
+#define UART_SBUS_HANDLE (&huart1)
+#define UART_SBUS_TX_DMA DMA1_Channel4
+#elif UART_ROLE_SBUS == UART_ROLE_USART2
+#define UART_SBUS_HANDLE (&huart2)
+#define UART_SBUS_TX_DMA DMA1_Channel7
+#elif UART_ROLE_SBUS == UART_ROLE_USART3
+#define UART_SBUS_HANDLE (&huart3)
+#define UART_SBUS_TX_DMA DMA1_Channel2
+#else
+#define UART_SBUS_HANDLE ((UART_HandleTypeDef *)0)
+#define UART_SBUS_TX_DMA ((DMA_Channel_TypeDef *)0)
+#endif
+
+#if (UART_ROLE_SBUS != UART_ROLE_NONE) && \
+    ((UART_ROLE_SBUS == UART_ROLE_DEBUG) || (UART_ROLE_SBUS == UART_ROLE_GNSS) || (UART_ROLE_SBUS == UART_ROLE_CRSF))
+#error "UART_ROLE_SBUS needs a UART of its own"
+#endif
+
+// USART2 TX and TIM4_UP are both hard wired to DMA1 Channel 7
+#if (UART_ROLE_SBUS == UART_ROLE_USART2) && PPM_OUTPUT_ENABLED
+#error "SBUS on USART2 and the PPM output both need DMA1 Channel 7"
 #endif
 
 #endif // UART_CONFIG_H
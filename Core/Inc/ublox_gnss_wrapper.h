@@ -1,27 +1,149 @@
 /**
  * @file ublox_gnss_wrapper.h
- * @brief Non-blocking wrapper for SFE_UBLOX_GNSS for STM32 HAL UART operation
+ * @brief Non-blocking u-blox / NMEA GNSS driver for STM32 HAL UART operation
  * 
- * This wrapper class provides a non-blocking interface to the SparkFun u-blox GNSS
- * library. All getter methods return immediately with cached values. The GNSS module
- * must be polled periodically using the update() method.
+ * This wrapper class provides a non-blocking interface to a u-blox GNSS module. The
+ * received data is decoded by the streaming UbxParser (NAV-PVT, optional NAV-DOP /
+ * NAV-STATUS). Other modules are read with the NmeaParser (GGA, RMC, VTG), see "NMEA
+ * fallback" below. All getter methods return immediately with cached values. The GNSS
+ * module must be polled periodically using the update() method.
+ * 
+ * Every decoded NAV-PVT epoch is published as one GnssSnapshot with a sequence number
+ * (seqlock: the publish count is odd while the snapshot is written, a reader retries
+ * if the count changed during its copy). Consumers compare getSequence() with the last
+ * one they handled and take the whole epoch with getSnapshot() - position, altitude
+ * and speed never mix two epochs.
+ * 
+ * Bring-up (state machine advanced by update(), no waiting):
+ * - PROBE: the host UART steps through 9600 / 4800 / 38400 / 115200 / 230400 / 460800 baud
+ *   (starting at GNSS_OPERATING_BAUD), polls NAV-PVT and listens for GNSS_PROBE_TIMEOUT_MS
+ *   for a valid UBX frame or NMEA sentence
+ * - CONFIGURE: UBX-CFG-PRT (GNSS_OPERATING_BAUD, UBX only output), host UART follows,
+ *   UBX-CFG-RATE (GNSS_OPERATING_PERIOD_MS), UBX-CFG-MSG (NAV-PVT every epoch), in
+ *   high-rate mode UBX-CFG-MSG rate 0 for the other periodic NAV messages.
+ *   Each command waits for its ACK, GNSS_CONFIG_RETRIES attempts, then a new search.
+ *   A NAK of CFG-RATE steps the rate down at once: 20Hz, 10Hz, GNSS_MEASUREMENT_PERIOD_MS
+ * - RUNNING: no valid frame for GNSS_RX_TIMEOUT_MS (module power cycled, UART overrun)
+ *   starts a new search
+ * The configuration is not saved in the module, it is sent after every power up.
+ * With setWarmStart() the last known position follows as UBX-MGA-INI aiding (the time
+ * only with GNSS_AIDING_TIME_ACCURACY_S > 0, see there).
+ * 
+ * NMEA fallback (GNSS_PROTOCOL): with GNSS_PROTOCOL_AUTO a module that sends valid NMEA
+ * sentences but does not answer the NAV-PVT poll within the probe time is taken as a
+ * generic GPS - state NMEA, no configuration, it stays at the found baud rate and its
+ * default output. GNSS_PROTOCOL_NMEA skips the poll and takes the first valid sentence,
+ * GNSS_PROTOCOL_UBX configures every module that talks (the former behaviour). The GGA /
+ * RMC / VTG sentences of one fix (same UTC time) are merged and published as one
+ * GnssSnapshot once GGA and RMC or VTG are in - or, if the module sends fewer sentences,
+ * when the next fix starts. NMEA has no accuracy estimates: hAcc = HDOP *
+ * GNSS_NMEA_UERE_MM, vAcc = 1.5 * hAcc (VDOP is typically 1.5 * HDOP), pDOP carries the
+ * HDOP, sAcc and velocityDown are 0. 2D / 3D is not in GGA (GSA is not decoded): a fix
+ * with 4+ satellites counts as 3D. iTOW is derived from the UTC date / time of RMC and
+ * GNSS_NMEA_LEAP_SECONDS (time of day only until the first RMC with a date).
+ * No MGA aiding in NMEA mode.
+ * 
+ * High-rate mode (GNSS_HIGH_RATE_HZ 10..25): module and host UART both switch to
+ * GNSS_HIGH_RATE_BAUD and NAV-PVT is the only output. A NAV-PVT frame is 100 bytes =
+ * 1000 bit on the 8N1 line; the rate must keep the link below GNSS_MAX_UART_LOAD_PERCENT
+ * (checked at compile time). The RX interrupt fires per byte, 230400 baud = 23k
+ * interrupts/s. USART3 runs at preemption priority 1 and has one byte time (43us) to
+ * read a byte before the next one overruns. The priority 0 handlers (ADC DMA block sum,
+ * I2C1 event / error, CRSF telemetry TX byte, PPS edge) take ~24us together if all are
+ * pending at once, the USART3 handler ~3.5us (estimates). The main loop empties the RX
+ * FIFO (UART_GNSS_FIFO_SIZE, 5 NAV-PVT frames = 200ms at 25Hz) every pass.
+ * test/test_my_serial.cpp checks both budgets. Lost bytes
+ * show up in the mySerial statistics (RX FIFO overflow, UART overrun) and as UBX checksum
+ * errors - debug console command "gnss". Update rates above 10Hz need a module that
+ * supports them (M8: 10Hz with GPS + GLONASS, M9/M10: 25Hz); a NAK of CFG-RATE steps
+ * down to the next supported rate, getMeasurementPeriod_ms() tells the one in use.
+ * GNSS_HIGH_RATE_HZ may also come from the build (-D); the host test
+ * test/test_gnss_bringup.cpp runs the bring-up and the line load of both configurations
+ * against a simulated module (test/host/gnss_module.h).
  * 
  * Usage:
- * 1. Initialize myHalfSerial_X for UART3
+ * 1. Initialize mySerial for UART3
  * 2. Create UbloxGNSSWrapper instance
- * 3. Call begin() once during setup (blocking, ~1 second max)
+ * 3. Call begin() once during setup (non-blocking)
  * 4. Call update() periodically from main loop (non-blocking)
- * 5. Call getter methods to access cached data (non-blocking)
+ * 5. getSequence() / getSnapshot() per new epoch, or the single value getters
  */
 
 #ifndef UBLOX_GNSS_WRAPPER_H
 #define UBLOX_GNSS_WRAPPER_H
 
+#include <stdint.h>
+
+#define GNSS_BAUD_RATE 115200               // module and host UART after the bring-up
+#define GNSS_MEASUREMENT_PERIOD_MS 500      // navigation solution rate (2Hz)
+#ifndef GNSS_HIGH_RATE_HZ
+#define GNSS_HIGH_RATE_HZ 0                 // 10..25: high-rate mode, NAV-PVT only; 0 = off
+#endif
+#define GNSS_HIGH_RATE_BAUD 230400          // module and host UART in high-rate mode
+#define GNSS_MAX_UART_LOAD_PERCENT 50       // NAV-PVT share of the line capacity
+#define GNSS_PROBE_TIMEOUT_MS 1200          // listen time per baud rate (1Hz NMEA default output)
+#define GNSS_ACK_TIMEOUT_MS 300             // per configuration command
+#define GNSS_CONFIG_RETRIES 3
+#define GNSS_PORT_SWITCH_MS 100             // CFG-PRT sent -> host UART follows
+#define GNSS_RX_TIMEOUT_MS 3000             // no valid frame while running -> new search
+#define GNSS_AIDING_POSITION_ACCURACY_M 10000   // the aircraft may have been moved since the position was stored
+#define GNSS_AIDING_TIME_ACCURACY_S 0       // > 0 only with a real time source (RTC); the stored time is hours old, 0 = no time aiding
+
+#define GNSS_PROTOCOL_AUTO 0                // UBX if the module answers the NAV-PVT poll, else NMEA
+#define GNSS_PROTOCOL_UBX 1                 // u-blox only
+#define GNSS_PROTOCOL_NMEA 2                // any NMEA 0183 module, no configuration
+#define GNSS_PROTOCOL GNSS_PROTOCOL_AUTO
+#define GNSS_NMEA_UERE_MM 4000              // NMEA: range error for hAcc = HDOP * UERE
+#define GNSS_NMEA_LEAP_SECONDS 18           // NMEA: GPS - UTC (since 2017), for iTOW
+
+#if GNSS_HIGH_RATE_HZ
+#define GNSS_OPERATING_BAUD GNSS_HIGH_RATE_BAUD
+#define GNSS_OPERATING_PERIOD_MS (1000 / GNSS_HIGH_RATE_HZ)
+#else
+#define GNSS_OPERATING_BAUD GNSS_BAUD_RATE
+#define GNSS_OPERATING_PERIOD_MS GNSS_MEASUREMENT_PERIOD_MS
+#endif
+
 #ifdef __cplusplus
-#include "SparkFun_u-blox_GNSS_Arduino_Library.h"
+#include "stm32_arduino_compatibility.h"
+#include "ubx_parser.h"
+#include "nmea_parser.h"
 #endif
 
 #ifdef __cplusplus
+struct GnssSnapshot {
+    uint32_t sequence;      // epoch counter, 0 = no epoch yet
+    uint32_t timestamp_us;  // reception of the epoch (timebase_micros())
+    uint32_t iTOW;          // ms, GPS time of week of the navigation epoch
+    int32_t latitude;       // degrees * 10^-7
+    int32_t longitude;      // degrees * 10^-7
+    int32_t altitudeMSL;    // mm
+    int32_t groundSpeed;    // mm/s
+    int32_t heading;        // degrees * 10^-5, heading of motion
+    int32_t velocityDown;   // mm/s (NMEA: 0)
+    uint32_t hAcc;          // mm, horizontal accuracy estimate
+    uint32_t vAcc;          // mm, vertical accuracy estimate
+    uint32_t sAcc;          // mm/s, speed accuracy estimate (NMEA: 0 = unknown)
+    uint16_t pDOP;          // 0.01 (NMEA: HDOP)
+    uint8_t fixType;        // 0 none, 2 2D, 3 3D, 4 GNSS + dead reckoning, 5 time only
+    uint8_t numSV;
+    bool fixOK;             // gnssFixOK and a 2D / 3D fix
+    bool timeValid;         // UTC date and time below are valid
+    uint16_t year;          // UTC
+    uint8_t month, day, hour, minute, second;
+};
+
+// Last known position / time, sent as UBX-MGA-INI aiding after the bring-up
+struct GnssWarmStart {
+    int32_t latitude;       // degrees * 10^-7
+    int32_t longitude;      // degrees * 10^-7
+    int32_t altitudeMSL;    // mm
+    uint32_t hAcc;          // mm
+    uint16_t year;          // UTC
+    uint8_t month, day, hour, minute, second;
+    uint8_t reserved;
+};
+
 class UbloxGNSSWrapper {
 public:
     /**
@@ -31,71 +153,75 @@ public:
     UbloxGNSSWrapper(Stream &serialPort);
     
     /**
-     * @brief Initialize GNSS module (BLOCKING - safe to call during setup only)
-     * @param maxWait: Maximum time to wait for initialization in ms
-     * @return true if initialization successful, false otherwise
+     * @brief Start the bring-up state machine (NON-BLOCKING)
+     * @return false if no serial port is set
      * 
-     * This call blocks for up to maxWait milliseconds. It should only be used during
-     * system initialization, not in the main loop.
+     * The module is searched and configured in the background by update(), see
+     * isConfigured() / getStateName() for the progress.
      */
-    bool begin(uint16_t maxWait = 1000);
+    bool begin(void);
     
     /**
-     * @brief Update GNSS data (NON-BLOCKING)
+     * @brief Set the aiding data for the next bring-ups (call before begin())
      * 
-     * Call this periodically (e.g., every 100ms) from main loop. It polls the module
-     * for new data without blocking. Returns immediately.
+     * After each configuration the module gets UBX-MGA-INI-POS_LLH (accuracy at least
+     * GNSS_AIDING_POSITION_ACCURACY_M) and, with GNSS_AIDING_TIME_ACCURACY_S > 0,
+     * UBX-MGA-INI-TIME_UTC. MGA needs protocol 15+ (u-blox M8 and later), older modules
+     * ignore the frames.
      */
-    void update(void);
-    
-    // ========================================================================
-    // Configuration Methods (can block during setup)
-    // ========================================================================
+    void setWarmStart(const GnssWarmStart &warmStart);
     
     /**
-     * @brief Set UART baud rate
-     * @param baudrate: Target baud rate (e.g., 115200)
-     * @param maxWait: Maximum time to wait in ms
+     * @brief Update GNSS data (NON-BLOCKING)
+     * 
+     * Call this periodically (e.g., every 100ms) from main loop. It parses the bytes
+     * received since the last call, advances the bring-up and updates the caches.
+     * Returns immediately.
      */
-    void setSerialRate(uint32_t baudrate, uint16_t maxWait = 1000);
+    void update(void);
     
     /**
-     * @brief Enable/disable automatic PVT reports
-     * @param enabled: true to enable, false to disable
-     * @param maxWait: Maximum time to wait in ms
-     * @return true if successful
+     * @brief Check if the module was found and configured
+     * @return true once NAV-PVT output runs at GNSS_OPERATING_BAUD, or in NMEA mode
      */
-    bool setAutoPVT(bool enabled, uint16_t maxWait = 1000);
+    bool isConfigured(void);
     
     /**
-     * @brief Set measurement rate
-     * @param rate: Time between measurements in milliseconds
-     * @param maxWait: Maximum time to wait in ms
-     * @return true if successful
+     * @brief Get the host UART baud rate in use (probe rate during the search)
      */
-    bool setMeasurementRate(uint16_t rate, uint16_t maxWait = 1000);
+    uint32_t getBaudRate(void);
     
     /**
-     * @brief Configure UART1 output
-     * @param comSettings: COM_TYPE_UBX, COM_TYPE_NMEA, etc.
-     * @param maxWait: Maximum time to wait in ms
-     * @return true if successful
+     * @brief Get the measurement period in use - longer than GNSS_OPERATING_PERIOD_MS
+     *        if the module rejected the configured rate
      */
-    bool setUART1Output(uint8_t comSettings, uint16_t maxWait = 1000);
+    uint16_t getMeasurementPeriod_ms(void);
     
     /**
-     * @brief Poll for latest PVT data (explicit poll if autoPVT disabled)
-     * @param maxWait: Max wait time in ms (when autoPVT disabled)
-     * @return true if new data available
+     * @brief Get the bring-up state as text for diagnostics
      */
-    bool getPVT(uint16_t maxWait = 100);
+    const char* getStateName(void);
     
     // ========================================================================
     // Getter Methods (NON-BLOCKING - return cached values)
     // ========================================================================
     
     /**
-     * @brief Get latitude (cached from last successful update)
+     * @brief Sequence number of the last published epoch (0 = none yet)
+     */
+    uint32_t getSequence(void);
+    
+    /**
+     * @brief Copy the last published epoch, consistent even if update() runs meanwhile
+     * @param snapshot: output
+     * @return false if no epoch was published yet
+     */
+    bool getSnapshot(GnssSnapshot *snapshot) const;
+    
+    // single values of the last published epoch
+    
+    /**
+     * @brief Get latitude
      * @return Latitude in degrees * 10^-7 (e.g., 40.123456° = 401234560)
      */
     int32_t getLatitude(void);
@@ -107,7 +233,7 @@ public:
     int32_t getLongitude(void);
     
     /**
-     * @brief Get altitude above mean sea level (cached)
+     * @brief Get altitude above mean sea level
      * @return Altitude in millimeters
      */
     int32_t getAltitudeMSL(void);
@@ -115,47 +241,134 @@ public:
 
     
     /**
-     * @brief Get ground speed (cached)
+     * @brief Get ground speed
      * @return Speed in mm/s
      */
     int32_t getGroundSpeed(void);
     
     /**
-     * @brief Get heading (cached)
+     * @brief Get heading
      * @return Heading in degrees * 10^-5
      */
     int32_t getHeading(void);
     
     /**
-     * @brief Get number of satellites in use (cached)
+     * @brief Get number of satellites in use
      * @return Number of satellites (0-99)
      */
     uint8_t getSIV(void);
     
     /**
-     * @brief Check if we have a valid fix
-     * @return true if fix is valid (SIV > 0)
+     * @brief Get GPS time of week of the navigation epoch
+     * @return iTOW in ms, changes with every new PVT epoch
      */
-    bool hasValidFix(void);
+    uint32_t getTimeOfWeek(void);
+    
+    /**
+     * @brief Get fix type
+     * @return 0 = no fix, 2 = 2D, 3 = 3D, 4 = GNSS + dead reckoning
+     */
+    uint8_t getFixType(void);
+    
+    /**
+     * @brief Get vertical accuracy estimate
+     * @return Accuracy in millimeters
+     */
+    uint32_t getVerticalAccuracy(void);
+    
+    /**
+     * @brief Get horizontal dilution of precision (cached, needs NAV-DOP enabled)
+     * @return HDOP * 100, 0 if no NAV-DOP was received
+     */
+    uint16_t getHDOP(void);
+    
+    /**
+     * @brief Get time to first fix (cached, needs NAV-STATUS enabled)
+     * @return TTFF in ms, 0 before the first fix
+     */
+    uint32_t getTimeToFirstFix(void);
+    
+    /**
+     * @brief Get UBX frame statistics (valid frames, checksum errors)
+     */
+    const UbxParserStats& getParserStats(void);
+    
+    /**
+     * @brief Get NMEA sentence statistics (valid sentences, checksum errors)
+     */
+    const NmeaParserStats& getNmeaStats(void);
     
     /**
-     * @brief Get the underlying SFE_UBLOX_GNSS object for advanced use
-     * @return Reference to the GNSS object
+     * @brief Check if we have a valid fix
+     * @return true if the module flags the fix as valid (gnssFixOK, 2D or 3D)
      */
-    SFE_UBLOX_GNSS& getGNSS(void);
+    bool hasValidFix(void);
 
 private:
-    SFE_UBLOX_GNSS myGNSS;
+    enum BringupState : uint8_t {
+        STATE_IDLE,
+        STATE_PROBE,
+        STATE_CONFIGURE,
+        STATE_RUNNING,
+        STATE_NMEA
+    };
+    
+    // NMEA sentences merged into the open epoch
+    enum NmeaEpochPart : uint8_t {
+        NMEA_EPOCH_GGA = 0x01,
+        NMEA_EPOCH_RMC = 0x02,
+        NMEA_EPOCH_VTG = 0x04
+    };
+    
+    void handleMessage(void);
+    void handleNmea(void);
+    bool openNmeaEpoch(uint8_t part, bool timeValid, uint32_t time_ms);
+    void publishNmeaEpoch(void);
+    void startProbe(uint8_t baudIndex, uint32_t now);
+    void sendCommand(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t length);
+    void sendConfigStep(uint32_t now);
+    bool stepDownRate(void);
+    void advanceBringup(uint32_t now);
+    void publish(GnssSnapshot &snapshot);
+    void sendWarmStart(void);
+    
     Stream *serialPort;  // Store the serial port reference
+    UbxParser parser;    // streaming decoder for the received bytes
+    NmeaParser nmea;     // probe and NMEA mode
+    
+    // Bring-up state
+    BringupState state;
+    uint8_t baudIndex;
+    uint8_t configStep;
+    uint8_t configAttempts;
+    bool framesSeen;     // valid UBX frame since the last probe or command
+    bool sentencesSeen;  // valid NMEA sentence since the last probe
+    bool ackPending;
+    int8_t ackResult;    // 1 ACK, -1 NAK, 0 none yet
+    uint8_t ackClass, ackId;
+    uint32_t stateTime;
+    uint32_t lastFrameTime;
+    uint32_t baudRate;
+    uint16_t period_ms;  // CFG-RATE measurement period, stepped down on a NAK
+    uint8_t txFrame[24 + UBX_FRAME_OVERHEAD];  // largest command: MGA-INI-TIME_UTC
+    GnssWarmStart warmStart;
+    bool warmStartValid;
+    
+    // NMEA epoch assembly
+    GnssSnapshot nmeaEpoch;
+    uint8_t nmeaEpochParts;     // NmeaEpochPart bits, 0 = no epoch open
+    bool nmeaEpochTimeValid;
+    uint32_t nmeaEpochTime_ms;  // UTC time of day of the open epoch
+    uint16_t nmeaHDOP;
+    uint8_t nmeaQuality;        // GGA fix quality
+    bool nmeaRmcActive;
+    bool nmeaDateValid;         // last RMC date, kept for GGA only epochs
     
-    // Cached data (updated by update())
-    int32_t cachedLatitude;
-    int32_t cachedLongitude;
-    int32_t cachedAltitude;
-    int32_t cachedSpeed;
-    int32_t cachedHeading;
-    uint8_t cachedSIV;
-    bool cachedValidFix;
+    // Published epoch (seqlock) and cached data of the optional messages
+    volatile uint32_t publishCount;
+    GnssSnapshot published;
+    uint16_t cachedHDOP;
+    uint32_t cachedTimeToFirstFix;
     
     uint32_t lastUpdateTime;
 };
@@ -0,0 +1,140 @@
+/**
+ * @file ubx_parser.h
+ * @brief Streaming u-blox UBX frame parser and NAV-PVT / NAV-DOP / NAV-STATUS decoder
+ *
+ * Byte wise state machine (sync 0xB5 0x62, class, id, 16 bit length, payload,
+ * Fletcher-8 checksum CK_A / CK_B) without heap or Arduino shims. The checksum runs
+ * along with the bytes, a complete frame is reported by parse() returning true. The
+ * payload buffer holds UBX_MAX_PAYLOAD bytes (NAV-PVT is the largest message used);
+ * longer frames are checksummed and dropped so the parser stays in sync, a length
+ * field above UBX_MAX_FRAME_LENGTH restarts the sync search.
+ *
+ * Decoding reads the little endian fields byte wise (no alignment requirement) into
+ * plain structs. buildFrame() creates the frame around a payload for commands sent
+ * to the module.
+ *
+ * RAM: sizeof(UbxParser) = 116 bytes (92 byte payload, state, statistics), no heap.
+ * The SparkFun u-blox library it replaces took 444 bytes for its buffers alone
+ * (256 byte CFG payload, NAV-PVT packet, 92 byte auto payload, ACK / BUF payloads).
+ *
+ * Usage:
+ * 1. parse() for every received byte
+ * 2. on true: getClass() / getId(), then decodeNavPvt() etc.
+ */
+
+#ifndef UBX_PARSER_H
+#define UBX_PARSER_H
+
+#include <stdint.h>
+
+#define UBX_SYNC_1 0xB5
+#define UBX_SYNC_2 0x62
+#define UBX_MAX_PAYLOAD 92                  // NAV-PVT
+#define UBX_MAX_FRAME_LENGTH 1024           // larger length fields are taken as a false sync
+#define UBX_FRAME_OVERHEAD 8                // sync, class, id, length, checksum
+
+#define UBX_CLASS_NAV 0x01
+#define UBX_CLASS_ACK 0x05
+#define UBX_NAV_STATUS 0x03
+#define UBX_NAV_DOP 0x04
+#define UBX_NAV_PVT 0x07
+
+#ifdef __cplusplus
+
+struct UbxNavPvt {
+    uint32_t iTOW;                          // ms, GPS time of week of the epoch
+    uint16_t year;
+    uint8_t month, day, hour, minute, second;
+    uint8_t valid;                          // bit 0 date, bit 1 time valid
+    uint8_t fixType;                        // 0 none, 2 2D, 3 3D, 4 GNSS + DR, 5 time only
+    uint8_t flags;                          // bit 0 gnssFixOK
+    uint8_t numSV;
+    int32_t lon, lat;                       // deg * 1e-7
+    int32_t height, hMSL;                   // mm
+    uint32_t hAcc, vAcc;                    // mm
+    int32_t velN, velE, velD;               // mm/s
+    int32_t gSpeed;                         // mm/s
+    int32_t headMot;                        // deg * 1e-5
+    uint32_t sAcc;                          // mm/s
+    uint32_t headAcc;                       // deg * 1e-5
+    uint16_t pDOP;                          // 0.01
+};
+
+struct UbxNavDop {
+    uint32_t iTOW;
+    uint16_t gDOP, pDOP, tDOP, vDOP, hDOP;  // 0.01
+};
+
+struct UbxNavStatus {
+    uint32_t iTOW;
+    uint8_t gpsFix;
+    uint8_t flags;                          // bit 0 gpsFixOk
+    uint32_t ttff;                          // ms, time to first fix
+    uint32_t msss;                          // ms since startup / reset
+};
+
+struct UbxParserStats {
+    uint32_t frames;                        // valid frames of any class
+    uint32_t checksumErrors;
+    uint32_t oversized;                     // valid sync / length, payload > UBX_MAX_PAYLOAD
+};
+
+class UbxParser {
+public:
+    UbxParser();
+
+    void reset(void);
+
+    /**
+     * @brief Feed one received byte
+     * @return true if it completed a frame with a valid checksum
+     */
+    bool parse(uint8_t byte);
+
+    uint8_t getClass(void) const { return m_class; }
+    uint8_t getId(void) const { return m_id; }
+    uint16_t getLength(void) const { return m_length; }
+    const uint8_t *getPayload(void) const { return m_payload; }
+    bool isMessage(uint8_t msgClass, uint8_t msgId) const { return m_class == msgClass && m_id == msgId; }
+
+    // decode the last frame, false if it is not this message or too short
+    bool decodeNavPvt(UbxNavPvt *pvt) const;
+    bool decodeNavDop(UbxNavDop *dop) const;
+    bool decodeNavStatus(UbxNavStatus *status) const;
+
+    const UbxParserStats &getStats(void) const { return m_stats; }
+
+    /**
+     * @brief Write a complete frame (sync, header, payload, checksum)
+     * @param frame: output, length + UBX_FRAME_OVERHEAD bytes
+     * @param payload: may already be in place at frame + 6
+     * @return frame length
+     */
+    static uint16_t buildFrame(uint8_t *frame, uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t length);
+
+private:
+    enum State : uint8_t {
+        STATE_SYNC_1,
+        STATE_SYNC_2,
+        STATE_CLASS,
+        STATE_ID,
+        STATE_LENGTH_1,
+        STATE_LENGTH_2,
+        STATE_PAYLOAD,
+        STATE_CK_A,
+        STATE_CK_B
+    };
+
+    State m_state;
+    uint8_t m_class;
+    uint8_t m_id;
+    uint16_t m_length;
+    uint16_t m_index;
+    uint8_t m_ckA, m_ckB;
+    uint8_t m_payload[UBX_MAX_PAYLOAD];
+    UbxParserStats m_stats;
+};
+
+#endif // __cplusplus
+
+#endif // UBX_PARSER_H
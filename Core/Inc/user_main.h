@@ -5,14 +5,16 @@
 #ifndef USER_MAIN_H
 #define USER_MAIN_H
 
-#define TARGET_BLUEPILL
-// #define TARGET_MATEKSYS_CRSF_PWM_V10
+// Board selection - one header per board in Core/Inc/boards/
+#define BOARD_HEADER "boards/board_bluepill.h"
+// #define BOARD_HEADER "boards/board_matek_crsf_pwm_v10.h"
 
 #include "main.h"
 #include "platform_abstraction.h"
 #include <stdint.h>
 #include "stm32_arduino_compatibility.h"
 #include "mySerial.h"
+#include BOARD_HEADER
 
 // C++ only includes
 #ifdef __cplusplus
@@ -23,19 +25,17 @@
 //#include "myHalfSerial_X.h"
 //#include "../SparkFun_u-blox_GNSS_Arduino_Library/src/SparkFun_u-blox_GNSS_Arduino_Library.h"
 
-#define num_PWM_channels 10
+#define num_PWM_channels BOARD_NUM_PWM_CHANNELS
 
 extern TIM_HandleTypeDef htim1;
 extern TIM_HandleTypeDef htim2;
 extern TIM_HandleTypeDef htim3;
+extern I2C_HandleTypeDef hi2c1;
 //extern TIM_HandleTypeDef htim16;
 extern UART_HandleTypeDef huart1;
 extern UART_HandleTypeDef huart2;
 extern UART_HandleTypeDef huart3;
 
-extern TIM_HandleTypeDef* Timer_map[num_PWM_channels];
-extern unsigned int PWM_Channelmap[num_PWM_channels];
-
 
 #ifdef __cplusplus
 extern "C" {
@@ -49,7 +49,6 @@ void Serial_InitUART2(void);  // Initialize Serial (UART2) for debug output
 
 void user_init(void);
 void user_loop_step(void);
-//static void user_pwm_setvalue(uint8_t pwm_channel, uint16_t PWM_pulse_lengt);
 //int8_t send_UART2(char* msg); 
 
 #ifdef __cplusplus
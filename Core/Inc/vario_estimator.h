@@ -0,0 +1,63 @@
+/**
+ * @file vario_estimator.h
+ * @brief Two state Kalman filter (altitude, vertical speed) for the barometric vario
+ *
+ * Constant velocity model driven by white noise acceleration, single precision:
+ *   predict  h += v * dt, P = F P F' + q * [dt^4/4 dt^3/2; dt^3/2 dt^2]
+ *   correct  K = P H' / (P00 + r), x += K * (z - h)
+ * dt is the measured interval between two sample timestamps, not the nominal task
+ * period, so jitter and dropped samples do not scale the vertical speed.
+ *
+ * Tuning: accel_noise (m/s^2, standard deviation of the vertical acceleration the model
+ * allows) trades vario lag against noise, baro_noise (m) is the altitude noise of one
+ * sample. With the defaults a step in climb rate reaches 90% in ~1.4s at 8Hz samples,
+ * the former IIR chain took ~3.4s (test/test_vario_estimator.cpp).
+ *
+ * Usage:
+ * 1. setNoise() (optional)
+ * 2. update() with every altitude sample and its timestamp
+ * 3. getAltitude() / getVario()
+ */
+
+#ifndef VARIO_ESTIMATOR_H
+#define VARIO_ESTIMATOR_H
+
+#include <stdint.h>
+
+#define VARIO_ACCEL_NOISE 1.0f              // m/s^2
+#define VARIO_BARO_NOISE 0.25f              // m, SPL06 16x oversampling incl. turbulence
+#define VARIO_MAX_DT_US 1000000             // longer gaps restart the filter at the sample
+
+#ifdef __cplusplus
+
+class VarioEstimator {
+public:
+    VarioEstimator();
+
+    void setNoise(float accel_noise, float baro_noise);
+    void reset(float altitude_m);
+
+    /**
+     * @brief Predict to the sample time and correct with the measured altitude
+     * @param altitude_m: barometric altitude
+     * @param timestamp_us: time of the sample (timebase_micros() domain)
+     */
+    void update(float altitude_m, uint32_t timestamp_us);
+
+    float getAltitude(void) const { return m_altitude; }
+    float getVario(void) const { return m_vario; }
+    bool isValid(void) const { return m_valid; }
+
+private:
+    float m_altitude;
+    float m_vario;
+    float m_p00, m_p01, m_p11;              // covariance (symmetric)
+    float m_q;                              // accel_noise^2
+    float m_r;                              // baro_noise^2
+    uint32_t m_lastTimestamp_us;
+    bool m_valid;
+};
+
+#endif // __cplusplus
+
+#endif // VARIO_ESTIMATOR_H
@@ -0,0 +1,79 @@
+/**
+ * @file adc_calibration.cpp
+ * @brief Two point voltage / zero current calibration with a CRC protected flash record
+ */
+
+#include "adc_calibration.h"
+#include "flash_record.h"
+
+// CALIBRATION region of the linker script - one 1k flash page
+extern "C" const uint32_t _calibration_start[];
+
+static_assert(sizeof(BatteryCalibration) % 4 == 0, "calibration record is programmed in words");
+static_assert(sizeof(BatteryCalibration) <= FLASH_RECORD_MAX_PAYLOAD, "calibration record exceeds the flash page");
+
+static int32_t g_voltagePoint1_q8 = -1;     // raw reading of point 1, -1 = not recorded
+static int32_t g_voltagePoint1_mV = 0;
+
+// accept calibrations within 0.5 .. 2x of the compiled scale only
+static bool scaleValid(uint32_t scale_q16, uint32_t default_q16) {
+    return scale_q16 >= default_q16 / 2 && scale_q16 <= default_q16 * 2;
+}
+
+bool adc_calibration_load(BatteryMeasurement &battery) {
+    BatteryCalibration calibration;
+    BatteryCalibration defaults = BatteryMeasurement::defaultCalibration();
+
+    if (!flash_record_read(_calibration_start, ADC_CALIBRATION_MAGIC, ADC_CALIBRATION_VERSION, &calibration, sizeof(calibration))) {
+        return false;
+    }
+    if (!scaleValid(calibration.voltageScale_q16, defaults.voltageScale_q16)) return false;
+    if (!scaleValid(calibration.currentScale_q16, defaults.currentScale_q16)) return false;
+    battery.setCalibration(calibration);
+    return true;
+}
+
+HAL_StatusTypeDef adc_calibration_save(const BatteryMeasurement &battery) {
+    BatteryCalibration calibration = battery.getCalibration();
+    return flash_record_write(_calibration_start, ADC_CALIBRATION_MAGIC, ADC_CALIBRATION_VERSION, &calibration,
+                              sizeof(calibration));
+}
+
+HAL_StatusTypeDef adc_calibration_defaults(BatteryMeasurement &battery) {
+    battery.setCalibration(BatteryMeasurement::defaultCalibration());
+    g_voltagePoint1_q8 = -1;
+    return flash_record_erase(_calibration_start);
+}
+
+bool adc_calibration_voltage_point(BatteryMeasurement &battery, uint8_t point, int32_t voltage_mV) {
+    int32_t raw_q8 = battery.getVoltageRaw_q8();
+
+    if (point == 1) {
+        g_voltagePoint1_q8 = raw_q8;
+        g_voltagePoint1_mV = voltage_mV;
+        return true;
+    }
+    if (point != 2 || g_voltagePoint1_q8 < 0) return false;
+
+    int32_t span_mV = voltage_mV - g_voltagePoint1_mV;
+    int32_t span_q8 = raw_q8 - g_voltagePoint1_q8;
+    if (span_mV < 0) { span_mV = -span_mV; span_q8 = -span_q8; }
+    if (span_mV < ADC_CALIBRATION_MIN_SPAN_MV || span_q8 <= 0) return false;
+
+    // mV = raw_q8 * scale_q16 >> 24 - offset, solved for the two points
+    BatteryCalibration calibration = battery.getCalibration();
+    uint32_t scale_q16 = (uint32_t)(((int64_t)span_mV << 24) / span_q8);
+    if (!scaleValid(scale_q16, BAT_VOLTAGE_SCALE_Q16)) return false;
+    calibration.voltageScale_q16 = scale_q16;
+    calibration.voltageOffset_mV = (int32_t)(((int64_t)g_voltagePoint1_q8 * scale_q16) >> 24) - g_voltagePoint1_mV;
+    battery.setCalibration(calibration);
+    g_voltagePoint1_q8 = -1;
+    return true;
+}
+
+bool adc_calibration_zero_current(BatteryMeasurement &battery) {
+    BatteryCalibration calibration = battery.getCalibration();
+    calibration.currentOffset_mA = (int32_t)(((int64_t)battery.getCurrentRaw_q8() * calibration.currentScale_q16) >> 24);
+    battery.setCalibration(calibration);
+    return true;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file adc_sampler.cpp
+ * @brief Implementation of the circular DMA block accumulator / decimator
+ */
+
+#include "adc_sampler.h"
+
+static_assert(ADC_SAMPLER_DECIMATION >= 4 && ADC_SAMPLER_DECIMATION <= 256 &&
+              (ADC_SAMPLER_DECIMATION & (ADC_SAMPLER_DECIMATION - 1)) == 0,
+              "ADC_SAMPLER_DECIMATION must be a power of two 4..256");
+
+AdcSampler::AdcSampler()
+    : m_hadc(nullptr), m_blockCount(0), m_published(0), m_sequence(0) {
+    for (uint8_t channel = 0; channel < ADC_SAMPLER_RESULTS; channel++) {
+        m_accu[channel] = 0;
+        m_result[0][channel] = m_result[1][channel] = 0;
+    }
+    setDecimation(ADC_SAMPLER_DECIMATION);
+}
+
+bool AdcSampler::setDecimation(uint16_t ratio) {
+    if (m_hadc != nullptr) return false;                    // DMA length is fixed while running
+    if (ratio < 4 || ratio > 256 || (ratio & (ratio - 1)) != 0) return false;
+
+    int8_t log2_ratio = 0;
+    while ((1U << log2_ratio) < ratio) log2_ratio++;
+
+    m_decimation = ratio;
+    m_blockScans = (ratio < ADC_SAMPLER_MAX_BLOCK_SCANS) ? ratio : ADC_SAMPLER_MAX_BLOCK_SCANS;
+    m_blocksPerResult = (uint8_t)(ratio / m_blockScans);
+    m_shift = (int8_t)(log2_ratio - ADC_SAMPLER_RESULT_SHIFT);
+    int8_t log2_blocks = 0;
+    while ((1U << log2_blocks) < m_blocksPerResult) log2_blocks++;
+    m_auxShift = (int8_t)(log2_blocks - ADC_SAMPLER_RESULT_SHIFT);
+    return true;
+}
+
+bool AdcSampler::start(ADC_HandleTypeDef *hadc) {
+    if (hadc == nullptr || m_hadc != nullptr) return false;
+    m_blockCount = 0;
+    for (uint8_t channel = 0; channel < ADC_SAMPLER_RESULTS; channel++) m_accu[channel] = 0;
+    m_hadc = hadc;
+    // both halves of the buffer: half transfer and transfer complete interrupt alternate
+    if (HAL_ADC_Start_DMA(hadc, (uint32_t*)m_buffer, 2U * m_blockScans * ADC_SAMPLER_CHANNELS) != HAL_OK) {
+        m_hadc = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool AdcSampler::onTransfer(bool second_half) {
+    if (m_hadc == nullptr) return false;
+
+    const volatile uint16_t *sample = &m_buffer[second_half ? m_blockScans * ADC_SAMPLER_CHANNELS : 0];
+    uint32_t sum[ADC_SAMPLER_CHANNELS] = {0};
+    for (uint16_t scan = 0; scan < m_blockScans; scan++) {
+        for (uint8_t channel = 0; channel < ADC_SAMPLER_CHANNELS; channel++) {
+            sum[channel] += *sample++;
+        }
+    }
+    for (uint8_t channel = 0; channel < ADC_SAMPLER_CHANNELS; channel++) m_accu[channel] += sum[channel];
+    // injected group (JAUTO after each burst): latest conversion, one read per block
+    m_accu[ADC_SAMPLER_VREFINT] += m_hadc->Instance->JDR1 & 0x0FFFU;
+    m_accu[ADC_SAMPLER_TEMPERATURE] += m_hadc->Instance->JDR2 & 0x0FFFU;
+
+    if (++m_blockCount < m_blocksPerResult) return false;
+    m_blockCount = 0;
+
+    // publish: max. sum is 4095 * 256 - fits uint32 before scaling
+    uint8_t next = m_published ^ 1U;
+    for (uint8_t channel = 0; channel < ADC_SAMPLER_CHANNELS; channel++) {
+        uint32_t value = (m_shift >= 0) ? (m_accu[channel] >> m_shift) : (m_accu[channel] << -m_shift);
+        m_result[next][channel] = (uint16_t)value;
+        m_accu[channel] = 0;
+    }
+    for (uint8_t channel = ADC_SAMPLER_CHANNELS; channel < ADC_SAMPLER_RESULTS; channel++) {
+        uint32_t value = (m_auxShift >= 0) ? (m_accu[channel] >> m_auxShift) : (m_accu[channel] << -m_auxShift);
+        m_result[next][channel] = (uint16_t)value;
+        m_accu[channel] = 0;
+    }
+    m_published = next;
+    m_sequence = m_sequence + 1;
+    return true;
+}
+
+uint32_t AdcSampler::getResult(uint16_t *results) const {
+    uint32_t sequence;
+    do {    // retry if the ISR published twice while copying
+        sequence = m_sequence;
+        const volatile uint16_t *published = m_result[m_published];
+        for (uint8_t channel = 0; channel < ADC_SAMPLER_RESULTS; channel++) results[channel] = published[channel];
+    } while (sequence != m_sequence);
+    return sequence;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file adc_trigger.cpp
+ * @brief TIM4 CC4 triggered ADC bursts, locked to the TIM1 servo frame
+ */
+
+#include "adc_trigger.h"
+#include "adc_sampler.h"
+#include "servo_timer_sync.h"
+#include "ppm_output.h"
+#include "user_main.h"
+
+static_assert(ADC_TRIGGER_BURST_SCANS >= 1 && ADC_TRIGGER_BURST_SCANS * ADC_SAMPLER_CHANNELS <= 16,
+              "adc_trigger: the regular sequence has 16 ranks at most");
+static_assert(SERVO_TIMER_PERIOD_US % ADC_TRIGGER_PERIOD_US == 0,
+              "adc_trigger: ADC_TRIGGER_PERIOD_US must divide the servo period to stay phase locked");
+static_assert(ADC_TRIGGER_PHASE_US + ADC_TRIGGER_BURST_SCANS * ADC_TRIGGER_SCAN_US + ADC_TRIGGER_INJECTED_US <= ADC_TRIGGER_PERIOD_US,
+              "adc_trigger: the burst does not fit into the trigger period");
+#if ADC_TRIGGER_QUIET_WINDOW
+static_assert(SERVO_PHASE_TIM2_US % ADC_TRIGGER_PERIOD_US == 0 && SERVO_PHASE_TIM3_US % ADC_TRIGGER_PERIOD_US == 0,
+              "adc_trigger: servo pulses must start at phase 0 of a trigger period (SERVO_PHASE_TIMx_US)");
+static_assert(ADC_TRIGGER_PHASE_US >= BOARD_SERVO_PULSE_MAX_US,
+              "adc_trigger: the burst overlaps the servo pulses");
+#endif
+
+#if !PPM_OUTPUT_ENABLED
+static TIM_HandleTypeDef htim_adc;
+#endif
+
+HAL_StatusTypeDef adc_trigger_init(ADC_HandleTypeDef *hadc) {
+  ADC_ChannelConfTypeDef sConfig = {0};
+  ADC_InjectionConfTypeDef sConfigInjected = {0};
+
+  // repeat the VBAT / current pair for the whole burst - ranks 1/2 are set by MX_ADC1_Init
+  sConfig.SamplingTime = ADC_SAMPLETIME_71CYCLES_5;
+  for (uint32_t rank = 3; rank <= ADC_TRIGGER_BURST_SCANS * ADC_SAMPLER_CHANNELS; rank++) {
+    sConfig.Channel = (rank & 1U) ? ADC_CHANNEL_4 : ADC_CHANNEL_5;
+    sConfig.Rank = rank;
+    if (HAL_ADC_ConfigChannel(hadc, &sConfig) != HAL_OK) return HAL_ERROR;
+  }
+  hadc->Init.NbrOfConversion = ADC_TRIGGER_BURST_SCANS * ADC_SAMPLER_CHANNELS;
+  MODIFY_REG(hadc->Instance->SQR1, ADC_SQR1_L, ADC_SQR1_L_SHIFT(hadc->Init.NbrOfConversion));
+
+  // VREFINT / temperature sensor: converted automatically after each regular sequence, read from JDR1/JDR2
+  sConfigInjected.InjectedSamplingTime = ADC_SAMPLETIME_239CYCLES_5;
+  sConfigInjected.InjectedNbrOfConversion = ADC_SAMPLER_AUX_CHANNELS;
+  sConfigInjected.InjectedDiscontinuousConvMode = DISABLE;
+  sConfigInjected.AutoInjectedConv = ENABLE;
+  sConfigInjected.ExternalTrigInjecConv = ADC_INJECTED_SOFTWARE_START;
+  sConfigInjected.InjectedChannel = ADC_CHANNEL_VREFINT;
+  sConfigInjected.InjectedRank = ADC_INJECTED_RANK_1;
+  if (HAL_ADCEx_InjectedConfigChannel(hadc, &sConfigInjected) != HAL_OK) return HAL_ERROR;
+  sConfigInjected.InjectedChannel = ADC_CHANNEL_TEMPSENSOR;
+  sConfigInjected.InjectedRank = ADC_INJECTED_RANK_2;
+  if (HAL_ADCEx_InjectedConfigChannel(hadc, &sConfigInjected) != HAL_OK) return HAL_ERROR;
+
+#if PPM_OUTPUT_ENABLED
+  // TIM4 generates the PPM signal - free running scans, not synchronised to the servo frame
+  hadc->Init.ExternalTrigConv = ADC_SOFTWARE_START;
+  hadc->Init.ContinuousConvMode = ENABLE;
+  MODIFY_REG(hadc->Instance->CR2, ADC_CR2_EXTSEL | ADC_CR2_CONT, ADC_SOFTWARE_START | ADC_CR2_CONT);
+  return HAL_OK;
+#else
+  TIM_SlaveConfigTypeDef sSlaveConfig = {0};
+  TIM_OC_InitTypeDef sConfigOC = {0};
+
+  __HAL_RCC_TIM4_CLK_ENABLE();
+  htim_adc.Instance = TIM4;
+  htim_adc.Init.Prescaler = 72-1;                           // 1us ticks like the servo timers
+  htim_adc.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim_adc.Init.Period = ADC_TRIGGER_PERIOD_US - 1;
+  htim_adc.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim_adc.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_Base_Init(&htim_adc) != HAL_OK) return HAL_ERROR;
+
+  sSlaveConfig.SlaveMode = TIM_SLAVEMODE_TRIGGER;           // started by the TIM1 TRGO like TIM2/TIM3
+  sSlaveConfig.InputTrigger = TIM_TS_ITR0;                  // ITR0 = TIM1 for TIM4 (F103)
+  if (HAL_TIM_SlaveConfigSynchro(&htim_adc, &sSlaveConfig) != HAL_OK) return HAL_ERROR;
+
+  // PWM2: OC4REF rises when the counter reaches CCR4 - that edge is the T4_CC4 trigger
+  // (PWM1 would rise at the wrap to 0, together with the servo pulses). The F1 ADC only
+  // sees it with CC4E set: TIM4 is remapped to PD12..PD15, not bonded below 100 pins,
+  // so the channel output drives no pin and PB9 stays I2C1 SDA.
+  __HAL_AFIO_REMAP_TIM4_ENABLE();
+  sConfigOC.OCMode = TIM_OCMODE_PWM2;
+  sConfigOC.Pulse = ADC_TRIGGER_PHASE_US;
+  sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+  sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+  if (HAL_TIM_PWM_ConfigChannel(&htim_adc, &sConfigOC, TIM_CHANNEL_4) != HAL_OK) return HAL_ERROR;
+  __HAL_TIM_SET_COUNTER(&htim_adc, 0);
+  return HAL_OK;
+#endif
+}
+
+void adc_trigger_start(void) {
+#if !PPM_OUTPUT_ENABLED
+  HAL_TIM_PWM_Start(&htim_adc, TIM_CHANNEL_4);              // CC4E; the counter is enabled by the TIM1 TRGO
+#endif
+}
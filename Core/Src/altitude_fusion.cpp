@@ -0,0 +1,71 @@
+/**
+ * @file altitude_fusion.cpp
+ * @brief Baro offset Kalman filter on GNSS epochs, fused MSL altitude per baro sample
+ */
+
+#include "altitude_fusion.h"
+#include <math.h>
+
+AltitudeFusion::AltitudeFusion() {
+    reset();
+}
+
+void AltitudeFusion::reset(void) {
+    m_baroAltitude = 0.0f;
+    m_vario = 0.0f;
+    m_baroTimestamp_us = 0;
+    m_baroValid = false;
+    m_offset = 0.0f;
+    m_p = 0.0f;
+    m_gnssTimestamp_us = 0;
+    m_rejects = 0;
+    m_gnssValid = false;
+    m_altitude = 0.0f;
+}
+
+float AltitudeFusion::getOffsetStd(void) const {
+    return m_gnssValid ? sqrtf(m_p) : INFINITY;
+}
+
+void AltitudeFusion::updateBaro(float altitude_m, float vario_mps, uint32_t timestamp_us) {
+    m_baroAltitude = altitude_m;
+    m_vario = vario_mps;
+    m_baroTimestamp_us = timestamp_us;
+    m_baroValid = true;
+    m_altitude = altitude_m - m_offset;     // offset 0 without GNSS: pressure altitude
+}
+
+bool AltitudeFusion::updateGnss(float msl_m, float accuracy_m, uint32_t timestamp_us) {
+    if (!m_baroValid) return false;
+    int32_t age_us = (int32_t)(timestamp_us - m_baroTimestamp_us);
+    if (age_us > FUSION_MAX_EXTRAPOLATION_US || age_us < -FUSION_MAX_EXTRAPOLATION_US) return false;
+
+    float r = accuracy_m > 0.0f ? accuracy_m * accuracy_m : FUSION_GNSS_NOISE * FUSION_GNSS_NOISE;
+    float measured = m_baroAltitude + m_vario * (age_us * 1e-6f) - msl_m;   // baro at the epoch time
+
+    if (!m_gnssValid) {
+        m_offset = measured;
+        m_p = r;
+    } else {
+        float dt = (uint32_t)(timestamp_us - m_gnssTimestamp_us) * 1e-6f;
+        m_p += FUSION_OFFSET_DRIFT * FUSION_OFFSET_DRIFT * dt;
+        m_gnssTimestamp_us = timestamp_us;
+
+        float s = m_p + r;
+        float innovation = measured - m_offset;
+        if (innovation * innovation > FUSION_GATE * FUSION_GATE * s) {
+            if (++m_rejects < FUSION_MAX_REJECTS) return false;
+            m_offset = measured;            // persistent jump (QNH step, new fix geometry) - restart
+            m_p = r;
+        } else {
+            float k = m_p / s;
+            m_offset += k * innovation;
+            m_p -= k * m_p;
+        }
+    }
+    m_rejects = 0;
+    m_gnssTimestamp_us = timestamp_us;
+    m_gnssValid = true;
+    m_altitude = m_baroAltitude - m_offset;
+    return true;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file baro_altitude.cpp
+ * @brief Table + quadratic interpolation for the barometric altitude formula
+ */
+
+#include "baro_altitude.h"
+
+// 44330m * (1 - (p / 101325Pa)^0.1903) in mm at p = BARO_ALTITUDE_P_MIN_PA + i * 512Pa
+static const int32_t altitude_lut_mm[BARO_ALTITUDE_POINTS] = {
+    9165371, 9051945, 8940050, 8829640, 8720672, 8613105, 8506898, 8402015,
+    8298419, 8196074, 8094949, 7995010, 7896227, 7798570, 7702013, 7606526,
+    7512084, 7418661, 7326234, 7234779, 7144273, 7054695, 6966024, 6878239,
+    6791321, 6705251, 6620011, 6535582, 6451949, 6369094, 6287001, 6205656,
+    6125042, 6045145, 5965952, 5887448, 5809621, 5732456, 5655943, 5580068,
+    5504821, 5430188, 5356160, 5282726, 5209874, 5137595, 5065879, 4994716,
+    4924097, 4854012, 4784452, 4715410, 4646875, 4578840, 4511298, 4444239,
+    4377657, 4311543, 4245891, 4180693, 4115943, 4051633, 3987757, 3924308,
+    3861281, 3798669, 3736465, 3674665, 3613261, 3552249, 3491623, 3431378,
+    3371507, 3312007, 3252872, 3194097, 3135677, 3077607, 3019883, 2962501,
+    2905455, 2848741, 2792355, 2736294, 2680551, 2625125, 2570010, 2515203,
+    2460700, 2406497, 2352590, 2298977, 2245653, 2192615, 2139859, 2087383,
+    2035182, 1983254, 1931596, 1880204, 1829076, 1778208, 1727597, 1677241,
+    1627137, 1577281, 1527672, 1478306, 1429181, 1380294, 1331643, 1283224,
+    1235037, 1187077, 1139344, 1091833, 1044544, 997474, 950620, 903981,
+    857553, 811336, 765327, 719523, 673923, 628525, 583327, 538327,
+    493522, 448912, 404494, 360265, 316226, 272373, 228705, 185220,
+    141917, 98794, 55848, 13080, -29514, -71935, -114184, -156262,
+    -198172, -239915, -281492, -322905, -364155, -405244, -446173, -486943,
+    -527556, -568013, -608316, -648465, -688463, -728310, -768007, -807557,
+};
+
+int32_t baro_altitude_mm(int32_t pressure_q8) {
+    const int32_t offset_max = (int32_t)(BARO_ALTITUDE_POINTS - 1) << (BARO_ALTITUDE_STEP_SHIFT + 8);
+    int32_t offset = pressure_q8 - ((int32_t)BARO_ALTITUDE_P_MIN_PA << 8);
+    if (offset < 0) offset = 0;
+    if (offset > offset_max) offset = offset_max;
+
+    // segment index and position inside it (Q16), the last segment uses the points before it
+    uint32_t index = (uint32_t)offset >> (BARO_ALTITUDE_STEP_SHIFT + 8);
+    int32_t frac_q16 = (int32_t)(((uint32_t)offset & ((1UL << (BARO_ALTITUDE_STEP_SHIFT + 8)) - 1)) >> (BARO_ALTITUDE_STEP_SHIFT + 8 - 16));
+    if (index > BARO_ALTITUDE_POINTS - 3) {
+        frac_q16 += (int32_t)(index - (BARO_ALTITUDE_POINTS - 3)) << 16;
+        index = BARO_ALTITUDE_POINTS - 3;
+    }
+
+    int32_t y0 = altitude_lut_mm[index];
+    int32_t d1 = altitude_lut_mm[index + 1] - y0;
+    int32_t d2 = altitude_lut_mm[index + 2] - 2 * altitude_lut_mm[index + 1] + y0;
+
+    // y0 + f * d1 + f * (f - 1) / 2 * d2
+    int64_t f_fm1_q16 = ((int64_t)frac_q16 * (frac_q16 - 65536)) >> 16;
+    return y0 + (int32_t)(((int64_t)frac_q16 * d1) >> 16) + (int32_t)((f_fm1_q16 * d2) >> 17);
+}
@@ -0,0 +1,87 @@
+/**
+ * @file battery_measurement.cpp
+ * @brief Implementation of the fixed point battery voltage / current pipeline
+ */
+
+#include "battery_measurement.h"
+
+// filt_q8 (max. 65520 << 8) * scale must not overflow 64 bit and the result must fit int32
+static_assert(BAT_VOLTAGE_SCALE_Q16 < (1UL << 24) && BAT_CURRENT_SCALE_Q16 < (1UL << 24), "battery scale out of range");
+
+static_assert(BAT_VREFINT_NOMINAL < (1UL << 16), "VREFINT nominal value out of range");
+
+static inline int32_t iir_q8(int32_t state_q8, uint16_t input) {
+    int32_t diff = ((int32_t)input << 8) - state_q8;
+    return state_q8 + (int32_t)(((int64_t)diff * BAT_IIR_ALPHA_Q16) >> 16);
+}
+
+static inline int32_t scale_q8(int32_t value_q8, uint32_t scale_q16) {
+    return (int32_t)(((int64_t)value_q8 * scale_q16) >> 24);
+}
+
+BatteryMeasurement::BatteryMeasurement()
+    : m_voltage_q8(0), m_current_q8(0), m_vref_q8(0), m_temperature_q8(0), m_hasSample(false),
+      m_voltageScale_q16(BAT_VOLTAGE_SCALE_Q16), m_currentScale_q16(BAT_CURRENT_SCALE_Q16),
+      m_voltageOffset_mV(BAT_VOLTAGE_OFFSET_MV), m_currentOffset_mA(BAT_CURRENT_OFFSET_MA),
+      m_voltage_mV(0), m_current_mA(0), m_vdda_mV((int32_t)BAT_ADC_VREF_MV), m_ratio_q16(1UL << 16),
+      m_temperature_dC(0) {
+}
+
+BatteryCalibration BatteryMeasurement::defaultCalibration(void) {
+    BatteryCalibration calibration = {BAT_VOLTAGE_SCALE_Q16, BAT_VOLTAGE_OFFSET_MV, BAT_CURRENT_SCALE_Q16, BAT_CURRENT_OFFSET_MA};
+    return calibration;
+}
+
+void BatteryMeasurement::setCalibration(const BatteryCalibration &calibration) {
+    m_voltageScale_q16 = calibration.voltageScale_q16;
+    m_voltageOffset_mV = calibration.voltageOffset_mV;
+    m_currentScale_q16 = calibration.currentScale_q16;
+    m_currentOffset_mA = calibration.currentOffset_mA;
+}
+
+BatteryCalibration BatteryMeasurement::getCalibration(void) const {
+    BatteryCalibration calibration = {m_voltageScale_q16, m_voltageOffset_mV, m_currentScale_q16, m_currentOffset_mA};
+    return calibration;
+}
+
+void BatteryMeasurement::update(const uint16_t *adc_results) {
+    uint16_t voltage = adc_results[BAT_ADC_CHANNEL_VOLTAGE];
+    uint16_t current = adc_results[BAT_ADC_CHANNEL_CURRENT];
+    uint16_t vref = adc_results[ADC_SAMPLER_VREFINT];
+    uint16_t temperature = adc_results[ADC_SAMPLER_TEMPERATURE];
+
+    if (!m_hasSample) {     // start the filter at the first value instead of ramping up from 0
+        m_voltage_q8 = (int32_t)voltage << 8;
+        m_current_q8 = (int32_t)current << 8;
+        m_vref_q8 = (int32_t)vref << 8;
+        m_temperature_q8 = (int32_t)temperature << 8;
+        m_hasSample = true;
+    } else {
+        m_voltage_q8 = iir_q8(m_voltage_q8, voltage);
+        m_current_q8 = iir_q8(m_current_q8, current);
+        m_vref_q8 = iir_q8(m_vref_q8, vref);
+        m_temperature_q8 = iir_q8(m_temperature_q8, temperature);
+    }
+
+    // supply correction VDDA / BAT_ADC_VREF_MV in Q16 - one division for both channels
+    uint32_t vref_counts = (uint32_t)(m_vref_q8 + 128) >> 8;
+    uint32_t ratio_q16 = 1UL << 16;
+    if (vref_counts > BAT_VREFINT_NOMINAL / 2) {    // VREFINT not converted (yet) -> nominal supply
+        ratio_q16 = (BAT_VREFINT_NOMINAL << 16) / vref_counts;
+        if (ratio_q16 < (3UL << 14)) ratio_q16 = 3UL << 14;     // limit to 0.75 .. 1.25
+        if (ratio_q16 > (5UL << 14)) ratio_q16 = 5UL << 14;
+    }
+    m_ratio_q16 = ratio_q16;
+    m_vdda_mV = (int32_t)(((uint32_t)BAT_ADC_VREF_MV * ratio_q16 + (1UL << 15)) >> 16);
+
+    uint32_t voltageScale_q16 = (uint32_t)(((uint64_t)m_voltageScale_q16 * ratio_q16) >> 16);
+    uint32_t currentScale_q16 = (uint32_t)(((uint64_t)m_currentScale_q16 * ratio_q16) >> 16);
+    m_voltage_mV = scale_q8(m_voltage_q8, voltageScale_q16) - m_voltageOffset_mV;
+    m_current_mA = scale_q8(m_current_q8, currentScale_q16) - m_currentOffset_mA;
+
+    // temperature sensor voltage relative to VREFINT, 0.1mV - two more divisions per result
+    if (vref_counts > BAT_VREFINT_NOMINAL / 2) {
+        int32_t vsense_01mV = (int32_t)((((uint32_t)m_temperature_q8 >> 8) * (BAT_VREFINT_MV * 10U)) / vref_counts);
+        m_temperature_dC = (int16_t)(((BAT_TEMP_V25_01MV - vsense_01mV) * 10) / BAT_TEMP_SLOPE_01MV + 250);
+    }
+}
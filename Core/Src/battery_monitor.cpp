@@ -0,0 +1,88 @@
+/**
+ * @file battery_monitor.cpp
+ * @brief Implementation of the coulomb counter and the sag compensated state of charge
+ */
+
+#include "battery_monitor.h"
+
+#define MAUS_PER_MAH 3600000000ULL          // 1mAh = 1mA * 3600s
+
+// LiPo resting cell voltage at 0, 10, 20 .. 100 % state of charge
+static const int16_t soc_lut_mV[] = {3300, 3600, 3700, 3750, 3790, 3830, 3870, 3930, 3990, 4080, 4200};
+static const uint8_t SOC_LUT_SIZE = sizeof(soc_lut_mV) / sizeof(soc_lut_mV[0]);
+
+BatteryMonitor::BatteryMonitor() {
+    reset();
+}
+
+void BatteryMonitor::reset(void) {
+    m_voltage_mV = 0;
+    m_current_mA = 0;
+    m_charge_mAus = 0;
+    m_consumed_mAh = 0;
+    m_lastUpdate_us = 0;
+    m_remaining_q8 = 0;
+    m_cells = BAT_CELL_COUNT;
+    m_hasUpdate = false;
+    m_hasSoc = false;
+}
+
+uint16_t BatteryMonitor::socFromCell_q8(int32_t cell_mV) {
+    if (cell_mV <= soc_lut_mV[0]) return 0;
+    if (cell_mV >= soc_lut_mV[SOC_LUT_SIZE - 1]) return 100 << 8;
+    uint8_t index = 1;
+    while (cell_mV > soc_lut_mV[index]) index++;
+    int32_t low = soc_lut_mV[index - 1];
+    // 10% steps between the LUT points, linear in between
+    return (uint16_t)(((index - 1) * 10 << 8) + ((cell_mV - low) * (10 << 8)) / (soc_lut_mV[index] - low));
+}
+
+void BatteryMonitor::update(int32_t voltage_mV, int32_t current_mA, uint32_t now_us) {
+    m_voltage_mV = voltage_mV;
+    m_current_mA = current_mA;
+
+    if (voltage_mV < BAT_MIN_VALID_MV) {    // no battery - keep the counter, nothing to estimate
+        m_lastUpdate_us = now_us;
+        m_hasUpdate = true;
+        return;
+    }
+
+    // coulomb counting - mA * us, whole mAh are carried out
+    uint32_t dt_us = now_us - m_lastUpdate_us;
+    m_lastUpdate_us = now_us;
+    if (m_hasUpdate && current_mA > 0 && dt_us < BAT_MAX_DT_US) {
+        m_charge_mAus += (uint64_t)current_mA * dt_us;
+        while (m_charge_mAus >= MAUS_PER_MAH) {
+            m_charge_mAus -= MAUS_PER_MAH;
+            m_consumed_mAh++;
+        }
+    }
+
+    if (m_cells == 0) m_cells = (uint8_t)((voltage_mV + BAT_CELL_MAX_MV - 1) / BAT_CELL_MAX_MV);
+
+    // resting voltage estimate: add the sag across the internal resistance (mA * mOhm = uV)
+    int32_t rest_mV = voltage_mV + (current_mA > 0 ? current_mA * BAT_INTERNAL_RESISTANCE_MOHM / 1000 : 0);
+    uint16_t soc_q8 = socFromCell_q8(rest_mV / m_cells);
+    if (!m_hasSoc) m_remaining_q8 = soc_q8;
+    else m_remaining_q8 = (uint16_t)(m_remaining_q8 + (((int32_t)soc_q8 - m_remaining_q8) >> 5));   // ~1.3s at 50Hz
+    m_hasSoc = true;
+    m_hasUpdate = true;
+}
+
+size_t BatteryMonitor::encodeCrsfFrame(uint8_t *payload) const {
+    uint32_t voltage_dV = m_voltage_mV > 0 ? ((uint32_t)m_voltage_mV + 50) / 100 : 0;
+    uint32_t current_dA = m_current_mA > 0 ? ((uint32_t)m_current_mA + 50) / 100 : 0;
+    uint32_t capacity = m_consumed_mAh > 0xFFFFFF ? 0xFFFFFF : m_consumed_mAh;
+
+    if (voltage_dV > 0xFFFF) voltage_dV = 0xFFFF;
+    if (current_dA > 0xFFFF) current_dA = 0xFFFF;
+    payload[0] = (uint8_t)(voltage_dV >> 8);
+    payload[1] = (uint8_t)voltage_dV;
+    payload[2] = (uint8_t)(current_dA >> 8);
+    payload[3] = (uint8_t)current_dA;
+    payload[4] = (uint8_t)(capacity >> 16);
+    payload[5] = (uint8_t)(capacity >> 8);
+    payload[6] = (uint8_t)capacity;
+    payload[7] = getRemaining_pct();
+    return CRSF_BATTERY_SENSOR_PAYLOAD_SIZE;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file channel_mixer.cpp
+ * @brief Implementation of the LUT based channel mixer
+ */
+
+#include "channel_mixer.h"
+
+ChannelMixer::ChannelMixer() {
+    setDefaults();
+}
+
+void ChannelMixer::setDefaults(void) {
+    for (uint8_t output = 0; output < MIXER_NUM_OUTPUTS; output++) {
+        MixerOutputConfig config = {0, 0, 0, 0, false, 0, 0, 0, 0};
+        config.sourceA = output + 1;
+        config.weightA = 100;
+        config.endpointLow = 100;
+        config.endpointHigh = 100;
+        configure(output, config);
+    }
+}
+
+bool ChannelMixer::configure(uint8_t output, const MixerOutputConfig &config) {
+    if (output >= MIXER_NUM_OUTPUTS) return false;
+    if (config.sourceA < 1 || config.sourceA > MIXER_NUM_INPUTS) return false;
+    if (config.sourceB > MIXER_NUM_INPUTS) return false;
+
+    m_config[output] = config;
+    if (m_config[output].expo > 100) m_config[output].expo = 100;
+    if (m_config[output].endpointLow > 150) m_config[output].endpointLow = 150;
+    if (m_config[output].endpointHigh > 150) m_config[output].endpointHigh = 150;
+
+    m_indexA[output] = config.sourceA - 1;
+    m_weightA_q7[output] = (int16_t)((int32_t)config.weightA * 128 / 100);
+    if (config.sourceB == 0) {   // no second input: weight 0 keeps process() branch free
+        m_indexB[output] = 0;
+        m_weightB_q7[output] = 0;
+    } else {
+        m_indexB[output] = config.sourceB - 1;
+        m_weightB_q7[output] = (int16_t)((int32_t)config.weightB * 128 / 100);
+    }
+    buildLUT(output);
+    return true;
+}
+
+void ChannelMixer::buildLUT(uint8_t output) {
+    const MixerOutputConfig &config = m_config[output];
+
+    for (int32_t i = 0; i < MIXER_LUT_SIZE; i++) {
+        int32_t x = -MIXER_LUT_RANGE + (i << MIXER_LUT_SHIFT);
+        // expo: blend of linear and cubic curve, both pass through +-MIXER_LUT_RANGE
+        int32_t cube = x * x / MIXER_LUT_RANGE * x / MIXER_LUT_RANGE;
+        int32_t y = (x * (100 - config.expo) + cube * config.expo) / 100;
+        if (config.reverse) y = -y;
+        y = y * ((y >= 0) ? config.endpointHigh : config.endpointLow) / 100;
+        y += MIXER_CENTER_US + config.subtrim;
+        if (y < MIXER_OUTPUT_MIN_US) y = MIXER_OUTPUT_MIN_US;
+        if (y > MIXER_OUTPUT_MAX_US) y = MIXER_OUTPUT_MAX_US;
+        m_lut[output][i] = (int16_t)y;
+    }
+}
+
+void ChannelMixer::process(const uint16_t *channels_us, uint16_t *outputs_us, uint8_t num_outputs) const {
+    if (num_outputs > MIXER_NUM_OUTPUTS) num_outputs = MIXER_NUM_OUTPUTS;
+
+    for (uint8_t output = 0; output < num_outputs; output++) {
+        int32_t mix = ((int32_t)channels_us[m_indexA[output]] - MIXER_CENTER_US) * m_weightA_q7[output]
+                    + ((int32_t)channels_us[m_indexB[output]] - MIXER_CENTER_US) * m_weightB_q7[output];
+        mix >>= 7;
+        if (mix < -MIXER_LUT_RANGE) mix = -MIXER_LUT_RANGE;
+        if (mix >  MIXER_LUT_RANGE) mix =  MIXER_LUT_RANGE;
+
+        const int16_t *lut = m_lut[output];
+        uint32_t position = (uint32_t)(mix + MIXER_LUT_RANGE);
+        uint32_t index = position >> MIXER_LUT_SHIFT;
+        if (index >= MIXER_LUT_SIZE - 1) {
+            outputs_us[output] = (uint16_t)lut[MIXER_LUT_SIZE - 1];
+            continue;
+        }
+        int32_t fraction = (int32_t)(position & ((1u << MIXER_LUT_SHIFT) - 1));
+        outputs_us[output] = (uint16_t)(lut[index] + (((lut[index + 1] - lut[index]) * fraction) >> MIXER_LUT_SHIFT));
+    }
+}
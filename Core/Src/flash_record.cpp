@@ -0,0 +1,76 @@
+/**
+ * @file flash_record.cpp
+ * @brief CRC protected flash record: page erase and word programming through the HAL
+ */
+
+#include "flash_record.h"
+#include <string.h>
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t length) {
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+    }
+    return crc;
+}
+
+static bool sizeValid(size_t size) {
+    return size % 4 == 0 && size <= FLASH_RECORD_MAX_PAYLOAD;
+}
+
+static HAL_StatusTypeDef erasePage(const uint32_t *page) {
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t pageError = 0;
+
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = (uint32_t)(uintptr_t)page;
+    erase.NbPages = 1;
+    return HAL_FLASHEx_Erase(&erase, &pageError);
+}
+
+uint32_t flash_record_crc32(const void *data, size_t length) {
+    return ~crc32Update(0xFFFFFFFFUL, (const uint8_t *)data, length);
+}
+
+bool flash_record_read(const uint32_t *page, uint32_t magic, uint32_t version, void *payload, size_t size) {
+    if (!sizeValid(size)) return false;
+    if (page[0] != magic || page[1] != version) return false;
+    if (page[2 + size / 4] != flash_record_crc32(page, 8 + size)) return false;
+    memcpy(payload, page + 2, size);
+    return true;
+}
+
+HAL_StatusTypeDef flash_record_write(const uint32_t *page, uint32_t magic, uint32_t version, const void *payload,
+                                     size_t size) {
+    uint32_t header[2] = {magic, version};
+    HAL_StatusTypeDef status;
+
+    if (!sizeValid(size)) return HAL_ERROR;
+    uint32_t crc = ~crc32Update(crc32Update(0xFFFFFFFFUL, (const uint8_t *)header, sizeof(header)),
+                                (const uint8_t *)payload, size);
+
+    HAL_FLASH_Unlock();
+    status = erasePage(page);
+    uint32_t address = (uint32_t)(uintptr_t)page;
+    for (uint8_t i = 0; status == HAL_OK && i < 2; i++, address += 4) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address, header[i]);
+    }
+    const uint8_t *data = (const uint8_t *)payload;
+    for (size_t offset = 0; status == HAL_OK && offset < size; offset += 4, address += 4) {
+        uint32_t word;
+        memcpy(&word, data + offset, 4);    // payload may be unaligned
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address, word);
+    }
+    if (status == HAL_OK) status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address, crc);   // last: marks the record complete
+    HAL_FLASH_Lock();
+    return status;
+}
+
+HAL_StatusTypeDef flash_record_erase(const uint32_t *page) {
+    HAL_StatusTypeDef status;
+
+    HAL_FLASH_Unlock();
+    status = erasePage(page);
+    HAL_FLASH_Lock();
+    return status;
+}
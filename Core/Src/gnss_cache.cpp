@@ -0,0 +1,68 @@
+/**
+ * @file gnss_cache.cpp
+ * @brief CRC protected GNSS warm start record and its once per boot save policy
+ */
+
+#include "gnss_cache.h"
+#include "flash_record.h"
+
+// GNSS_CACHE region of the linker script - one 1k flash page
+extern "C" const uint32_t _gnss_cache_start[];
+
+static_assert(sizeof(GnssCacheData) % 4 == 0, "GNSS cache record is programmed in words");
+static_assert(sizeof(GnssCacheData) <= FLASH_RECORD_MAX_PAYLOAD, "GNSS cache record exceeds the flash page");
+
+static bool g_saved = false;                // written during this boot
+static uint32_t g_goodSince_ms = 0;         // first epoch of the current run of good fixes
+static bool g_good = false;
+
+bool gnss_cache_load(GnssCacheData *data) {
+    return flash_record_read(_gnss_cache_start, GNSS_CACHE_MAGIC, GNSS_CACHE_VERSION, data, sizeof(*data));
+}
+
+HAL_StatusTypeDef gnss_cache_save(const GnssCacheData &data) {
+    return flash_record_write(_gnss_cache_start, GNSS_CACHE_MAGIC, GNSS_CACHE_VERSION, &data, sizeof(data));
+}
+
+HAL_StatusTypeDef gnss_cache_erase(void) {
+    return flash_record_erase(_gnss_cache_start);
+}
+
+bool gnss_cache_task(const GnssSnapshot &gnss, uint32_t now_ms, int32_t clockError_ppb, bool clockValid) {
+    if (g_saved) return false;
+
+    bool good = gnss.fixOK && gnss.fixType == 3 && gnss.timeValid && gnss.hAcc <= GNSS_CACHE_MAX_HACC_MM &&
+                gnss.groundSpeed <= GNSS_CACHE_MAX_SPEED_MMS;
+    if (!good) {
+        g_good = false;
+        return false;
+    }
+    if (!g_good) {
+        g_good = true;
+        g_goodSince_ms = now_ms;
+    }
+    if (now_ms - g_goodSince_ms < GNSS_CACHE_SAVE_DELAY_MS) return false;
+
+    GnssCacheData data = GnssCacheData();
+    if (!clockValid) {                      // keep the stored clock error until the PPS clock locks
+        GnssCacheData stored;
+        if (gnss_cache_load(&stored) && stored.clockValid) {
+            clockError_ppb = stored.clockError_ppb;
+            clockValid = true;
+        }
+    }
+    data.warmStart.latitude = gnss.latitude;
+    data.warmStart.longitude = gnss.longitude;
+    data.warmStart.altitudeMSL = gnss.altitudeMSL;
+    data.warmStart.hAcc = gnss.hAcc;
+    data.warmStart.year = gnss.year;
+    data.warmStart.month = gnss.month;
+    data.warmStart.day = gnss.day;
+    data.warmStart.hour = gnss.hour;
+    data.warmStart.minute = gnss.minute;
+    data.warmStart.second = gnss.second;
+    data.clockError_ppb = clockValid ? clockError_ppb : 0;
+    data.clockValid = clockValid ? 1 : 0;
+    g_saved = true;                         // one attempt per boot, also if programming fails
+    return gnss_cache_save(data) == HAL_OK;
+}
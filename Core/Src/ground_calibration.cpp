@@ -0,0 +1,46 @@
+/**
+ * @file ground_calibration.cpp
+ * @brief Welford running mean / variance with convergence detection
+ */
+
+#include "ground_calibration.h"
+#include <math.h>
+
+GroundCalibration::GroundCalibration() : m_ground(0.0f), m_ready(false) {
+    rezero();
+}
+
+void GroundCalibration::rezero(void) {
+    m_skip = GROUND_CAL_SKIP_SAMPLES;
+    m_count = 0;
+    m_mean = 0.0f;
+    m_m2 = 0.0f;
+    m_calibrating = true;                   // m_ground / m_ready stay until the new mean is complete
+}
+
+float GroundCalibration::getStandardError(void) const {
+    if (m_count < 2) return INFINITY;
+    return sqrtf(m_m2 / (float)(m_count - 1) / (float)m_count);
+}
+
+bool GroundCalibration::update(float altitude_m) {
+    if (!m_calibrating) return false;
+    if (m_skip > 0) {
+        m_skip--;
+        return false;
+    }
+
+    m_count++;
+    float delta = altitude_m - m_mean;
+    m_mean += delta / (float)m_count;
+    m_m2 += delta * (altitude_m - m_mean);
+
+    // var / n < sem^2 without the square root
+    bool converged = m_count >= GROUND_CAL_MIN_SAMPLES &&
+                     m_m2 < GROUND_CAL_MAX_SEM_M * GROUND_CAL_MAX_SEM_M * (float)(m_count - 1) * (float)m_count;
+    if (!converged && m_count < GROUND_CAL_MAX_SAMPLES) return false;
+    m_ground = m_mean;
+    m_calibrating = false;
+    m_ready = true;
+    return true;
+}
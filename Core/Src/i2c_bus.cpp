@@ -0,0 +1,300 @@
+/**
+ * @file i2c_bus.cpp
+ * @brief Implementation of the interrupt driven I2C transaction queue
+ */
+
+#include "i2c_bus.h"
+#include "timebase.h"
+
+static_assert((I2C_BUS_QUEUE_SIZE & (I2C_BUS_QUEUE_SIZE - 1)) == 0, "I2C_BUS_QUEUE_SIZE must be a power of two");
+
+#define QUEUE_MASK (I2C_BUS_QUEUE_SIZE - 1)
+
+I2cBus::I2cBus(I2C_HandleTypeDef *hi2c)
+    : m_hi2c(hi2c), m_head(0), m_tail(0), m_current(nullptr), m_rxPhase(false), m_startPending(false),
+      m_numPeriodic(0), m_statsStart_us(0) {
+    resetStats(0);
+}
+
+bool I2cBus::submit(I2cTransaction *transaction) {
+    bool accepted = false;
+    uint32_t primask = __get_PRIMASK();     // also called from completion callbacks
+    __disable_irq();
+    if (transaction->status != I2C_STATUS_QUEUED && transaction->status != I2C_STATUS_BUSY) {
+        uint8_t next = (m_head + 1) & QUEUE_MASK;
+        if (next == m_tail) {
+            m_stats.queueFull++;
+        } else {
+            transaction->status = I2C_STATUS_QUEUED;
+            transaction->submit_us = timebase_micros();
+            m_queue[m_head] = transaction;
+            m_head = next;
+            accepted = true;
+        }
+    }
+    __set_PRIMASK(primask);
+    if (accepted) startNext();
+    return accepted;
+}
+
+bool I2cBus::addPeriodic(I2cTransaction *transaction, uint32_t period_us) {
+    if (m_numPeriodic >= I2C_BUS_MAX_PERIODIC || period_us == 0) return false;
+    m_periodic[m_numPeriodic].transaction = transaction;
+    m_periodic[m_numPeriodic].period_us = period_us;
+    m_periodic[m_numPeriodic].next_us = timebase_micros();
+    m_periodic[m_numPeriodic].enabled = true;
+    m_numPeriodic++;
+    return true;
+}
+
+void I2cBus::setPeriodicEnabled(I2cTransaction *transaction, bool enabled) {
+    for (uint8_t index = 0; index < m_numPeriodic; index++) {
+        Periodic &device = m_periodic[index];
+        if (device.transaction != transaction) continue;
+        if (enabled && !device.enabled) device.next_us = timebase_micros();
+        device.enabled = enabled;
+    }
+}
+
+bool I2cBus::cancel(I2cTransaction *transaction) {
+    bool queued = false;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t index = m_tail; index != m_head; index = (index + 1) & QUEUE_MASK) {
+        if (m_queue[index] != transaction) continue;
+        m_queue[index] = nullptr;           // startNext() skips the slot
+        queued = true;
+    }
+    if (queued) {
+        transaction->status = I2C_STATUS_TIMEOUT;
+        m_stats.errors++;
+        m_stats.timeouts++;
+    }
+    __set_PRIMASK(primask);
+    if (queued) return true;
+    if (transaction->status != I2C_STATUS_BUSY) return false;
+    abort(transaction);
+    return true;
+}
+
+bool I2cBus::setClock(uint32_t clock_hz) {
+    if (!isIdle()) return false;            // idle: no interrupt starts a transfer either
+    if (clock_hz > I2C_BUS_MAX_CLOCK_HZ) clock_hz = I2C_BUS_MAX_CLOCK_HZ;
+    if (clock_hz < I2C_BUS_MIN_CLOCK_HZ) clock_hz = I2C_BUS_MIN_CLOCK_HZ;
+    m_hi2c->Init.ClockSpeed = clock_hz;
+    m_hi2c->Init.DutyCycle = I2C_DUTYCYCLE_2;
+    return HAL_I2C_Init(m_hi2c) == HAL_OK;
+}
+
+void I2cBus::schedule(uint32_t now_us) {
+    I2cTransaction *current = m_current;
+    if (current != nullptr && now_us - current->start_us > I2C_BUS_TIMEOUT_US) {
+        abort(current);                     // also a START that never got a free bus
+    } else if (current != nullptr && m_startPending) {
+        startCurrent();                     // bus was still busy or the HAL refused the START
+    }
+
+    for (uint8_t index = 0; index < m_numPeriodic; index++) {
+        Periodic &device = m_periodic[index];
+        if (!device.enabled) continue;
+        I2cStatus status = device.transaction->status;
+        if (status == I2C_STATUS_QUEUED || status == I2C_STATUS_BUSY) continue;
+        if ((int32_t)(now_us - device.next_us) < 0) continue;
+        device.next_us += device.period_us;
+        if ((int32_t)(now_us - device.next_us) >= 0) device.next_us = now_us + device.period_us;  // fell behind - no burst
+        submit(device.transaction);
+    }
+}
+
+void I2cBus::startNext(void) {
+    // claim the next transaction with interrupts disabled, start it with interrupts enabled
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    I2cTransaction *transaction = nullptr;
+    while (transaction == nullptr && m_current == nullptr && m_head != m_tail) {
+        transaction = m_queue[m_tail];
+        m_tail = (m_tail + 1) & QUEUE_MASK;
+        if (transaction == nullptr) continue;   // cancelled while queued
+        transaction->status = I2C_STATUS_BUSY;
+        transaction->start_us = timebase_micros();
+        m_startPending = true;
+        m_current = transaction;
+    }
+    __set_PRIMASK(primask);
+    if (transaction != nullptr) startCurrent();
+}
+
+bool I2cBus::waitBusFree(void) const {
+    // BUSY clears with the STOP of the previous transfer, a few bit times after its interrupt.
+    // The I2C interrupt shares priority 0 with the CRSF UART (1 byte IT buffer, 23.8us per
+    // byte): never spin there, the START is left to schedule()
+    if (__get_IPSR() != 0) return __HAL_I2C_GET_FLAG(m_hi2c, I2C_FLAG_BUSY) == RESET;
+    uint32_t start_us = timebase_micros();
+    while (__HAL_I2C_GET_FLAG(m_hi2c, I2C_FLAG_BUSY) != RESET) {
+        if (timebase_micros() - start_us >= I2C_BUS_STOP_WAIT_US) return false;
+    }
+    return true;
+}
+
+void I2cBus::startCurrent(void) {
+    // only the context that claimed m_current or schedule() get here - nobody else touches the handle
+    I2cTransaction *transaction = m_current;
+    HAL_StatusTypeDef status;
+
+    // the HAL polls BUSY up to 25ms before a START - never let it
+    if (!waitBusFree()) return;
+    m_startPending = false;
+    uint32_t claim_us = transaction->start_us;
+    transaction->start_us = timebase_micros();  // before the call: the interrupt may come right away
+    if (transaction->txLength > 0) {
+        m_rxPhase = false;
+        // write-read: no STOP after the write, the read starts with a repeated START
+        status = HAL_I2C_Master_Seq_Transmit_IT(m_hi2c, (uint16_t)(transaction->address << 1), (uint8_t *)transaction->txData,
+                                                transaction->txLength,
+                                                transaction->rxLength > 0 ? I2C_FIRST_FRAME : I2C_FIRST_AND_LAST_FRAME);
+    } else {
+        m_rxPhase = true;
+        status = HAL_I2C_Master_Seq_Receive_IT(m_hi2c, (uint16_t)(transaction->address << 1), transaction->rxData,
+                                               transaction->rxLength, I2C_FIRST_AND_LAST_FRAME);
+    }
+    if (status == HAL_BUSY) {
+        transaction->start_us = claim_us;   // the timeout runs from the claim while the START is refused
+        m_startPending = true;              // handle not ready - schedule() retries until the timeout
+    } else if (status != HAL_OK) {
+        complete(I2C_STATUS_ERROR);
+    }
+}
+
+void I2cBus::finish(I2cStatus status) {
+    // interrupt context or interrupts disabled
+    I2cTransaction *transaction = m_current;
+    uint32_t now_us = timebase_micros();
+
+    transaction->busTime_us = now_us - transaction->start_us;
+    transaction->latency_us = now_us - transaction->submit_us;
+    m_stats.transactions++;
+    m_stats.busy_us += transaction->busTime_us;
+    if (transaction->latency_us > m_stats.maxLatency_us) m_stats.maxLatency_us = transaction->latency_us;
+    if (status != I2C_STATUS_DONE) m_stats.errors++;
+
+    m_current = nullptr;
+    m_startPending = false;
+    transaction->status = status;
+    if (transaction->callback) transaction->callback(transaction);
+}
+
+void I2cBus::complete(I2cStatus status) {
+    // finish() outside the I2C interrupt: the callback sees the same conditions as there
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    finish(status);
+    __set_PRIMASK(primask);
+    startNext();
+}
+
+void I2cBus::abort(I2cTransaction *transaction) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool stuck = (m_current == transaction);
+    if (stuck) __HAL_I2C_DISABLE_IT(m_hi2c, I2C_IT_EVT | I2C_IT_BUF | I2C_IT_ERR);   // no late completion
+    __set_PRIMASK(primask);
+    if (!stuck) return;                     // completed in the meantime
+
+    // slave holding SDA low (reset in the middle of a read), SCL stretched, lost interrupt
+    recoverBus();
+    m_stats.timeouts++;
+    complete(I2C_STATUS_TIMEOUT);
+}
+
+static void busDelay(void) {
+    uint32_t start = timebase_micros();
+    while (timebase_micros() - start < 5) {}    // half a 100kHz clock period
+}
+
+void I2cBus::recoverBus(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    HAL_I2C_DeInit(m_hi2c);                 // pins back to GPIO, peripheral clock off
+
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_WritePin(I2C_BUS_SCL_GPIO_Port, I2C_BUS_SCL_Pin, GPIO_PIN_SET);
+    HAL_GPIO_WritePin(I2C_BUS_SDA_GPIO_Port, I2C_BUS_SDA_Pin, GPIO_PIN_SET);
+    GPIO_InitStruct.Pin = I2C_BUS_SCL_Pin;
+    HAL_GPIO_Init(I2C_BUS_SCL_GPIO_Port, &GPIO_InitStruct);
+    GPIO_InitStruct.Pin = I2C_BUS_SDA_Pin;
+    HAL_GPIO_Init(I2C_BUS_SDA_GPIO_Port, &GPIO_InitStruct);
+    busDelay();
+
+    // a slave in the middle of a read byte releases SDA after at most 9 clocks
+    for (uint8_t clock = 0; clock < 9 && HAL_GPIO_ReadPin(I2C_BUS_SDA_GPIO_Port, I2C_BUS_SDA_Pin) == GPIO_PIN_RESET; clock++) {
+        HAL_GPIO_WritePin(I2C_BUS_SCL_GPIO_Port, I2C_BUS_SCL_Pin, GPIO_PIN_RESET);
+        busDelay();
+        HAL_GPIO_WritePin(I2C_BUS_SCL_GPIO_Port, I2C_BUS_SCL_Pin, GPIO_PIN_SET);
+        busDelay();
+    }
+
+    // STOP: SDA low -> high while SCL is high
+    HAL_GPIO_WritePin(I2C_BUS_SCL_GPIO_Port, I2C_BUS_SCL_Pin, GPIO_PIN_RESET);
+    busDelay();
+    HAL_GPIO_WritePin(I2C_BUS_SDA_GPIO_Port, I2C_BUS_SDA_Pin, GPIO_PIN_RESET);
+    busDelay();
+    HAL_GPIO_WritePin(I2C_BUS_SCL_GPIO_Port, I2C_BUS_SCL_Pin, GPIO_PIN_SET);
+    busDelay();
+    HAL_GPIO_WritePin(I2C_BUS_SDA_GPIO_Port, I2C_BUS_SDA_Pin, GPIO_PIN_SET);
+    busDelay();
+
+    // the F103 I2C can keep BUSY set after glitches on the lines (errata) - full peripheral reset
+    if (m_hi2c->Instance == I2C1) { __HAL_RCC_I2C1_FORCE_RESET(); __HAL_RCC_I2C1_RELEASE_RESET(); }
+    else { __HAL_RCC_I2C2_FORCE_RESET(); __HAL_RCC_I2C2_RELEASE_RESET(); }
+    HAL_I2C_Init(m_hi2c);                   // MspInit restores the alternate function pins
+}
+
+void I2cBus::onTransferDone(I2C_HandleTypeDef *hi2c, bool error) {
+    I2cTransaction *transaction = m_current;
+    if (hi2c != m_hi2c || transaction == nullptr || m_startPending) return;    // not our transfer
+
+    if (error) {
+        finish((m_hi2c->ErrorCode & HAL_I2C_ERROR_AF) ? I2C_STATUS_NACK : I2C_STATUS_ERROR);
+    } else if (!m_rxPhase && transaction->rxLength > 0) {
+        m_rxPhase = true;
+        if (HAL_I2C_Master_Seq_Receive_IT(m_hi2c, (uint16_t)(transaction->address << 1), transaction->rxData,
+                                          transaction->rxLength, I2C_LAST_FRAME) == HAL_OK) {
+            return;                         // repeated START, no BUSY wait in the HAL for a LAST_FRAME
+        }
+        finish(I2C_STATUS_ERROR);
+    } else {
+        finish(I2C_STATUS_DONE);
+    }
+    startNext();
+}
+
+void I2cBus::getStats(I2cBusStats *stats, uint32_t now_us) const {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = m_stats;
+    __set_PRIMASK(primask);
+    stats->elapsed_us = now_us - m_statsStart_us;
+}
+
+void I2cBus::resetStats(uint32_t now_us) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    m_stats.transactions = 0;
+    m_stats.errors = 0;
+    m_stats.timeouts = 0;
+    m_stats.queueFull = 0;
+    m_stats.maxLatency_us = 0;
+    m_stats.busy_us = 0;
+    m_stats.elapsed_us = 0;
+    m_statsStart_us = now_us;
+    __set_PRIMASK(primask);
+}
+
+uint16_t I2cBus::getUtilisation_permille(uint32_t now_us) const {
+    uint32_t elapsed_us = now_us - m_statsStart_us;
+    if (elapsed_us == 0) return 0;
+    uint32_t permille = (uint32_t)(((uint64_t)m_stats.busy_us * 1000U) / elapsed_us);
+    return (uint16_t)(permille > 1000 ? 1000 : permille);
+}
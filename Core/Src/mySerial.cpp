@@ -1,11 +1,11 @@
-#include "../inc/mySerial.h"
+#include "mySerial.h"
 #include "stm32f1xx_hal_uart.h"							   
 #include <cstddef>
 #include <cstdint>
 
 
 mySerial::mySerial()
-    : m_huart(nullptr),  m_tx_fifo(nullptr), m_rx_fifo(nullptr),m_fifo_size(0),
+    : m_huart(nullptr),  m_tx_fifo(nullptr), m_rx_fifo(nullptr),m_fifo_size(0), m_rx_fifo_size(0),
       m_tx_fifo_head(0), m_tx_fifo_tail(0), m_rx_fifo_head(0), m_rx_fifo_tail(0), m_uart_tx_buffer(nullptr), m_uart_rx_buffer(nullptr), m_uart_tx_buffer_size(0) {}
 
 mySerial::~mySerial() {
@@ -15,11 +15,14 @@ mySerial::~mySerial() {
     if (m_uart_rx_buffer) delete[] m_uart_rx_buffer;
 }
 
-void mySerial::init(UART_HandleTypeDef *huart,  size_t fifo_buffer_size, size_t UART_tx_buffer_size) {
+void mySerial::init(UART_HandleTypeDef *huart,  size_t fifo_buffer_size, size_t UART_tx_buffer_size,
+                    DMA_Channel_TypeDef *rx_dma, size_t rx_fifo_size) {
     m_huart = huart;
+    m_rx_dma = rx_dma;
     m_huart_tx_ready = true;
     m_huart_rx_ready = true;
     m_fifo_size = fifo_buffer_size;
+    m_rx_fifo_size = rx_fifo_size ? rx_fifo_size : fifo_buffer_size;
     m_uart_tx_buffer_size = UART_tx_buffer_size;
     m_tx_fifo_head = m_tx_fifo_tail = 0;
     m_rx_fifo_head = m_rx_fifo_tail = 0;
@@ -28,21 +31,46 @@ void mySerial::init(UART_HandleTypeDef *huart,  size_t fifo_buffer_size, size_t
     if (m_uart_tx_buffer) delete[] m_uart_tx_buffer;
     if (m_uart_rx_buffer) delete[] m_uart_rx_buffer;
     m_tx_fifo = new uint8_t[m_fifo_size];
-    m_rx_fifo = new uint8_t[m_fifo_size];
+    m_rx_fifo = new uint8_t[m_rx_fifo_size];
     m_uart_tx_buffer = new uint8_t[m_uart_tx_buffer_size];
     m_uart_rx_buffer = new uint8_t[m_uart_rx_buffer_size];
     
     // Abort any existing receive operation to prevent conflicts
     HAL_UART_AbortReceive(m_huart);
     
-    // Start UART receive interrupt - Wait for one character
-    m_huart_rx_ready = false;
-    HAL_UART_Receive_IT(m_huart, m_uart_rx_buffer, m_uart_rx_buffer_size);
-    HAL_UART_Receive_IT(m_huart, m_uart_rx_buffer, m_uart_rx_buffer_size);
+    // Start UART receive interrupt - Wait for one character (or the circular RX DMA)
+    start_RX();
     
     m_initialized = true;  // Mark as fully initialized
 }
 
+void mySerial::start_RX() {
+    m_huart_rx_ready = false;
+    if (!m_rx_dma) {
+        HAL_UART_Receive_IT(m_huart, m_uart_rx_buffer, m_uart_rx_buffer_size);
+        return;
+    }
+    // USART DR -> RX FIFO, byte wide, circular, no interrupts: the DMA counter is the FIFO head
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    m_rx_dma->CCR = 0;
+    (void)m_huart->Instance->SR;        // SR then DR read: clears an overrun left from before
+    (void)m_huart->Instance->DR;
+    m_rx_dma->CPAR = (uint32_t)(uintptr_t)&m_huart->Instance->DR;
+    m_rx_dma->CMAR = (uint32_t)(uintptr_t)m_rx_fifo;
+    m_rx_dma->CNDTR = m_rx_fifo_size;
+    m_rx_dma->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN;
+    SET_BIT(m_huart->Instance->CR3, USART_CR3_DMAR);
+}
+
+void mySerial::update_RX_DMA() {
+    // the DMA has written (fifo size - CNDTR) bytes since the last wrap. A lap the reader
+    // did not keep up with is not detectable - the FIFO is sized for the longest stall.
+    size_t head = m_rx_fifo_size - m_rx_dma->CNDTR;
+    if (head >= m_rx_fifo_size) head = 0;  // CNDTR reloads to the FIFO size after the last byte
+    m_stats.rxBytes += (head - m_rx_fifo_head + m_rx_fifo_size) % m_rx_fifo_size;
+    m_rx_fifo_head = head;
+}
+
 void mySerial::set_ready_TX() {
     m_huart_tx_ready = true;
 }
@@ -60,18 +88,50 @@ int8_t mySerial::restart_RX(){
     HAL_UART_AbortReceive(m_huart);
     m_tx_fifo_head = m_tx_fifo_tail = 0;
     m_rx_fifo_head = m_rx_fifo_tail = 0;
-    m_huart_rx_ready = false;
-    HAL_UART_Receive_IT(m_huart, m_uart_rx_buffer, m_uart_rx_buffer_size);
-    HAL_UART_Receive_IT(m_huart, m_uart_rx_buffer, m_uart_rx_buffer_size);
+    start_RX();
 
     return 0;
 }
 
+int8_t mySerial::setBaudRate(uint32_t baudrate){
+    if (!m_initialized || !m_huart) {
+        return -1;  // Not initialized
+    }
+
+    HAL_UART_AbortTransmit(m_huart);
+    HAL_UART_AbortReceive(m_huart);
+    m_huart->Init.BaudRate = baudrate;
+    if (HAL_UART_Init(m_huart) != HAL_OK) {  // peripheral is already set up - only BRR / CR registers are written
+        return -1;
+    }
+    m_huart_tx_ready = true;
+    return restart_RX();
+}
+
+void mySerial::onError(){
+    if (!m_initialized || !m_huart) {
+        return;
+    }
+    uint32_t error = m_huart->ErrorCode;
+    if (error & HAL_UART_ERROR_ORE) m_stats.overrunErrors++;
+    if (error & HAL_UART_ERROR_FE) m_stats.framingErrors++;
+    if (error & HAL_UART_ERROR_NE) m_stats.noiseErrors++;
+    // an overrun aborts the reception (RxState back to READY) - FE / NE keep it running
+    if (!m_rx_dma && m_huart->RxState == HAL_UART_STATE_READY) {
+        start_RX();
+    }
+}
+
+void mySerial::resetStats(){
+    m_stats = SerialStats();
+}
+
 uint8_t* mySerial::get_uart_rx_buffer(){
 	return m_uart_rx_buffer;
 }
 
 size_t mySerial::available() {
+    if (m_initialized && m_rx_dma) update_RX_DMA();
     return fifo_data_length( m_isRX);
 }
 
@@ -107,7 +167,7 @@ size_t mySerial::fifo_free_space(bool m_isTXfifo)  {
     }
     else {
         if (m_rx_fifo_head >= m_rx_fifo_tail)
-                return m_fifo_size - (m_rx_fifo_head - m_rx_fifo_tail) - 1;
+                return m_rx_fifo_size - (m_rx_fifo_head - m_rx_fifo_tail) - 1;
         else    return m_rx_fifo_tail - m_rx_fifo_head - 1;       
     }
 }
@@ -116,7 +176,7 @@ size_t mySerial::fifo_free_space(bool m_isTXfifo)  {
 
 size_t mySerial::fifo_data_length(bool m_isTXfifo) {
     if (m_isTXfifo) return (m_tx_fifo_head - m_tx_fifo_tail + m_fifo_size) % m_fifo_size;
-    else            return (m_rx_fifo_head - m_rx_fifo_tail + m_fifo_size) % m_fifo_size;
+    else            return (m_rx_fifo_head - m_rx_fifo_tail + m_rx_fifo_size) % m_rx_fifo_size;
 
 }
 
@@ -128,8 +188,11 @@ void mySerial::fifo_push(bool m_isTXfifo, uint8_t c) {
     }
     else{
         m_rx_fifo[m_rx_fifo_head] = c;
-        m_rx_fifo_head = (m_rx_fifo_head + 1) % m_fifo_size;
-	    if (m_rx_fifo_head == m_rx_fifo_tail) m_rx_fifo_tail=(m_rx_fifo_head+1)%m_fifo_size;  // overflow behavior for UART RX: drop oldest byte
+        m_rx_fifo_head = (m_rx_fifo_head + 1) % m_rx_fifo_size;
+	    if (m_rx_fifo_head == m_rx_fifo_tail) {  // overflow behavior for UART RX: drop oldest byte
+            m_rx_fifo_tail=(m_rx_fifo_head+1)%m_rx_fifo_size;
+            m_stats.rxOverflows++;
+        }
     }
 }
 
@@ -141,7 +204,7 @@ uint8_t mySerial::fifo_pop(bool m_isTXfifo) {
     }
     else{               // RX FIFO
        c = m_rx_fifo[m_rx_fifo_tail];
-       m_rx_fifo_tail = (m_rx_fifo_tail + 1) % m_fifo_size;       
+       m_rx_fifo_tail = (m_rx_fifo_tail + 1) % m_rx_fifo_size;       
     }
     return c;
 }
@@ -162,10 +225,11 @@ size_t mySerial::write(const uint8_t *data_array, size_t len) {
 }
 
 size_t mySerial::read( uint8_t *data_array, size_t len) {
-    if (!m_initialized || !m_rx_fifo || m_fifo_size == 0) {
+    if (!m_initialized || !m_rx_fifo || m_rx_fifo_size == 0) {
         return 0;  // Not initialized
     }
     size_t byte_read = 0;
+    if (m_rx_dma) update_RX_DMA();
     size_t available_data = fifo_data_length(m_isRX);
     size_t to_read = (len < available_data) ? len : available_data;
     for (size_t i = 0; i < to_read; ++i) {
@@ -221,7 +285,7 @@ size_t mySerial::TX_callBackPull() {
 }
 
 int8_t mySerial::receive() {
-    if (!m_initialized || !m_huart || !m_rx_fifo || m_fifo_size == 0) {
+    if (!m_initialized || !m_huart || !m_rx_fifo || m_rx_fifo_size == 0 || m_rx_dma) {
         return -1;  // Not initialized
     }
 	if( !m_huart_rx_ready){
@@ -231,6 +295,7 @@ int8_t mySerial::receive() {
 		for (size_t i = 0; i < m_uart_rx_buffer_size; ++i) {
 			fifo_push(m_isRX,m_uart_rx_buffer[i]);
 		}
+	m_stats.rxBytes += m_uart_rx_buffer_size;
 	m_huart_rx_ready = false;
 	HAL_UART_Receive_IT(m_huart, m_uart_rx_buffer,m_uart_rx_buffer_size);
     return fifo_data_length(m_isRX);
@@ -0,0 +1,272 @@
+/**
+ * @file nmea_parser.cpp
+ * @brief NMEA sentence state machine, in place field split and GGA / RMC / VTG decoding
+ */
+
+#include "nmea_parser.h"
+#include <string.h>
+
+#define GGA_FIELDS 10                       // up to the altitude
+#define RMC_FIELDS 10                       // up to the date
+#define VTG_FIELDS 8                        // up to the speed in km/h
+#define DATA_LENGTH (NMEA_MAX_SENTENCE - 6) // without '$', "*hh", <CR><LF> and with the terminator
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int8_t hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static bool appendDigit(uint32_t *value, uint8_t digit) {
+    if (*value > (uint32_t)(INT32_MAX - digit) / 10) return false;
+    *value = *value * 10 + digit;
+    return true;
+}
+
+// "[-]123.456" -> value * 10^decimals, further decimals rounded
+static bool parseFixed(const char *s, uint8_t decimals, int32_t *value) {
+    bool negative = (*s == '-');
+    if (negative) s++;
+    if (!isDigit(*s) && !(*s == '.' && isDigit(s[1]))) return false;
+
+    uint32_t result = 0;
+    for (; isDigit(*s); s++) {
+        if (!appendDigit(&result, *s - '0')) return false;
+    }
+    uint8_t places = 0;
+    bool roundUp = false;
+    if (*s == '.') {
+        for (s++; isDigit(*s); s++, places++) {
+            if (places < decimals && !appendDigit(&result, *s - '0')) return false;
+            if (places == decimals) roundUp = (*s >= '5');
+        }
+    }
+    if (*s != '\0') return false;
+    for (; places < decimals; places++) {
+        if (!appendDigit(&result, 0)) return false;
+    }
+    if (roundUp) {
+        if (result == INT32_MAX) return false;
+        result++;
+    }
+    *value = negative ? -(int32_t)result : (int32_t)result;
+    return true;
+}
+
+// "ddmm.mmmmm" / "dddmm.mmmmm" + 'N' / 'S' / 'E' / 'W' -> degrees * 10^-7
+static bool parseCoordinate(const char *s, const char *hemisphere, uint32_t maxDegrees, int32_t *value) {
+    uint32_t whole = 0;
+    uint8_t digits = 0;
+    for (; isDigit(*s); s++) {
+        if (++digits > 5) return false;
+        whole = whole * 10 + (*s - '0');
+    }
+    if (digits < 3) return false;
+
+    uint32_t fraction = 0;                  // minutes * 10^7 below the whole minutes
+    uint32_t scale = 1000000UL;
+    if (*s == '.') {
+        for (s++; isDigit(*s); s++) {
+            fraction += (uint32_t)(*s - '0') * scale;
+            scale /= 10;
+        }
+    }
+    if (*s != '\0') return false;
+
+    uint32_t degrees = whole / 100;
+    uint32_t minutes = whole % 100;
+    if (minutes >= 60) return false;
+    uint32_t result = degrees * 10000000UL + (minutes * 10000000UL + fraction + 30) / 60;
+    if (result > maxDegrees * 10000000UL) return false;
+
+    switch (hemisphere[0]) {
+    case 'N':
+    case 'E':
+        *value = (int32_t)result;
+        return true;
+    case 'S':
+    case 'W':
+        *value = -(int32_t)result;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// "hhmmss[.sss]" -> ms of the UTC day
+static bool parseTime(const char *s, uint32_t *time_ms) {
+    for (uint8_t i = 0; i < 6; i++) {
+        if (!isDigit(s[i])) return false;
+    }
+    uint32_t hour = (s[0] - '0') * 10 + (s[1] - '0');
+    uint32_t minute = (s[2] - '0') * 10 + (s[3] - '0');
+    uint32_t second = (s[4] - '0') * 10 + (s[5] - '0');
+    if (hour > 23 || minute > 59 || second > 60) return false;     // 60: leap second
+
+    uint32_t fraction = 0;
+    uint32_t scale = 100;
+    s += 6;
+    if (*s == '.') {
+        for (s++; isDigit(*s); s++) {
+            fraction += (uint32_t)(*s - '0') * scale;
+            scale /= 10;
+        }
+    }
+    if (*s != '\0') return false;
+    *time_ms = ((hour * 60 + minute) * 60 + second) * 1000 + fraction;
+    return true;
+}
+
+// "ddmmyy"
+static bool parseDate(const char *s, uint16_t *year, uint8_t *month, uint8_t *day) {
+    for (uint8_t i = 0; i < 6; i++) {
+        if (!isDigit(s[i])) return false;
+    }
+    if (s[6] != '\0') return false;
+    *day = (uint8_t)((s[0] - '0') * 10 + (s[1] - '0'));
+    *month = (uint8_t)((s[2] - '0') * 10 + (s[3] - '0'));
+    *year = (uint16_t)(2000 + (s[4] - '0') * 10 + (s[5] - '0'));
+    return *day >= 1 && *day <= 31 && *month >= 1 && *month <= 12;
+}
+
+// knots with 3 decimals -> mm/s
+static bool parseKnots(const char *s, int32_t *speed) {
+    int32_t milliKnots;
+    if (!parseFixed(s, 3, &milliKnots) || milliKnots < 0) return false;
+    *speed = (int32_t)(((int64_t)milliKnots * 1852 + 1800) / 3600);
+    return true;
+}
+
+NmeaParser::NmeaParser() {
+    reset();
+    m_stats = NmeaParserStats();
+}
+
+void NmeaParser::reset(void) {
+    m_state = STATE_START;
+    m_length = 0;
+    m_fieldCount = 0;
+    m_checksum = 0;
+    m_received = 0;
+    m_buffer[0] = '\0';
+}
+
+void NmeaParser::drop(void) {
+    m_stats.dropped++;
+    m_state = STATE_START;
+    m_fieldCount = 0;
+}
+
+bool NmeaParser::parse(uint8_t byte) {
+    if (byte == '$') {                      // start of a sentence, also inside a broken one
+        if (m_state != STATE_START) m_stats.dropped++;
+        m_state = STATE_DATA;
+        m_length = 0;
+        m_fieldCount = 1;
+        m_fields[0] = 0;
+        m_checksum = 0;
+        return false;
+    }
+
+    switch (m_state) {
+    case STATE_DATA:
+        if (byte == '*') {
+            m_buffer[m_length] = '\0';
+            m_state = STATE_CK_1;
+            return false;
+        }
+        if (byte < 0x20 || byte > 0x7E || m_length >= DATA_LENGTH - 1) {
+            drop();
+            return false;
+        }
+        m_checksum ^= byte;
+        if (byte == ',') {
+            if (m_fieldCount >= NMEA_MAX_FIELDS) {
+                drop();
+                return false;
+            }
+            m_buffer[m_length++] = '\0';
+            m_fields[m_fieldCount++] = m_length;
+        } else {
+            m_buffer[m_length++] = (char)byte;
+        }
+        return false;
+    case STATE_CK_1:
+        if (hexValue(byte) < 0) {
+            drop();
+            return false;
+        }
+        m_received = (uint8_t)(hexValue(byte) << 4);
+        m_state = STATE_CK_2;
+        return false;
+    case STATE_CK_2:
+        m_state = STATE_START;
+        if (hexValue(byte) < 0) {
+            drop();
+            return false;
+        }
+        if ((m_received | hexValue(byte)) != m_checksum) {
+            m_stats.checksumErrors++;
+            m_fieldCount = 0;
+            return false;
+        }
+        m_stats.sentences++;
+        return true;
+    default:
+        return false;                       // <CR><LF> and noise between sentences
+    }
+}
+
+NmeaSentence NmeaParser::getType(void) const {
+    const char *address = getField(0);
+    if (strlen(address) != 5 || address[0] == 'P') return NMEA_OTHER;     // talker + formatter, 'P': proprietary
+    const char *formatter = address + 2;
+    if (strcmp(formatter, "GGA") == 0) return NMEA_GGA;
+    if (strcmp(formatter, "RMC") == 0) return NMEA_RMC;
+    if (strcmp(formatter, "VTG") == 0) return NMEA_VTG;
+    return NMEA_OTHER;
+}
+
+const char *NmeaParser::getField(uint8_t index) const {
+    return index < m_fieldCount ? m_buffer + m_fields[index] : "";
+}
+
+bool NmeaParser::decodeGga(NmeaGga *gga) const {
+    if (getType() != NMEA_GGA || m_fieldCount < GGA_FIELDS) return false;
+    int32_t value;
+    gga->timeValid = parseTime(getField(1), &gga->time_ms);
+    gga->positionValid = parseCoordinate(getField(2), getField(3), 90, &gga->lat) &&
+                         parseCoordinate(getField(4), getField(5), 180, &gga->lon);
+    gga->quality = (parseFixed(getField(6), 0, &value) && value >= 0 && value <= 9) ? (uint8_t)value : 0;
+    gga->numSV = (parseFixed(getField(7), 0, &value) && value >= 0 && value <= 255) ? (uint8_t)value : 0;
+    gga->hDOPValid = parseFixed(getField(8), 2, &value) && value >= 0 && value <= 65535;
+    gga->hDOP = gga->hDOPValid ? (uint16_t)value : 0;
+    gga->altitudeValid = parseFixed(getField(9), 3, &gga->altitudeMSL);
+    return true;
+}
+
+bool NmeaParser::decodeRmc(NmeaRmc *rmc) const {
+    if (getType() != NMEA_RMC || m_fieldCount < RMC_FIELDS) return false;
+    rmc->timeValid = parseTime(getField(1), &rmc->time_ms);
+    rmc->active = (strcmp(getField(2), "A") == 0);
+    rmc->positionValid = parseCoordinate(getField(3), getField(4), 90, &rmc->lat) &&
+                         parseCoordinate(getField(5), getField(6), 180, &rmc->lon);
+    rmc->speedValid = parseKnots(getField(7), &rmc->speed);
+    rmc->courseValid = parseFixed(getField(8), 5, &rmc->course);
+    rmc->dateValid = parseDate(getField(9), &rmc->year, &rmc->month, &rmc->day);
+    rmc->mode = getField(12)[0];
+    return true;
+}
+
+bool NmeaParser::decodeVtg(NmeaVtg *vtg) const {
+    if (getType() != NMEA_VTG || m_fieldCount < VTG_FIELDS) return false;
+    vtg->courseValid = parseFixed(getField(1), 5, &vtg->course);
+    vtg->speedValid = parseKnots(getField(5), &vtg->speed);
+    vtg->mode = getField(9)[0];
+    return true;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file output_filter.cpp
+ * @brief Implementation of the fixed point servo output interpolation / slew filter
+ */
+
+#include "output_filter.h"
+
+OutputFilter::OutputFilter()
+    : m_frameTime(0), m_lastUpdate(0), m_frameInterval(OUTPUT_FILTER_DEFAULT_FRAME_MS),
+      m_hasFrame(false), m_hasInterval(false) {
+    for (uint8_t channel = 0; channel < OUTPUT_FILTER_CHANNELS; channel++) {
+        m_mode[channel] = OUTPUT_FILTER_NONE;
+        m_slewStep_q16[channel] = 0;
+        m_output_q16[channel] = m_start_q16[channel] = m_target_q16[channel] = 1500 << 16;
+        m_rampStep_q16[channel] = 0;
+    }
+}
+
+bool OutputFilter::setMode(uint8_t channel, OutputFilterMode mode, uint16_t slew_us_per_s) {
+    if (channel >= OUTPUT_FILTER_CHANNELS) return false;
+    m_mode[channel] = mode;
+    m_slewStep_q16[channel] = (int32_t)(((uint32_t)slew_us_per_s << 16) / 1000);   // us/s -> Q16 us/ms
+    if (mode == OUTPUT_FILTER_SLEW && m_slewStep_q16[channel] == 0) m_slewStep_q16[channel] = 1;
+    return true;
+}
+
+void OutputFilter::newFrame(const uint16_t *targets_us, uint8_t num_channels, uint32_t now_ms) {
+    if (num_channels > OUTPUT_FILTER_CHANNELS) num_channels = OUTPUT_FILTER_CHANNELS;
+
+    uint32_t interval = now_ms - m_frameTime;
+    for (uint8_t channel = 0; channel < num_channels; channel++) {
+        // a running ramp continues from where it is now, not from the last update()
+        if (m_mode[channel] == OUTPUT_FILTER_INTERPOLATE) {
+            m_output_q16[channel] = (interval >= m_frameInterval) ? m_target_q16[channel]
+                                  : m_start_q16[channel] + m_rampStep_q16[channel] * (int32_t)interval;
+        }
+    }
+    if (m_hasFrame) {   // track the frame rate - interpolation spans one frame interval
+        if (interval > OUTPUT_FILTER_MAX_FRAME_MS) interval = OUTPUT_FILTER_MAX_FRAME_MS;
+        if (m_hasInterval) m_frameInterval = (3 * m_frameInterval + interval + 2) / 4;
+        else               m_frameInterval = interval;   // first measurement replaces the default
+        m_hasInterval = true;
+        if (m_frameInterval < 1) m_frameInterval = 1;
+    }
+    m_frameTime = now_ms;
+
+    for (uint8_t channel = 0; channel < num_channels; channel++) {
+        int32_t target = (int32_t)targets_us[channel] << 16;
+        if (!m_hasFrame) m_output_q16[channel] = target;   // first frame: no ramp from the dummy center
+        m_target_q16[channel] = target;
+        m_start_q16[channel] = m_output_q16[channel];
+        m_rampStep_q16[channel] = (target - m_output_q16[channel]) / (int32_t)m_frameInterval;
+    }
+    if (!m_hasFrame) m_lastUpdate = now_ms;
+    m_hasFrame = true;
+}
+
+void OutputFilter::update(uint16_t *outputs_us, uint8_t num_channels, uint32_t now_ms) {
+    if (num_channels > OUTPUT_FILTER_CHANNELS) num_channels = OUTPUT_FILTER_CHANNELS;
+
+    uint32_t since_frame = now_ms - m_frameTime;
+    if (since_frame > m_frameInterval) since_frame = m_frameInterval;
+    uint32_t since_update = now_ms - m_lastUpdate;
+    if (since_update > OUTPUT_FILTER_MAX_FRAME_MS) since_update = OUTPUT_FILTER_MAX_FRAME_MS;
+    m_lastUpdate = now_ms;
+
+    for (uint8_t channel = 0; channel < num_channels; channel++) {
+        int32_t target = m_target_q16[channel];
+        int32_t output;
+
+        switch (m_mode[channel]) {
+        case OUTPUT_FILTER_INTERPOLATE:
+            output = (since_frame >= m_frameInterval) ? target
+                   : m_start_q16[channel] + m_rampStep_q16[channel] * (int32_t)since_frame;
+            break;
+        case OUTPUT_FILTER_SLEW: {
+            int32_t max_step = m_slewStep_q16[channel] * (int32_t)since_update;
+            int32_t delta = target - m_output_q16[channel];
+            if (delta > max_step) delta = max_step;
+            if (delta < -max_step) delta = -max_step;
+            output = m_output_q16[channel] + delta;
+            break;
+        }
+        default:
+            output = target;
+            break;
+        }
+        m_output_q16[channel] = output;
+        outputs_us[channel] = (uint16_t)((output + (1 << 15)) >> 16);
+    }
+}
@@ -13,6 +13,8 @@ long map(long x, long in_min, long in_max, long out_min, long out_max) {
 #include "platform_abstraction.h"
 #include "mySerial.h"
 #include "uart_config.h"
+#include "adc_sampler.h"
+#include "i2c_bus.h"
 #include "stm32f103xb.h"
 #include <cstdint>
 #include <cstring>
@@ -28,7 +30,9 @@ extern I2C_HandleTypeDef hi2c1;
 extern volatile uint32_t RX1_overrun, ELRS_TX_count;
 extern volatile uint32_t adcValue, ADC_count;
 extern volatile uint8_t isADCFinished;
+extern AdcSampler adcSampler;
 extern volatile uint8_t i2cWriteComplete;
+extern I2cBus i2cBus;
 extern mySerial serialDebug;
 extern mySerial serialCrsf;
 extern mySerial serialGnss;
@@ -45,16 +49,24 @@ extern "C" int __io_putchar(int ch){
 }
 
 
+extern "C" void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc) {
+    if (hadc->Instance == ADC1) {
+        // first half of the circular DMA buffer is complete - accumulate it while the DMA fills the second half
+        if (adcSampler.onTransfer(false)) {
+            ADC_count++;
+            isADCFinished = 1;
+        }
+    }
+}
+
 extern "C" void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
     if (hadc->Instance == ADC1) {
-        // Handle ADC conversion complete event
-        // For example, read the converted value
-        // adcValue = HAL_ADC_GetValue(&hadc1);
-        // Process adcValue as needed
-        ADC_count++;
-        isADCFinished = +1;
+        // second half complete, the DMA wraps around to the first half
+        if (adcSampler.onTransfer(true)) {
+            ADC_count++;
+            isADCFinished = 1;
+        }
     }
-//    while (1);
 }
 
 extern "C" void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
@@ -104,12 +116,31 @@ extern "C" void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
 #endif
 }
 
+extern "C" void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+#if UART_ROLE_GNSS != UART_ROLE_NONE
+    if (huart == UART_GNSS_HANDLE) {
+        // overrun / framing / noise - counted for the link statistics, RX re-armed after an overrun
+        serialGnss.onError();
+    }
+#endif
+}
+
 // I2C MasterTxCpltCallback
 extern "C" void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c) {
     if (hi2c == &hi2c1) {
         // Handle I2C transmission complete event
         i2cWriteComplete = 1;
     }
+    i2cBus.onTransferDone(hi2c, false);     // next phase / next queued transaction
+}
+
+extern "C" void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    i2cBus.onTransferDone(hi2c, false);
+}
+
+// NACK, bus error, arbitration lost - the HAL has released the bus already
+extern "C" void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    i2cBus.onTransferDone(hi2c, true);
 }
 
 
@@ -157,4 +188,11 @@ size_t STM32Stream::write(const uint8_t *buf, size_t len) {
     return 0;
 }
 
+bool STM32Stream::setBaudRate(uint32_t baudrate) {
+    if (_serial) {
+        return _serial->setBaudRate(baudrate) == 0;
+    }
+    return false;
+}
+
 
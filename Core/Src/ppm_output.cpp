@@ -0,0 +1,83 @@
+/**
+ * @file ppm_output.cpp
+ * @brief PPM frame encoder and timer/DMA based PPM generator
+ */
+
+#include "ppm_output.h"
+
+size_t ppm_encode_frame(uint16_t *slots, const uint16_t *channels_us, uint8_t num_channels) {
+    uint32_t frame_used = 0;
+
+    for (uint8_t channel = 0; channel < num_channels; channel++) {
+        uint16_t us = channels_us[channel];
+        if (us < 800) us = 800;
+        if (us > 2200) us = 2200;
+        slots[channel] = us - 1;            // ARR = slot length - 1
+        frame_used += us;
+    }
+    uint32_t sync_us = (frame_used + PPM_MIN_SYNC_US < PPM_FRAME_US) ? PPM_FRAME_US - frame_used : PPM_MIN_SYNC_US;
+    slots[num_channels] = (uint16_t)(sync_us - 1);
+    return num_channels + 1;
+}
+
+
+// clock and pin of the default PPM timer - not part of the CubeMX generated MSP code
+static void ppm_output_msp_init(TIM_HandleTypeDef *htim) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    if (htim->Instance != PPM_TIM) return;
+    if (PPM_TIM == TIM4) __HAL_RCC_TIM4_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    GPIO_InitStruct.Pin = PPM_GPIO_PIN;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(PPM_GPIO_PORT, &GPIO_InitStruct);
+}
+
+PpmOutput::PpmOutput() : m_htim(nullptr) {
+    uint16_t center[PPM_NUM_CHANNELS];
+    for (uint8_t channel = 0; channel < PPM_NUM_CHANNELS; channel++) center[channel] = 1500;
+    ppm_encode_frame(m_slots, center, PPM_NUM_CHANNELS);
+}
+
+bool PpmOutput::init(TIM_HandleTypeDef *htim, uint32_t tim_channel, DMA_Channel_TypeDef *dma_update, bool invert) {
+    TIM_OC_InitTypeDef sConfigOC = {0};
+
+    if (!htim || !dma_update) return false;
+    ppm_output_msp_init(htim);
+
+    htim->Init.Prescaler = 72-1;                        // 1us ticks like the servo timers
+    htim->Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim->Init.Period = m_slots[PPM_NUM_CHANNELS];      // start with the sync gap
+    htim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    if (HAL_TIM_PWM_Init(htim) != HAL_OK) return false;
+
+    sConfigOC.OCMode = TIM_OCMODE_PWM1;
+    sConfigOC.Pulse = PPM_MARK_US;
+    sConfigOC.OCPolarity = invert ? TIM_OCPOLARITY_LOW : TIM_OCPOLARITY_HIGH;
+    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+    if (HAL_TIM_PWM_ConfigChannel(htim, &sConfigOC, tim_channel) != HAL_OK) return false;
+
+    // update event -> next slot length into ARR (preload), circular over the slot table
+    dma_update->CCR = 0;
+    dma_update->CPAR = (uint32_t)(uintptr_t)&htim->Instance->ARR;
+    dma_update->CMAR = (uint32_t)(uintptr_t)m_slots;
+    dma_update->CNDTR = PPM_NUM_CHANNELS + 1;
+    dma_update->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_DIR | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_PL_0;
+    dma_update->CCR |= DMA_CCR_EN;
+    __HAL_TIM_ENABLE_DMA(htim, TIM_DMA_UPDATE);
+
+    m_htim = htim;
+    return HAL_TIM_PWM_Start(htim, tim_channel) == HAL_OK;
+}
+
+void PpmOutput::setChannels(const uint16_t *channels_us, uint8_t num_channels) {
+    uint16_t values[PPM_NUM_CHANNELS];
+
+    for (uint8_t channel = 0; channel < PPM_NUM_CHANNELS; channel++) {
+        values[channel] = (channel < num_channels) ? channels_us[channel] : 1500;
+    }
+    ppm_encode_frame(m_slots, values, PPM_NUM_CHANNELS);   // single 16 bit writes - DMA may read at any time
+}
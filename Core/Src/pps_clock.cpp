@@ -0,0 +1,198 @@
+/**
+ * @file pps_clock.cpp
+ * @brief Timepulse EXTI capture, pulse labeling and the phase / frequency loop filter
+ */
+
+#include "pps_clock.h"
+#include "timebase.h"
+
+#define NS_PER_S 1000000000LL
+#define WEEK_MS 604800000UL
+#define WEEK_NS (604800LL * NS_PER_S)
+
+static volatile uint32_t g_pulseUs = 0;
+static volatile uint16_t g_pulseNs = 0;
+static volatile uint32_t g_pulseCount = 0;
+static uint32_t g_readCount = 0;
+
+// local time difference a - b in ns, |a - b| < 35 minutes
+static int64_t localDiff_ns(uint32_t a_us, uint16_t a_ns, uint32_t b_us, uint16_t b_ns) {
+    return (int64_t)(int32_t)(a_us - b_us) * 1000 + (int32_t)a_ns - (int32_t)b_ns;
+}
+
+static void localAdvance(uint32_t *us, uint16_t *ns, int64_t offset_ns) {
+    int64_t total = *ns + offset_ns;
+    int64_t whole = total / 1000;
+    int32_t remainder = (int32_t)(total - whole * 1000);
+    if (remainder < 0) {
+        remainder += 1000;
+        whole--;
+    }
+    *us += (uint32_t)whole;
+    *ns = (uint16_t)remainder;
+}
+
+static int64_t absolute(int64_t value) {
+    return value < 0 ? -value : value;
+}
+
+void pps_capture_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_AFIO_CLK_ENABLE();
+    GPIO_InitStruct.Pin = PPS_GPIO_PIN;
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+    GPIO_InitStruct.Pull = GPIO_PULLDOWN;   // no module connected: no pulses
+    HAL_GPIO_Init(PPS_GPIO_PORT, &GPIO_InitStruct);
+
+    HAL_NVIC_SetPriority(PPS_EXTI_IRQn, PPS_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(PPS_EXTI_IRQn);
+}
+
+bool pps_capture_read(uint32_t *timestamp_us, uint16_t *fraction_ns) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t count = g_pulseCount;
+    *timestamp_us = g_pulseUs;
+    *fraction_ns = g_pulseNs;
+    __set_PRIMASK(primask);
+    if (count == g_readCount) return false;
+    g_readCount = count;
+    return true;
+}
+
+extern "C" void EXTI9_5_IRQHandler(void) {
+    uint32_t cycles = DWT->CYCCNT - PPS_CAPTURE_LATENCY_CYCLES;    // first: fixed latency to the edge
+    if (__HAL_GPIO_EXTI_GET_IT(PPS_GPIO_PIN) == 0) return;
+    __HAL_GPIO_EXTI_CLEAR_IT(PPS_GPIO_PIN);
+    uint16_t fraction_ns;
+    g_pulseUs = timebase_at_cycles(cycles, &fraction_ns);
+    g_pulseNs = fraction_ns;
+    g_pulseCount++;
+}
+
+PpsClock::PpsClock() {
+    reset();
+    m_stats = PpsClockStats();
+}
+
+void PpsClock::reset(void) {
+    m_pulseUs = 0;
+    m_pulseNs = 0;
+    m_pulsePending = false;
+    m_anchorUs = 0;
+    m_anchorNs = 0;
+    m_anchorTow_ms = 0;
+    m_anchorValid = false;
+    m_frequencyValid = false;
+    m_frequencyPreset = false;
+    m_frequency_ppb = 0;
+    m_rejects = 0;
+    m_lockCount = 0;
+}
+
+void PpsClock::presetFrequency(int32_t frequency_ppb) {
+    m_frequency_ppb = frequency_ppb;
+    m_frequencyPreset = true;
+}
+
+void PpsClock::addPulse(uint32_t timestamp_us, uint16_t fraction_ns) {
+    if (m_pulsePending) m_stats.unlabeled++;
+    m_pulseUs = timestamp_us;
+    m_pulseNs = fraction_ns;
+    m_pulsePending = true;
+    m_stats.pulses++;
+}
+
+void PpsClock::addEpoch(uint32_t iTOW, uint32_t timestamp_us) {
+    if (m_anchorValid && timestamp_us - m_anchorUs > PPS_MAX_GAP_S * 1000000UL) m_lockCount = 0;   // holdover
+    if (!m_pulsePending) return;
+
+    // reception delay of this epoch if it belongs to the second that starts with the pulse
+    int32_t latency_ms = (int32_t)(timestamp_us - m_pulseUs) / 1000 - (int32_t)(iTOW % 1000);
+    if (latency_ms < 0) return;             // epoch of the previous second, wait for the next one
+    m_pulsePending = false;
+    if (latency_ms >= PPS_MAX_EPOCH_LATENCY_MS) {
+        m_stats.unlabeled++;
+        return;
+    }
+    discipline(iTOW - iTOW % 1000);
+}
+
+void PpsClock::restart(uint32_t tow_ms) {
+    m_anchorUs = m_pulseUs;
+    m_anchorNs = m_pulseNs;
+    m_anchorTow_ms = tow_ms;
+    m_anchorValid = true;
+    m_frequencyValid = m_frequencyPreset;   // preset: used for the first acquisition only
+    m_frequencyPreset = false;
+    m_rejects = 0;
+    m_lockCount = 0;
+    m_stats.restarts++;
+}
+
+void PpsClock::discipline(uint32_t tow_ms) {
+    if (!m_anchorValid) {
+        restart(tow_ms);
+        return;
+    }
+    uint32_t elapsed_ms = (tow_ms + WEEK_MS - m_anchorTow_ms) % WEEK_MS;
+    if (elapsed_ms == 0 || elapsed_ms > PPS_MAX_GAP_S * 1000UL) {
+        restart(tow_ms);
+        return;
+    }
+    int32_t seconds = (int32_t)(elapsed_ms / 1000);
+    int64_t measured = localDiff_ns(m_pulseUs, m_pulseNs, m_anchorUs, m_anchorNs);
+
+    if (!m_frequencyValid) {                // second pulse: frequency straight from the interval
+        int64_t error_ppb = (measured - seconds * NS_PER_S) / seconds;
+        if (absolute(error_ppb) > PPS_MAX_FREQ_ERROR_PPB) {
+            restart(tow_ms);
+            return;
+        }
+        m_frequency_ppb = (int32_t)error_ppb;
+        m_frequencyValid = true;
+        m_anchorUs = m_pulseUs;
+        m_anchorNs = m_pulseNs;
+        m_anchorTow_ms = tow_ms;
+        m_stats.used++;
+        return;
+    }
+
+    int64_t predicted = seconds * (NS_PER_S + m_frequency_ppb);
+    int64_t residual = measured - predicted;
+    m_stats.lastResidual_ns = (int32_t)(residual > INT32_MAX ? INT32_MAX : residual < -INT32_MAX ? -INT32_MAX : residual);
+    if (absolute(residual) > PPS_MAX_RESIDUAL_NS) {
+        m_stats.rejected++;
+        m_lockCount = 0;
+        if (++m_rejects >= PPS_MAX_REJECTS) restart(tow_ms);
+        return;
+    }
+    m_rejects = 0;
+
+    localAdvance(&m_anchorUs, &m_anchorNs, predicted + (residual >> PPS_PHASE_SHIFT));
+    m_anchorTow_ms = tow_ms;
+    m_frequency_ppb += (int32_t)((residual >> PPS_FREQ_SHIFT) / seconds);
+    if (absolute(residual) <= PPS_LOCK_NS) {
+        if (m_lockCount < PPS_LOCK_PULSES) m_lockCount++;
+    } else {
+        m_lockCount = 0;
+    }
+    m_stats.used++;
+}
+
+bool PpsClock::toGnssTime(uint32_t timestamp_us, uint64_t *tow_ns) const {
+    if (!m_anchorValid) return false;
+    int64_t local = localDiff_ns(timestamp_us, 0, m_anchorUs, m_anchorNs);
+    int64_t gnss = local - local * m_frequency_ppb / (NS_PER_S + m_frequency_ppb);
+    int64_t tow = (int64_t)m_anchorTow_ms * 1000000 + gnss;
+    if (tow < 0) tow += WEEK_NS;
+    else if (tow >= WEEK_NS) tow -= WEEK_NS;
+    *tow_ns = (uint64_t)tow;
+    return true;
+}
+
+uint32_t PpsClock::toGnssInterval(uint32_t interval_us) const {
+    return interval_us - (uint32_t)((int64_t)interval_us * m_frequency_ppb / (NS_PER_S + m_frequency_ppb));
+}
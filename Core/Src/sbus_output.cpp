@@ -0,0 +1,86 @@
+/**
+ * @file sbus_output.cpp
+ * @brief SBUS frame encoder and DMA driven transmitter
+ */
+
+#include "sbus_output.h"
+#include <string.h>
+
+uint16_t sbus_us_to_value(uint16_t us) {
+    // inverse of us = 880 + value * 5/8 (FrSky / Futaba scaling), rounded down like the
+    // flight controller side: 988 / 1500 / 2012us give exactly 172 / 992 / 1811
+    if (us <= 880) return 0;
+    uint32_t value = (uint32_t)(us - 880) * 8 / 5;
+    return (value > 2047) ? 2047 : (uint16_t)value;
+}
+
+size_t sbus_encode_frame(uint8_t *frame, const uint16_t *channels_us, uint8_t flags) {
+    memset(frame, 0, SBUS_FRAME_SIZE);
+    frame[0] = SBUS_HEADER;
+
+    // 16 x 11 bit, LSB first, packed into frame[1..22]
+    uint32_t bits = 0;
+    uint8_t bit_count = 0, index = 1;
+    for (uint8_t channel = 0; channel < SBUS_NUM_CHANNELS; channel++) {
+        bits |= (uint32_t)sbus_us_to_value(channels_us[channel]) << bit_count;
+        bit_count += 11;
+        while (bit_count >= 8) {
+            frame[index++] = (uint8_t)bits;
+            bits >>= 8;
+            bit_count -= 8;
+        }
+    }
+    frame[23] = flags & (SBUS_FLAG_CH17 | SBUS_FLAG_CH18 | SBUS_FLAG_FRAME_LOST | SBUS_FLAG_FAILSAFE);
+    frame[24] = SBUS_FOOTER;
+    return SBUS_FRAME_SIZE;
+}
+
+
+SbusOutput::SbusOutput() : m_huart(nullptr), m_dma(nullptr), m_frameCount(0) {
+    memset(m_frame, 0, sizeof(m_frame));
+}
+
+bool SbusOutput::init(UART_HandleTypeDef *huart, DMA_Channel_TypeDef *dma_tx) {
+    if (!huart || !dma_tx) return false;
+
+    // 8 data bits + even parity = 9 bit word on the F1 USART, 2 stop bits
+    HAL_UART_DeInit(huart);
+    huart->Init.BaudRate = SBUS_BAUDRATE;
+    huart->Init.WordLength = UART_WORDLENGTH_9B;
+    huart->Init.StopBits = UART_STOPBITS_2;
+    huart->Init.Parity = UART_PARITY_EVEN;
+    huart->Init.Mode = UART_MODE_TX;
+    huart->Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart->Init.OverSampling = UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(huart) != HAL_OK) return false;
+
+    // memory -> USART DR, byte wide, no interrupts: the frame cadence is set by send()
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    dma_tx->CCR = 0;
+    dma_tx->CPAR = (uint32_t)(uintptr_t)&huart->Instance->DR;
+    dma_tx->CCR = DMA_CCR_MINC | DMA_CCR_DIR;
+    SET_BIT(huart->Instance->CR3, USART_CR3_DMAT);
+
+    m_huart = huart;
+    m_dma = dma_tx;
+    return true;
+}
+
+bool SbusOutput::isBusy(void) const {
+    if (!m_dma) return false;
+    if ((m_dma->CCR & DMA_CCR_EN) && m_dma->CNDTR != 0) return true;    // bytes left for the DMA
+    return !(m_huart->Instance->SR & USART_SR_TC);                       // last byte still shifting out
+}
+
+bool SbusOutput::send(const uint16_t *channels_us, uint8_t flags) {
+    if (!m_dma || isBusy()) return false;
+
+    sbus_encode_frame(m_frame, channels_us, flags);   // DMA is idle - the buffer is free
+
+    m_dma->CCR &= ~DMA_CCR_EN;          // CMAR/CNDTR are only writable with the channel disabled
+    m_dma->CMAR = (uint32_t)(uintptr_t)m_frame;
+    m_dma->CNDTR = SBUS_FRAME_SIZE;
+    m_dma->CCR |= DMA_CCR_EN;           // TXE request starts the transfer right away
+    m_frameCount++;
+    return true;
+}
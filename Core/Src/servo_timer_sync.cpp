@@ -0,0 +1,44 @@
+/**
+ * @file servo_timer_sync.cpp
+ * @brief Master/slave synchronisation of the servo PWM timers with phase offsets
+ */
+
+#include "servo_timer_sync.h"
+#include "user_main.h"
+
+static_assert(BoardServoOutputs::uses<1>::value || (!BoardServoOutputs::uses<2>::value && !BoardServoOutputs::uses<3>::value),
+              "servo_timer_sync: TIM2/TIM3 are triggered by TIM1 - the board needs at least one output on TIM1");
+
+static HAL_StatusTypeDef servo_timer_slave_init(TIM_HandleTypeDef *htim, uint16_t phase_us) {
+  TIM_SlaveConfigTypeDef sSlaveConfig = {0};
+
+  sSlaveConfig.SlaveMode = TIM_SLAVEMODE_TRIGGER;   // counter is enabled by the TIM1 TRGO
+  sSlaveConfig.InputTrigger = TIM_TS_ITR0;          // ITR0 = TIM1 for TIM2 and TIM3 (F103)
+  if (HAL_TIM_SlaveConfigSynchro(htim, &sSlaveConfig) != HAL_OK) return HAL_ERROR;
+  // the slave wraps (and starts its pulses) phase_us after the master
+  __HAL_TIM_SET_COUNTER(htim, (SERVO_TIMER_PERIOD_US - (phase_us % SERVO_TIMER_PERIOD_US)) % SERVO_TIMER_PERIOD_US);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef servo_timers_sync_init(uint16_t tim2_phase_us, uint16_t tim3_phase_us) {
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_ENABLE;         // TRGO on TIM1 counter enable
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_ENABLE;  // delay TIM1 start to match the slaves exactly
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim1, &sMasterConfig) != HAL_OK) return HAL_ERROR;
+  __HAL_TIM_SET_COUNTER(&htim1, 0);
+
+  if (servo_timer_slave_init(&htim2, tim2_phase_us) != HAL_OK) return HAL_ERROR;
+  if (servo_timer_slave_init(&htim3, tim3_phase_us) != HAL_OK) return HAL_ERROR;
+  return HAL_OK;
+}
+
+void servo_timers_run(void) {
+  // counters only: CCxE and the TIM1 MOE are still off, so no pulses are generated
+  __HAL_TIM_ENABLE(&htim1);
+}
+
+void servo_timers_start(void) {
+  // slave channels are armed first, enabling TIM1 releases all slave counters at once
+  BoardServoOutputs::start();
+}
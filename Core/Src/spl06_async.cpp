@@ -0,0 +1,227 @@
+/**
+ * @file spl06_async.cpp
+ * @brief SPL06-001 bring-up state machine, burst reads and integer compensation
+ */
+
+#include "spl06_async.h"
+#include <string.h>
+
+#define REG_PSR_B2 0x00
+#define REG_PRS_CFG 0x06
+#define REG_TMP_CFG 0x07
+#define REG_MEAS_CFG 0x08
+#define REG_CFG_REG 0x09
+#define REG_PRODUCT_ID 0x0D
+#define REG_COEF 0x10
+#define REG_COEF_SRCE 0x28
+
+#define MEAS_CFG_READY 0xC0                 // COEF_RDY | SENSOR_RDY
+#define MEAS_CFG_BACKGROUND_BOTH 0x07       // continuous pressure and temperature
+#define CFG_REG_T_SHIFT 0x08                // required for oversampling > 8x
+#define CFG_REG_P_SHIFT 0x04
+#define READY_POLL_US 10000
+
+// compensation scale factors kP / kT per oversampling code (datasheet table 4)
+static const int32_t scale_factor[8] = {524288, 1572864, 3670016, 7864320, 253952, 516096, 1040384, 2088960};
+
+static_assert(SPL06_PRESSURE_OVERSAMPLING < 8 && SPL06_TEMPERATURE_OVERSAMPLING < 8 && SPL06_MEASUREMENT_RATE < 8,
+              "SPL06: register codes are 3 bit");
+
+static int32_t signExtend(uint32_t value, uint8_t bits) {
+    return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+// a * b >> 20 for a Q20 accumulator beyond 32 bit, exact without a 128 bit product
+static int64_t mulQ20(int64_t a, int32_t b) {
+    return (a >> 20) * b + (((a & 0xFFFFF) * b) >> 20);
+}
+
+Spl06Async::Spl06Async(I2cBus *bus, uint8_t address)
+    : m_bus(bus), m_address(address), m_state(STATE_IDLE), m_configStep(0), m_coefSource(0), m_waitUntil_us(0),
+      m_readErrors(0), m_errors(0), m_periodicAdded(false), m_burstReg(REG_PSR_B2), m_rawTimestamp_us(0), m_rawReady(false),
+      m_c0(0), m_c1(0), m_c00(0), m_c10(0), m_c01(0), m_c11(0), m_c20(0), m_c21(0), m_c30(0) {
+    m_setup = I2cTransaction();
+    m_setup.address = address;
+    m_setup.txData = m_setupTx;
+    m_setup.rxData = m_setupRx;
+
+    m_burst = I2cTransaction();
+    m_burst.address = address;
+    m_burst.txData = &m_burstReg;
+    m_burst.txLength = 1;
+    m_burst.rxData = m_burstRx;
+    m_burst.rxLength = sizeof(m_burstRx);
+    m_burst.callback = onBurstRead;
+    m_burst.context = this;
+
+    m_sample = Spl06Sample();
+}
+
+void Spl06Async::begin(void) {
+    m_state = STATE_PROBE;
+    m_waitUntil_us = 0;
+    m_setup.status = I2C_STATUS_IDLE;
+}
+
+void Spl06Async::update(uint32_t now_us) {
+    if (m_state == STATE_IDLE) return;
+
+    if (m_state == STATE_RUNNING) {
+        if (m_readErrors >= SPL06_MAX_READ_ERRORS) {    // sensor lost (power glitch, reset) - new bring-up
+            fail(now_us);
+            return;
+        }
+        if (!m_rawReady) return;
+        uint8_t raw[6];
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        memcpy(raw, m_raw, sizeof(raw));
+        uint32_t timestamp_us = m_rawTimestamp_us;
+        m_rawReady = false;
+        __set_PRIMASK(primask);
+        compensate(raw, timestamp_us);
+        return;
+    }
+
+    if (m_state == STATE_FAILED) {
+        if ((int32_t)(now_us - m_waitUntil_us) < 0) return;
+        m_state = STATE_PROBE;
+        m_setup.status = I2C_STATUS_IDLE;
+    }
+
+    switch (m_setup.status) {
+    case I2C_STATUS_QUEUED:
+    case I2C_STATUS_BUSY:
+        return;
+    case I2C_STATUS_DONE:
+        m_setup.status = I2C_STATUS_IDLE;
+        transactionDone(now_us);
+        return;
+    case I2C_STATUS_IDLE:
+        break;
+    default:                                // NACK, bus error, timeout
+        fail(now_us);
+        return;
+    }
+    if ((int32_t)(now_us - m_waitUntil_us) < 0) return;
+
+    switch (m_state) {
+    case STATE_PROBE:            startRead(REG_PRODUCT_ID, 1); break;
+    case STATE_WAIT_READY:       startRead(REG_MEAS_CFG, 1); break;
+    case STATE_READ_COEF:        startRead(REG_COEF, 18); break;
+    case STATE_READ_COEF_SOURCE: startRead(REG_COEF_SRCE, 1); break;
+    case STATE_CONFIGURE:
+        if (m_configStep == 0) startWrite(REG_PRS_CFG, (SPL06_MEASUREMENT_RATE << 4) | SPL06_PRESSURE_OVERSAMPLING);
+        if (m_configStep == 1) startWrite(REG_TMP_CFG, m_coefSource | (SPL06_MEASUREMENT_RATE << 4) | SPL06_TEMPERATURE_OVERSAMPLING);
+        if (m_configStep == 2) startWrite(REG_CFG_REG, (SPL06_PRESSURE_OVERSAMPLING > 3 ? CFG_REG_P_SHIFT : 0) |
+                                                      (SPL06_TEMPERATURE_OVERSAMPLING > 3 ? CFG_REG_T_SHIFT : 0));
+        if (m_configStep == 3) startWrite(REG_MEAS_CFG, MEAS_CFG_BACKGROUND_BOTH);
+        break;
+    default:
+        break;
+    }
+}
+
+void Spl06Async::startRead(uint8_t reg, uint8_t length) {
+    m_setupTx[0] = reg;
+    m_setup.txLength = 1;
+    m_setup.rxLength = length;
+    m_bus->submit(&m_setup);                // queue full: status stays idle, retried by the next update()
+}
+
+void Spl06Async::startWrite(uint8_t reg, uint8_t value) {
+    m_setupTx[0] = reg;
+    m_setupTx[1] = value;
+    m_setup.txLength = 2;
+    m_setup.rxLength = 0;
+    m_bus->submit(&m_setup);
+}
+
+void Spl06Async::transactionDone(uint32_t now_us) {
+    m_waitUntil_us = now_us;
+    switch (m_state) {
+    case STATE_PROBE:
+        if (m_setupRx[0] != SPL06_PRODUCT_ID) { fail(now_us); return; }
+        m_state = STATE_WAIT_READY;
+        break;
+    case STATE_WAIT_READY:
+        if ((m_setupRx[0] & MEAS_CFG_READY) == MEAS_CFG_READY) m_state = STATE_READ_COEF;
+        else m_waitUntil_us = now_us + READY_POLL_US;   // coefficients are loaded ~40ms after power up
+        break;
+    case STATE_READ_COEF:
+        parseCoefficients();
+        m_state = STATE_READ_COEF_SOURCE;
+        break;
+    case STATE_READ_COEF_SOURCE:
+        m_coefSource = m_setupRx[0] & 0x80;     // TMP_EXT must match the sensor used for the coefficients
+        m_configStep = 0;
+        m_state = STATE_CONFIGURE;
+        break;
+    case STATE_CONFIGURE:
+        if (++m_configStep < 4) break;
+        m_readErrors = 0;
+        m_rawReady = false;
+        m_state = STATE_RUNNING;
+        if (m_periodicAdded) m_bus->setPeriodicEnabled(&m_burst, true);
+        else m_periodicAdded = m_bus->addPeriodic(&m_burst, SPL06_READ_PERIOD_US);
+        break;
+    default:
+        break;
+    }
+}
+
+void Spl06Async::fail(uint32_t now_us) {
+    if (m_periodicAdded) m_bus->setPeriodicEnabled(&m_burst, false);    // no burst reads until the next bring-up
+    m_errors++;
+    m_setup.status = I2C_STATUS_IDLE;
+    m_state = STATE_FAILED;
+    m_waitUntil_us = now_us + SPL06_RETRY_US;
+}
+
+void Spl06Async::parseCoefficients(void) {
+    const uint8_t *c = m_setupRx;
+    m_c0 = signExtend(((uint32_t)c[0] << 4) | (c[1] >> 4), 12);
+    m_c1 = signExtend(((uint32_t)(c[1] & 0x0F) << 8) | c[2], 12);
+    m_c00 = signExtend(((uint32_t)c[3] << 12) | ((uint32_t)c[4] << 4) | (c[5] >> 4), 20);
+    m_c10 = signExtend(((uint32_t)(c[5] & 0x0F) << 16) | ((uint32_t)c[6] << 8) | c[7], 20);
+    m_c01 = signExtend(((uint32_t)c[8] << 8) | c[9], 16);
+    m_c11 = signExtend(((uint32_t)c[10] << 8) | c[11], 16);
+    m_c20 = signExtend(((uint32_t)c[12] << 8) | c[13], 16);
+    m_c21 = signExtend(((uint32_t)c[14] << 8) | c[15], 16);
+    m_c30 = signExtend(((uint32_t)c[16] << 8) | c[17], 16);
+}
+
+void Spl06Async::compensate(const uint8_t *raw, uint32_t timestamp_us) {
+    int32_t p_raw = signExtend(((uint32_t)raw[0] << 16) | ((uint32_t)raw[1] << 8) | raw[2], 24);
+    int32_t t_raw = signExtend(((uint32_t)raw[3] << 16) | ((uint32_t)raw[4] << 8) | raw[5], 24);
+
+    // scaled raw values in Q20 (|value| < 2^25)
+    int32_t p = (int32_t)(((int64_t)p_raw << 20) / scale_factor[SPL06_PRESSURE_OVERSAMPLING]);
+    int32_t t = (int32_t)(((int64_t)t_raw << 20) / scale_factor[SPL06_TEMPERATURE_OVERSAMPLING]);
+
+    int64_t acc = ((int64_t)m_c20 << 20) + (int64_t)m_c30 * p;
+    acc = ((int64_t)m_c10 << 20) + mulQ20(acc, p);
+    int64_t pressure_q20 = ((int64_t)m_c00 << 20) + mulQ20(acc, p);
+    acc = ((int64_t)m_c11 << 20) + (int64_t)m_c21 * p;
+    acc = ((int64_t)m_c01 << 20) + mulQ20(acc, p);
+    pressure_q20 += mulQ20(acc, t);
+
+    m_sample.pressure_q8 = (int32_t)(pressure_q20 >> 12);
+    m_sample.temperature_cC = (int16_t)(m_c0 * 50 + (((int64_t)m_c1 * t * 100) >> 20));
+    m_sample.timestamp_us = timestamp_us;
+    m_sample.sequence++;
+    if (m_sample.sequence == 0) m_sample.sequence = 1;
+}
+
+void Spl06Async::onBurstRead(I2cTransaction *transaction) {
+    // I2C interrupt context - keep a copy, the conversion runs in update()
+    Spl06Async *sensor = (Spl06Async *)transaction->context;
+    if (transaction->status != I2C_STATUS_DONE) {
+        sensor->m_readErrors++;
+        return;
+    }
+    memcpy(sensor->m_raw, sensor->m_burstRx, sizeof(sensor->m_raw));
+    sensor->m_rawTimestamp_us = transaction->start_us;
+    sensor->m_rawReady = true;
+    sensor->m_readErrors = 0;
+}
@@ -11,7 +11,6 @@
 // ============================================================================
 
 STM32Serial *pSerial = nullptr;
-TwoWire Wire;
 SPIClass SPI;
 
 // Global serial instance for UART2 debug - initialized by Serial_InitUART2()
@@ -45,14 +44,17 @@ uint32_t millis(void) {
 uint32_t micros(void) {
     timing_init();
     
-    uint32_t ticks = HAL_GetTick();
-    uint32_t counter = SysTick->VAL;
+    uint32_t ticks, counter;
+    do {    // the tick interrupt may hit between the two reads - retry until both belong to one tick
+        ticks = HAL_GetTick();
+        counter = SysTick->VAL;
+    } while (ticks != HAL_GetTick());
     
-    // SysTick counts DOWN, so we need to invert
+    // SysTick counts DOWN from LOAD to 0, LOAD + 1 counts per tick
     uint32_t load = SysTick->LOAD;
-    uint32_t elapsed_in_tick = (load - counter) * g_microsPerTick / load;
+    uint32_t elapsed_in_tick = (load - counter) * g_microsPerTick / (load + 1);
     
-    return (ticks * 1000000) + elapsed_in_tick;
+    return (ticks * g_microsPerTick) + elapsed_in_tick;
 }
 
 void delay(uint32_t ms) {
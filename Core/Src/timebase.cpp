@@ -0,0 +1,51 @@
+/**
+ * @file timebase.cpp
+ * @brief DWT cycle counter based monotonic microsecond clock
+ */
+
+#include "timebase.h"
+
+static uint32_t g_cyclesPerMicro = 72;
+static uint32_t g_lastCycles = 0;
+static uint32_t g_cycleRemainder = 0;
+static uint32_t g_micros = 0;
+
+void timebase_init(void) {
+  g_cyclesPerMicro = SystemCoreClock / 1000000U;
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  g_lastCycles = 0;
+  g_cycleRemainder = 0;
+  g_micros = 0;
+}
+
+uint32_t timebase_micros(void) {
+  uint32_t primask = __get_PRIMASK();   // also called from interrupts - update the state atomically
+  __disable_irq();
+  uint32_t cycles = DWT->CYCCNT;
+  uint32_t elapsed = (cycles - g_lastCycles) + g_cycleRemainder;   // wrap safe for < 2^32 cycles
+  g_lastCycles = cycles;
+  uint32_t us = elapsed / g_cyclesPerMicro;
+  g_cycleRemainder = elapsed - us * g_cyclesPerMicro;
+  g_micros += us;
+  uint32_t now = g_micros;
+  __set_PRIMASK(primask);
+  return now;
+}
+
+uint32_t timebase_at_cycles(uint32_t cycles, uint16_t *fraction_ns) {
+  uint32_t primask = __get_PRIMASK();   // read only, but g_micros / g_lastCycles must match
+  __disable_irq();
+  int32_t elapsed = (int32_t)(cycles - g_lastCycles) + (int32_t)g_cycleRemainder;   // < 0: event before the last update
+  int32_t us = elapsed / (int32_t)g_cyclesPerMicro;
+  int32_t remainder = elapsed - us * (int32_t)g_cyclesPerMicro;
+  if (remainder < 0) {
+    us--;
+    remainder += g_cyclesPerMicro;
+  }
+  uint32_t micros = g_micros + (uint32_t)us;
+  __set_PRIMASK(primask);
+  if (fraction_ns) *fraction_ns = (uint16_t)((uint32_t)remainder * 1000U / g_cyclesPerMicro);
+  return micros;
+}
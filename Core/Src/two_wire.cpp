@@ -0,0 +1,147 @@
+/**
+ * @file two_wire.cpp
+ * @brief Arduino TwoWire as a blocking facade over the I2cBus
+ */
+
+#include "stm32_arduino_compatibility.h"
+#include "timebase.h"
+
+extern I2cBus i2cBus;
+
+TwoWire Wire;
+
+TwoWire::TwoWire() : TwoWire(&i2cBus) {
+}
+
+TwoWire::TwoWire(int sda, int scl) : TwoWire(&i2cBus) {
+    (void)sda;
+    (void)scl;
+}
+
+TwoWire::TwoWire(I2cBus *bus)
+    : m_bus(bus), m_timeout_us(WIRE_DEFAULT_TIMEOUT_US), m_timeoutFlag(false), m_txAddress(0), m_txLength(0),
+      m_transmitting(false), m_overflow(false), m_writePending(false), m_rxLength(0), m_rxIndex(0) {
+    memset(&m_transaction, 0, sizeof(m_transaction));
+}
+
+void TwoWire::setClock(uint32_t freq) {
+    // the bus re-initialises only while idle - let queued sensor reads finish first
+    uint32_t start_us = timebase_micros();
+    while (!m_bus->setClock(freq)) {
+        uint32_t now_us = timebase_micros();
+        if (now_us - start_us >= m_timeout_us) {
+            m_timeoutFlag = true;
+            return;
+        }
+        m_bus->schedule(now_us);
+    }
+}
+
+void TwoWire::setWireTimeout(uint32_t timeout_us, bool reset_with_timeout) {
+    (void)reset_with_timeout;               // the I2cBus always recovers the bus after a timeout
+    m_timeout_us = timeout_us;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    flushPendingWrite();                    // endTransmission(false) without requestFrom()
+    m_txAddress = address;
+    m_txLength = 0;
+    m_transmitting = true;
+    m_overflow = false;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (!m_transmitting) return 0;
+    if (m_txLength >= WIRE_BUFFER_SIZE) {
+        m_overflow = true;
+        return 0;
+    }
+    m_txBuffer[m_txLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity) {
+    size_t count = 0;
+    while (count < quantity && write(data[count])) count++;
+    return count;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+    if (!m_transmitting) return 4;
+    m_transmitting = false;
+    if (m_overflow) return 1;
+    if (!sendStop && m_txLength > 0) {
+        m_writePending = true;              // repeated START with the following requestFrom()
+        return 0;
+    }
+    return transfer(m_txLength, 0);
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
+    (void)sendStop;                         // every transaction of the bus ends with a STOP
+    uint8_t txLength = 0;
+
+    if (m_writePending && m_txAddress == address) {
+        txLength = m_txLength;
+        m_writePending = false;
+    } else {
+        flushPendingWrite();
+    }
+    m_rxLength = 0;
+    m_rxIndex = 0;
+    if (quantity > WIRE_BUFFER_SIZE) quantity = WIRE_BUFFER_SIZE;
+    if (quantity == 0) return 0;
+    m_txAddress = address;
+    if (transfer(txLength, quantity) != 0) return 0;
+    m_rxLength = quantity;
+    return quantity;
+}
+
+int TwoWire::available(void) {
+    return m_rxLength - m_rxIndex;
+}
+
+int TwoWire::read(void) {
+    if (m_rxIndex >= m_rxLength) return -1;
+    return m_rxBuffer[m_rxIndex++];
+}
+
+int TwoWire::peek(void) {
+    if (m_rxIndex >= m_rxLength) return -1;
+    return m_rxBuffer[m_rxIndex];
+}
+
+uint8_t TwoWire::flushPendingWrite(void) {
+    if (!m_writePending) return 0;
+    m_writePending = false;
+    return transfer(m_txLength, 0);
+}
+
+uint8_t TwoWire::transfer(uint8_t txLength, uint8_t rxLength) {
+    m_transaction.address = m_txAddress;
+    m_transaction.txData = m_txBuffer;
+    m_transaction.txLength = txLength;
+    m_transaction.rxData = m_rxBuffer;
+    m_transaction.rxLength = rxLength;
+    m_transaction.callback = nullptr;
+    if (!m_bus->submit(&m_transaction)) return 4;          // queue full
+
+    uint32_t start_us = m_transaction.submit_us;
+    while (m_transaction.status == I2C_STATUS_QUEUED || m_transaction.status == I2C_STATUS_BUSY) {
+        uint32_t now_us = timebase_micros();
+        if (now_us - start_us >= m_timeout_us) {
+            m_bus->cancel(&m_transaction);
+            break;
+        }
+        m_bus->schedule(now_us);
+    }
+
+    switch (m_transaction.status) {
+    case I2C_STATUS_DONE: return 0;
+    case I2C_STATUS_NACK: return 2;
+    case I2C_STATUS_TIMEOUT:
+        m_timeoutFlag = true;
+        return 5;
+    default: return 4;
+    }
+}
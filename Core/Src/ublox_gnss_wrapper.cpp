@@ -1,116 +1,582 @@
 /**
  * @file ublox_gnss_wrapper.cpp
- * @brief Implementation of non-blocking wrapper for SFE_UBLOX_GNSS
+ * @brief Implementation of the non-blocking u-blox GNSS driver, its bring-up and the NMEA fallback
  */
 
 #include "ublox_gnss_wrapper.h"
 #include "stm32_arduino_compatibility.h"
+#include "timebase.h"
+
+#define UBX_CLASS_CFG 0x06
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+#define UBX_ACK_NAK 0x00
+#define UBX_ACK_ACK 0x01
+#define UBX_CLASS_MGA 0x13
+#define UBX_MGA_INI 0x40
+#define MGA_INI_POS_LLH 0x01
+#define MGA_INI_TIME_UTC 0x10
+#define MGA_INI_LEAP_UNKNOWN 0x80
+
+#define CFG_PRT_UART1 1
+#define CFG_PRT_MODE_8N1 0x000008D0UL
+#define CFG_PRT_PROTO_UBX 0x01
+#define CFG_PRT_PROTO_NMEA 0x02
+
+#define NAV_PVT_FLAGS_FIX_OK 0x01
+#define NAV_PVT_VALID_DATE_TIME 0x03
+#define SNAPSHOT_READ_ATTEMPTS 4
+
+#define NMEA_HDOP_UNKNOWN 9999             // 99.99, the usual "no value" of receivers
+#define DAY_MS 86400000UL
+#define WEEK_MS (7 * DAY_MS)
+
+#define NAV_PVT_FRAME_BITS ((UBX_MAX_PAYLOAD + UBX_FRAME_OVERHEAD) * 10)   // 8N1: start + 8 data + stop
+
+// probe order after the first attempt at GNSS_OPERATING_BAUD; 9600 is the factory default,
+// 4800 the NMEA 0183 standard rate of older generic modules
+static const uint32_t probeBaudRates[] = {9600, 4800, 38400, 115200, 230400, 460800};
+static const uint8_t numProbeBaudRates = sizeof(probeBaudRates) / sizeof(probeBaudRates[0]);
+
+// CFG-RATE periods tried after a NAK, each longer than the last: 20Hz, 10Hz (M8 with GPS +
+// GLONASS), then the default rate
+static const uint16_t fallbackPeriods_ms[] = {50, 100, GNSS_MEASUREMENT_PERIOD_MS};
+static const uint8_t numFallbackPeriods = sizeof(fallbackPeriods_ms) / sizeof(fallbackPeriods_ms[0]);
+
+// UART budget: NAV-PVT bits per measurement period against the line capacity
+static_assert((uint64_t)NAV_PVT_FRAME_BITS * 1000 * 100 <= (uint64_t)GNSS_OPERATING_PERIOD_MS * GNSS_OPERATING_BAUD * GNSS_MAX_UART_LOAD_PERCENT,
+              "GNSS: NAV-PVT rate exceeds the UART budget, raise the baud rate");
+
+static_assert(GNSS_AIDING_TIME_ACCURACY_S <= 65535, "GNSS: MGA-INI-TIME accuracy is a 16 bit field");
+
+#if GNSS_HIGH_RATE_HZ
+static_assert(GNSS_HIGH_RATE_HZ >= 10 && GNSS_HIGH_RATE_HZ <= 25, "GNSS: high-rate mode is 10..25Hz");
+
+// periodic NAV messages an earlier (saved) configuration may have enabled
+static const uint8_t disabledNavMessages[] = {
+    0x01, 0x02, 0x03, 0x04, 0x06, 0x11, 0x12, 0x20, 0x21, 0x22, 0x30, 0x35   // POSECEF .. SAT
+};
+static const uint8_t numDisabledNavMessages = sizeof(disabledNavMessages);
+#else
+static const uint8_t numDisabledNavMessages = 0;
+#endif
+
+enum ConfigStep : uint8_t {
+    CONFIG_PORT,        // CFG-PRT: baud rate, UBX only output
+    CONFIG_RATE,        // CFG-RATE: measurement period
+    CONFIG_NAV_PVT,     // CFG-MSG: NAV-PVT every navigation solution
+    CONFIG_DISABLE      // CFG-MSG rate 0, one step per disabledNavMessages entry
+};
+static const uint8_t configDone = CONFIG_DISABLE + numDisabledNavMessages;
+
+static uint8_t defaultBaudIndex(void) {
+    for (uint8_t index = 0; index < numProbeBaudRates; index++) {
+        if (probeBaudRates[index] == GNSS_OPERATING_BAUD) return index;
+    }
+    return 0;
+}
+
+static void putU2(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void putU4(uint8_t *p, uint32_t value) {
+    putU2(p, (uint16_t)value);
+    putU2(p + 2, (uint16_t)(value >> 16));
+}
+
+// GPS time of week from UTC: weekday of the date (0 = Sunday, start of the GPS week) + leap seconds
+static uint32_t gpsTimeOfWeek(uint16_t year, uint8_t month, uint8_t day, bool dateValid, uint32_t time_ms) {
+    static const uint8_t monthOffset[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+    uint32_t weekday = 0;
+    if (dateValid) {
+        uint32_t y = year - (month < 3 ? 1 : 0);
+        weekday = (y + y / 4 - y / 100 + y / 400 + monthOffset[month - 1] + day) % 7;
+    }
+    return (weekday * DAY_MS + time_ms + GNSS_NMEA_LEAP_SECONDS * 1000UL) % WEEK_MS;
+}
 
 UbloxGNSSWrapper::UbloxGNSSWrapper(Stream &serialPort) 
-    : serialPort(&serialPort), cachedLatitude(0), cachedLongitude(0), cachedAltitude(0),
-      cachedSpeed(0), cachedHeading(0), cachedSIV(0), 
-      cachedValidFix(false), lastUpdateTime(0) {
-    // Store the serial port reference for later use
+    : serialPort(&serialPort), state(STATE_IDLE), baudIndex(0), configStep(0), configAttempts(0),
+      framesSeen(false), sentencesSeen(false), ackPending(false), ackResult(0), ackClass(0), ackId(0), stateTime(0),
+      lastFrameTime(0), baudRate(GNSS_OPERATING_BAUD), period_ms(GNSS_OPERATING_PERIOD_MS), warmStartValid(false), nmeaEpochParts(0),
+      nmeaEpochTimeValid(false), nmeaEpochTime_ms(0), nmeaHDOP(NMEA_HDOP_UNKNOWN), nmeaQuality(0), nmeaRmcActive(false),
+      nmeaDateValid(false), publishCount(0), cachedHDOP(0), cachedTimeToFirstFix(0), lastUpdateTime(0) {
+    published = GnssSnapshot();
+    warmStart = GnssWarmStart();
+    nmeaEpoch = GnssSnapshot();
+}
+
+void UbloxGNSSWrapper::setWarmStart(const GnssWarmStart &data) {
+    warmStart = data;
+    warmStartValid = true;
 }
 
-bool UbloxGNSSWrapper::begin(uint16_t maxWait) {
-    // This is a blocking call, safe to use during initialization
-    // Use the stored serial port reference
+bool UbloxGNSSWrapper::begin(void) {
+    // Non-blocking: only starts the search, update() does the rest
     if (!serialPort) {
         return false; // Serial port not initialized
     }
     
-    // Begin communication with GNSS module
-    bool success = myGNSS.begin(*serialPort, maxWait, true);
+    startProbe(defaultBaudIndex(), millis());
+    return true;
+}
+
+void UbloxGNSSWrapper::update(void) {
+    // Non-blocking update - decode everything received since the last call
+    // (one NAV-PVT frame per measurement epoch), then advance the bring-up
+    uint32_t now = millis();
+    int c;
+    while ((c = serialPort->read()) >= 0) {
+        if (parser.parse((uint8_t)c)) {
+            framesSeen = true;
+            lastFrameTime = now;
+            handleMessage();
+        } else if ((state == STATE_PROBE || state == STATE_NMEA) && nmea.parse((uint8_t)c)) {
+            sentencesSeen = true;
+            if (state == STATE_NMEA) {
+                lastFrameTime = now;
+                handleNmea();
+            }
+        }
+    }
     
-    if (success) {
-        // Configure for non-blocking operation
-        // Enable automatic PVT reporting at 1Hz
-        myGNSS.setAutoPVT(true, maxWait);
+    advanceBringup(now);
+    lastUpdateTime = now;
+}
+
+void UbloxGNSSWrapper::advanceBringup(uint32_t now) {
+    switch (state) {
+    case STATE_PROBE:
+        if ((framesSeen && GNSS_PROTOCOL != GNSS_PROTOCOL_NMEA) || (sentencesSeen && GNSS_PROTOCOL == GNSS_PROTOCOL_UBX)) {
+            // module talks at this baud rate - configure it
+            configStep = CONFIG_PORT;
+            configAttempts = 0;
+            state = STATE_CONFIGURE;
+            sendConfigStep(now);
+        } else if (sentencesSeen && (GNSS_PROTOCOL == GNSS_PROTOCOL_NMEA || now - stateTime >= GNSS_PROBE_TIMEOUT_MS)) {
+            // NMEA without an answer to the NAV-PVT poll - generic module, read as it is
+            state = STATE_NMEA;
+            lastFrameTime = now;
+            nmeaEpochParts = 0;
+        } else if (now - stateTime >= GNSS_PROBE_TIMEOUT_MS) {
+            startProbe((baudIndex + 1) % numProbeBaudRates, now);
+        }
+        break;
+        
+    case STATE_CONFIGURE:
+        if (configStep == CONFIG_PORT) {
+            // the CFG-PRT ACK may be lost in the baud change - follow once the command is out
+            if (now - stateTime < GNSS_PORT_SWITCH_MS) break;
+            serialPort->setBaudRate(GNSS_OPERATING_BAUD);
+            baudRate = GNSS_OPERATING_BAUD;
+            parser.reset();
+            configStep++;
+            sendConfigStep(now);
+            break;
+        }
+        if (ackResult > 0) {
+            configAttempts = 0;
+            if (++configStep == configDone) {
+                state = STATE_RUNNING;
+                lastFrameTime = now;
+                if (warmStartValid) sendWarmStart();    // every bring-up: the module may have lost its state
+                break;
+            }
+            sendConfigStep(now);
+        } else if (ackResult < 0 && configStep == CONFIG_RATE && stepDownRate()) {
+            configAttempts = 0;         // rate not supported by the module - next lower one at once
+            sendConfigStep(now);
+        } else if (ackResult < 0 || now - stateTime >= GNSS_ACK_TIMEOUT_MS) {
+            if (++configAttempts >= GNSS_CONFIG_RETRIES) startProbe(defaultBaudIndex(), now);
+            else sendConfigStep(now);
+        }
+        break;
+        
+    case STATE_RUNNING:
+        if (now - lastFrameTime >= GNSS_RX_TIMEOUT_MS) startProbe(defaultBaudIndex(), now);
+        break;
         
-        // Set measurement rate to 500ms (2Hz)
-        myGNSS.setMeasurementRate(500, maxWait);
+    case STATE_NMEA:
+        // not configured by us: the module comes back at the same baud rate
+        if (now - lastFrameTime >= GNSS_RX_TIMEOUT_MS) startProbe(baudIndex, now);
+        break;
         
-        // Configure UART1 output to UBX only (reduces baudrate)
-        myGNSS.setUART1Output(COM_TYPE_UBX, maxWait);
+    default:
+        break;
     }
-    
-    return success;
 }
 
-void UbloxGNSSWrapper::update(void) {
-    // Non-blocking update - just check for new data
-    // The checkUblox method is non-blocking when autoPVT is enabled
-    myGNSS.checkUblox();
+bool UbloxGNSSWrapper::stepDownRate(void) {
+    for (uint8_t index = 0; index < numFallbackPeriods; index++) {
+        if (fallbackPeriods_ms[index] > period_ms) {
+            period_ms = fallbackPeriods_ms[index];
+            return true;
+        }
+    }
+    return false;
+}
+
+void UbloxGNSSWrapper::startProbe(uint8_t index, uint32_t now) {
+    baudIndex = index;
+    baudRate = probeBaudRates[index];
+    period_ms = GNSS_OPERATING_PERIOD_MS;   // a new (or updated) module gets the full rate again
+    state = STATE_PROBE;
+    stateTime = now;
+    framesSeen = false;
+    sentencesSeen = false;
+    ackPending = false;
+    serialPort->setBaudRate(baudRate);
+    parser.reset();
+    nmea.reset();
+    if (GNSS_PROTOCOL != GNSS_PROTOCOL_NMEA) {
+        sendCommand(UBX_CLASS_NAV, UBX_NAV_PVT, nullptr, 0);   // poll, answered by a u-blox module
+    }
+}
+
+void UbloxGNSSWrapper::sendConfigStep(uint32_t now) {
+    uint8_t payload[20] = {0};
+    uint8_t id;
+    uint16_t length;
     
-    // Cache the current values (these are updated automatically when autoPVT is enabled)
-    cachedLatitude = myGNSS.getLatitude(0);   // maxWait = 0 means non-blocking
-    cachedLongitude = myGNSS.getLongitude(0);
-    cachedAltitude = myGNSS.getAltitudeMSL(0);
-    cachedSpeed = myGNSS.getGroundSpeed(0);
-    cachedHeading = myGNSS.getHeading(0);
-    cachedSIV = myGNSS.getSIV(0);
+    switch (configStep) {
+    case CONFIG_PORT:
+        id = UBX_CFG_PRT;
+        length = 20;
+        payload[0] = CFG_PRT_UART1;
+        putU4(payload + 4, CFG_PRT_MODE_8N1);
+        putU4(payload + 8, GNSS_OPERATING_BAUD);
+        putU2(payload + 12, CFG_PRT_PROTO_UBX | CFG_PRT_PROTO_NMEA);   // in
+        putU2(payload + 14, CFG_PRT_PROTO_UBX);                        // out: UBX only
+        break;
+    case CONFIG_RATE:
+        id = UBX_CFG_RATE;
+        length = 6;
+        putU2(payload + 0, period_ms);
+        putU2(payload + 2, 1);          // one navigation solution per measurement
+        putU2(payload + 4, 1);          // GPS time reference
+        break;
+    case CONFIG_NAV_PVT:
+        id = UBX_CFG_MSG;
+        length = 3;
+        payload[0] = UBX_CLASS_NAV;
+        payload[1] = UBX_NAV_PVT;
+        payload[2] = 1;                 // every solution on the current port
+        break;
+    default:
+        id = UBX_CFG_MSG;
+        length = 3;
+        payload[0] = UBX_CLASS_NAV;
+#if GNSS_HIGH_RATE_HZ
+        payload[1] = disabledNavMessages[configStep - CONFIG_DISABLE];
+#endif
+        payload[2] = 0;                 // off on the current port
+        break;
+    }
     
-    // Determine if we have a valid fix
-    cachedValidFix = (cachedSIV > 0);
+    stateTime = now;
+    ackClass = UBX_CLASS_CFG;
+    ackId = id;
+    ackResult = 0;
+    ackPending = true;
+    sendCommand(UBX_CLASS_CFG, id, payload, length);
+}
+
+void UbloxGNSSWrapper::sendCommand(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t length) {
+    uint16_t frameLength = UbxParser::buildFrame(txFrame, msgClass, msgId, payload, length);
+    serialPort->write(txFrame, frameLength);   // queued, sent by the UART TX interrupt
+}
+
+void UbloxGNSSWrapper::sendWarmStart(void) {
+    // MGA messages are not acknowledged by default - sent once, no wait
+    uint8_t payload[24] = {0};
+    uint32_t accuracy_cm = warmStart.hAcc / 10;
+    if (accuracy_cm < GNSS_AIDING_POSITION_ACCURACY_M * 100UL) accuracy_cm = GNSS_AIDING_POSITION_ACCURACY_M * 100UL;
+    payload[0] = MGA_INI_POS_LLH;
+    putU4(payload + 4, (uint32_t)warmStart.latitude);
+    putU4(payload + 8, (uint32_t)warmStart.longitude);
+    putU4(payload + 12, (uint32_t)(warmStart.altitudeMSL / 10));    // cm
+    putU4(payload + 16, accuracy_cm);
+    sendCommand(UBX_CLASS_MGA, UBX_MGA_INI, payload, 20);
     
-    lastUpdateTime = millis();
+#if GNSS_AIDING_TIME_ACCURACY_S > 0
+    uint8_t utc[24] = {0};
+    utc[0] = MGA_INI_TIME_UTC;
+    utc[2] = 0;                         // time reference: on receipt of the message
+    utc[3] = MGA_INI_LEAP_UNKNOWN;
+    putU2(utc + 4, warmStart.year);
+    utc[6] = warmStart.month;
+    utc[7] = warmStart.day;
+    utc[8] = warmStart.hour;
+    utc[9] = warmStart.minute;
+    utc[10] = warmStart.second;
+    putU2(utc + 16, GNSS_AIDING_TIME_ACCURACY_S);
+    sendCommand(UBX_CLASS_MGA, UBX_MGA_INI, utc, 24);
+#endif
 }
 
-void UbloxGNSSWrapper::setSerialRate(uint32_t baudrate, uint16_t maxWait) {
-    myGNSS.setSerialRate(baudrate, COM_PORT_UART1, maxWait);
+void UbloxGNSSWrapper::publish(GnssSnapshot &snapshot) {
+    snapshot.sequence = published.sequence + 1;
+    if (snapshot.sequence == 0) snapshot.sequence = 1;
+    
+    publishCount++;     // odd: write in progress
+    __DMB();
+    published = snapshot;
+    __DMB();
+    publishCount++;
 }
 
-bool UbloxGNSSWrapper::setAutoPVT(bool enabled, uint16_t maxWait) {
-    return myGNSS.setAutoPVT(enabled, maxWait);
+void UbloxGNSSWrapper::handleMessage(void) {
+    if (parser.getClass() == UBX_CLASS_ACK) {
+        const uint8_t *payload = parser.getPayload();
+        if (ackPending && parser.getLength() >= 2 && payload[0] == ackClass && payload[1] == ackId) {
+            ackResult = (parser.getId() == UBX_ACK_ACK) ? 1 : -1;
+            ackPending = false;
+        }
+        return;
+    }
+    if (parser.getClass() != UBX_CLASS_NAV) return;
+    
+    switch (parser.getId()) {
+    case UBX_NAV_PVT: {
+        UbxNavPvt pvt;
+        if (!parser.decodeNavPvt(&pvt)) break;
+        GnssSnapshot snapshot;
+        snapshot.timestamp_us = timebase_micros();
+        snapshot.iTOW = pvt.iTOW;
+        snapshot.latitude = pvt.lat;
+        snapshot.longitude = pvt.lon;
+        snapshot.altitudeMSL = pvt.hMSL;
+        snapshot.groundSpeed = pvt.gSpeed;
+        snapshot.heading = pvt.headMot;
+        snapshot.velocityDown = pvt.velD;
+        snapshot.hAcc = pvt.hAcc;
+        snapshot.vAcc = pvt.vAcc;
+        snapshot.sAcc = pvt.sAcc;
+        snapshot.pDOP = pvt.pDOP;
+        snapshot.fixType = pvt.fixType;
+        snapshot.numSV = pvt.numSV;
+        
+        // Valid fix: the module's own gnssFixOK (DOP / accuracy masks) and a position fix
+        snapshot.fixOK = (pvt.flags & NAV_PVT_FLAGS_FIX_OK) && pvt.fixType >= 2 && pvt.fixType <= 4;
+        snapshot.timeValid = (pvt.valid & NAV_PVT_VALID_DATE_TIME) == NAV_PVT_VALID_DATE_TIME;
+        snapshot.year = pvt.year;
+        snapshot.month = pvt.month;
+        snapshot.day = pvt.day;
+        snapshot.hour = pvt.hour;
+        snapshot.minute = pvt.minute;
+        snapshot.second = pvt.second;
+        publish(snapshot);
+        break;
+    }
+    case UBX_NAV_DOP: {
+        UbxNavDop dop;
+        if (parser.decodeNavDop(&dop)) cachedHDOP = dop.hDOP;
+        break;
+    }
+    case UBX_NAV_STATUS: {
+        UbxNavStatus status;
+        if (parser.decodeNavStatus(&status)) cachedTimeToFirstFix = status.ttff;
+        break;
+    }
+    default:
+        break;
+    }
 }
 
-bool UbloxGNSSWrapper::setMeasurementRate(uint16_t rate, uint16_t maxWait) {
-    return myGNSS.setMeasurementRate(rate, maxWait);
+void UbloxGNSSWrapper::handleNmea(void) {
+    switch (nmea.getType()) {
+    case NMEA_GGA: {
+        NmeaGga gga;
+        if (!nmea.decodeGga(&gga) || !openNmeaEpoch(NMEA_EPOCH_GGA, gga.timeValid, gga.time_ms)) return;
+        if (gga.positionValid) {
+            nmeaEpoch.latitude = gga.lat;
+            nmeaEpoch.longitude = gga.lon;
+        }
+        if (gga.altitudeValid) nmeaEpoch.altitudeMSL = gga.altitudeMSL;
+        nmeaEpoch.numSV = gga.numSV;
+        nmeaHDOP = gga.hDOPValid ? gga.hDOP : NMEA_HDOP_UNKNOWN;
+        nmeaQuality = gga.positionValid ? gga.quality : 0;
+        break;
+    }
+    case NMEA_RMC: {
+        NmeaRmc rmc;
+        if (!nmea.decodeRmc(&rmc) || !openNmeaEpoch(NMEA_EPOCH_RMC, rmc.timeValid, rmc.time_ms)) return;
+        if (rmc.positionValid) {
+            nmeaEpoch.latitude = rmc.lat;
+            nmeaEpoch.longitude = rmc.lon;
+        }
+        if (rmc.speedValid) nmeaEpoch.groundSpeed = rmc.speed;
+        if (rmc.courseValid) nmeaEpoch.heading = rmc.course;
+        if (rmc.dateValid) {
+            nmeaEpoch.year = rmc.year;
+            nmeaEpoch.month = rmc.month;
+            nmeaEpoch.day = rmc.day;
+            nmeaDateValid = true;
+        }
+        nmeaRmcActive = rmc.active && rmc.positionValid && rmc.mode != 'N';
+        break;
+    }
+    case NMEA_VTG: {
+        // no time field: belongs to the epoch opened by GGA / RMC before it
+        NmeaVtg vtg;
+        if (nmeaEpochParts == 0 || (nmeaEpochParts & NMEA_EPOCH_VTG) || !nmea.decodeVtg(&vtg)) return;
+        nmeaEpochParts |= NMEA_EPOCH_VTG;
+        if (vtg.speedValid) nmeaEpoch.groundSpeed = vtg.speed;
+        if (vtg.courseValid) nmeaEpoch.heading = vtg.course;
+        break;
+    }
+    default:
+        return;
+    }
+    
+    // position (GGA) and velocity (RMC / VTG) of the fix complete
+    if ((nmeaEpochParts & NMEA_EPOCH_GGA) && (nmeaEpochParts & (NMEA_EPOCH_RMC | NMEA_EPOCH_VTG))) publishNmeaEpoch();
 }
 
-bool UbloxGNSSWrapper::setUART1Output(uint8_t comSettings, uint16_t maxWait) {
-    return myGNSS.setUART1Output(comSettings, maxWait);
+bool UbloxGNSSWrapper::openNmeaEpoch(uint8_t part, bool timeValid, uint32_t time_ms) {
+    bool sameTime = (timeValid == nmeaEpochTimeValid) && (!timeValid || time_ms == nmeaEpochTime_ms);
+    if (nmeaEpochParts != 0 && ((nmeaEpochParts & part) || !sameTime)) {
+        publishNmeaEpoch();             // next fix started: the module sends fewer sentences
+    }
+    if (nmeaEpochParts == 0) {
+        if (timeValid && sameTime) return false;    // late sentence of the epoch published already
+        
+        // new epoch; the date stays until the next RMC
+        uint16_t year = nmeaEpoch.year;
+        uint8_t month = nmeaEpoch.month, day = nmeaEpoch.day;
+        nmeaEpoch = GnssSnapshot();
+        nmeaEpoch.year = year;
+        nmeaEpoch.month = month;
+        nmeaEpoch.day = day;
+        nmeaEpoch.timestamp_us = timebase_micros();     // first sentence of the fix
+        nmeaEpochTimeValid = timeValid;
+        nmeaEpochTime_ms = time_ms;
+        nmeaHDOP = NMEA_HDOP_UNKNOWN;
+        nmeaQuality = 0;
+        nmeaRmcActive = false;
+    }
+    nmeaEpochParts |= part;
+    return true;
 }
 
-bool UbloxGNSSWrapper::getPVT(uint16_t maxWait) {
-    // If autoPVT is enabled, this returns without blocking
-    // If autoPVT is disabled, this polls and waits up to maxWait
-    return myGNSS.getPVT(maxWait);
+void UbloxGNSSWrapper::publishNmeaEpoch(void) {
+    if (nmeaEpochParts & NMEA_EPOCH_GGA) {
+        // GGA quality 1..5: GPS, DGPS, PPS, RTK fixed / float; 6: dead reckoning only
+        if (nmeaQuality >= 1 && nmeaQuality <= 5) nmeaEpoch.fixType = nmeaEpoch.numSV >= 4 ? 3 : 2;
+        else if (nmeaQuality == 6) nmeaEpoch.fixType = 1;
+    } else if (nmeaRmcActive) {
+        nmeaEpoch.fixType = 2;          // RMC only: no altitude
+    }
+    // RMC status 'V' (void) overrides a GGA fix
+    nmeaEpoch.fixOK = nmeaEpoch.fixType >= 2 && (!(nmeaEpochParts & NMEA_EPOCH_RMC) || nmeaRmcActive);
+    nmeaEpoch.pDOP = nmeaHDOP;
+    nmeaEpoch.hAcc = (uint32_t)nmeaHDOP * GNSS_NMEA_UERE_MM / 100;
+    nmeaEpoch.vAcc = nmeaEpoch.hAcc * 3 / 2;
+    cachedHDOP = nmeaHDOP;
+    
+    nmeaEpoch.timeValid = nmeaEpochTimeValid && nmeaDateValid;
+    if (nmeaEpochTimeValid) {
+        nmeaEpoch.hour = (uint8_t)(nmeaEpochTime_ms / 3600000UL);
+        nmeaEpoch.minute = (uint8_t)(nmeaEpochTime_ms / 60000UL % 60);
+        nmeaEpoch.second = (uint8_t)(nmeaEpochTime_ms / 1000UL % 60);
+        nmeaEpoch.iTOW = gpsTimeOfWeek(nmeaEpoch.year, nmeaEpoch.month, nmeaEpoch.day, nmeaDateValid, nmeaEpochTime_ms);
+    }
+    nmeaEpochParts = 0;
+    publish(nmeaEpoch);
 }
 
 // ============================================================================
 // Non-blocking Getter Methods
 // ============================================================================
 
+uint32_t UbloxGNSSWrapper::getSequence(void) {
+    return published.sequence;
+}
+
+bool UbloxGNSSWrapper::getSnapshot(GnssSnapshot *snapshot) const {
+    for (uint8_t attempt = 0; attempt < SNAPSHOT_READ_ATTEMPTS; attempt++) {
+        uint32_t count = publishCount;
+        __DMB();
+        if (count & 1) continue;
+        *snapshot = published;
+        __DMB();
+        if (publishCount == count) return snapshot->sequence != 0;
+    }
+    return false;
+}
+
 int32_t UbloxGNSSWrapper::getLatitude(void) {
-    return cachedLatitude;
+    return published.latitude;
 }
 
 int32_t UbloxGNSSWrapper::getLongitude(void) {
-    return cachedLongitude;
+    return published.longitude;
 }
 
 int32_t UbloxGNSSWrapper::getAltitudeMSL(void) {
-    return cachedAltitude;
+    return published.altitudeMSL;
 }
 
 int32_t UbloxGNSSWrapper::getGroundSpeed(void) {
-    return cachedSpeed;
+    return published.groundSpeed;
 }
 
 int32_t UbloxGNSSWrapper::getHeading(void) {
-    return cachedHeading;
+    return published.heading;
 }
 
 uint8_t UbloxGNSSWrapper::getSIV(void) {
-    return cachedSIV;
+    return published.numSV;
 }
 
-bool UbloxGNSSWrapper::hasValidFix(void) {
-    return cachedValidFix;
+uint32_t UbloxGNSSWrapper::getTimeOfWeek(void) {
+    return published.iTOW;
+}
+
+uint8_t UbloxGNSSWrapper::getFixType(void) {
+    return published.fixType;
+}
+
+uint32_t UbloxGNSSWrapper::getVerticalAccuracy(void) {
+    return published.vAcc;
+}
+
+uint16_t UbloxGNSSWrapper::getHDOP(void) {
+    return cachedHDOP;
+}
+
+uint32_t UbloxGNSSWrapper::getTimeToFirstFix(void) {
+    return cachedTimeToFirstFix;
+}
+
+const UbxParserStats& UbloxGNSSWrapper::getParserStats(void) {
+    return parser.getStats();
 }
 
-SFE_UBLOX_GNSS& UbloxGNSSWrapper::getGNSS(void) {
-    return myGNSS;
+const NmeaParserStats& UbloxGNSSWrapper::getNmeaStats(void) {
+    return nmea.getStats();
+}
+
+bool UbloxGNSSWrapper::isConfigured(void) {
+    return state == STATE_RUNNING || state == STATE_NMEA;
+}
+
+uint32_t UbloxGNSSWrapper::getBaudRate(void) {
+    return baudRate;
+}
+
+uint16_t UbloxGNSSWrapper::getMeasurementPeriod_ms(void) {
+    return period_ms;
+}
+
+const char* UbloxGNSSWrapper::getStateName(void) {
+    static const char *const names[] = {"idle", "probe", "configure", "running", "nmea"};
+    return names[state];
+}
+
+bool UbloxGNSSWrapper::hasValidFix(void) {
+    return published.fixOK;
 }
@@ -0,0 +1,179 @@
+/**
+ * @file ubx_parser.cpp
+ * @brief UBX frame state machine, Fletcher-8 checksum and NAV message decoding
+ */
+
+#include "ubx_parser.h"
+#include <string.h>
+
+#define NAV_PVT_LENGTH 84                   // protocol 14 (u-blox 7), 92 from u-blox 8 on
+#define NAV_DOP_LENGTH 18
+#define NAV_STATUS_LENGTH 16
+
+static uint16_t getU2(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU4(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int32_t getI4(const uint8_t *p) {
+    return (int32_t)getU4(p);
+}
+
+UbxParser::UbxParser() {
+    reset();
+    m_stats = UbxParserStats();
+}
+
+void UbxParser::reset(void) {
+    m_state = STATE_SYNC_1;
+    m_class = 0;
+    m_id = 0;
+    m_length = 0;
+    m_index = 0;
+    m_ckA = 0;
+    m_ckB = 0;
+}
+
+bool UbxParser::parse(uint8_t byte) {
+    switch (m_state) {
+    case STATE_SYNC_1:
+        if (byte == UBX_SYNC_1) m_state = STATE_SYNC_2;
+        return false;
+    case STATE_SYNC_2:
+        if (byte == UBX_SYNC_2) m_state = STATE_CLASS;
+        else m_state = (byte == UBX_SYNC_1) ? STATE_SYNC_2 : STATE_SYNC_1;
+        return false;
+    case STATE_CLASS:
+        m_class = byte;
+        m_ckA = byte;
+        m_ckB = byte;
+        m_state = STATE_ID;
+        return false;
+    case STATE_PAYLOAD:
+        if (m_index < UBX_MAX_PAYLOAD) m_payload[m_index] = byte;
+        m_ckA += byte;
+        m_ckB += m_ckA;
+        if (++m_index >= m_length) m_state = STATE_CK_A;
+        return false;
+    case STATE_CK_A:
+        if (byte != m_ckA) {
+            m_stats.checksumErrors++;
+            m_state = (byte == UBX_SYNC_1) ? STATE_SYNC_2 : STATE_SYNC_1;
+            return false;
+        }
+        m_state = STATE_CK_B;
+        return false;
+    case STATE_CK_B:
+        m_state = STATE_SYNC_1;
+        if (byte != m_ckB) {
+            m_stats.checksumErrors++;
+            if (byte == UBX_SYNC_1) m_state = STATE_SYNC_2;
+            return false;
+        }
+        if (m_length > UBX_MAX_PAYLOAD) {
+            m_stats.oversized++;
+            return false;
+        }
+        m_stats.frames++;
+        return true;
+    default:
+        break;
+    }
+
+    // header bytes after the class: id, length
+    m_ckA += byte;
+    m_ckB += m_ckA;
+    if (m_state == STATE_ID) {
+        m_id = byte;
+        m_state = STATE_LENGTH_1;
+    } else if (m_state == STATE_LENGTH_1) {
+        m_length = byte;
+        m_state = STATE_LENGTH_2;
+    } else {
+        m_length |= (uint16_t)byte << 8;
+        m_index = 0;
+        if (m_length > UBX_MAX_FRAME_LENGTH) {      // false sync inside other data
+            m_stats.checksumErrors++;
+            m_state = STATE_SYNC_1;
+            return false;
+        }
+        m_state = m_length > 0 ? STATE_PAYLOAD : STATE_CK_A;
+    }
+    return false;
+}
+
+bool UbxParser::decodeNavPvt(UbxNavPvt *pvt) const {
+    if (!isMessage(UBX_CLASS_NAV, UBX_NAV_PVT) || m_length < NAV_PVT_LENGTH) return false;
+    const uint8_t *p = m_payload;
+    pvt->iTOW = getU4(p + 0);
+    pvt->year = getU2(p + 4);
+    pvt->month = p[6];
+    pvt->day = p[7];
+    pvt->hour = p[8];
+    pvt->minute = p[9];
+    pvt->second = p[10];
+    pvt->valid = p[11];
+    pvt->fixType = p[20];
+    pvt->flags = p[21];
+    pvt->numSV = p[23];
+    pvt->lon = getI4(p + 24);
+    pvt->lat = getI4(p + 28);
+    pvt->height = getI4(p + 32);
+    pvt->hMSL = getI4(p + 36);
+    pvt->hAcc = getU4(p + 40);
+    pvt->vAcc = getU4(p + 44);
+    pvt->velN = getI4(p + 48);
+    pvt->velE = getI4(p + 52);
+    pvt->velD = getI4(p + 56);
+    pvt->gSpeed = getI4(p + 60);
+    pvt->headMot = getI4(p + 64);
+    pvt->sAcc = getU4(p + 68);
+    pvt->headAcc = getU4(p + 72);
+    pvt->pDOP = getU2(p + 76);
+    return true;
+}
+
+bool UbxParser::decodeNavDop(UbxNavDop *dop) const {
+    if (!isMessage(UBX_CLASS_NAV, UBX_NAV_DOP) || m_length < NAV_DOP_LENGTH) return false;
+    const uint8_t *p = m_payload;
+    dop->iTOW = getU4(p + 0);
+    dop->gDOP = getU2(p + 4);
+    dop->pDOP = getU2(p + 6);
+    dop->tDOP = getU2(p + 8);
+    dop->vDOP = getU2(p + 10);
+    dop->hDOP = getU2(p + 12);
+    return true;
+}
+
+bool UbxParser::decodeNavStatus(UbxNavStatus *status) const {
+    if (!isMessage(UBX_CLASS_NAV, UBX_NAV_STATUS) || m_length < NAV_STATUS_LENGTH) return false;
+    const uint8_t *p = m_payload;
+    status->iTOW = getU4(p + 0);
+    status->gpsFix = p[4];
+    status->flags = p[5];
+    status->ttff = getU4(p + 8);
+    status->msss = getU4(p + 12);
+    return true;
+}
+
+uint16_t UbxParser::buildFrame(uint8_t *frame, uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t length) {
+    frame[0] = UBX_SYNC_1;
+    frame[1] = UBX_SYNC_2;
+    frame[2] = msgClass;
+    frame[3] = msgId;
+    frame[4] = (uint8_t)(length & 0xFF);
+    frame[5] = (uint8_t)(length >> 8);
+    if (length > 0 && payload != frame + 6) memcpy(frame + 6, payload, length);
+
+    uint8_t ckA = 0, ckB = 0;
+    for (uint16_t i = 2; i < length + 6; i++) {
+        ckA += frame[i];
+        ckB += ckA;
+    }
+    frame[length + 6] = ckA;
+    frame[length + 7] = ckB;
+    return length + UBX_FRAME_OVERHEAD;
+}
@@ -4,7 +4,6 @@
 #include "user_main.h"
 #include "mySerial.h"
 #include "uart_config.h"
-//#include "ublox_gnss_example.h"
 //#include "ublox_gnss_wrapper.h"
 //#include "stm32_arduino_compatibility.h"
 //#include <cstddef>
@@ -12,39 +11,42 @@
 #include <cstddef>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <sys/_intsup.h>
 #include "../AlfredoCRSF/src/AlfredoCRSF.h"
 #include "platform_abstraction.h"
+#include "servo_timer_sync.h"
+#include "channel_mixer.h"
+#include "output_filter.h"
+#include "sbus_output.h"
+#include "ppm_output.h"
+#include "adc_sampler.h"
+#include "adc_trigger.h"
+#include "battery_measurement.h"
+#include "battery_monitor.h"
+#include "adc_calibration.h"
+#include "timebase.h"
+#include "i2c_bus.h"
+#include "spl06_async.h"
+#include "baro_altitude.h"
+#include "vario_estimator.h"
+#include "ground_calibration.h"
+#include "altitude_fusion.h"
+#include "pps_clock.h"
+#include "gnss_cache.h"
 
 
 //#include "stm32g0xx_hal_adc.h"
-#include "../SPL06-001/SPL06-001.h"
-#include "../SPL06-001/spl06_001_glue.h" 
 
 
 
 #define CRSF_BATTERY_SENSOR_CELLS_MAX 12
-#define BAT_ADC_Oversampling_Ratio 16  // Must match ADC oversampling ratio
-#define BAT_ADC_Voltage_divider 11.0f // Voltage divider ratio 10k and 1k resistors
 #define DBG_STRINGBUFSIZE 100
+#define DBG_CONSOLE_LINE_MAX 32
 char debug_str_buffer[DBG_STRINGBUFSIZE];
 
-#ifdef TARGET_MATEKSYS_CRSF_PWM_V10
-// PWM Channel to Timer and Channel mapping for the used "Matek CRSF_PWM_V10" board
-TIM_HandleTypeDef* Timer_map[num_PWM_channels]={&htim2,      &htim2,       &htim16,      &htim2,       &htim3,       &htim3,       &htim3,       &htim3,       &htim1,       &htim1};
-unsigned int PWM_Channelmap[num_PWM_channels]={TIM_CHANNEL_1,TIM_CHANNEL_2,TIM_CHANNEL_1,TIM_CHANNEL_3,TIM_CHANNEL_4,TIM_CHANNEL_3,TIM_CHANNEL_2,TIM_CHANNEL_1,TIM_CHANNEL_1,TIM_CHANNEL_2};
-//   Servo Channel number                             1                 2                 3                 4                 5                 6                 7                 8                 9                 10  
-//   Timer channel offset = TIM_Channel_X -1)*4       0                 4                 0                 8                12                 8                 4                 0                 0                  4                
-#endif
-
-#ifdef TARGET_BLUEPILL // BluePill or other custom board - adjust Timer_map and PWM_Channelmap according to your wiring and timers used
-// PWM Channel to Timer and Channel mapping  for the used "BluePill" board
-TIM_HandleTypeDef* Timer_map[num_PWM_channels]={&htim2,       &htim2,       &htim3,       &htim3,       &htim3,       &htim3,       &htim1,       &htim1,       &htim1,       &htim1};
-unsigned int PWM_Channelmap[num_PWM_channels]={ TIM_CHANNEL_1,TIM_CHANNEL_2,TIM_CHANNEL_1,TIM_CHANNEL_2,TIM_CHANNEL_3,TIM_CHANNEL_4,TIM_CHANNEL_1,TIM_CHANNEL_2,TIM_CHANNEL_3,TIM_CHANNEL_4};
-//   Servo Channel number                             1                 2                 3                 4                 5                 6                 7                 8                 9                 10  
-#endif
-
-
 #ifdef __cplusplus
 extern "C" {
 
@@ -55,17 +57,14 @@ void gnss_module_update(uint32_t millis_now);
 UbloxGNSSWrapper *pGNSS = nullptr;
 
 
-#define TARGET_MATEKSYS_CRSF_PWM_V10
-TwoWire BaroWire(SDA2, SCL2);	
-
-
-SPL06 BaroSensor(&BaroWire); 
 //mySerial serialDebug, serialGnss;
 void setupBaroSensor();  
 void baroProcessingTask(uint32_t millis_now);
 void baroSerialDisplayTask(uint32_t millis_now);
 #if UART_ROLE_CRSF != UART_ROLE_NONE
-static void telemetrySendCellVoltage(uint8_t cellId, float voltage);
+static void telemetrySendCellVoltage(uint8_t cellId, uint16_t voltage_mV);
+static void telemetrySendBattery(void);
+static void telemetrySendTemperature(uint8_t sourceId, int16_t temperature_dC);
 void telemetrySendBaroAltitude(float altitude);
 void telemetrySendVario( float verticalspd);
 void telemetrySendGps_int(UbloxGNSSWrapper *pGNSS);
@@ -87,21 +86,35 @@ extern "C" int serial2_putchar(int ch)
 static void pwm_update_task(uint32_t actual_millis);
 static void LED_and_debugSerial_task(uint32_t actual_millis);
 static void analog_measurement_task(uint32_t actual_millis);
+static void rc_output_task(uint32_t actual_millis);
+#if UART_ROLE_DEBUG != UART_ROLE_NONE
+static void debug_console_task(void);
+static void debug_console_command(char *line);
+#endif
 #if UART_ROLE_CRSF != UART_ROLE_NONE
 static void CRSF_reception_watchdog_task(uint32_t actual_millis);
 static void telemetry_transmission_task(uint32_t actual_millis);
+#if ADC_CAL_CRSF_CHANNEL
+static void CRSF_calibration_task(uint32_t actual_millis);
+#endif
+#if GROUND_CAL_CRSF_CHANNEL
+static void CRSF_baro_zero_task(uint32_t actual_millis);
+#endif
 #endif
 void gnssUpdateTask(uint32_t actual_millis);
 void gnssDisplayTask(uint32_t actual_millis);
+void gnssFusionUpdate(void);
 bool gnss_init(UART_HandleTypeDef *huart3, mySerial *gnssSerial_param);
 
 
 
 static void error_handling_task(void); 
+#if UART_ROLE_CRSF != UART_ROLE_NONE
+static void CRSF_channels_received(void);
+#endif
 
 // basic functions
 
-static void user_pwm_setvalue(uint8_t pwm_channel, uint16_t PWM_pulse_length);
 int8_t send_UART2(void);
 
 extern ADC_HandleTypeDef hadc1;
@@ -113,25 +126,39 @@ STM32Stream* crsfSerial = nullptr;      // UART1 wrapper - initialized in user_i
 STM32Stream* gnssSerial = nullptr;      // UART3 wrapper - initialized in gnss_init()
 
 AlfredoCRSF crsf;
+ChannelMixer mixer;                     // CRSF channel -> PWM output mapping and curves
+static_assert(num_PWM_channels <= MIXER_NUM_OUTPUTS, "ChannelMixer has less outputs than PWM channels");
+OutputFilter outputFilter;              // per channel interpolation / slew limit between CRSF frames
+static_assert(num_PWM_channels <= OUTPUT_FILTER_CHANNELS, "OutputFilter has less channels than PWM channels");
+volatile bool isCRSFNewFrame = false;   // set by the CRSF channel packet callback
+#if UART_ROLE_SBUS != UART_ROLE_NONE
+SbusOutput sbusOutput;                  // CRSF channels re-emitted as SBUS
+#endif
+#if PPM_OUTPUT_ENABLED
+TIM_HandleTypeDef htim_ppm;
+PpmOutput ppmOutput;                    // CRSF channels 1-8 re-emitted as PPM
+#endif
 volatile bool isCRSFLinkUp = false;
 volatile uint32_t RX1_overrun = 0, crsfSerialRestartRX_counter=0, main_loop_cnt=0, ADC_period=0;
 volatile uint32_t ELRS_TX_count = 0, ADC_count=0;
-volatile uint16_t ADC_buffer[2]; // ADC buffer for DMA
+AdcSampler adcSampler;                  // VBAT / current scan, circular DMA + decimation
+BatteryMeasurement battery;             // fixed point VBAT / current conversion
+I2cBus i2cBus(&hi2c1);                  // interrupt driven sensor transactions
+Spl06Async baroSensor(&i2cBus);         // SPL06-001 background mode, burst reads on the I2cBus
+VarioEstimator varioEstimator;          // Kalman filter altitude / vertical speed
+GroundCalibration groundCalibration;    // ground reference for AGL, ready on convergence
+AltitudeFusion altitudeFusion;          // baro + GNSS: drift corrected MSL altitude
+PpsClock ppsClock;                      // GNSS timepulse disciplined timebase_micros() -> GPS time
+BatteryMonitor batteryMonitor;          // consumed mAh, remaining %, CRSF battery sensor frame
 volatile uint8_t isADCFinished=0;
 volatile uint8_t i2cWriteComplete=1;
-static float bat_voltage=0.0f, bat_current=0.0f;
-
-static const float IIR_ALPHA  = 0.135755f;  // 0.5Hz cut off (fc/40 / fc=Hz /Tc=320ms)
-static const float IIR_BETA  = (1.0f - IIR_ALPHA);
+static int32_t bat_voltage_mV=0, bat_current_mA=0;
 
 int32_t GNSS_Altitude_MSL=0;
 static const float mmsTokmh = 0.0036f; // conversion factor from mm/s to km/h
 
-static float GND_altitude=0;
-static float previous_alt_ASL=0, baroAltitude=0, baroTemperature=0, baroPressure=0;
-static float vario=0,filt_alt_AGL=0;
-static double filt_vario=0, filt_alt_ASL=0;
-static uint32_t GND_alt_count=0;
+static float baroAltitude=0, baroTemperature=0, baroPressure=0;
+static float filt_alt_AGL=0, filt_vario=0, filt_alt_ASL=0;
 
 // GNSS module state variables
 static bool gnss_initialized = false;
@@ -144,21 +171,39 @@ static uint32_t gnss_last_print_time = 0;
 void user_init(void)  // same as the "arduino setup()" function
 {
   HAL_Delay(5);
+  timebase_init();
 #if UART_ROLE_DEBUG != UART_ROLE_NONE
   serialDebug.init(UART_DEBUG_HANDLE, UART_DEBUG_FIFO_SIZE, UART_DEBUG_TX_BUF_SIZE);
 #endif
 #if UART_ROLE_CRSF != UART_ROLE_NONE
-  // Initialize CRSF mySerial wrapper and STM32Stream
-  serialCrsf.init(UART_CRSF_HANDLE, UART_CRSF_FIFO_SIZE, UART_CRSF_TX_BUF_SIZE);
+  // Initialize CRSF mySerial wrapper and STM32Stream - circular RX DMA, no byte lost during a flash write
+  serialCrsf.init(UART_CRSF_HANDLE, UART_CRSF_FIFO_SIZE, UART_CRSF_TX_BUF_SIZE, UART_CRSF_RX_DMA, UART_CRSF_RX_FIFO_SIZE);
   crsfSerial = new STM32Stream(&serialCrsf);
   crsf.begin(*crsfSerial);
+  crsf.onPacketChannels = CRSF_channels_received;
 #endif
   
+  servo_timers_sync_init(SERVO_PHASE_TIM2_US, SERVO_PHASE_TIM3_US); // stagger the servo pulses of TIM1/TIM2/TIM3
+//  outputFilter.setMode(4, OUTPUT_FILTER_SLEW, 500);       // e.g. gear on output 5: 1000us travel in 2s
+//  outputFilter.setMode(9, OUTPUT_FILTER_INTERPOLATE);     // e.g. high rate digital servo on output 10
+#if UART_ROLE_SBUS != UART_ROLE_NONE
+  sbusOutput.init(UART_SBUS_HANDLE, UART_SBUS_TX_DMA);
+#endif
+#if PPM_OUTPUT_ENABLED
+  htim_ppm.Instance = PPM_TIM;
+  ppmOutput.init(&htim_ppm, PPM_TIM_CHANNEL, PPM_DMA_CHANNEL);
+#endif
+  adc_calibration_load(battery);   // board calibration from flash, compiled defaults otherwise
   HAL_ADCEx_Calibration_Start(&hadc1);
   HAL_Delay(20);
-  HAL_ADC_Start_DMA(&hadc1, (uint32_t*)ADC_buffer, 2);
-//  setupBaroSensor();
+  adc_trigger_init(&hadc1); // TIM4 CC4 triggered scan bursts in the quiet window of the servo frame
+  adcSampler.setDecimation(ADC_SAMPLER_DECIMATION);
+  adcSampler.start(&hadc1); // results every ADC_SAMPLER_DECIMATION scans
+  adc_trigger_start();
+  servo_timers_run();       // servo frame and ADC trigger run from here on, pulses start with the CRSF link
+  setupBaroSensor();
   gnss_module_init();
+  pps_capture_init();       // GNSS timepulse on PPS_GPIO_PIN
 //  HAL_Delay(20);
 }
 
@@ -173,9 +218,21 @@ void user_loop_step(void) // same as the "arduino loop()" function
   CRSF_reception_watchdog_task(actual_millis);
 #endif
   pwm_update_task(actual_millis);
+  rc_output_task(actual_millis);
   LED_and_debugSerial_task(actual_millis);
   analog_measurement_task(actual_millis);
-//  baroProcessingTask(actual_millis);
+  i2cBus.schedule(timebase_micros());     // periodic sensor reads, I2C transfer timeout
+  baroSensor.update(timebase_micros());   // SPL06 bring-up / conversion of the last burst read
+#if UART_ROLE_DEBUG != UART_ROLE_NONE
+  debug_console_task();
+#endif
+#if UART_ROLE_CRSF != UART_ROLE_NONE && ADC_CAL_CRSF_CHANNEL
+  CRSF_calibration_task(actual_millis);
+#endif
+#if UART_ROLE_CRSF != UART_ROLE_NONE && GROUND_CAL_CRSF_CHANNEL
+  CRSF_baro_zero_task(actual_millis);
+#endif
+  baroProcessingTask(actual_millis);
 //  baroSerialDisplayTask(actual_millis);
   gnssUpdateTask(actual_millis);
   gnssDisplayTask(actual_millis);
@@ -194,29 +251,54 @@ void user_loop_step(void) // same as the "arduino loop()" function
 }
 
 void gnssUpdateTask(uint32_t actual_millis) {
-  static uint32_t last_update_time = 0;
-  if ((actual_millis - last_update_time) <100) return; // Update every 100ms
-    last_update_time = actual_millis;
-    if (gnss_initialized && pGNSS) {
-      pGNSS->update();
+  (void)actual_millis;
+  uint32_t pulse_us;
+  uint16_t pulse_ns;
+  if (pps_capture_read(&pulse_us, &pulse_ns)) ppsClock.addPulse(pulse_us, pulse_ns);   // labeled by the next epoch
+  if (gnss_initialized && pGNSS) {
+    pGNSS->update();      // every pass: an epoch is published as soon as its last byte is in
+    gnssFusionUpdate();
   }
 }
 
+void gnssFusionUpdate(void) {
+  static uint32_t last_sequence = 0;
+  GnssSnapshot gnss;
+
+  if (pGNSS->getSequence() == last_sequence) return;          // one correction per PVT epoch
+  if (!pGNSS->getSnapshot(&gnss)) return;
+  last_sequence = gnss.sequence;
+  if (gnss.fixOK) ppsClock.addEpoch(gnss.iTOW, gnss.timestamp_us);
+  gnss_cache_task(gnss, millis(), ppsClock.getFrequencyError_ppb(), ppsClock.isLocked());   // warm start record, once per boot
+  if (!gnss.fixOK || gnss.fixType < 3) return;                // 3D fix (or with dead reckoning) only
+  altitudeFusion.updateGnss(gnss.altitudeMSL / 1000.0f, gnss.vAcc / 1000.0f, gnss.timestamp_us);
+}
+
 void gnssDisplayTask(uint32_t actual_millis) {
   static uint32_t last_print_time = 0;
+  static uint32_t last_sequence = 0;
   static char float_string_buffer[16];
+  GnssSnapshot gnss;
 
   if ((actual_millis - last_print_time) <500) return; // Print every 500ms
 
-  last_print_time = actual_millis;
  // if (gnss_initialized && pGNSS) {
-  if (pGNSS) {
-    printf("GPS %s , ",pGNSS->hasValidFix() ? "Valid Fix" : "   No Fix");
-    printf("Sats: %2d , ", pGNSS->getSIV());
-    printf("Latitude: %s , ", floatToString(float_string_buffer, sizeof(float_string_buffer), pGNSS->getLatitude()/10000000.0f,2,5));
-    printf("Longitude: %s , ", floatToString(float_string_buffer, sizeof(float_string_buffer), pGNSS->getLongitude()/10000000.0f,3,5));
-    printf("Altitude MSL: %s m", floatToString(float_string_buffer, sizeof(float_string_buffer), pGNSS->getAltitudeMSL()/1000.0f));
-    printf(", Speed: %s km/h", floatToString(float_string_buffer, sizeof(float_string_buffer), pGNSS->getGroundSpeed()*mmsTokmh));
+  if (pGNSS && !pGNSS->isConfigured()) {
+    last_print_time = actual_millis;
+    printf("GPS bring-up: %s at %lu baud\n\r", pGNSS->getStateName(), (unsigned long)pGNSS->getBaudRate());
+    return;
+  }
+  if (pGNSS && pGNSS->getSequence() != last_sequence && pGNSS->getSnapshot(&gnss)) {   // new epoch only
+    last_print_time = actual_millis;
+    last_sequence = gnss.sequence;
+    printf("GPS %s , ",gnss.fixOK ? "Valid Fix" : "   No Fix");
+    printf("Sats: %2d , ", gnss.numSV);
+    printf("Latitude: %s , ", floatToString(float_string_buffer, sizeof(float_string_buffer), gnss.latitude/10000000.0f,2,5));
+    printf("Longitude: %s , ", floatToString(float_string_buffer, sizeof(float_string_buffer), gnss.longitude/10000000.0f,3,5));
+    printf("Altitude MSL: %s m", floatToString(float_string_buffer, sizeof(float_string_buffer), gnss.altitudeMSL/1000.0f));
+    printf(", Speed: %s km/h", floatToString(float_string_buffer, sizeof(float_string_buffer), gnss.groundSpeed*mmsTokmh));
+    if (altitudeFusion.hasGnss())
+      printf(", Fused MSL: %s m", floatToString(float_string_buffer, sizeof(float_string_buffer), altitudeFusion.getAltitudeMSL()));
     printf("\n\r");
   }
 } 
@@ -224,32 +306,220 @@ void gnssDisplayTask(uint32_t actual_millis) {
       
 
 static void analog_measurement_task(uint32_t actual_millis) {
-  // analog measurement task running with ADC speed is fed by DMA ~22ms with oversampling 16, 
-  // ADC clock is 32MHz prescaler 128, sample time 160.5 cycles Total conversion time per channel = 160.5 + 12.5 =173 cycles
-  //
+  // analog measurement task runs with the AdcSampler result rate: 20ms with decimation 64 (3200 scans/s),
+  // ADC clock is 12MHz (PCLK2/6), sample time 71.5 cycles Total conversion time per channel = 71.5 + 12.5 = 84 cycles
   static uint32_t last_adc_millis = 0;
 
-  static float adcValue1 =0, adcValue2=0;
-  static const float VOLTAGE_DIV = 11.0f;
-  static const float SHUNT_RESISTOR_OHMS = 0.066f;
-  static const float ADC_GAIN = 1.01f;
-  static const float VOLTAGE_OFFSET = 0.00f;
-  static const float CURRENT_OFFSET = 0.015f;
-  static const float IIR_ALPHA = 0.239057f; // IIR filter alpha coefficient (for Sample_frequency/20 cutoff)
-  static const float IIR_BETA = 1.0f - IIR_ALPHA;
+  uint16_t adc_results[ADC_SAMPLER_RESULTS];
 
   if (isADCFinished == 0) return; // Previous ADC conversion not finished
   ADC_period=actual_millis - last_adc_millis;
   last_adc_millis = actual_millis;
   isADCFinished = 0;
-  adcValue1 = adcValue1*IIR_BETA + (float)ADC_buffer[0] * IIR_ALPHA; // Filter the first ADC channel (VBAT);
-  adcValue2 = adcValue2*IIR_BETA + (float)ADC_buffer[1] * IIR_ALPHA; // Filter the second ADC channel (Current);
-  bat_voltage = ((float)adcValue1 * 3.3f / 4095.0f * VOLTAGE_DIV * ADC_GAIN/(float)BAT_ADC_Oversampling_Ratio)-VOLTAGE_OFFSET;
-  bat_current = ((float)adcValue2 * 3.3f / 4095.0f * ADC_GAIN/(float)BAT_ADC_Oversampling_Ratio / SHUNT_RESISTOR_OHMS)-CURRENT_OFFSET; 
+  adcSampler.getResult(adc_results);
+  battery.update(adc_results); // integer IIR + Q16 scaling, no soft-float calls
+  bat_voltage_mV = battery.getVoltage_mV();
+  bat_current_mA = battery.getCurrent_mA();
+  batteryMonitor.update(bat_voltage_mV, bat_current_mA, timebase_micros()); // coulomb counting per ADC result
+}
+
+
+#if UART_ROLE_DEBUG != UART_ROLE_NONE
+static void debug_console_task(void) {
+  // collects debug UART input into lines, "\r" or "\n" terminates a command
+  static char line[DBG_CONSOLE_LINE_MAX];
+  static uint8_t line_len = 0;
+  uint8_t c;
+
+  while (serialDebug.available() && serialDebug.read(&c, 1) == 1) {
+    if (c == '\r' || c == '\n') {
+      if (line_len == 0) continue;
+      line[line_len] = 0;
+      line_len = 0;
+      debug_console_command(line);
+    } else if (line_len < DBG_CONSOLE_LINE_MAX - 1) {
+      line[line_len++] = (char)c;
+    }
+  }
+}
+
+static void debug_console_command(char *line) {
+  // cal v1 <mV> | cal v2 <mV> | cal i0 | cal save | cal defaults | cal show | i2c | bench | baro | baro zero | gnss | gnss forget | pps
+  bool ok = true;
+
+  if (strcmp(line, "baro") == 0 || strcmp(line, "baro zero") == 0) {
+    if (line[4] != '\0') groundCalibration.rezero();   // previous ground stays in use until the new one is ready
+    printf("baro: ground %s (%u samples, sem %ld mm), ground %ld mm, AGL %ld mm\r\n",
+           groundCalibration.isCalibrating() ? "calibrating" : "ready", groundCalibration.getSampleCount(),
+           groundCalibration.getSampleCount() < 2 ? -1L : (long)(groundCalibration.getStandardError() * 1000.0f),
+           (long)(groundCalibration.getGroundAltitude() * 1000.0f), (long)(filt_alt_AGL * 1000.0f));
+    return;
+  }
+
+  if (strcmp(line, "bench") == 0) {   // cycles (DWT): altitude table vs. powf, battery fixed vs. float, UBX parser
+    volatile int32_t pressure_q8 = 95000 << 8;
+    volatile int32_t altitude_mm = 0;
+    volatile float altitude_m = 0;
+    uint32_t start = DWT->CYCCNT;
+    for (uint8_t i = 0; i < 64; i++) altitude_mm = baro_altitude_mm(pressure_q8 + i * 1000);
+    uint32_t table_cycles = (DWT->CYCCNT - start) / 64;
+    start = DWT->CYCCNT;
+    for (uint8_t i = 0; i < 64; i++) altitude_m = 44330.0f * (1.0f - powf((pressure_q8 + i * 1000) / 256.0f / 101325.0f, 0.1903f));
+    uint32_t powf_cycles = (DWT->CYCCNT - start) / 64;
+    printf("altitude: table %lu cycles, powf %lu cycles (%ld mm / %ld mm)\r\n", (unsigned long)table_cycles,
+           (unsigned long)powf_cycles, (long)altitude_mm, (long)(altitude_m * 1000.0f));
+
+    // battery result: fixed point pipeline vs. the same work in float - four IIRs, supply
+    // correction from VREFINT, voltage, current and temperature
+    uint16_t bat_results[ADC_SAMPLER_RESULTS] = { 20000, 8000, (uint16_t)BAT_VREFINT_NOMINAL, 28000 };
+    BatteryMeasurement bat_bench;
+    start = DWT->CYCCNT;
+    for (uint8_t i = 0; i < 64; i++) {
+      bat_results[BAT_ADC_CHANNEL_VOLTAGE] = (uint16_t)(20000 + i * 16);
+      bat_results[BAT_ADC_CHANNEL_CURRENT] = (uint16_t)(8000 + i * 8);
+      bat_bench.update(bat_results);
+    }
+    uint32_t fixed_cycles = (DWT->CYCCNT - start) / 64;
+    const float alpha = 0.239057f;
+    float filt_v = 20000.0f, filt_i = 8000.0f, filt_vref = (float)BAT_VREFINT_NOMINAL, filt_t = 28000.0f;
+    volatile float bat_float_mV = 0, bat_float_mA = 0, bat_float_dC = 0;
+    start = DWT->CYCCNT;
+    for (uint8_t i = 0; i < 64; i++) {
+      filt_v += ((float)(20000 + i * 16) - filt_v) * alpha;
+      filt_i += ((float)(8000 + i * 8) - filt_i) * alpha;
+      filt_vref += ((float)bat_results[ADC_SAMPLER_VREFINT] - filt_vref) * alpha;
+      filt_t += ((float)bat_results[ADC_SAMPLER_TEMPERATURE] - filt_t) * alpha;
+      float vdda_mV = (float)BAT_VREFINT_MV * 4095.0f * 16.0f / filt_vref;
+      bat_float_mV = filt_v * vdda_mV / 4095.0f * 11.0f * 1.01f / 16.0f - BAT_VOLTAGE_OFFSET_MV;
+      bat_float_mA = filt_i * vdda_mV / 4095.0f * 1.01f / 16.0f / 0.066f - BAT_CURRENT_OFFSET_MA;
+      float vsense_mV = filt_t * (float)BAT_VREFINT_MV / filt_vref;
+      bat_float_dC = ((float)BAT_TEMP_V25_01MV / 10.0f - vsense_mV) * 100.0f / (float)BAT_TEMP_SLOPE_01MV + 250.0f;
+    }
+    uint32_t float_cycles = (DWT->CYCCNT - start) / 64;
+    printf("battery: fixed %lu cycles, float %lu cycles per result (all channels) (%ld / %ld mV, %ld / %ld mA, %d / %ld dC)\r\n",
+           (unsigned long)fixed_cycles, (unsigned long)float_cycles, (long)bat_bench.getVoltage_mV(), (long)bat_float_mV,
+           (long)bat_bench.getCurrent_mA(), (long)bat_float_mA, bat_bench.getTemperature_dC(), (long)bat_float_dC);
+
+    uint8_t frame[UBX_MAX_PAYLOAD + UBX_FRAME_OVERHEAD] = { 0 };   // zero NAV-PVT, payload in place
+    uint16_t length = UbxParser::buildFrame(frame, UBX_CLASS_NAV, UBX_NAV_PVT, frame + 6, UBX_MAX_PAYLOAD);
+    UbxParser parser;
+    uint8_t frames = 0;
+    start = DWT->CYCCNT;
+    for (uint8_t i = 0; i < 8; i++) {
+      for (uint16_t j = 0; j < length; j++) frames += parser.parse(frame[j]);
+    }
+    uint32_t parse_cycles = DWT->CYCCNT - start;
+    printf("ubx: %lu.%02lu cycles per byte (%u NAV-PVT frames)\r\n", (unsigned long)(parse_cycles / (8U * length)),
+           (unsigned long)(parse_cycles * 100U / (8U * length) % 100U), frames);
+    return;
+  }
+
+  if (strcmp(line, "gnss forget") == 0) {   // next boot is a cold start, CRSF bytes wait in the RX DMA meanwhile
+    printf("gnss: warm start record %s\r\n", gnss_cache_erase() == HAL_OK ? "erased" : "erase failed");
+    return;
+  }
+
+  if (strcmp(line, "gnss") == 0 && pGNSS) {   // link check since the last call: epoch rate, UART load, lost bytes
+    static uint32_t last_ms = 0, last_sequence = 0, last_frames = 0, last_sentences = 0, last_checksum_errors = 0;
+    uint32_t now = millis();
+    uint32_t elapsed = now - last_ms;
+    const SerialStats &uart = serialGnss.getStats();
+    const UbxParserStats &ubx = pGNSS->getParserStats();
+    const NmeaParserStats &nmea = pGNSS->getNmeaStats();
+    uint32_t epochs = pGNSS->getSequence() - last_sequence;
+    uint32_t load_permille = elapsed ? (uint32_t)((uint64_t)uart.rxBytes * 10 * 1000000 / ((uint64_t)pGNSS->getBaudRate() * elapsed)) : 0;
+    printf("gnss: %s at %lu baud, period %u ms, %lu epochs in %lu ms, load %lu.%lu %%\r\n", pGNSS->getStateName(),
+           (unsigned long)pGNSS->getBaudRate(), (unsigned)pGNSS->getMeasurementPeriod_ms(), (unsigned long)epochs, (unsigned long)elapsed,
+           (unsigned long)(load_permille / 10), (unsigned long)(load_permille % 10));
+    printf("gnss: %lu bytes, %lu frames, %lu sentences, %lu checksum errors, lost: %lu fifo overflow, %lu overrun, %lu framing, %lu noise\r\n",
+           (unsigned long)uart.rxBytes, (unsigned long)(ubx.frames - last_frames), (unsigned long)(nmea.sentences - last_sentences),
+           (unsigned long)(ubx.checksumErrors + nmea.checksumErrors - last_checksum_errors), (unsigned long)uart.rxOverflows,
+           (unsigned long)uart.overrunErrors, (unsigned long)uart.framingErrors, (unsigned long)uart.noiseErrors);
+    serialGnss.resetStats();
+    last_ms = now;
+    last_sequence = pGNSS->getSequence();
+    last_frames = ubx.frames;
+    last_sentences = nmea.sentences;
+    last_checksum_errors = ubx.checksumErrors + nmea.checksumErrors;
+    return;
+  }
+
+  if (strcmp(line, "pps") == 0) {   // disciplined clock state, GPS time of week now
+    const PpsClockStats &stats = ppsClock.getStats();
+    uint64_t tow_ns = 0;
+    bool valid = ppsClock.toGnssTime(timebase_micros(), &tow_ns);
+    printf("pps: %s, frequency %ld ppb, residual %ld ns, %lu pulses, %lu used, %lu unlabeled, %lu rejected, %lu restarts\r\n",
+           ppsClock.isLocked() ? "locked" : "not locked", (long)ppsClock.getFrequencyError_ppb(), (long)stats.lastResidual_ns,
+           (unsigned long)stats.pulses, (unsigned long)stats.used, (unsigned long)stats.unlabeled,
+           (unsigned long)stats.rejected, (unsigned long)stats.restarts);
+    if (valid) printf("pps: TOW %lu.%06lu s\r\n", (unsigned long)(tow_ns / 1000000000ULL), (unsigned long)(tow_ns / 1000ULL % 1000000ULL));
+    return;
+  }
+
+  if (strcmp(line, "i2c") == 0) {
+    I2cBusStats stats;
+    uint32_t now_us = timebase_micros();
+    i2cBus.getStats(&stats, now_us);
+    printf("i2c: %lu transactions, %lu errors (%lu timeouts), %lu queue full, max latency %lu us, load %u.%u %%\r\n",
+           (unsigned long)stats.transactions, (unsigned long)stats.errors, (unsigned long)stats.timeouts,
+           (unsigned long)stats.queueFull, (unsigned long)stats.maxLatency_us,
+           i2cBus.getUtilisation_permille(now_us) / 10, i2cBus.getUtilisation_permille(now_us) % 10);
+    i2cBus.resetStats(now_us);
+    return;
+  }
+  if (strncmp(line, "cal ", 4) != 0) { printf("unknown command: %s\r\n", line); return; }
+  line += 4;
+  if (strncmp(line, "v1 ", 3) == 0)           ok = adc_calibration_voltage_point(battery, 1, atol(line + 3));
+  else if (strncmp(line, "v2 ", 3) == 0)      ok = adc_calibration_voltage_point(battery, 2, atol(line + 3));
+  else if (strcmp(line, "i0") == 0)           ok = adc_calibration_zero_current(battery);
+  else if (strcmp(line, "save") == 0)         ok = adc_calibration_save(battery) == HAL_OK;
+  else if (strcmp(line, "defaults") == 0)     ok = adc_calibration_defaults(battery) == HAL_OK;
+  else if (strcmp(line, "show") != 0)         ok = false;
+
+  BatteryCalibration cal = battery.getCalibration();
+  printf("cal %s: U = %ld mV (scale %lu, offset %ld) I = %ld mA (scale %lu, offset %ld)\r\n", ok ? "ok" : "failed",
+         (long)battery.getVoltage_mV(), (unsigned long)cal.voltageScale_q16, (long)cal.voltageOffset_mV,
+         (long)battery.getCurrent_mA(), (unsigned long)cal.currentScale_q16, (long)cal.currentOffset_mA);
 }
+#endif
 
 
 #if UART_ROLE_CRSF != UART_ROLE_NONE
+#if ADC_CAL_CRSF_CHANNEL
+static void CRSF_calibration_task(uint32_t actual_millis) {
+  // zero current calibration when the switch channel is held high - on the ground, no load.
+  // Stored right away: the CRSF RX DMA keeps receiving through the flash write stall.
+  static uint32_t switch_low_millis = 0;
+  static bool done = false;
+
+  if (!crsf.isLinkUp() || crsf.getChannel(ADC_CAL_CRSF_CHANNEL) < 1800) {
+    switch_low_millis = actual_millis;
+    done = false;
+    return;
+  }
+  if (done || actual_millis - switch_low_millis < ADC_CAL_CRSF_HOLD_MS) return;
+  done = true;
+  if (adc_calibration_zero_current(battery)) adc_calibration_save(battery);
+}
+#endif
+
+#if GROUND_CAL_CRSF_CHANNEL
+static void CRSF_baro_zero_task(uint32_t actual_millis) {
+  // restart the ground level calibration when the switch channel is held high
+  static uint32_t switch_low_millis = 0;
+  static bool done = false;
+
+  if (!crsf.isLinkUp() || crsf.getChannel(GROUND_CAL_CRSF_CHANNEL) < 1800) {
+    switch_low_millis = actual_millis;
+    done = false;
+    return;
+  }
+  if (done || actual_millis - switch_low_millis < GROUND_CAL_CRSF_HOLD_MS) return;
+  done = true;
+  groundCalibration.rezero();
+}
+#endif
+
 static void CRSF_reception_watchdog_task(uint32_t actual_millis) {
 
   static  uint32_t last_watchdog_millis = 0;
@@ -262,19 +532,24 @@ static void CRSF_reception_watchdog_task(uint32_t actual_millis) {
 }
 
 
+static void CRSF_channels_received(void) {
+  isCRSFNewFrame = true;
+}
+
+
 static void telemetry_transmission_task(uint32_t actual_millis) {
   static uint32_t last_telemetry_millis = 0;
   static uint32_t telemetry_carousel = 0;
-  #define CAROUSEL_MAX 5
+  #define CAROUSEL_MAX 6
 
   if (actual_millis - last_telemetry_millis < 500/CAROUSEL_MAX) return;
-  if(bat_voltage<0.0f) bat_voltage=0.0f;
-  if(bat_current<0.0f) bat_current=0.0f;
-  if (telemetry_carousel ==0)   telemetrySendCellVoltage(1, bat_voltage);
-  if (telemetry_carousel ==1)   telemetrySendCellVoltage(2, bat_current);
-  if (telemetry_carousel ==2)   telemetrySendBaroAltitude(filt_alt_AGL);
-  if (telemetry_carousel ==3)   telemetrySendVario( filt_vario);
+  if (telemetry_carousel ==0)   telemetrySendBattery();
+  if (telemetry_carousel ==1)   telemetrySendCellVoltage(1, (uint16_t)batteryMonitor.getCellVoltage_mV());
+  // no baro frames while the ground level is calibrated - the receiver shows the sensor as not ready
+  if (telemetry_carousel ==2 && groundCalibration.isReady())   telemetrySendBaroAltitude(filt_alt_AGL);
+  if (telemetry_carousel ==3 && groundCalibration.isReady())   telemetrySendVario( filt_vario);
   if (telemetry_carousel ==4)   telemetrySendGps_int(pGNSS);  
+  if (telemetry_carousel ==5)   telemetrySendTemperature(0, battery.getTemperature_dC());
   last_telemetry_millis = actual_millis;
   telemetry_carousel++;
   telemetry_carousel %= CAROUSEL_MAX;
@@ -285,18 +560,45 @@ static void pwm_update_task(uint32_t actual_millis) {
 
   if (!isCRSFLinkUp && crsf.isLinkUp()) { // Link just came up - initialize PWM outputs
     isCRSFLinkUp = true;
-    for (uint8_t channel=0; channel<num_PWM_channels; channel++){ // start up all PWMs & outouts
-      HAL_TIM_PWM_Start(Timer_map[channel], PWM_Channelmap[channel]);
-    }
+    servo_timers_start(); // start up all PWMs & outputs - TIM1 last, it releases the phase shifted TIM2/TIM3
     return;
   } // set PWM values from CRSF to PWM channel
   static uint32_t servo_update_millis =0; 
   if (actual_millis-servo_update_millis <1) return; // Update every ms to minimize delay between CRSF reception and PWM output
   servo_update_millis = actual_millis;
-  for (uint8_t channel=0; channel<num_PWM_channels; channel++){
-    uint16_t PWM_value = crsf.getChannel(channel+1);
-    user_pwm_setvalue(channel, PWM_value);      
+  static uint16_t crsf_channels[MIXER_NUM_INPUTS], PWM_values[num_PWM_channels];
+  if (isCRSFNewFrame) { // mix once per received frame, the output filter interpolates in between
+    isCRSFNewFrame = false;
+    for (uint8_t channel=0; channel<MIXER_NUM_INPUTS; channel++){
+      crsf_channels[channel] = crsf.getChannel(channel+1);
+    }
+    mixer.process(crsf_channels, PWM_values, num_PWM_channels);
+    outputFilter.newFrame(PWM_values, num_PWM_channels, actual_millis);
   }
+  outputFilter.update(PWM_values, num_PWM_channels, actual_millis);
+  BoardServoOutputs::update(PWM_values); // compare registers grouped per timer, applied at the next PWM period
+}
+
+static void rc_output_task(uint32_t actual_millis) {
+  // SBUS / PPM re-emission of the raw CRSF channels - the frames are sent by DMA
+#if (UART_ROLE_SBUS != UART_ROLE_NONE) || PPM_OUTPUT_ENABLED
+  static uint32_t last_sbus_millis = 0;
+  static uint16_t rc_channels[SBUS_NUM_CHANNELS];
+
+  if (actual_millis - last_sbus_millis < SBUS_FRAME_INTERVAL_MS) return;
+  last_sbus_millis = actual_millis;
+  for (uint8_t channel=0; channel<SBUS_NUM_CHANNELS; channel++){
+    rc_channels[channel] = crsf.getChannel(channel+1);
+  }
+#if UART_ROLE_SBUS != UART_ROLE_NONE
+  sbusOutput.send(rc_channels, crsf.isLinkUp() ? 0 : (SBUS_FLAG_FRAME_LOST | SBUS_FLAG_FAILSAFE));
+#endif
+#if PPM_OUTPUT_ENABLED
+  if (crsf.isLinkUp()) ppmOutput.setChannels(rc_channels, PPM_NUM_CHANNELS); // hold last values on link loss
+#endif
+#else
+  (void)actual_millis;
+#endif
 }
 
 static void LED_and_debugSerial_task(uint32_t actual_millis) {
@@ -307,8 +609,7 @@ static void LED_and_debugSerial_task(uint32_t actual_millis) {
 
   if (actual_millis - last_debugTerm_millis < 500) return;
   last_debugTerm_millis = actual_millis;
-//  HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_14 );        //TARGET_MATEK
-  HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_2 ); // TARGET_BluePill
+  HAL_GPIO_TogglePin(BOARD_LED_GPIO_Port, BOARD_LED_Pin);
   
   printf("%7lu : ELRS_UP = %1d  / CH1 = %4d CH2 =  %4d, Restart = %4lu ADC_period = %4lu\r\n", (unsigned long)main_loop_cnt, crsf.isLinkUp(), ch1, ch2, (unsigned long)crsfSerialRestartRX_counter, (unsigned long)ADC_period);
 }
@@ -320,54 +621,37 @@ static void error_handling_task(void) {
 
 
 #if UART_ROLE_CRSF != UART_ROLE_NONE
-static void telemetrySendCellVoltage(uint8_t cellId, float voltage) {
+static void telemetrySendCellVoltage(uint8_t cellId, uint16_t voltage_mV) {
   static  uint8_t payload[3];
   
   if (cellId < 1 || cellId > CRSF_BATTERY_SENSOR_CELLS_MAX)     return;
   payload[0] = cellId;
-  uint16_t voltage_be = htobe16((uint16_t)(voltage * 1000.0)); //mV
+  uint16_t voltage_be = htobe16(voltage_mV);
   memcpy(&payload[1], &voltage_be, sizeof(voltage_be));
   crsf.queuePacket(CRSF_SYNC_BYTE, 0x0e, payload, sizeof(payload));
 }
-#endif
 
-static void user_pwm_setvalue(uint8_t pwm_channel, uint16_t PWM_pulse_length) {
-  static TIM_OC_InitTypeDef sConfigOC={0,0,0,0,0,0,0};
+static void telemetrySendBattery(void) {
+  static uint8_t payload[CRSF_BATTERY_SENSOR_PAYLOAD_SIZE];
 
-  sConfigOC.OCMode = TIM_OCMODE_PWM1;
-  uint32_t count = __HAL_TIM_GET_COUNTER(Timer_map[pwm_channel]);
-  if ((count<2250) || (count >19950)) return; // do not update PWM value in the middle of a PWM pulse
-  if (PWM_pulse_length <750) PWM_pulse_length =750;
-  if (PWM_pulse_length >2250) PWM_pulse_length =2250;
-  sConfigOC.Pulse = PWM_pulse_length;
-  HAL_TIM_PWM_ConfigChannel(Timer_map[pwm_channel], &sConfigOC, PWM_Channelmap[pwm_channel]);
+  // voltage, current, consumed mAh and remaining % in one standard frame
+  batteryMonitor.encodeCrsfFrame(payload);
+  crsf.queuePacket(CRSF_SYNC_BYTE, CRSF_FRAMETYPE_BATTERY_SENSOR_ID, payload, sizeof(payload));
 }
 
+static void telemetrySendTemperature(uint8_t sourceId, int16_t temperature_dC) {
+  static uint8_t payload[3];
 
-void setupBaroSensor(){   // SPL06-001 sensor version 
-  unsigned status;
-
-  BaroWire.begin();
+  payload[0] = sourceId;
+  uint16_t temperature_be = htobe16((uint16_t)temperature_dC); // 0.1C
+  memcpy(&payload[1], &temperature_be, sizeof(temperature_be));
+  crsf.queuePacket(CRSF_SYNC_BYTE, 0x0d, payload, sizeof(payload));
+}
+#endif
 
-  HAL_Delay(10);
-  
-  status = BaroSensor.begin(SPL06_ADDRESS_ALT,SPL06_PRODID);
-  //unsigned status = BaroSensor.begin(SPL06_ADDRESS_ALT);
-  if (!status) {
-    printf("Could not find a valid SPL06-001 sensor, check wiring or try a different address!\\n\r");
-    {
-      
-      printf("SensorID was:   0x%02X", BaroSensor.sensorID());
-    }
-    printf("        ID of 0xFF probably means a bad address, a BMP 180 or BMP 085");
-    while (1) HAL_Delay(10);
-  }
-  BaroSensor.setSampling(SPL06::MODE_BACKGND_BOTH,
-                          SPL06::SAMPLING_X16,
-                          SPL06::SAMPLING_X16,
-                          SPL06::RATE_X16,
-                          SPL06::RATE_X16);
-  printf("SPL06-001 ready");
+void setupBaroSensor(){   // SPL06-001 sensor version 
+  // bring-up runs in the background (baroSensor.update()), retried every second without a sensor
+  baroSensor.begin();
 }
 
 
@@ -440,33 +724,24 @@ void baroSerialDisplayTask(uint32_t millis_now){
 
 void baroProcessingTask(uint32_t millis_now){
 
-  static uint32_t last_millis=0,loop_counter=0;
-  if (millis_now - last_millis < 125) return;
-  last_millis = millis_now;
-  static uint32_t millis_start=0, millis_end=0;
-
+  static uint32_t last_sequence=0;
+  Spl06Sample sample;
 
-  millis_start=HAL_GetTick();
+  (void)millis_now;
+  if (baroSensor.getSequence() == last_sequence) return;   // one pass per sample (SPL06_READ_PERIOD_US)
+  baroSensor.getSample(&sample);
+  last_sequence = sample.sequence;
 
-  baroAltitude = BaroSensor.readPressureAltitudeMeter(1013.25);
-  baroTemperature = BaroSensor.readTemperature();
-  baroPressure = BaroSensor.readPressure();
+  baroPressure = sample.pressure_q8 / 256.0f;         // Pa
+  baroTemperature = sample.temperature_cC / 100.0f;
+  baroAltitude = baro_altitude_mm(sample.pressure_q8) / 1000.0f;   // table + interpolation instead of powf
 
-  if (loop_counter <1000) {    // initialisation --> average ground altitude
-    GND_altitude += baroAltitude;
-    GND_alt_count++;
-    filt_alt_ASL = baroAltitude;
-  } else {
-    filt_alt_ASL = (IIR_ALPHA * baroAltitude) + (IIR_BETA * filt_alt_ASL);
-  }
-  filt_alt_AGL =filt_alt_ASL - (GND_altitude / GND_alt_count);
-  vario=(filt_alt_AGL-previous_alt_ASL)*20;
-  filt_vario = (IIR_ALPHA * vario) + (IIR_BETA * filt_vario);
-  previous_alt_ASL = filt_alt_AGL;
-  loop_counter++;
-  millis_end=HAL_GetTick();
-  volatile uint32_t baro_processing_millis = millis_end - millis_start; // For debugging - check how long baro processing takes and if it causes delays in PWM output or CRSF reception
-  printf("Baro processing time: %lu ms\n\r", (unsigned long)baro_processing_millis);
+  groundCalibration.update(baroAltitude);   // running mean until converged (1..3s), then fixed
+  varioEstimator.update(baroAltitude, sample.timestamp_us);   // dt from the sample timestamps
+  filt_alt_ASL = varioEstimator.getAltitude();
+  filt_alt_AGL =filt_alt_ASL - groundCalibration.getGroundAltitude();
+  filt_vario = varioEstimator.getVario();
+  altitudeFusion.updateBaro(filt_alt_ASL, filt_vario, sample.timestamp_us);
 }
 
 
@@ -474,14 +749,17 @@ void baroProcessingTask(uint32_t millis_now){
 void telemetrySendGps_int(UbloxGNSSWrapper *pGNSS)
 {
   crsf_sensor_gps_t crsfGps = { 0 };
+  GnssSnapshot gnss;
 
+  if (!pGNSS || !pGNSS->getSnapshot(&gnss)) return;   // all fields from one epoch
   // Values are MSB first (BigEndian)
-  crsfGps.latitude = htobe32(pGNSS->getLatitude());
-  crsfGps.longitude = htobe32(pGNSS->getLongitude());
-  crsfGps.groundspeed = htobe16(pGNSS->getGroundSpeed()*mmsTokmh*10);
-  crsfGps.heading = htobe16(pGNSS->getHeading());   //TODO: heading seems to not display in EdgeTX correctly, some kind of overflow error
-  crsfGps.altitude = htobe16((uint16_t)(pGNSS->getAltitudeMSL()/1000 + 1000));
-  crsfGps.satellites = (uint8_t)(pGNSS->getSIV() & 0xFF);
+  crsfGps.latitude = htobe32(gnss.latitude);
+  crsfGps.longitude = htobe32(gnss.longitude);
+  crsfGps.groundspeed = htobe16(gnss.groundSpeed*mmsTokmh*10);
+  crsfGps.heading = htobe16((uint16_t)(gnss.heading / 1000));   // 1e-5 deg (UBX) -> 1e-2 deg (CRSF)
+  int32_t altitude_m = altitudeFusion.hasGnss() ? (int32_t)altitudeFusion.getAltitudeMSL() : gnss.altitudeMSL/1000;
+  crsfGps.altitude = htobe16((uint16_t)(altitude_m + 1000));
+  crsfGps.satellites = gnss.numSV;
   crsf.queuePacket(CRSF_SYNC_BYTE, CRSF_FRAMETYPE_GPS, &crsfGps, sizeof(crsfGps));
 }
 #endif
@@ -493,12 +771,10 @@ void gnss_module_init(void) {
     gnss_initialized = false;
     return;
 #endif
-    // This call blocks for ~1-2 seconds while waiting for module response
-    // Safe to call during initialization
+    // Non-blocking: the module is searched (baud rate autodetect) and configured by gnssUpdateTask
     gnss_initialized = gnss_init(UART_GNSS_HANDLE, &serialGnss);
     if (gnss_initialized) {
-      printf(">>> GNSS Module: INITIALIZED OK\n\r");
-      printf(">>> Waiting for satellite fix (may take 30-60 seconds on cold start)...\n\r");
+      printf(">>> GNSS Module: searching (baud rate autodetect)...\n\r");
       gnss_last_update_time = millis();
       gnss_last_print_time = millis();
     } 
@@ -506,12 +782,7 @@ void gnss_module_init(void) {
       printf( ">>> GNSS Module: INITIALIZATION FAILED\r\n");
       printf( ">>> Check:\r\n");
       printf( ">>>  1. UART3 is enabled in STM32CubeMX\r\n");
-      printf( ">>>  2. Baud rate matches module (38400 or 115200)\r\n");
-      printf( ">>>  3. GNSS module is powered and connected\r\n");
-      printf( ">>>  4. RX antenna is connected\r\n\r\n");
     }
-    delay(50); // Small delay to ensure UART messages are sent before any further processing
-    delay(1 );
 }
 
 bool gnss_init(UART_HandleTypeDef *huart3, mySerial *gnssSerial_param) {
@@ -533,12 +804,20 @@ bool gnss_init(UART_HandleTypeDef *huart3, mySerial *gnssSerial_param) {
         return false;
     }
     
-    if (!pGNSS->begin(100)) {  // block this amount of millis 100ms max during initialization
+    // Last good fix from flash: MGA-INI aiding after the bring-up, PPS clock error preset
+    GnssCacheData cache;
+    if (gnss_cache_load(&cache)) {
+        pGNSS->setWarmStart(cache.warmStart);
+        if (cache.clockValid) ppsClock.presetFrequency(cache.clockError_ppb);
+        printf(">>> GNSS warm start: position of %04u-%02u-%02u %02u:%02u UTC\n\r", cache.warmStart.year,
+               cache.warmStart.month, cache.warmStart.day, cache.warmStart.hour, cache.warmStart.minute);
+    }
+    
+    if (!pGNSS->begin()) {  // starts the bring-up state machine, returns immediately
         printf("GNSS init failed\n\r");
         return false;
     }
-    
-    printf("GNSS initialized successfully\n\r");
+
 //    lastUpdateTime = millis();
     return true;
 }
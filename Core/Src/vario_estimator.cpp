@@ -0,0 +1,53 @@
+/**
+ * @file vario_estimator.cpp
+ * @brief Kalman filter predict / correct for altitude and vertical speed
+ */
+
+#include "vario_estimator.h"
+
+VarioEstimator::VarioEstimator()
+    : m_altitude(0.0f), m_vario(0.0f), m_p00(0.0f), m_p01(0.0f), m_p11(0.0f), m_lastTimestamp_us(0), m_valid(false) {
+    setNoise(VARIO_ACCEL_NOISE, VARIO_BARO_NOISE);
+}
+
+void VarioEstimator::setNoise(float accel_noise, float baro_noise) {
+    m_q = accel_noise * accel_noise;
+    m_r = baro_noise * baro_noise;
+}
+
+void VarioEstimator::reset(float altitude_m) {
+    m_altitude = altitude_m;
+    m_vario = 0.0f;
+    m_p00 = m_r;
+    m_p01 = 0.0f;
+    m_p11 = 1.0f;                           // (1m/s)^2 - unknown climb rate at start
+    m_valid = true;
+}
+
+void VarioEstimator::update(float altitude_m, uint32_t timestamp_us) {
+    uint32_t dt_us = timestamp_us - m_lastTimestamp_us;
+    m_lastTimestamp_us = timestamp_us;
+    if (!m_valid || dt_us > VARIO_MAX_DT_US || dt_us == 0) {
+        reset(altitude_m);
+        return;
+    }
+    float dt = dt_us * 1e-6f;
+    float dt2 = dt * dt;
+
+    // predict
+    m_altitude += m_vario * dt;
+    m_p00 += dt * (2.0f * m_p01 + dt * m_p11) + m_q * dt2 * dt2 * 0.25f;
+    m_p01 += dt * m_p11 + m_q * dt2 * dt * 0.5f;
+    m_p11 += m_q * dt2;
+
+    // correct
+    float s = m_p00 + m_r;
+    float k0 = m_p00 / s;
+    float k1 = m_p01 / s;
+    float innovation = altitude_m - m_altitude;
+    m_altitude += k0 * innovation;
+    m_vario += k1 * innovation;
+    m_p11 -= k1 * m_p01;
+    m_p01 -= k1 * m_p00;                    // uses the predicted p00, updated last
+    m_p00 -= k0 * m_p00;
+}
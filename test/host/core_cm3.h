@@ -0,0 +1,55 @@
+/**
+ * @file core_cm3.h
+ * @brief Host build shim in front of the CMSIS Cortex-M3 core header
+ *
+ * stm32f103xb.h includes "core_cm3.h" from the include path; this file comes first,
+ * keeps cmsis_gcc.h (ARM inline assembly) out and provides the compiler macros and the
+ * few core intrinsics the firmware uses as host no-ops. Register definitions come from
+ * the real header; the peripheral instances are redirected by host_periph.h.
+ */
+
+#ifndef HOST_CORE_CM3_H
+#define HOST_CORE_CM3_H
+
+#include <stdint.h>
+
+#define __CMSIS_COMPILER_H                  // cmsis_compiler.h / cmsis_gcc.h are ARM only
+
+#define __ASM __asm
+#define __INLINE inline
+#define __STATIC_INLINE static inline
+#define __STATIC_FORCEINLINE static inline
+#define __NO_RETURN __attribute__((__noreturn__))
+#define __USED __attribute__((used))
+#define __WEAK __attribute__((weak))
+#define __PACKED __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x) __attribute__((aligned(x)))
+#define __RESTRICT __restrict
+#define __COMPILER_BARRIER() __asm volatile("" ::: "memory")
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint32_t host_primask;               // 1 while "interrupts" are disabled
+extern uint32_t host_ipsr;                  // exception number of the "running interrupt", 0 = thread mode
+
+static inline void __disable_irq(void) { host_primask = 1; }
+static inline void __enable_irq(void) { host_primask = 0; }
+static inline uint32_t __get_PRIMASK(void) { return host_primask; }
+static inline void __set_PRIMASK(uint32_t primask) { host_primask = primask; }
+static inline uint32_t __get_IPSR(void) { return host_ipsr; }
+static inline void __DMB(void) { __COMPILER_BARRIER(); }
+static inline void __DSB(void) { __COMPILER_BARRIER(); }
+static inline void __ISB(void) { __COMPILER_BARRIER(); }
+static inline void __NOP(void) {}
+
+#ifdef __cplusplus
+}
+#endif
+
+#include_next "core_cm3.h"
+
+#endif // HOST_CORE_CM3_H
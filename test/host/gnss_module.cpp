@@ -0,0 +1,274 @@
+/**
+ * @file gnss_module.cpp
+ * @brief Simulated u-blox / generic NMEA module
+ */
+
+#include "gnss_module.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CLASS_CFG 0x06
+#define CFG_PRT 0x00
+#define CFG_MSG 0x01
+#define CFG_RATE 0x08
+#define CLASS_MGA 0x13
+#define MGA_INI 0x40
+#define MGA_INI_POS_LLH 0x01
+#define NAV_PVT_LENGTH 92
+
+static uint16_t getU2(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU4(const uint8_t *p) {
+    return getU2(p) | ((uint32_t)getU2(p + 2) << 16);
+}
+
+static void putU4(uint8_t *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+// payload length of the periodic NAV messages (NAV-SAT / SVINFO with 20 satellites)
+static uint16_t navLength(uint8_t id) {
+    switch (id) {
+    case 0x02: return 28;                   // POSLLH
+    case 0x04: return 18;                   // DOP
+    case 0x06: return 52;                   // SOL
+    case 0x07: return NAV_PVT_LENGTH;
+    case 0x12: return 36;                   // VELNED
+    case 0x30:                              // SVINFO
+    case 0x35: return 8 + 12 * 20;          // SAT
+    default: return 20;
+    }
+}
+
+static void noFixOutput(GnssModule &module, uint32_t now_ms) {
+    (void)now_ms;
+    module.sendNmea("GPGGA,,,,,,0,00,99.99,,,,,,");
+}
+
+GnssModule::GnssModule() : hostBaud(0), time_ms(0) {
+    reset(true, 9600);
+}
+
+void GnssModule::reset(bool isUblox, uint32_t moduleBaud) {
+    ublox = isUblox;
+    baud = moduleBaud;
+    ubxOut = isUblox;
+    nmeaOut = true;
+    period_ms = 1000;
+    memset(navRates, 0, sizeof(navRates));
+    minPeriod_ms = 25;
+    ignoreId = 0;
+    ignoreCount = 0;
+    memset(&pvt, 0, sizeof(pvt));
+    coldTtff_ms = 0;
+    aidedTtff_ms = 0;
+    aided = false;
+    aidedAt_ms = 0;
+    powerUp_ms = time_ms;
+    nmeaOutput = noFixOutput;
+    baudSwitches = 0;
+    memset(log, 0, sizeof(log));
+    logCount = 0;
+    txBytes = 0;
+    rxOverflows = 0;
+    parser.reset();
+    rxHead = rxTail = 0;
+}
+
+void GnssModule::step(uint32_t now_ms) {
+    time_ms = now_ms;
+    if (now_ms % period_ms != 0) return;
+    pvt.iTOW = now_ms;
+    if (coldTtff_ms) {
+        bool fix = now_ms - powerUp_ms >= coldTtff_ms || (aided && now_ms - aidedAt_ms >= aidedTtff_ms);
+        pvt.fixType = fix ? 3 : 0;
+        pvt.flags = fix ? 0x01 : 0x00;
+    }
+    if (ubxOut) {
+        for (int id = 0; id < 256; id++) {
+            if (navRates[id] == 0 || (now_ms / period_ms) % navRates[id] != 0) continue;
+            if (id == UBX_NAV_PVT) {
+                sendNavPvt();
+            } else {
+                uint8_t payload[8 + 12 * 20] = {0};
+                send(UBX_CLASS_NAV, (uint8_t)id, payload, navLength((uint8_t)id));
+            }
+        }
+    }
+    if (nmeaOut && nmeaOutput) nmeaOutput(*this, now_ms);
+}
+
+void GnssModule::sendNmea(const char *body) {
+    char sentence[96];
+    uint8_t checksum = 0;
+    for (const char *c = body; *c; c++) checksum ^= (uint8_t)*c;
+    int length = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+    put((const uint8_t *)sentence, (uint16_t)length);
+}
+
+void GnssModule::sendRaw(const uint8_t *data, uint16_t length) {
+    put(data, length);
+}
+
+uint32_t GnssModule::countCommands(uint8_t msgClass, uint8_t msgId) const {
+    uint32_t count = 0;
+    uint32_t first = logCount > GNSS_MODULE_LOG_SIZE ? logCount - GNSS_MODULE_LOG_SIZE : 0;
+    for (uint32_t i = first; i < logCount; i++) {
+        const GnssModuleCommand &entry = log[i % GNSS_MODULE_LOG_SIZE];
+        if (entry.msgClass == msgClass && entry.msgId == msgId) count++;
+    }
+    return count;
+}
+
+const GnssModuleCommand *GnssModule::lastCommand(uint8_t msgClass, uint8_t msgId) const {
+    uint32_t first = logCount > GNSS_MODULE_LOG_SIZE ? logCount - GNSS_MODULE_LOG_SIZE : 0;
+    for (uint32_t i = logCount; i > first; i--) {
+        const GnssModuleCommand &entry = log[(i - 1) % GNSS_MODULE_LOG_SIZE];
+        if (entry.msgClass == msgClass && entry.msgId == msgId) return &entry;
+    }
+    return nullptr;
+}
+
+size_t GnssModule::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t GnssModule::write(const uint8_t *buffer, size_t size) {
+    if (hostBaud != baud || !ublox) return size;   // garbage at the wrong rate / not understood
+    for (size_t i = 0; i < size; i++) {
+        if (parser.parse(buffer[i])) command();
+    }
+    return size;
+}
+
+int GnssModule::read(void) {
+    if (rxTail == rxHead) return -1;
+    uint8_t c = rx[rxTail];
+    rxTail = (uint16_t)((rxTail + 1) % GNSS_MODULE_RX_SIZE);
+    return c;
+}
+
+int GnssModule::available(void) {
+    return (rxHead - rxTail + GNSS_MODULE_RX_SIZE) % GNSS_MODULE_RX_SIZE;
+}
+
+bool GnssModule::setBaudRate(uint32_t baudrate) {
+    hostBaud = baudrate;
+    if (baudSwitches < GNSS_MODULE_BAUD_LOG_SIZE) baudLog[baudSwitches] = baudrate;
+    baudSwitches++;
+    rxHead = rxTail = 0;
+    parser.reset();
+    return true;
+}
+
+void GnssModule::send(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t length) {
+    uint8_t frame[8 + 12 * 20 + UBX_FRAME_OVERHEAD];
+    uint16_t frameLength = UbxParser::buildFrame(frame, msgClass, msgId, payload, length);
+    put(frame, frameLength);
+}
+
+void GnssModule::put(const uint8_t *data, uint16_t length) {
+    txBytes += length;
+    if (hostBaud != baud) return;
+    for (uint16_t i = 0; i < length; i++) {
+        uint16_t next = (uint16_t)((rxHead + 1) % GNSS_MODULE_RX_SIZE);
+        if (next == rxTail) {
+            rxOverflows++;
+            return;
+        }
+        rx[rxHead] = data[i];
+        rxHead = next;
+    }
+}
+
+void GnssModule::command(void) {
+    GnssModuleCommand &entry = log[logCount++ % GNSS_MODULE_LOG_SIZE];
+    const uint8_t *payload = parser.getPayload();
+    uint16_t length = parser.getLength();
+    entry.msgClass = parser.getClass();
+    entry.msgId = parser.getId();
+    entry.length = length;
+    memset(entry.payload, 0, sizeof(entry.payload));
+    memcpy(entry.payload, payload, length < sizeof(entry.payload) ? length : sizeof(entry.payload));
+    entry.hostBaud = hostBaud;
+    entry.time_ms = time_ms;
+
+    if (parser.isMessage(UBX_CLASS_NAV, UBX_NAV_PVT) && length == 0) {
+        sendNavPvt();                       // poll
+        return;
+    }
+    if (parser.isMessage(CLASS_MGA, MGA_INI) && length > 0 && payload[0] == MGA_INI_POS_LLH && !aided) {
+        aided = true;                       // no ACK: the wrapper sends MGA without acknowledgement
+        aidedAt_ms = time_ms;
+        return;
+    }
+    if (parser.getClass() != CLASS_CFG) return;
+    if (parser.getId() == ignoreId && ignoreCount > 0) {
+        ignoreCount--;
+        return;
+    }
+    switch (parser.getId()) {
+    case CFG_PRT:
+        if (length < 20) return;
+        baud = getU4(payload + 8);
+        ubxOut = (getU2(payload + 14) & 0x01) != 0;
+        nmeaOut = (getU2(payload + 14) & 0x02) != 0;
+        acknowledge(true);                  // already at the new rate
+        break;
+    case CFG_RATE:
+        if (length < 6) return;
+        if (getU2(payload) < minPeriod_ms) {
+            acknowledge(false);
+            return;
+        }
+        period_ms = getU2(payload);
+        acknowledge(true);
+        break;
+    case CFG_MSG:
+        if (length < 3) return;
+        if (payload[0] == UBX_CLASS_NAV) navRates[payload[1]] = payload[2];
+        acknowledge(true);
+        break;
+    default:
+        break;
+    }
+}
+
+void GnssModule::acknowledge(bool ack) {
+    uint8_t payload[2] = {parser.getClass(), parser.getId()};
+    send(UBX_CLASS_ACK, ack ? 0x01 : 0x00, payload, 2);
+}
+
+void GnssModule::sendNavPvt(void) {
+    uint8_t payload[NAV_PVT_LENGTH] = {0};
+    putU4(payload + 0, pvt.iTOW);
+    payload[4] = (uint8_t)pvt.year;
+    payload[5] = (uint8_t)(pvt.year >> 8);
+    payload[6] = pvt.month;
+    payload[7] = pvt.day;
+    payload[8] = pvt.hour;
+    payload[9] = pvt.minute;
+    payload[10] = pvt.second;
+    payload[11] = pvt.valid;
+    payload[20] = pvt.fixType;
+    payload[21] = pvt.flags;
+    payload[23] = pvt.numSV;
+    putU4(payload + 24, (uint32_t)pvt.lon);
+    putU4(payload + 28, (uint32_t)pvt.lat);
+    putU4(payload + 32, (uint32_t)pvt.height);
+    putU4(payload + 36, (uint32_t)pvt.hMSL);
+    putU4(payload + 40, pvt.hAcc);
+    putU4(payload + 44, pvt.vAcc);
+    putU4(payload + 48, (uint32_t)pvt.velN);
+    putU4(payload + 52, (uint32_t)pvt.velE);
+    putU4(payload + 56, (uint32_t)pvt.velD);
+    putU4(payload + 60, (uint32_t)pvt.gSpeed);
+    putU4(payload + 64, (uint32_t)pvt.headMot);
+    putU4(payload + 68, pvt.sAcc);
+    putU4(payload + 72, pvt.headAcc);
+    payload[76] = (uint8_t)pvt.pDOP;
+    payload[77] = (uint8_t)(pvt.pDOP >> 8);
+    send(UBX_CLASS_NAV, UBX_NAV_PVT, payload, NAV_PVT_LENGTH);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file gnss_module.h
+ * @brief Simulated GNSS module behind the Stream of the UbloxGNSSWrapper
+ *
+ * The module has its own UART baud rate. Bytes only get through when the host side
+ * (setBaudRate()) runs at the same rate, otherwise they are lost in both directions like
+ * framing garbage on the real line. Received UBX commands are logged with the host baud
+ * rate they were sent at.
+ *
+ * u-blox mode: answers the NAV-PVT poll, CFG-PRT (baud rate and output protocols, the
+ * ACK goes out at the new rate), CFG-RATE and CFG-MSG with ACK-ACK. ignoreId /
+ * ignoreCount lose the next commands of one CFG id, a CFG-RATE below minPeriod_ms gets
+ * ACK-NAK. Power up (reset()) is the factory default: 9600 baud, UBX + NMEA out, 1Hz,
+ * all NAV messages off.
+ *
+ * Output per measurement period (step() every ms): the NAV messages with a CFG-MSG rate
+ * and, with NMEA output on, the nmeaOutput sentences (default: a GGA without fix).
+ * txBytes counts everything put on the line for the load check.
+ *
+ * Acquisition (off with coldTtff_ms = 0, pvt as preset by the test): no fix until
+ * coldTtff_ms after power up, or aidedTtff_ms after the first MGA-INI-POS_LLH if that is
+ * earlier. Both times are model parameters, not a receiver measurement.
+ */
+
+#ifndef GNSS_MODULE_H
+#define GNSS_MODULE_H
+
+#include "ublox_gnss_wrapper.h"
+
+#define GNSS_MODULE_RX_SIZE 4096
+#define GNSS_MODULE_LOG_SIZE 64
+#define GNSS_MODULE_BAUD_LOG_SIZE 16
+
+struct GnssModuleCommand {
+    uint8_t msgClass, msgId;
+    uint16_t length;
+    uint8_t payload[24];                    // first bytes
+    uint32_t hostBaud;                      // host UART rate when it was sent
+    uint32_t time_ms;
+};
+
+class GnssModule : public Stream {
+public:
+    GnssModule();
+
+    /**
+     * @brief Power up: factory configuration at the given baud rate, logs cleared
+     * @param ublox: false = generic NMEA module, UBX is ignored
+     */
+    void reset(bool ublox, uint32_t baud);
+
+    /**
+     * @brief Module time, call every ms - sends the output of each measurement epoch
+     */
+    void step(uint32_t now_ms);
+
+    /**
+     * @brief Send "$<body>*<checksum>\r\n"
+     */
+    void sendNmea(const char *body);
+
+    /**
+     * @brief Put raw bytes on the line (corrupt sentences, other protocols)
+     */
+    void sendRaw(const uint8_t *data, uint16_t length);
+
+    // log access
+    uint32_t countCommands(uint8_t msgClass, uint8_t msgId) const;
+    const GnssModuleCommand *lastCommand(uint8_t msgClass, uint8_t msgId) const;
+
+    // Stream
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    int read(void);
+    int available(void);
+    bool setBaudRate(uint32_t baudrate);
+
+    // device
+    bool ublox;
+    uint32_t baud;
+    bool ubxOut, nmeaOut;
+    uint16_t period_ms;
+    uint8_t navRates[256];                  // CFG-MSG rate per NAV message id
+    uint16_t minPeriod_ms;                  // shorter CFG-RATE periods are NAKed
+    uint8_t ignoreId;                       // CFG id of commands that get lost ...
+    uint8_t ignoreCount;                    // ... this many times
+    UbxNavPvt pvt;                          // NAV-PVT content, iTOW follows the module time
+    uint32_t coldTtff_ms;                   // acquisition model, 0 = off
+    uint32_t aidedTtff_ms;                  // fix this long after the position aiding
+    bool aided;                             // MGA-INI-POS_LLH received ...
+    uint32_t aidedAt_ms;                    // ... at this module time
+    void (*nmeaOutput)(GnssModule &module, uint32_t now_ms);
+
+    // host side and observations
+    uint32_t hostBaud;
+    uint32_t baudSwitches;                  // setBaudRate() calls ...
+    uint32_t baudLog[GNSS_MODULE_BAUD_LOG_SIZE];    // ... and their first rates
+    GnssModuleCommand log[GNSS_MODULE_LOG_SIZE];    // ring of the last commands
+    uint32_t logCount;                      // all commands received
+    uint32_t txBytes;                       // module -> host line, any baud rate
+    uint32_t rxOverflows;
+
+private:
+    void send(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t length);
+    void put(const uint8_t *data, uint16_t length);
+    void command(void);
+    void acknowledge(bool ack);
+    void sendNavPvt(void);
+
+    uint32_t time_ms;
+    uint32_t powerUp_ms;
+    UbxParser parser;
+    uint8_t rx[GNSS_MODULE_RX_SIZE];
+    uint16_t rxHead, rxTail;
+};
+
+#endif // GNSS_MODULE_H
@@ -0,0 +1,79 @@
+/**
+ * @file hal_host.c
+ * @brief Host register blocks and HAL stubs for the firmware sources under test
+ *
+ * Only what the tested sources reference. Init functions succeed without side effects,
+ * GPIO pins read back what was written (ODR). The GPIO functions are weak, i2c_mock.cpp
+ * replaces them with its bus model; the timer functions are weak for tests that need
+ * their register effects.
+ */
+
+#include "main.h"
+
+uint32_t host_primask = 0;
+uint32_t host_ipsr = 0;
+
+DWT_Type host_DWT;
+CoreDebug_Type host_CoreDebug;
+SysTick_Type host_SysTick;
+RCC_TypeDef host_RCC;
+FLASH_TypeDef host_FLASH;
+GPIO_TypeDef host_GPIOA, host_GPIOB, host_GPIOC;
+I2C_TypeDef host_I2C1, host_I2C2;
+EXTI_TypeDef host_EXTI;
+AFIO_TypeDef host_AFIO;
+TIM_TypeDef host_TIM4;
+
+uint32_t SystemCoreClock = 72000000;
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) {
+    huart->gState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart) {
+    huart->gState = HAL_UART_STATE_RESET;
+    return HAL_OK;
+}
+
+__WEAK HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim) {
+    (void)htim;
+    return HAL_OK;
+}
+
+__WEAK HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, const TIM_OC_InitTypeDef *sConfig, uint32_t Channel) {
+    (void)htim;
+    (void)sConfig;
+    (void)Channel;
+    return HAL_OK;
+}
+
+__WEAK HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    (void)htim;
+    (void)Channel;
+    return HAL_OK;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+    (void)IRQn;
+    (void)PreemptPriority;
+    (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    (void)IRQn;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+    (void)GPIOx;
+    (void)GPIO_Init;
+}
+
+__WEAK void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    if (PinState == GPIO_PIN_SET) GPIOx->ODR |= GPIO_Pin;
+    else GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+}
+
+__WEAK GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file host_periph.h
+ * @brief Peripheral register blocks in host RAM (force included into every host test source)
+ *
+ * The device header maps RCC, GPIO, I2C, ... to fixed addresses. After it has been
+ * included once (include guards) the instances are redefined to host variables, so
+ * firmware code that touches registers directly runs unchanged and the tests can
+ * preset or inspect the register contents. Defined in hal_host.c.
+ */
+
+#ifndef HOST_PERIPH_H
+#define HOST_PERIPH_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern DWT_Type host_DWT;
+extern CoreDebug_Type host_CoreDebug;
+extern SysTick_Type host_SysTick;
+extern RCC_TypeDef host_RCC;
+extern FLASH_TypeDef host_FLASH;
+extern GPIO_TypeDef host_GPIOA, host_GPIOB, host_GPIOC;
+extern I2C_TypeDef host_I2C1, host_I2C2;
+extern EXTI_TypeDef host_EXTI;
+extern AFIO_TypeDef host_AFIO;
+extern TIM_TypeDef host_TIM4;
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef DWT
+#define DWT (&host_DWT)
+#undef CoreDebug
+#define CoreDebug (&host_CoreDebug)
+#undef SysTick
+#define SysTick (&host_SysTick)
+#undef RCC
+#define RCC (&host_RCC)
+#undef FLASH
+#define FLASH (&host_FLASH)
+#undef GPIOA
+#define GPIOA (&host_GPIOA)
+#undef GPIOB
+#define GPIOB (&host_GPIOB)
+#undef GPIOC
+#define GPIOC (&host_GPIOC)
+#undef I2C1
+#define I2C1 (&host_I2C1)
+#undef I2C2
+#define I2C2 (&host_I2C2)
+#undef EXTI
+#define EXTI (&host_EXTI)
+#undef AFIO
+#define AFIO (&host_AFIO)
+#undef TIM4
+#define TIM4 (&host_TIM4)
+
+#endif // HOST_PERIPH_H
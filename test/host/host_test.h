@@ -0,0 +1,43 @@
+/**
+ * @file host_test.h
+ * @brief Minimal check macros for the host tests (no framework, exit code = result)
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <math.h>
+#include <stdio.h>
+
+static int host_test_failures = 0;
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);           \
+            host_test_failures++;                                                           \
+        }                                                                                   \
+    } while (0)
+
+#define CHECK_EQUAL(expected, actual)                                                       \
+    do {                                                                                    \
+        long long e_ = (long long)(expected), a_ = (long long)(actual);                    \
+        if (e_ != a_) {                                                                     \
+            printf("%s:%d: %s: expected %lld, got %lld\n", __FILE__, __LINE__, #actual, e_, a_); \
+            host_test_failures++;                                                           \
+        }                                                                                   \
+    } while (0)
+
+#define CHECK_NEAR(expected, actual, tolerance)                                             \
+    do {                                                                                    \
+        double e_ = (double)(expected), a_ = (double)(actual);                             \
+        if (!(fabs(e_ - a_) <= (double)(tolerance))) {                                      \
+            printf("%s:%d: %s: expected %g +- %g, got %g\n", __FILE__, __LINE__, #actual, e_, \
+                   (double)(tolerance), a_);                                                \
+            host_test_failures++;                                                           \
+        }                                                                                   \
+    } while (0)
+
+#define TEST_RESULT() (host_test_failures == 0 ? 0 : 1)
+
+#endif // HOST_TEST_H
@@ -0,0 +1,144 @@
+/**
+ * @file i2c_mock.cpp
+ * @brief HAL I2C master and bus GPIO mock
+ */
+
+#include "i2c_mock.h"
+#include "i2c_bus.h"
+#include <string.h>
+
+I2cMock i2c_mock;
+
+void i2c_mock_reset(I2C_HandleTypeDef *hi2c, uint8_t slaveAddress) {
+    memset(&i2c_mock, 0, sizeof(i2c_mock));
+    i2c_mock.slaveAddress = slaveAddress;
+    i2c_mock.stopDelay_us = 5;
+    memset(hi2c, 0, sizeof(*hi2c));
+    memset(&host_I2C1, 0, sizeof(host_I2C1));
+    memset(&host_GPIOB, 0, sizeof(host_GPIOB));
+    host_GPIOB.ODR = I2C_BUS_SCL_Pin | I2C_BUS_SDA_Pin;     // idle bus: both lines high
+    hi2c->Instance = I2C1;
+    hi2c->State = HAL_I2C_STATE_READY;
+}
+
+static HAL_StatusTypeDef start(I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *data, uint16_t length,
+                               uint32_t options, bool read) {
+    bool first = (options == I2C_FIRST_FRAME || options == I2C_FIRST_AND_LAST_FRAME);
+
+    if (host_primask) i2c_mock.maskedStarts++;
+    if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+    if (first && (hi2c->Instance->SR2 & I2C_SR2_BUSY)) {
+        i2c_mock.busyStarts++;
+        hi2c->ErrorCode |= HAL_I2C_ERROR_TIMEOUT;
+        return HAL_BUSY;
+    }
+    if (i2c_mock.refuseStarts > 0) {
+        i2c_mock.refuseStarts--;
+        return HAL_BUSY;
+    }
+
+    hi2c->Instance->SR2 |= I2C_SR2_BUSY;
+    hi2c->Instance->CR2 |= I2C_IT_EVT | I2C_IT_BUF | I2C_IT_ERR;
+    hi2c->State = read ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+    hi2c->XferOptions = options;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    i2c_mock.stopPending = false;
+    I2cMockTransfer &transfer = i2c_mock.log[i2c_mock.logCount++ % I2C_MOCK_LOG_SIZE];
+    transfer.address = (uint8_t)(address >> 1);
+    transfer.read = read;
+    transfer.options = options;
+    transfer.length = length;
+    transfer.data = data;
+    i2c_mock.running = true;
+    return HAL_OK;
+}
+
+extern "C" HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                                            uint16_t Size, uint32_t XferOptions) {
+    return start(hi2c, DevAddress, pData, Size, XferOptions, false);
+}
+
+extern "C" HAL_StatusTypeDef HAL_I2C_Master_Seq_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                                           uint16_t Size, uint32_t XferOptions) {
+    return start(hi2c, DevAddress, pData, Size, XferOptions, true);
+}
+
+extern "C" HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) {
+    i2c_mock.inits++;
+    i2c_mock.running = false;
+    hi2c->State = HAL_I2C_STATE_READY;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    if (i2c_mock.sdaHeldClocks == 0) hi2c->Instance->SR2 &= ~I2C_SR2_BUSY;
+    return HAL_OK;
+}
+
+extern "C" HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c) {
+    i2c_mock.deinits++;
+    i2c_mock.running = false;
+    hi2c->State = HAL_I2C_STATE_RESET;
+    return HAL_OK;
+}
+
+bool i2c_mock_complete(I2C_HandleTypeDef *hi2c, uint32_t now_us) {
+    if (!i2c_mock.running) return false;
+    i2c_mock.running = false;
+    if ((hi2c->Instance->CR2 & I2C_IT_EVT) == 0) return false;
+
+    const I2cMockTransfer &transfer = i2c_mock.log[(i2c_mock.logCount - 1) % I2C_MOCK_LOG_SIZE];
+    uint32_t options = transfer.options;
+    bool stop = (options == I2C_FIRST_AND_LAST_FRAME || options == I2C_LAST_FRAME || options == I2C_OTHER_AND_LAST_FRAME);
+
+    hi2c->State = HAL_I2C_STATE_READY;
+    uint32_t ipsr = host_ipsr;
+    host_ipsr = 16 + I2C1_EV_IRQn;          // the callbacks run in the I2C interrupt
+    if (transfer.address != i2c_mock.slaveAddress || i2c_mock.nackNext) {
+        i2c_mock.nackNext = false;
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;     // the HAL sends a STOP after a NACK
+        i2c_mock.stopPending = true;
+        i2c_mock.busyUntil_us = now_us + i2c_mock.stopDelay_us;
+        HAL_I2C_ErrorCallback(hi2c);
+        host_ipsr = ipsr;
+        return true;
+    }
+
+    for (uint16_t index = 0; index < transfer.length; index++) {
+        if (transfer.read) transfer.data[index] = i2c_mock.registers[i2c_mock.pointer++];
+        else if (index == 0) i2c_mock.pointer = transfer.data[0];
+        else i2c_mock.registers[i2c_mock.pointer++] = transfer.data[index];
+    }
+    if (stop) {
+        i2c_mock.stopPending = true;
+        i2c_mock.busyUntil_us = now_us + i2c_mock.stopDelay_us;
+    }
+    if (transfer.read) HAL_I2C_MasterRxCpltCallback(hi2c);
+    else HAL_I2C_MasterTxCpltCallback(hi2c);
+    host_ipsr = ipsr;
+    return true;
+}
+
+void i2c_mock_tick(uint32_t now_us) {
+    if (i2c_mock.stopPending && (int32_t)(now_us - i2c_mock.busyUntil_us) >= 0) {
+        host_I2C1.SR2 &= ~I2C_SR2_BUSY;
+        i2c_mock.stopPending = false;
+    }
+}
+
+// bus recovery by GPIO: rising SCL edges clock the slave, SDA low -> high with SCL high is a STOP
+extern "C" void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    bool sclHigh = (GPIOx->ODR & I2C_BUS_SCL_Pin) != 0;
+    bool sdaHigh = (GPIOx->ODR & I2C_BUS_SDA_Pin) != 0;
+
+    if (PinState == GPIO_PIN_SET) GPIOx->ODR |= GPIO_Pin;
+    else GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    if (GPIOx != I2C_BUS_SCL_GPIO_Port || PinState != GPIO_PIN_SET) return;
+    if (GPIO_Pin == I2C_BUS_SCL_Pin && !sclHigh) {
+        i2c_mock.sclClocks++;
+        if (i2c_mock.sdaHeldClocks > 0) i2c_mock.sdaHeldClocks--;
+    }
+    if (GPIO_Pin == I2C_BUS_SDA_Pin && !sdaHigh && sclHigh && i2c_mock.sdaHeldClocks == 0) i2c_mock.stops++;
+}
+
+extern "C" GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    if (GPIOx == I2C_BUS_SDA_GPIO_Port && GPIO_Pin == I2C_BUS_SDA_Pin && i2c_mock.sdaHeldClocks > 0) return GPIO_PIN_RESET;
+    return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
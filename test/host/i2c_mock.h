@@ -0,0 +1,74 @@
+/**
+ * @file i2c_mock.h
+ * @brief HAL I2C master mock with one register file slave on the I2cBus pins
+ *
+ * Implements the HAL_I2C functions the firmware calls. A started transfer stays running
+ * until i2c_mock_complete(), which moves the data between the buffer and the slave
+ * (register pointer + auto increment like most sensors) and calls the HAL completion or
+ * error callback in interrupt context (__get_IPSR() != 0) - the test defines those like
+ * platform_abstraction.cpp does.
+ *
+ * Bus model: a START sets BUSY in SR2, the STOP clears it stopDelay_us later
+ * (i2c_mock_tick() from the test timebase). A first frame started with BUSY set counts
+ * as busyStart (the real HAL polls there for 25ms), a start with interrupts disabled as
+ * maskedStart. A slave can hold SDA low for a number of SCL clocks; the GPIO functions
+ * count the recovery clocks and STOP conditions.
+ */
+
+#ifndef I2C_MOCK_H
+#define I2C_MOCK_H
+
+#include "main.h"
+#include <stdint.h>
+
+#define I2C_MOCK_LOG_SIZE 32
+
+struct I2cMockTransfer {
+    uint8_t address;                        // 7 bit
+    bool read;
+    uint32_t options;                       // I2C_FIRST_FRAME, ...
+    uint16_t length;
+    uint8_t *data;
+};
+
+struct I2cMock {
+    uint8_t slaveAddress;
+    uint8_t registers[256];
+    uint8_t pointer;
+    bool nackNext;                          // next completion ends with AF
+    uint8_t refuseStarts;                   // next starts return HAL_BUSY (handle in use)
+    uint32_t stopDelay_us;
+    uint8_t sdaHeldClocks;                  // SCL clocks until the slave releases SDA
+
+    bool running;
+    I2cMockTransfer log[I2C_MOCK_LOG_SIZE]; // accepted starts, ring of the last I2C_MOCK_LOG_SIZE
+    uint32_t logCount;                      // all accepted starts
+    uint32_t busyStarts;
+    uint32_t maskedStarts;
+    uint32_t inits, deinits;
+    uint32_t sclClocks;
+    uint32_t stops;
+
+    bool stopPending;
+    uint32_t busyUntil_us;
+};
+
+extern I2cMock i2c_mock;
+
+/**
+ * @brief Reset mock, slave and the handle (Instance = I2C1, READY, bus idle)
+ */
+void i2c_mock_reset(I2C_HandleTypeDef *hi2c, uint8_t slaveAddress);
+
+/**
+ * @brief End the running transfer like the I2C interrupt does
+ * @return false if nothing was running or the I2C interrupts were disabled
+ */
+bool i2c_mock_complete(I2C_HandleTypeDef *hi2c, uint32_t now_us);
+
+/**
+ * @brief Release BUSY once the STOP is on the bus - call from the test timebase
+ */
+void i2c_mock_tick(uint32_t now_us);
+
+#endif // I2C_MOCK_H
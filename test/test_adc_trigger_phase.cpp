@@ -0,0 +1,303 @@
+/**
+ * @file test_adc_trigger_phase.cpp
+ * @brief Sample timing and noise model for the TIM4 CC4 triggered ADC bursts
+ *
+ * Synthetic load: 3 servo groups (TIM1 / TIM2 / TIM3 at their SERVO_PHASE_TIMx_US),
+ * 4 outputs each, pulse widths moving like stick inputs. Every pulse edge rings on the
+ * current sense line (damped 200kHz, 15us decay), the servo drive pulls the reading up
+ * while a pulse is high, plus white noise. The ADC sample is the mean over the 71.5 cycle
+ * sampling window of each rank.
+ *
+ * Compared per 20ms frame (the AdcSampler result at the default 64x decimation):
+ * - free running: continuous scans, sample instants drift against the servo frame
+ * - triggered: ADC_TRIGGER_BURST_SCANS scans every ADC_TRIGGER_PERIOD_US at a phase
+ * The phase sweep shows the quiet window behind the longest servo pulse; the configured
+ * ADC_TRIGGER_PHASE_US has to be inside it.
+ *
+ * The burst start is not taken from ADC_TRIGGER_PHASE_US: adc_trigger_init() runs against
+ * the host TIM4 / AFIO registers (the HAL functions below write what the F1 HAL writes)
+ * and the trigger instant is the rising edge of OC4REF for the configured output compare
+ * mode and CCR4 - no trigger at all without CC4E.
+ */
+
+#include "host_test.h"
+#include "adc_sampler.h"
+#include "adc_trigger.h"
+#include "board_descriptor.h"
+#include "servo_timer_sync.h"
+#include "ppm_output.h"
+
+#define GROUPS 3
+#define OUTPUTS_PER_GROUP 4
+#define FRAMES 200
+#define BASE_COUNTS 1000.0                  // current sense DC level
+#define DRIVE_COUNTS 25.0                   // extra reading per servo pulse that is high
+#define RING_COUNTS 300.0                   // edge transient amplitude
+#define RING_TAU_US 15.0
+#define RING_HZ 200000.0
+#define NOISE_COUNTS 4.0                    // white noise, 1 sigma
+#define SAMPLE_WINDOW_US 6                  // 71.5 cycles at 12MHz
+#define SETTLED_US 100                      // transient below 0.1 count after 7.5 tau
+
+// the register effects of the HAL functions used by adc_trigger_init / adc_trigger_start
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc, ADC_ChannelConfTypeDef *sConfig) {
+    (void)hadc;
+    return (sConfig->Rank >= 1 && sConfig->Rank <= 16) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_InjectedConfigChannel(ADC_HandleTypeDef *hadc, ADC_InjectionConfTypeDef *sConfigInjected) {
+    (void)hadc;
+    (void)sConfigInjected;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim) {
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    if (htim->Init.AutoReloadPreload == TIM_AUTORELOAD_PRELOAD_ENABLE) htim->Instance->CR1 |= TIM_CR1_ARPE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_SlaveConfigSynchro(TIM_HandleTypeDef *htim, const TIM_SlaveConfigTypeDef *sSlaveConfig) {
+    MODIFY_REG(htim->Instance->SMCR, TIM_SMCR_SMS | TIM_SMCR_TS, sSlaveConfig->SlaveMode | sSlaveConfig->InputTrigger);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, const TIM_OC_InitTypeDef *sConfig, uint32_t Channel) {
+    if (Channel != TIM_CHANNEL_4) return HAL_ERROR;
+    MODIFY_REG(htim->Instance->CCMR2, TIM_CCMR2_OC4M | TIM_CCMR2_CC4S, sConfig->OCMode << 8);
+    htim->Instance->CCMR2 |= TIM_CCMR2_OC4PE;
+    MODIFY_REG(htim->Instance->CCER, TIM_CCER_CC4P, sConfig->OCPolarity << 12);
+    htim->Instance->CCR4 = sConfig->Pulse;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    if (Channel != TIM_CHANNEL_4) return HAL_ERROR;
+    htim->Instance->CCER |= TIM_CCER_CC4E;
+    if ((htim->Instance->SMCR & TIM_SMCR_SMS) != TIM_SLAVEMODE_TRIGGER) htim->Instance->CR1 |= TIM_CR1_CEN;
+    return HAL_OK;
+}
+
+// OC4REF of an up counting timer at counter value cnt (RM0008 output compare modes)
+static bool oc4ref(uint32_t mode, uint32_t ccr, uint32_t cnt) {
+    switch (mode) {
+    case TIM_OCMODE_PWM1: return cnt < ccr;
+    case TIM_OCMODE_PWM2: return cnt >= ccr;
+    case TIM_OCMODE_FORCED_ACTIVE: return true;
+    default: return false;              // frozen / match modes: no periodic edge from the reset state
+    }
+}
+
+// counter value of the OC4REF rising edge, -1 if the ADC never sees a T4_CC4 trigger
+static int32_t triggerPhase_us(void) {
+    if (!(TIM4->CCER & TIM_CCER_CC4E)) return -1;       // F1: the ADC trigger needs the enabled channel
+    uint32_t mode = (TIM4->CCMR2 & TIM_CCMR2_OC4M) >> 8;
+    uint32_t period = TIM4->ARR + 1;
+    for (uint32_t cnt = 0; cnt < period; cnt++) {
+        bool previous = oc4ref(mode, TIM4->CCR4, (cnt + period - 1) % period);
+        if (!previous && oc4ref(mode, TIM4->CCR4, cnt)) return (int32_t)(cnt * (TIM4->PSC + 1) / 72);
+    }
+    return -1;
+}
+
+static int32_t configuredPhase_us = -1;
+
+static void testTimerSetup(void) {
+    ADC_TypeDef adcRegisters = ADC_TypeDef();
+    ADC_HandleTypeDef hadc = ADC_HandleTypeDef();
+    hadc.Instance = &adcRegisters;
+
+    CHECK_EQUAL(HAL_OK, adc_trigger_init(&hadc));
+    adc_trigger_start();
+#if PPM_OUTPUT_ENABLED
+    CHECK(adcRegisters.CR2 & ADC_CR2_CONT);
+#else
+    CHECK_EQUAL(ADC_TRIGGER_PERIOD_US - 1, TIM4->ARR);
+    CHECK_EQUAL(TIM_SLAVEMODE_TRIGGER | TIM_TS_ITR0, TIM4->SMCR);
+    CHECK(!(TIM4->CR1 & TIM_CR1_CEN));                  // started by the TIM1 TRGO
+    CHECK(AFIO->MAPR & AFIO_MAPR_TIM4_REMAP);           // CH4 off PB9 (I2C1 SDA)
+
+    configuredPhase_us = triggerPhase_us();
+    printf("OC4REF rising edge at %ldus\n", (long)configuredPhase_us);
+    CHECK_EQUAL(ADC_TRIGGER_PHASE_US, configuredPhase_us);
+
+    // what the former setup did: PWM1 rises at the counter wrap, CC4E off never triggers
+    uint32_t ccmr2 = TIM4->CCMR2, ccer = TIM4->CCER;
+    MODIFY_REG(TIM4->CCMR2, TIM_CCMR2_OC4M, TIM_OCMODE_PWM1 << 8);
+    CHECK_EQUAL(0, triggerPhase_us());
+    TIM4->CCER &= ~TIM_CCER_CC4E;
+    CHECK_EQUAL(-1, triggerPhase_us());
+    TIM4->CCMR2 = ccmr2;
+    TIM4->CCER = ccer;
+#endif
+}
+
+static const uint32_t groupPhase_us[GROUPS] = {0, SERVO_PHASE_TIM2_US, SERVO_PHASE_TIM3_US};
+
+struct Frame {
+    uint16_t width_us[GROUPS][OUTPUTS_PER_GROUP];
+};
+
+static uint32_t randomState = 12345;
+
+static double uniform(void) {
+    randomState = randomState * 1664525U + 1013904223U;
+    return (randomState >> 8) / 16777216.0;
+}
+
+static double gaussian(void) {
+    double sum = 0;
+    for (int i = 0; i < 12; i++) sum += uniform();
+    return sum - 6.0;
+}
+
+static Frame frames[FRAMES];
+
+static void makeFrames(void) {
+    for (int frame = 0; frame < FRAMES; frame++) {
+        for (int group = 0; group < GROUPS; group++) {
+            for (int output = 0; output < OUTPUTS_PER_GROUP; output++) {
+                // slow stick movement over the full pulse range, one output pinned at the maximum
+                double phase = 2.0 * M_PI * (frame / 97.0 + (group * OUTPUTS_PER_GROUP + output) / 12.0);
+                double width = 1500.0 + 750.0 * sin(phase);
+                if (group == 0 && output == 0) width = BOARD_SERVO_PULSE_MAX_US;
+                frames[frame].width_us[group][output] = (uint16_t)width;
+            }
+        }
+    }
+}
+
+// noise free current sense reading at time t (us from the start of the first frame)
+static double signal(double t) {
+    int frame = (int)(t / SERVO_TIMER_PERIOD_US);
+    double value = BASE_COUNTS;
+
+    for (int f = frame - 1; f <= frame; f++) {
+        if (f < 0 || f >= FRAMES) continue;
+        double frameStart = (double)f * SERVO_TIMER_PERIOD_US;
+        for (int group = 0; group < GROUPS; group++) {
+            for (int output = 0; output < OUTPUTS_PER_GROUP; output++) {
+                double rise = frameStart + groupPhase_us[group];
+                double fall = rise + frames[f].width_us[group][output];
+                if (t >= rise && t < fall) value += DRIVE_COUNTS;
+                const double edges[2] = {rise, fall};
+                for (int e = 0; e < 2; e++) {
+                    double dt = t - edges[e];
+                    if (dt < 0 || dt > SETTLED_US) continue;
+                    value += RING_COUNTS * exp(-dt / RING_TAU_US) * cos(2.0 * M_PI * RING_HZ * dt * 1e-6);
+                }
+            }
+        }
+    }
+    return value;
+}
+
+static double sample(double start_us) {
+    double sum = 0;
+    for (int step = 0; step < 4 * SAMPLE_WINDOW_US; step++) sum += signal(start_us + step * 0.25);
+    return sum / (4 * SAMPLE_WINDOW_US) + NOISE_COUNTS * gaussian();
+}
+
+struct Result {
+    double rms;                             // frame result - BASE_COUNTS
+    double spread;                          // max - min of the frame results
+};
+
+// current is rank 2 of each scan
+static Result runTriggered(uint32_t phase_us) {
+    Result result = {0, 0};
+    double minimum = 1e9, maximum = -1e9;
+
+    for (int frame = 1; frame < FRAMES; frame++) {
+        double sum = 0;
+        int count = 0;
+        for (uint32_t trigger = 0; trigger < SERVO_TIMER_PERIOD_US / ADC_TRIGGER_PERIOD_US; trigger++) {
+            double burst = (double)frame * SERVO_TIMER_PERIOD_US + trigger * ADC_TRIGGER_PERIOD_US + phase_us;
+            for (int scan = 0; scan < ADC_TRIGGER_BURST_SCANS; scan++) {
+                sum += sample(burst + scan * ADC_TRIGGER_SCAN_US + ADC_TRIGGER_SCAN_US / 2);
+                count++;
+            }
+        }
+        double error = sum / count - BASE_COUNTS;
+        result.rms += error * error;
+        if (error < minimum) minimum = error;
+        if (error > maximum) maximum = error;
+    }
+    result.rms = sqrt(result.rms / (FRAMES - 1));
+    result.spread = maximum - minimum;
+    return result;
+}
+
+// continuous scans at the same sample time, 64 scans averaged per result like the sampler
+static Result runFreeRunning(void) {
+    Result result = {0, 0};
+    double minimum = 1e9, maximum = -1e9;
+    double t = SERVO_TIMER_PERIOD_US + 3.7;     // not aligned to anything
+    int results = 0;
+
+    while (t < (double)FRAMES * SERVO_TIMER_PERIOD_US - 2000) {
+        double sum = 0;
+        for (int scan = 0; scan < ADC_SAMPLER_DECIMATION; scan++) {
+            sum += sample(t + ADC_TRIGGER_SCAN_US / 2);
+            t += ADC_TRIGGER_SCAN_US;
+        }
+        double error = sum / ADC_SAMPLER_DECIMATION - BASE_COUNTS;
+        result.rms += error * error;
+        if (error < minimum) minimum = error;
+        if (error > maximum) maximum = error;
+        results++;
+        t += SERVO_TIMER_PERIOD_US * 0.37;  // results are picked up at random times by the main loop
+    }
+    result.rms = sqrt(result.rms / results);
+    result.spread = maximum - minimum;
+    return result;
+}
+
+// the sample instants of a triggered burst relative to the nearest servo pulse edge
+static void testDeterministicTiming(void) {
+    uint32_t burstEnd_us = configuredPhase_us + ADC_TRIGGER_BURST_SCANS * ADC_TRIGGER_SCAN_US + ADC_TRIGGER_INJECTED_US;
+    uint32_t lastEdge_us = BOARD_SERVO_PULSE_MAX_US;
+
+    printf("burst %ld..%uus, last pulse edge %uus, next edge %uus\n", (long)configuredPhase_us, burstEnd_us,
+           lastEdge_us, ADC_TRIGGER_PERIOD_US);
+    CHECK(configuredPhase_us >= (int32_t)lastEdge_us + 50);   // 50us = 3.3 tau of ringing, < 1% left
+    CHECK(burstEnd_us <= ADC_TRIGGER_PERIOD_US);
+    CHECK(SERVO_TIMER_PERIOD_US % ADC_TRIGGER_PERIOD_US == 0);    // same instants in every frame: no jitter
+}
+
+static void testPhaseSweep(void) {
+    double best = 1e9, configured = 0, worst = 0;
+
+    makeFrames();
+    printf("phase_us  rms  spread (counts, frame results)\n");
+    for (uint32_t phase = 0; phase + ADC_TRIGGER_BURST_SCANS * ADC_TRIGGER_SCAN_US + ADC_TRIGGER_INJECTED_US <= ADC_TRIGGER_PERIOD_US;
+         phase += 100) {
+        randomState = 12345;
+        Result result = runTriggered(phase);
+        printf("%8u %5.2f %6.2f\n", phase, result.rms, result.spread);
+        if (result.rms < best) best = result.rms;
+        if (result.rms > worst) worst = result.rms;
+    }
+    randomState = 12345;
+    Result triggered = runTriggered((uint32_t)configuredPhase_us);
+    configured = triggered.rms;
+    randomState = 12345;
+    Result freeRunning = runFreeRunning();
+    printf("configured %ldus: rms %.2f spread %.2f\n", (long)configuredPhase_us, triggered.rms, triggered.spread);
+    printf("free running:    rms %.2f spread %.2f\n", freeRunning.rms, freeRunning.spread);
+
+    // white noise alone: sigma / sqrt(64) ~ 0.5 counts
+    double noiseFloor = NOISE_COUNTS / sqrt((double)ADC_SAMPLER_DECIMATION);
+    CHECK(configured < 2.0 * noiseFloor);
+    CHECK(configured <= best * 1.2);
+    CHECK(freeRunning.rms > 10.0 * configured);
+    CHECK(worst > 10.0 * configured);
+}
+
+int main(void) {
+    testTimerSetup();
+    testDeterministicTiming();
+    testPhaseSweep();
+    return TEST_RESULT();
+}
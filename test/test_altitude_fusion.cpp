@@ -0,0 +1,193 @@
+/**
+ * @file test_altitude_fusion.cpp
+ * @brief Baro / GNSS fusion replay of a simulated flight
+ *
+ * The trace is built from a seeded generator: a 30 minute flight (climb, 21 minutes of
+ * soaring, descent), baro samples at 4Hz (standard atmosphere altitude with a drifting
+ * offset to MSL: 85m, 10m/h weather plus 1.5m sensor warm up, 0.2m noise) and GNSS
+ * epochs at 1Hz (correlated error AR(1) with tau 100s and 2.5m, 1m white noise, vAcc
+ * 3.5m) with three +40m multipath outliers at 900..902s. The baro samples run through
+ * VarioEstimator like in user_main.cpp.
+ *
+ * One flight is one realisation of the correlated GNSS error (a 5 minute mean still
+ * scatters by ~2m), so FLIGHTS seeds are flown. Checked per flight after a 2 minute
+ * convergence: fused altitude better than GNSS alone, the outliers rejected, the drift
+ * followed; over all flights: RMS errors, offset bias and the tracked drift.
+ */
+
+#include "host_test.h"
+#include "altitude_fusion.h"
+#include "vario_estimator.h"
+
+#define BARO_PERIOD_MS 250
+#define GNSS_PERIOD_MS 1000
+#define CONVERGED_MS 120000
+#define END_MS 1800000
+#define WINDOW_MS 300000
+#define BARO_NOISE_M 0.2
+#define GNSS_CORRELATED_M 2.5
+#define GNSS_TAU_S 100.0
+#define GNSS_NOISE_M 1.0
+#define GNSS_VACC_M 3.5
+#define OUTLIER_M 40.0
+#define FLIGHTS 8
+
+struct Row {
+    uint32_t time_ms;
+    double baro;                            // standard atmosphere altitude
+    bool epoch;                             // GNSS fields valid
+    double gnss, vAcc, truth, offset;       // MSL, the true MSL and baro offset for the checks
+};
+
+static uint32_t randomState;
+
+static double gaussian(void) {
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        randomState = randomState * 1664525U + 1013904223U;
+        sum += (randomState >> 8) / 16777216.0;
+    }
+    return sum - 6.0;
+}
+
+// MSL altitude: 2 minutes on the ground, climb at 2m/s, soaring, descent over 100s
+static double trueAltitude(double t) {
+    static const double ground = 420.0, top = 620.0;
+    if (t < 120.0) return ground;
+    if (t < 220.0) return ground + 2.0 * (t - 120.0);
+    if (t < 1500.0) return top + 30.0 * sin((t - 220.0) / 90.0) + 15.0 * sin((t - 220.0) / 23.0);
+    if (t < 1600.0) return trueAltitude(1499.999) + (ground - trueAltitude(1499.999)) * (t - 1500.0) / 100.0;
+    return ground;
+}
+
+static double baroOffset(double t) {
+    return 85.0 + 10.0 * t / 3600.0 + 1.5 * (1.0 - exp(-t / 600.0));
+}
+
+// samples of one flight
+class Flight {
+public:
+    explicit Flight(uint32_t seed) : m_time_ms(0), m_correlated(0) { randomState = seed; }
+
+    // next sample, false at the end
+    bool next(Row *row) {
+        if (m_time_ms > END_MS) return false;
+        double t = m_time_ms / 1000.0;
+        row->time_ms = m_time_ms;
+        row->truth = trueAltitude(t);
+        row->offset = baroOffset(t);
+        row->baro = row->truth + row->offset + BARO_NOISE_M * gaussian();
+        row->epoch = m_time_ms % GNSS_PERIOD_MS == 0;
+        if (row->epoch) {
+            double decay = exp(-GNSS_PERIOD_MS / 1000.0 / GNSS_TAU_S);
+            m_correlated = m_correlated * decay + GNSS_CORRELATED_M * sqrt(1.0 - decay * decay) * gaussian();
+            row->gnss = row->truth + m_correlated + GNSS_NOISE_M * gaussian();
+            if (m_time_ms >= 900000 && m_time_ms <= 902000) row->gnss += OUTLIER_M;
+            row->vAcc = GNSS_VACC_M;
+        }
+        m_time_ms += BARO_PERIOD_MS;
+        return true;
+    }
+
+private:
+    uint32_t m_time_ms;
+    double m_correlated;                    // AR(1) state of the GNSS error
+};
+
+struct FlightResult {
+    double fusedRms, gnssRms;
+    double offsetBias, offsetRms;
+    double drift, trueDrift;
+};
+
+static FlightResult fly(uint32_t seed) {
+    Flight flight(seed);
+    VarioEstimator vario;
+    AltitudeFusion fusion;
+    Row row;
+    double fusedSquares = 0, gnssSquares = 0, offsetSum = 0, offsetSquares = 0;
+    double firstOffset = 0, firstTrueOffset = 0, lastOffset = 0, lastTrueOffset = 0;
+    int epochs = 0, rejected = 0, outliersRejected = 0, firstEpochs = 0, lastEpochs = 0;
+
+    while (flight.next(&row)) {
+        uint32_t timestamp_us = row.time_ms * 1000U;
+        vario.update((float)row.baro, timestamp_us);
+        fusion.updateBaro(vario.getAltitude(), vario.getVario(), timestamp_us);
+        if (!row.epoch) continue;
+
+        bool outlier = row.time_ms >= 900000 && row.time_ms <= 902000;
+        if (!fusion.updateGnss((float)row.gnss, (float)row.vAcc, timestamp_us)) {
+            rejected++;
+            if (outlier) outliersRejected++;
+        }
+        if (row.time_ms < CONVERGED_MS) continue;
+
+        double truth = row.truth, trueOffset = row.offset;
+        double fusedError = fusion.getAltitudeMSL() - truth;
+        fusedSquares += fusedError * fusedError;
+        if (!outlier) {
+            double gnssError = row.gnss - truth;
+            gnssSquares += gnssError * gnssError;
+        }
+        double offsetError = fusion.getOffset() - trueOffset;
+        offsetSum += offsetError;
+        offsetSquares += offsetError * offsetError;
+        // offset change between the first and the last 5 minutes, averaged over the GNSS error correlation
+        if (row.time_ms < CONVERGED_MS + WINDOW_MS) {
+            firstOffset += fusion.getOffset();
+            firstTrueOffset += trueOffset;
+            firstEpochs++;
+        } else if (row.time_ms > END_MS - WINDOW_MS) {
+            lastOffset += fusion.getOffset();
+            lastTrueOffset += trueOffset;
+            lastEpochs++;
+        }
+        epochs++;
+    }
+
+    FlightResult result;
+    result.fusedRms = sqrt(fusedSquares / epochs);
+    result.gnssRms = sqrt(gnssSquares / (epochs - 3));
+    result.offsetBias = offsetSum / epochs;
+    result.offsetRms = sqrt(offsetSquares / epochs);
+    result.drift = lastOffset / lastEpochs - firstOffset / firstEpochs;
+    result.trueDrift = lastTrueOffset / lastEpochs - firstTrueOffset / firstEpochs;
+    printf("%4u  %4d  %5.2f  %5.2f  %d (%d)  %5.2f (%.2f)  %5.2f  %5.2f\n", (unsigned)seed, epochs, result.fusedRms,
+           result.gnssRms, rejected, outliersRejected, result.drift, result.trueDrift, result.offsetBias, result.offsetRms);
+
+    CHECK(epochs > 1500);
+    CHECK(fusion.hasGnss());
+    CHECK(result.fusedRms < result.gnssRms);
+    CHECK_EQUAL(3, outliersRejected);
+    CHECK(rejected <= 5);
+    CHECK(result.drift > 0);                // the drift is followed, not averaged away
+    return result;
+}
+
+static void testFlights(void) {
+    FlightResult mean = {0, 0, 0, 0, 0, 0};
+
+    printf("seed epochs fused  gnss  rejected  drift (true)  offset bias  rms [m]\n");
+    for (uint32_t seed = 1; seed <= FLIGHTS; seed++) {
+        FlightResult result = fly(seed);
+        mean.fusedRms += result.fusedRms / FLIGHTS;
+        mean.gnssRms += result.gnssRms / FLIGHTS;
+        mean.offsetBias += result.offsetBias / FLIGHTS;
+        mean.offsetRms += result.offsetRms / FLIGHTS;
+        mean.drift += result.drift / FLIGHTS;
+        mean.trueDrift += result.trueDrift / FLIGHTS;
+    }
+    printf("mean: fused rms %.2f m, gnss rms %.2f m, drift %.2f m (true %.2f m), offset bias %.2f m, rms %.2f m\n",
+           mean.fusedRms, mean.gnssRms, mean.drift, mean.trueDrift, mean.offsetBias, mean.offsetRms);
+
+    CHECK(mean.fusedRms < 0.8 * mean.gnssRms);
+    CHECK(mean.fusedRms < 2.5);
+    CHECK_NEAR(mean.trueDrift, mean.drift, 2.0);
+    CHECK(fabs(mean.offsetBias) < 1.0);     // the mean of the correlated GNSS error
+    CHECK(mean.offsetRms < 2.5);
+}
+
+int main(void) {
+    testFlights();
+    return TEST_RESULT();
+}
@@ -0,0 +1,55 @@
+/**
+ * @file test_baro_altitude.cpp
+ * @brief Table interpolated pressure altitude against the standard atmosphere formula
+ *
+ * Reference: h = 44330m * (1 - (p / 101325Pa)^0.1903) in double. The sweep covers
+ * 300..1100hPa in steps of 37/256Pa (not aligned to the 512Pa table points); the
+ * cycle count on the target comes from the "bench" console command.
+ */
+
+#include "host_test.h"
+#include "baro_altitude.h"
+
+static double reference_mm(double pressure_pa) {
+    return 44330.0 * (1.0 - pow(pressure_pa / 101325.0, 0.1903)) * 1000.0;
+}
+
+static void testSweep(void) {
+    double maxError = 0, maxErrorAt = 0;
+    int32_t previous = INT32_MAX;
+    bool monotonic = true;
+
+    for (int64_t pressure_q8 = 30000 * 256; pressure_q8 <= 110000 * 256; pressure_q8 += 37) {
+        int32_t altitude = baro_altitude_mm((int32_t)pressure_q8);
+        double error = fabs(altitude - reference_mm(pressure_q8 / 256.0));
+        if (error > maxError) {
+            maxError = error;
+            maxErrorAt = pressure_q8 / 256.0;
+        }
+        if (altitude > previous) monotonic = false;
+        previous = altitude;
+    }
+    printf("300..1100hPa: max. error %.2f mm at %.1f Pa\n", maxError, maxErrorAt);
+    CHECK(maxError < 4.0);
+    CHECK(monotonic);                       // no steps at the table points
+}
+
+static void testReferencePoints(void) {
+    CHECK_NEAR(0.0, baro_altitude_mm(101325 * 256), 4.0);
+    CHECK_NEAR(reference_mm(89876.0), baro_altitude_mm(89876 * 256), 4.0);     // ~1000m
+    CHECK_NEAR(reference_mm(54020.0), baro_altitude_mm(54020 * 256), 4.0);     // ~5000m
+}
+
+static void testClamp(void) {
+    CHECK_EQUAL(baro_altitude_mm(BARO_ALTITUDE_P_MIN_PA * 256), baro_altitude_mm(0));
+    CHECK_EQUAL(baro_altitude_mm(BARO_ALTITUDE_P_MIN_PA * 256), baro_altitude_mm(-1000));
+    int32_t p_max_q8 = (BARO_ALTITUDE_P_MIN_PA + ((BARO_ALTITUDE_POINTS - 1) << BARO_ALTITUDE_STEP_SHIFT)) * 256;
+    CHECK_EQUAL(baro_altitude_mm(p_max_q8), baro_altitude_mm(120000 * 256));
+}
+
+int main(void) {
+    testSweep();
+    testReferencePoints();
+    testClamp();
+    return TEST_RESULT();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file test_battery_measurement.cpp
+ * @brief Fixed point battery pipeline against the former float implementation
+ *
+ * The reference is the float code that BatteryMeasurement replaced (float IIR on the raw
+ * AdcSampler results, then the scale expressions), started at the first sample like the
+ * fixed point filter. Checked: the full 12 bit input range at steady state, a noisy
+ * dynamic sequence sample by sample, the VREFINT supply correction and the temperature
+ * sensor. The host timing at the end is for information only - the host has an FPU, the
+ * "bench" console command gives the cycle counts on the target.
+ */
+
+#include "host_test.h"
+#include "battery_measurement.h"
+#include <time.h>
+
+struct FloatReference {
+    float voltage;
+    float current;
+    bool started;
+
+    FloatReference() : voltage(0), current(0), started(false) {}
+
+    void update(const uint16_t *results) {
+        static const float IIR_ALPHA = 0.239057f;
+        static const float IIR_BETA = 1.0f - IIR_ALPHA;
+        if (!started) {
+            voltage = results[BAT_ADC_CHANNEL_VOLTAGE];
+            current = results[BAT_ADC_CHANNEL_CURRENT];
+            started = true;
+        } else {
+            voltage = voltage * IIR_BETA + (float)results[BAT_ADC_CHANNEL_VOLTAGE] * IIR_ALPHA;
+            current = current * IIR_BETA + (float)results[BAT_ADC_CHANNEL_CURRENT] * IIR_ALPHA;
+        }
+    }
+
+    // mV / mA like the former analog_measurement_task, with the supply as parameter
+    float voltage_mV(float vdda) const { return voltage * vdda / 4095.0f * 11.0f * 1.01f / 16.0f - BAT_VOLTAGE_OFFSET_MV; }
+    float current_mA(float vdda) const { return current * vdda / 4095.0f * 1.01f / 16.0f / 0.066f - BAT_CURRENT_OFFSET_MA; }
+};
+
+static uint16_t vrefResult(float vdda) {
+    return (uint16_t)(BAT_VREFINT_MV / vdda * 4095.0f * 16.0f + 0.5f);
+}
+
+static void testStaticRange(void) {
+    double maxVoltage = 0, maxCurrent = 0;
+
+    for (uint32_t counts = 0; counts < 4096; counts++) {
+        uint16_t results[ADC_SAMPLER_RESULTS] = {(uint16_t)(counts << 4), (uint16_t)(counts << 4), vrefResult(3300.0f), 0};
+        BatteryMeasurement battery;
+        FloatReference reference;
+        for (int i = 0; i < 3; i++) {
+            battery.update(results);
+            reference.update(results);
+        }
+        maxVoltage = fmax(maxVoltage, fabs(reference.voltage_mV(3300.0f) - battery.getVoltage_mV()));
+        maxCurrent = fmax(maxCurrent, fabs(reference.current_mA(3300.0f) - battery.getCurrent_mA()));
+    }
+    printf("0..4095 counts: max. error %.2f mV, %.2f mA\n", maxVoltage, maxCurrent);
+    CHECK(maxVoltage < 1.5);                // one LSB of the 8.9mV voltage step, mostly truncation
+    CHECK(maxCurrent < 1.5);
+}
+
+static void testDynamic(void) {
+    BatteryMeasurement battery;
+    FloatReference reference;
+    uint32_t seed = 1;
+    double maxVoltage = 0, maxCurrent = 0;
+
+    // 12.6V pack sagging under load steps, +-40 counts noise on the results
+    for (int step = 0; step < 5000; step++) {
+        seed = seed * 1103515245U + 12345U;
+        int32_t noise = (int32_t)((seed >> 16) % 81) - 40;
+        bool load = (step / 250) % 2;
+        int32_t voltage = (load ? 55000 : 58000) + noise;
+        int32_t current = (load ? 30000 : 2000) - noise;
+        uint16_t results[ADC_SAMPLER_RESULTS] = {(uint16_t)voltage, (uint16_t)current, vrefResult(3300.0f), 0};
+        battery.update(results);
+        reference.update(results);
+        maxVoltage = fmax(maxVoltage, fabs(reference.voltage_mV(3300.0f) - battery.getVoltage_mV()));
+        maxCurrent = fmax(maxCurrent, fabs(reference.current_mA(3300.0f) - battery.getCurrent_mA()));
+    }
+    printf("load steps: max. error %.2f mV, %.2f mA\n", maxVoltage, maxCurrent);
+    CHECK(maxVoltage < 2.0);                // Q8 filter state vs. float rounding over 5000 steps
+    CHECK(maxCurrent < 2.0);
+}
+
+static void testSupplyCorrection(void) {
+    // the ADC results scale with 1 / VDDA, the output must not
+    static const float supplies[] = {3000.0f, 3200.0f, 3300.0f, 3400.0f, 3600.0f};
+    const float input_mV = 2000.0f;         // at the ADC pin
+
+    for (unsigned index = 0; index < sizeof(supplies) / sizeof(supplies[0]); index++) {
+        float vdda = supplies[index];
+        uint16_t counts = (uint16_t)(input_mV / vdda * 4095.0f * 16.0f + 0.5f);
+        uint16_t results[ADC_SAMPLER_RESULTS] = {counts, counts, vrefResult(vdda), 0};
+        BatteryMeasurement battery;
+        FloatReference reference;
+        for (int i = 0; i < 3; i++) {
+            battery.update(results);
+            reference.update(results);
+        }
+        CHECK_NEAR(vdda, battery.getVdda_mV(), 2.0);
+        CHECK_NEAR(reference.voltage_mV(vdda), battery.getVoltage_mV(), 3.0);
+        CHECK_NEAR(reference.current_mA(vdda), battery.getCurrent_mA(), 3.0);
+    }
+}
+
+static void testTemperature(void) {
+    static const float temperatures[] = {-20.0f, 25.0f, 60.0f, 85.0f};
+
+    for (unsigned index = 0; index < sizeof(temperatures) / sizeof(temperatures[0]); index++) {
+        float vsense_mV = BAT_TEMP_V25_01MV / 10.0f - (temperatures[index] - 25.0f) * BAT_TEMP_SLOPE_01MV / 10.0f;
+        uint16_t results[ADC_SAMPLER_RESULTS] = {0, 0, vrefResult(3300.0f),
+                                                 (uint16_t)(vsense_mV / 3300.0f * 4095.0f * 16.0f + 0.5f)};
+        BatteryMeasurement battery;
+        battery.update(results);
+        CHECK_NEAR(temperatures[index] * 10.0f, battery.getTemperature_dC(), 5.0);
+    }
+}
+
+static void benchmark(void) {
+    uint16_t results[ADC_SAMPLER_RESULTS] = {20000, 8000, vrefResult(3300.0f), 28000};
+    const int rounds = 1000000;
+    BatteryMeasurement battery;
+    FloatReference reference;
+    volatile float sink = 0;
+
+    clock_t start = clock();
+    for (int i = 0; i < rounds; i++) {
+        results[0] = (uint16_t)(20000 + (i & 255));
+        battery.update(results);
+    }
+    double fixed_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds;
+    start = clock();
+    for (int i = 0; i < rounds; i++) {
+        results[0] = (uint16_t)(20000 + (i & 255));
+        reference.update(results);
+        sink = reference.voltage_mV(3300.0f) + reference.current_mA(3300.0f);
+    }
+    double float_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds;
+    printf("host: fixed %.1f ns, float %.1f ns per result (%d mV)\n", fixed_ns, float_ns, (int)sink);
+}
+
+int main(void) {
+    testStaticRange();
+    testDynamic();
+    testSupplyCorrection();
+    testTemperature();
+    benchmark();
+    return TEST_RESULT();
+}
@@ -0,0 +1,172 @@
+/**
+ * @file test_battery_monitor.cpp
+ * @brief Coulomb counter, state of charge and CRSF BATTERY_SENSOR payload of BatteryMonitor
+ *
+ * Checked: the mA*us -> mAh integration with the microsecond timebase wrapping at 2^32
+ * in the middle of the flight, skipped gaps, the LiPo LUT with the internal resistance
+ * compensation and its low pass, the cell count detection from the first valid voltage
+ * and the big endian byte layout of the 0x08 payload with its clamping.
+ */
+
+#include "host_test.h"
+#include "battery_monitor.h"
+#include <string.h>
+
+#define UPDATE_US 20000                     // 50Hz, like the ADC results in user_main.cpp
+
+static void testIntegration(void) {
+    BatteryMonitor monitor;
+
+    // 3600mA for 10s = 10mAh, the timebase wraps after 5s
+    uint32_t now_us = 0xFFFFFFFFUL - 5000000UL + 1;
+    monitor.update(12000, 3600, now_us);       // first update: the start, nothing integrated
+    CHECK_EQUAL(0, monitor.getConsumed_mAh());
+    for (uint32_t step = 0; step < 10000000UL / UPDATE_US; step++) {
+        now_us += UPDATE_US;
+        monitor.update(12000, 3600, now_us);
+        if (step == 5000000UL / UPDATE_US - 1) {
+            CHECK(now_us < UPDATE_US);         // wrapped
+            CHECK_EQUAL(5, monitor.getConsumed_mAh());
+        }
+    }
+    CHECK_EQUAL(10, monitor.getConsumed_mAh());
+
+    // the fraction below one mAh is kept: 0.5mAh + 0.5mAh
+    for (uint8_t i = 0; i < 2; i++) {
+        now_us += 500000;
+        monitor.update(12000, 3600, now_us);
+        CHECK_EQUAL(10U + i, monitor.getConsumed_mAh());
+    }
+
+    // a gap of BAT_MAX_DT_US (debugger halt) and negative current (charging) are not counted
+    now_us += BAT_MAX_DT_US;
+    monitor.update(12000, 3600, now_us);
+    now_us += 500000;
+    monitor.update(12000, -3600, now_us);
+    CHECK_EQUAL(11, monitor.getConsumed_mAh());
+
+    // no battery: nothing integrated, the count is kept
+    now_us += 500000;
+    monitor.update(500, 3600, now_us);
+    CHECK_EQUAL(11, monitor.getConsumed_mAh());
+
+    monitor.reset();
+    CHECK_EQUAL(0, monitor.getConsumed_mAh());
+}
+
+static void testStateOfCharge(void) {
+    BatteryMonitor monitor;
+
+    // LUT points and linear interpolation between them, 3S pack at rest
+    static const struct {
+        int32_t cell_mV;
+        uint8_t pct;
+    } points[] = {{3000, 0}, {3300, 0}, {3450, 5}, {3600, 10}, {3700, 20}, {3770, 35}, {3990, 80}, {4140, 95}, {4200, 100}, {4350, 100}};
+    for (uint8_t i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+        monitor.reset();
+        monitor.update(3 * points[i].cell_mV, 0, 0);
+        CHECK_EQUAL(3, monitor.getCellCount());
+        CHECK_EQUAL(points[i].pct, monitor.getRemaining_pct());
+    }
+
+    // 20A through 30mOhm: 600mV sag, the same 3.7V resting cells
+    monitor.reset();
+    monitor.update(11100 - 20000 * BAT_INTERNAL_RESISTANCE_MOHM / 1000, 20000, 0);
+    CHECK_EQUAL(20, monitor.getRemaining_pct());
+
+    // load step on a running estimate: unchanged with the compensation
+    monitor.reset();
+    uint32_t now_us = 0;
+    for (uint16_t step = 0; step < 100; step++, now_us += UPDATE_US) monitor.update(11310, 0, now_us);
+    CHECK_EQUAL(35, monitor.getRemaining_pct());
+    for (uint16_t step = 0; step < 100; step++, now_us += UPDATE_US) monitor.update(11310 - 900, 30000, now_us);
+    CHECK_EQUAL(35, monitor.getRemaining_pct());
+
+    // real drop 35 -> 20%: filtered, ~1.3s to follow
+    monitor.update(11100, 0, now_us += UPDATE_US);
+    CHECK(monitor.getRemaining_pct() > 33);
+    for (uint16_t step = 0; step < 200; step++, now_us += UPDATE_US) monitor.update(11100, 0, now_us);
+    CHECK_NEAR(20, monitor.getRemaining_pct(), 1);
+}
+
+static void testCellDetection(void) {
+    BatteryMonitor monitor;
+
+    // full, storage and empty packs of 1..6 cells
+    static const int32_t cell_mV[] = {4350, 4200, 3850, 3700};
+    for (uint8_t cells = 1; cells <= 6; cells++) {
+        for (uint8_t i = 0; i < sizeof(cell_mV) / sizeof(cell_mV[0]); i++) {
+            monitor.reset();
+            monitor.update(cells * cell_mV[i], 0, 0);
+            CHECK_EQUAL(cells, monitor.getCellCount());
+            CHECK_EQUAL(cell_mV[i], monitor.getCellVoltage_mV());
+        }
+    }
+
+    // the limit of the detection: above (n - 1) * BAT_CELL_MAX_MV, a 4S pack needs > 3.26V per cell
+    monitor.reset();
+    monitor.update(3 * BAT_CELL_MAX_MV + 1, 0, 0);
+    CHECK_EQUAL(4, monitor.getCellCount());
+    monitor.reset();
+    monitor.update(3 * BAT_CELL_MAX_MV, 0, 0);
+    CHECK_EQUAL(3, monitor.getCellCount());
+
+    // USB powered: no detection until a battery is plugged in, then fixed for the flight
+    monitor.reset();
+    monitor.update(BAT_MIN_VALID_MV - 1, 0, 0);
+    CHECK_EQUAL(BAT_CELL_COUNT, monitor.getCellCount());
+    CHECK_EQUAL(0, monitor.getRemaining_pct());
+    monitor.update(16800, 0, UPDATE_US);
+    CHECK_EQUAL(4, monitor.getCellCount());
+    monitor.update(12800, 0, 2 * UPDATE_US);   // sagging 4S, still 4 cells
+    CHECK_EQUAL(4, monitor.getCellCount());
+    CHECK_EQUAL(3200, monitor.getCellVoltage_mV());
+}
+
+static void testCrsfFrame(void) {
+    BatteryMonitor monitor;
+    uint8_t payload[CRSF_BATTERY_SENSOR_PAYLOAD_SIZE + 1];
+
+    // 0x12345 mAh consumed: 745650A for 360ms
+    monitor.update(16800, 0, 0);
+    monitor.update(16800, 745650000, 360000);
+    CHECK_EQUAL(0x12345, monitor.getConsumed_mAh());
+
+    // 12.35V -> 124 (0.1V), 15.55A -> 156 (0.1A), rounded
+    monitor.update(12350, 15550, 360000 + UPDATE_US);
+    memset(payload, 0xEE, sizeof(payload));
+    CHECK_EQUAL(CRSF_BATTERY_SENSOR_PAYLOAD_SIZE, monitor.encodeCrsfFrame(payload));
+    uint8_t pct = monitor.getRemaining_pct();
+    const uint8_t expected[] = {0x00, 124, 0x00, 156, 0x01, 0x23, 0x45, pct, 0xEE};
+    CHECK_EQUAL(0, memcmp(expected, payload, sizeof(expected)));
+
+    // negative current (charging / offset) is sent as 0, large values are clamped
+    monitor.update(12350, -200, 360000 + 2 * UPDATE_US);
+    monitor.encodeCrsfFrame(payload);
+    CHECK_EQUAL(0, payload[2]);
+    CHECK_EQUAL(0, payload[3]);
+    monitor.update(7000000, 7000000, 360000 + 3 * UPDATE_US);
+    monitor.encodeCrsfFrame(payload);
+    CHECK_EQUAL(0xFF, payload[0]);
+    CHECK_EQUAL(0xFF, payload[1]);
+    CHECK_EQUAL(0xFF, payload[2]);
+    CHECK_EQUAL(0xFF, payload[3]);
+
+    // the capacity field has 24 bit
+    monitor.reset();
+    uint32_t now_us = 0;
+    monitor.update(16800, 0, now_us);
+    while (monitor.getConsumed_mAh() <= 0xFFFFFF) monitor.update(16800, 2000000000, now_us += BAT_MAX_DT_US - 1);
+    monitor.encodeCrsfFrame(payload);
+    CHECK_EQUAL(0xFF, payload[4]);
+    CHECK_EQUAL(0xFF, payload[5]);
+    CHECK_EQUAL(0xFF, payload[6]);
+}
+
+int main(void) {
+    testIntegration();
+    testStateOfCharge();
+    testCellDetection();
+    testCrsfFrame();
+    return TEST_RESULT();
+}
@@ -0,0 +1,205 @@
+/**
+ * @file test_flash_record.cpp
+ * @brief Flash record helper, the ADC calibration and GNSS cache records on simulated flash pages
+ *
+ * The linker script pages are RAM arrays here, the HAL flash functions model the F1
+ * flash: erase sets the page to 0xFF, a word can only be programmed while unlocked and
+ * erased. Checked: the CRC32, round trip, the record layout (same as the former
+ * per-module records, stored pages stay valid), rejection of erased / foreign /
+ * corrupted / partly written pages, and the GNSS cache save policy.
+ */
+
+#include "host_test.h"
+#include "flash_record.h"
+#include "adc_calibration.h"
+#include "gnss_cache.h"
+#include <string.h>
+
+#define PAGE_WORDS (FLASH_PAGE_SIZE / 4)
+
+extern "C" {
+uint32_t _calibration_start[PAGE_WORDS];
+uint32_t _gnss_cache_start[PAGE_WORDS];
+}
+
+static bool unlocked = false;
+static uint32_t erases = 0, programs = 0;
+static uint32_t failAfter = 0;             // programming fails after this many words, 0 = never
+
+// the HAL takes 32 bit addresses: map them back to the RAM pages
+static uint32_t *wordAt(uint32_t address) {
+    uint32_t *pages[] = {_calibration_start, _gnss_cache_start};
+    for (uint8_t i = 0; i < 2; i++) {
+        uint32_t offset = address - (uint32_t)(uintptr_t)pages[i];
+        if (offset < FLASH_PAGE_SIZE) return pages[i] + offset / 4;
+    }
+    return nullptr;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    unlocked = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+    unlocked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *erase, uint32_t *pageError) {
+    uint32_t *word = wordAt(erase->PageAddress);
+    if (!unlocked || !word || erase->NbPages != 1) return HAL_ERROR;
+    memset(word, 0xFF, FLASH_PAGE_SIZE);
+    *pageError = 0xFFFFFFFFUL;
+    erases++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t typeProgram, uint32_t address, uint64_t data) {
+    uint32_t *word = wordAt(address);
+    if (!unlocked || !word || typeProgram != FLASH_TYPEPROGRAM_WORD || *word != 0xFFFFFFFFUL) return HAL_ERROR;
+    if (failAfter && programs >= failAfter) return HAL_ERROR;
+    *word = (uint32_t)data;
+    programs++;
+    return HAL_OK;
+}
+
+struct Payload {
+    uint32_t a;
+    int32_t b;
+    uint8_t c[8];
+};
+
+static void testRecord(void) {
+    CHECK_EQUAL(0xCBF43926UL, flash_record_crc32("123456789", 9));    // CRC-32 check value
+
+    Payload in = {0x12345678, -42, {1, 2, 3, 4, 5, 6, 7, 8}}, out;
+    memset(_gnss_cache_start, 0xFF, FLASH_PAGE_SIZE);
+    CHECK(!flash_record_read(_gnss_cache_start, 0xA5A5A5A5, 3, &out, sizeof(out)));     // erased
+
+    erases = programs = 0;
+    CHECK_EQUAL(HAL_OK, flash_record_write(_gnss_cache_start, 0xA5A5A5A5, 3, &in, sizeof(in)));
+    CHECK(!unlocked);
+    CHECK_EQUAL(1, erases);
+    CHECK_EQUAL(sizeof(in) / 4 + 3, programs);
+    CHECK(flash_record_read(_gnss_cache_start, 0xA5A5A5A5, 3, &out, sizeof(out)));
+    CHECK_EQUAL(0, memcmp(&in, &out, sizeof(in)));
+
+    // layout: magic, version, payload, CRC over everything before it
+    CHECK_EQUAL(0xA5A5A5A5, _gnss_cache_start[0]);
+    CHECK_EQUAL(3, _gnss_cache_start[1]);
+    CHECK_EQUAL(0, memcmp(&in, &_gnss_cache_start[2], sizeof(in)));
+    CHECK_EQUAL(flash_record_crc32(_gnss_cache_start, 8 + sizeof(in)), _gnss_cache_start[2 + sizeof(in) / 4]);
+
+    // foreign, old or corrupted records
+    CHECK(!flash_record_read(_gnss_cache_start, 0xA5A5A5A4, 3, &out, sizeof(out)));
+    CHECK(!flash_record_read(_gnss_cache_start, 0xA5A5A5A5, 2, &out, sizeof(out)));
+    CHECK(!flash_record_read(_gnss_cache_start, 0xA5A5A5A5, 3, &out, sizeof(out) - 4));
+    _gnss_cache_start[3] ^= 0x00010000;
+    CHECK(!flash_record_read(_gnss_cache_start, 0xA5A5A5A5, 3, &out, sizeof(out)));
+
+    // sizes that cannot be a record
+    CHECK_EQUAL(HAL_ERROR, flash_record_write(_gnss_cache_start, 1, 1, &in, 6));
+    uint8_t large[FLASH_RECORD_MAX_PAYLOAD + 4] = {0};
+    CHECK_EQUAL(HAL_ERROR, flash_record_write(_gnss_cache_start, 1, 1, large, sizeof(large)));
+    CHECK_EQUAL(HAL_OK, flash_record_write(_gnss_cache_start, 1, 1, large, FLASH_RECORD_MAX_PAYLOAD));
+    CHECK(flash_record_read(_gnss_cache_start, 1, 1, large, FLASH_RECORD_MAX_PAYLOAD));
+
+    // power lost / error while programming: the CRC word comes last, no valid record
+    programs = 0;
+    failAfter = 4;
+    CHECK_EQUAL(HAL_ERROR, flash_record_write(_gnss_cache_start, 0xA5A5A5A5, 3, &in, sizeof(in)));
+    failAfter = 0;
+    CHECK(!unlocked);
+    CHECK(!flash_record_read(_gnss_cache_start, 0xA5A5A5A5, 3, &out, sizeof(out)));
+
+    CHECK_EQUAL(HAL_OK, flash_record_write(_gnss_cache_start, 0xA5A5A5A5, 3, &in, sizeof(in)));
+    CHECK_EQUAL(HAL_OK, flash_record_erase(_gnss_cache_start));
+    CHECK(!flash_record_read(_gnss_cache_start, 0xA5A5A5A5, 3, &out, sizeof(out)));
+}
+
+static void testCalibration(void) {
+    BatteryMeasurement battery, restored;
+    BatteryCalibration calibration = BatteryMeasurement::defaultCalibration();
+    calibration.voltageScale_q16 = calibration.voltageScale_q16 * 101 / 100;
+    calibration.voltageOffset_mV = -37;
+    calibration.currentOffset_mA = 120;
+    battery.setCalibration(calibration);
+
+    memset(_calibration_start, 0xFF, FLASH_PAGE_SIZE);
+    CHECK(!adc_calibration_load(restored));
+    CHECK_EQUAL(HAL_OK, adc_calibration_save(battery));
+    CHECK_EQUAL(ADC_CALIBRATION_MAGIC, _calibration_start[0]);
+    CHECK(adc_calibration_load(restored));
+    CHECK_EQUAL(calibration.voltageScale_q16, restored.getCalibration().voltageScale_q16);
+    CHECK_EQUAL(-37, restored.getCalibration().voltageOffset_mV);
+    CHECK_EQUAL(120, restored.getCalibration().currentOffset_mA);
+
+    // the other page is untouched
+    memset(_gnss_cache_start, 0xFF, FLASH_PAGE_SIZE);
+    CHECK_EQUAL(HAL_OK, adc_calibration_save(battery));
+    CHECK_EQUAL(0xFFFFFFFFUL, _gnss_cache_start[0]);
+
+    CHECK_EQUAL(HAL_OK, adc_calibration_defaults(battery));
+    CHECK(!adc_calibration_load(restored));
+}
+
+static GnssSnapshot goodFix(void) {
+    GnssSnapshot gnss = GnssSnapshot();
+    gnss.fixOK = true;
+    gnss.fixType = 3;
+    gnss.timeValid = true;
+    gnss.hAcc = 2500;
+    gnss.latitude = 481173021;
+    gnss.longitude = -115166700;
+    gnss.altitudeMSL = 545400;
+    gnss.year = 2026;
+    gnss.month = 10;
+    gnss.day = 18;
+    return gnss;
+}
+
+static void testGnssCache(void) {
+    GnssSnapshot gnss = goodFix();
+    GnssCacheData data;
+
+    memset(_gnss_cache_start, 0xFF, FLASH_PAGE_SIZE);
+    erases = 0;
+
+    // moving, then a fix without time: no write
+    uint32_t now_ms = 1000;
+    gnss.groundSpeed = GNSS_CACHE_MAX_SPEED_MMS + 1;
+    for (; now_ms < 1000 + 2 * GNSS_CACHE_SAVE_DELAY_MS; now_ms += 500) CHECK(!gnss_cache_task(gnss, now_ms, 31700, true));
+    gnss.groundSpeed = 0;
+    gnss.timeValid = false;
+    CHECK(!gnss_cache_task(gnss, now_ms, 31700, true));
+    CHECK_EQUAL(0, erases);
+
+    // good fix on the ground: written once it has been held for GNSS_CACHE_SAVE_DELAY_MS, once per boot
+    gnss.timeValid = true;
+    uint32_t good_ms = now_ms;
+    for (; now_ms < good_ms + GNSS_CACHE_SAVE_DELAY_MS; now_ms += 500) CHECK(!gnss_cache_task(gnss, now_ms, 31700, true));
+    CHECK_EQUAL(0, erases);
+    CHECK(gnss_cache_task(gnss, now_ms, 31700, true));
+    CHECK_EQUAL(1, erases);
+    CHECK(!gnss_cache_task(gnss, now_ms + 500, 31700, true));
+    CHECK_EQUAL(1, erases);
+
+    CHECK(gnss_cache_load(&data));
+    CHECK_EQUAL(481173021, data.warmStart.latitude);
+    CHECK_EQUAL(-115166700, data.warmStart.longitude);
+    CHECK_EQUAL(545400, data.warmStart.altitudeMSL);
+    CHECK_EQUAL(2026, data.warmStart.year);
+    CHECK_EQUAL(31700, data.clockError_ppb);
+    CHECK_EQUAL(1, data.clockValid);
+
+    CHECK_EQUAL(HAL_OK, gnss_cache_erase());
+    CHECK(!gnss_cache_load(&data));
+}
+
+int main(void) {
+    testRecord();
+    testCalibration();
+    testGnssCache();
+    return TEST_RESULT();
+}
@@ -0,0 +1,336 @@
+/**
+ * @file test_gnss_bringup.cpp
+ * @brief u-blox probe / configure sequence and UART budget against a simulated module
+ *
+ * Built twice: with the default configuration (2Hz at 115200) and with
+ * GNSS_HIGH_RATE_HZ=25 (230400, NAV-PVT only). The module runs in 1ms steps, update()
+ * is called every 10ms like the main loop. Checked: the order of the probe baud rates,
+ * the CFG commands and their content, lost ACKs and NAKs, the new search after a module
+ * power cycle, the measured line load against GNSS_MAX_UART_LOAD_PERCENT, the
+ * MGA-INI aiding after the configuration and the time to first fix with and without
+ * the warm start record.
+ */
+
+#include "host_test.h"
+#include "gnss_module.h"
+#include "ublox_gnss_wrapper.h"
+
+#define CFG_PRT 0x00
+#define CFG_MSG 0x01
+#define CFG_RATE 0x08
+
+static uint32_t now_ms = 0;
+
+uint32_t millis(void) {
+    return now_ms;
+}
+
+uint32_t micros(void) {
+    return now_ms * 1000;
+}
+
+extern "C" uint32_t timebase_micros(void) {
+    return now_ms * 1000;
+}
+
+// returns the time until isConfigured(), -1 if not within ms
+static int32_t run(GnssModule &module, UbloxGNSSWrapper &gnss, uint32_t ms) {
+    int32_t configured_ms = -1;
+    for (uint32_t step = 1; step <= ms; step++) {
+        now_ms++;
+        module.step(now_ms);
+        if (now_ms % 10 == 0) gnss.update();
+        if (configured_ms < 0 && gnss.isConfigured()) configured_ms = (int32_t)step;
+    }
+    return configured_ms;
+}
+
+static void presetPvt(GnssModule &module) {
+    module.pvt.fixType = 3;
+    module.pvt.flags = 0x01;
+    module.pvt.numSV = 14;
+    module.pvt.lat = 481173021;
+    module.pvt.lon = -115166700;
+    module.pvt.hMSL = 545400;
+    module.pvt.vAcc = 2100;
+    module.pvt.gSpeed = 11524;
+}
+
+// module saved periodic NAV messages in an earlier configuration: POSLLH, SOL, VELNED, SVINFO, SAT
+static void presetSavedMessages(GnssModule &module) {
+    static const uint8_t ids[] = {0x02, 0x06, 0x12, 0x30, 0x35};
+    for (uint8_t i = 0; i < sizeof(ids); i++) module.navRates[ids[i]] = 1;
+}
+
+static void testProbeOrder(void) {
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    module.reset(true, 38400);
+    now_ms = 0;
+    gnss.begin();
+
+    // GNSS_OPERATING_BAUD first, then on through the list, 38400 answers
+    int32_t configured_ms = run(module, gnss, 10000);
+    static const uint32_t order[] = {9600, 4800, 38400, 115200, 230400, 460800};
+    uint8_t index = 0;
+    while (order[index] != GNSS_OPERATING_BAUD) index++;
+    uint8_t probes = 0;
+    do {
+        CHECK_EQUAL(order[index], module.baudLog[probes]);
+        index = (uint8_t)((index + 1) % 6);
+    } while (module.baudLog[probes++] != 38400 && probes < 6);
+    printf("configured after %ld ms at probe rate %u\n", (long)configured_ms, probes);
+    CHECK_EQUAL(GNSS_OPERATING_BAUD, module.baudLog[probes]);      // host follows CFG-PRT
+    CHECK(configured_ms >= (probes - 1) * GNSS_PROBE_TIMEOUT_MS);
+    CHECK(configured_ms <= (probes - 1) * GNSS_PROBE_TIMEOUT_MS + GNSS_PORT_SWITCH_MS + 200);
+}
+
+static void testConfigure(void) {
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    module.reset(true, 9600);
+    presetSavedMessages(module);
+    now_ms = 0;
+    gnss.begin();
+    CHECK(run(module, gnss, 8000) > 0);
+    CHECK_EQUAL(0, strcmp("running", gnss.getStateName()));
+    CHECK_EQUAL(GNSS_OPERATING_BAUD, gnss.getBaudRate());
+
+    // CFG-PRT at the found rate: operating baud, UBX + NMEA in, UBX out
+    const GnssModuleCommand *port = module.lastCommand(0x06, CFG_PRT);
+    CHECK(port != nullptr);
+    CHECK_EQUAL(9600, port->hostBaud);
+    CHECK_EQUAL(GNSS_OPERATING_BAUD, port->payload[8] | port->payload[9] << 8 | (uint32_t)port->payload[10] << 16);
+    CHECK_EQUAL(0x03, port->payload[12]);
+    CHECK_EQUAL(0x01, port->payload[14]);
+    const GnssModuleCommand *rate = module.lastCommand(0x06, CFG_RATE);
+    CHECK(rate != nullptr);
+    CHECK_EQUAL(GNSS_OPERATING_BAUD, rate->hostBaud);
+    CHECK_EQUAL(1, module.countCommands(0x06, CFG_RATE));
+    CHECK_EQUAL(GNSS_OPERATING_PERIOD_MS, module.period_ms);
+    CHECK(!module.nmeaOut);
+    CHECK_EQUAL(1, module.navRates[UBX_NAV_PVT]);
+#if GNSS_HIGH_RATE_HZ
+    // everything else off
+    CHECK_EQUAL(1 + 12, module.countCommands(0x06, CFG_MSG));
+    for (int id = 0; id < 256; id++) {
+        if (id != UBX_NAV_PVT) CHECK_EQUAL(0, module.navRates[id]);
+    }
+#else
+    CHECK_EQUAL(1, module.countCommands(0x06, CFG_MSG));
+#endif
+
+    // one published epoch per measurement period
+    presetPvt(module);
+    uint32_t sequence = gnss.getSequence();
+    run(module, gnss, 10000);
+    uint32_t epochs = gnss.getSequence() - sequence;
+    CHECK_NEAR(10000 / GNSS_OPERATING_PERIOD_MS, epochs, 1);
+    GnssSnapshot snapshot;
+    CHECK(gnss.getSnapshot(&snapshot));
+    CHECK(snapshot.fixOK);
+    CHECK_EQUAL(481173021, snapshot.latitude);
+    CHECK_EQUAL(-115166700, snapshot.longitude);
+    CHECK_EQUAL(545400, snapshot.altitudeMSL);
+    CHECK_EQUAL(now_ms - now_ms % GNSS_OPERATING_PERIOD_MS, snapshot.iTOW);
+    CHECK_EQUAL(0, gnss.getParserStats().checksumErrors);
+    CHECK_EQUAL(0, module.rxOverflows);
+}
+
+static void testUartBudget(void) {
+    // 8N1: 10 bit per byte, the NAV-PVT frame is the unit of the compile time check
+    CHECK_EQUAL(100, UBX_MAX_PAYLOAD + UBX_FRAME_OVERHEAD);
+
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    module.reset(true, 9600);
+    presetSavedMessages(module);
+    now_ms = 0;
+    gnss.begin();
+    CHECK(run(module, gnss, 8000) > 0);
+
+    // everything the module sends in 10s at the operating rate
+    uint32_t bytes = module.txBytes;
+    run(module, gnss, 10000);
+    bytes = module.txBytes - bytes;
+    double load = bytes * 10.0 / (GNSS_OPERATING_BAUD * 10.0) * 100.0;
+    double navPvtLoad = 1000.0 * (1000 / GNSS_OPERATING_PERIOD_MS) / GNSS_OPERATING_BAUD * 100.0;
+    printf("%u Hz at %u baud: line load %.1f%% (NAV-PVT %.1f%%), limit %u%%\n", 1000 / GNSS_OPERATING_PERIOD_MS,
+           GNSS_OPERATING_BAUD, load, navPvtLoad, GNSS_MAX_UART_LOAD_PERCENT);
+    CHECK(load <= GNSS_MAX_UART_LOAD_PERCENT);
+    CHECK(navPvtLoad <= GNSS_MAX_UART_LOAD_PERCENT);
+#if GNSS_HIGH_RATE_HZ
+    CHECK_NEAR(navPvtLoad, load, 0.5);                  // NAV-PVT only
+#endif
+}
+
+static void testLostAcks(void) {
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    module.reset(true, GNSS_OPERATING_BAUD);
+    module.ignoreId = CFG_RATE;
+    module.ignoreCount = GNSS_CONFIG_RETRIES - 1;
+    now_ms = 0;
+    gnss.begin();
+
+    // found at the first probe, CFG-RATE repeated after each ACK timeout
+    int32_t configured_ms = run(module, gnss, 3000);
+    printf("%u lost ACKs: configured after %ld ms\n", GNSS_CONFIG_RETRIES - 1, (long)configured_ms);
+    CHECK_EQUAL(GNSS_CONFIG_RETRIES, module.countCommands(0x06, CFG_RATE));
+    CHECK(configured_ms >= (GNSS_CONFIG_RETRIES - 1) * GNSS_ACK_TIMEOUT_MS);
+    CHECK(configured_ms <= GNSS_CONFIG_RETRIES * GNSS_ACK_TIMEOUT_MS + GNSS_PORT_SWITCH_MS);
+    CHECK_EQUAL(1, module.countCommands(UBX_CLASS_NAV, UBX_NAV_PVT));
+}
+
+static void testNak(void) {
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    module.reset(true, GNSS_OPERATING_BAUD);
+    module.minPeriod_ms = 100;                              // M8 with GPS + GLONASS: 10Hz at most
+    now_ms = 0;
+    gnss.begin();
+
+    // the configured rate or, after a NAK per faster rate, 10Hz
+    CHECK(run(module, gnss, 2000) > 0);
+    uint16_t expected_ms = GNSS_OPERATING_PERIOD_MS < 100 ? 100 : GNSS_OPERATING_PERIOD_MS;
+    uint32_t naks = (GNSS_OPERATING_PERIOD_MS < 50) + (GNSS_OPERATING_PERIOD_MS < 100);
+    printf("NAK below 10Hz: running at %u ms after %u CFG-RATE\n", gnss.getMeasurementPeriod_ms(),
+           module.countCommands(0x06, CFG_RATE));
+    CHECK_EQUAL(expected_ms, module.period_ms);
+    CHECK_EQUAL(expected_ms, gnss.getMeasurementPeriod_ms());
+    CHECK_EQUAL(naks + 1, module.countCommands(0x06, CFG_RATE));
+    CHECK_EQUAL(1, module.countCommands(0x06, CFG_PRT));
+    uint32_t sequence = gnss.getSequence();
+    run(module, gnss, 2000);
+    CHECK_NEAR(2000 / expected_ms, gnss.getSequence() - sequence, 1);
+
+    // no rate accepted: down to GNSS_MEASUREMENT_PERIOD_MS, GNSS_CONFIG_RETRIES NAKs there,
+    // then a new search - it never runs
+    module.reset(true, GNSS_OPERATING_BAUD);
+    module.minPeriod_ms = 1001;
+    now_ms = 0;
+    gnss.begin();
+    CHECK_EQUAL(-1, run(module, gnss, 1000));
+    uint32_t polls = module.countCommands(UBX_CLASS_NAV, UBX_NAV_PVT);
+    uint32_t ports = module.countCommands(0x06, CFG_PRT);
+    uint32_t rates = module.countCommands(0x06, CFG_RATE);
+    uint32_t ratesPerSearch = GNSS_CONFIG_RETRIES + (GNSS_OPERATING_PERIOD_MS < 50) + (GNSS_OPERATING_PERIOD_MS < 100) +
+                              (GNSS_OPERATING_PERIOD_MS < GNSS_MEASUREMENT_PERIOD_MS);
+    printf("NAK: %u polls, %u CFG-PRT, %u CFG-RATE in 1s\n", polls, ports, rates);
+    CHECK(polls >= 2);
+    CHECK(rates <= ratesPerSearch * ports && rates >= ratesPerSearch * (ports - 1));
+    CHECK_EQUAL(0, module.countCommands(0x06, CFG_MSG));
+
+    // firmware update of the module: the next search configures it
+    module.minPeriod_ms = 25;
+    CHECK(run(module, gnss, 1000) > 0);
+}
+
+static void testPowerCycle(void) {
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    module.reset(true, 9600);
+    now_ms = 0;
+    gnss.begin();
+    CHECK(run(module, gnss, 8000) > 0);
+
+    // power cycle: factory default at 9600, the running driver sees no more frames
+    module.reset(true, 9600);
+    presetPvt(module);
+    bool lost = false;
+    int32_t configured_ms = -1;
+    for (uint32_t ms = 10; ms <= 15000 && configured_ms < 0; ms += 10) {
+        run(module, gnss, 10);
+        if (!gnss.isConfigured()) lost = true;
+        else if (lost) configured_ms = (int32_t)ms;
+    }
+    printf("power cycle: configured again after %ld ms\n", (long)configured_ms);
+    CHECK(lost);
+    CHECK(configured_ms >= GNSS_RX_TIMEOUT_MS);
+    CHECK(configured_ms <= GNSS_RX_TIMEOUT_MS + 6 * GNSS_PROBE_TIMEOUT_MS + GNSS_PORT_SWITCH_MS + 200);
+    CHECK_EQUAL(GNSS_OPERATING_PERIOD_MS, module.period_ms);
+    uint32_t sequence = gnss.getSequence();
+    run(module, gnss, 2000);
+    CHECK(gnss.getSequence() - sequence >= 2000 / GNSS_OPERATING_PERIOD_MS - 1);
+    CHECK(gnss.hasValidFix());
+}
+
+// record of the gnss_cache: last good fix before the power down
+static GnssWarmStart storedFix(void) {
+    GnssWarmStart warmStart = GnssWarmStart();
+    warmStart.latitude = 481173021;
+    warmStart.longitude = -115166700;
+    warmStart.altitudeMSL = 545400;
+    warmStart.hAcc = 1500;
+    warmStart.year = 2026;
+    warmStart.month = 10;
+    warmStart.day = 18;
+    return warmStart;
+}
+
+static void testWarmStart(void) {
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    gnss.setWarmStart(storedFix());
+    module.reset(true, 9600);
+    now_ms = 0;
+    gnss.begin();
+    CHECK(run(module, gnss, 8000) > 0);
+
+    // MGA-INI-POS_LLH after the configuration, accuracy at least GNSS_AIDING_POSITION_ACCURACY_M
+    const GnssModuleCommand *aiding = module.lastCommand(0x13, 0x40);
+    CHECK(aiding != nullptr);
+    CHECK_EQUAL(0x01, aiding->payload[0]);
+    CHECK_EQUAL(54540, aiding->payload[12] | aiding->payload[13] << 8 | aiding->payload[14] << 16);
+    CHECK_EQUAL(GNSS_AIDING_POSITION_ACCURACY_M * 100UL,
+                aiding->payload[16] | aiding->payload[17] << 8 | (uint32_t)aiding->payload[18] << 16);
+    // MGA-INI-TIME_UTC only with a time source
+    CHECK_EQUAL(GNSS_AIDING_TIME_ACCURACY_S > 0 ? 2 : 1, module.countCommands(0x13, 0x40));
+}
+
+static void testTimeToFirstFix(void) {
+    // acquisition model: cold start 26s (u-blox M8 data sheet), 20s after a position aiding
+    // without ephemeris (assumed, to be measured on hardware). What the firmware adds is
+    // measured: the bring-up until the aiding reaches the module, and the time until the
+    // first fix of the module is published.
+    static const uint32_t cold_ms = 26000, aided_ms = 20000;
+    int32_t ttff_ms[2] = {-1, -1};
+    uint32_t aidingSent_ms = 0;
+    for (uint8_t warm = 0; warm < 2; warm++) {
+        GnssModule module;
+        UbloxGNSSWrapper gnss(module);
+        if (warm) gnss.setWarmStart(storedFix());
+        module.reset(true, 9600);
+        presetPvt(module);
+        module.coldTtff_ms = cold_ms;
+        module.aidedTtff_ms = aided_ms;
+        now_ms = 0;
+        gnss.begin();
+        for (uint32_t step = 0; step < 2 * cold_ms && ttff_ms[warm] < 0; step++) {
+            run(module, gnss, 1);
+            if (gnss.hasValidFix()) ttff_ms[warm] = (int32_t)now_ms;
+        }
+        CHECK_EQUAL(warm != 0, module.aided);
+        if (warm) aidingSent_ms = module.aidedAt_ms;
+    }
+    printf("TTFF: cold start %ld ms, warm start record %ld ms (aiding %lu ms after boot, model %lu / %lu ms)\n",
+           (long)ttff_ms[0], (long)ttff_ms[1], (unsigned long)aidingSent_ms, (unsigned long)cold_ms,
+           (unsigned long)aided_ms);
+    CHECK(ttff_ms[0] >= (int32_t)cold_ms && ttff_ms[0] <= (int32_t)(cold_ms + GNSS_OPERATING_PERIOD_MS + 10));
+    CHECK(aidingSent_ms > 0 && aidingSent_ms < 8000);
+    CHECK(ttff_ms[1] >= (int32_t)(aidingSent_ms + aided_ms));
+    CHECK(ttff_ms[1] <= (int32_t)(aidingSent_ms + aided_ms + GNSS_OPERATING_PERIOD_MS + 10));
+    CHECK(ttff_ms[1] < ttff_ms[0]);
+}
+
+int main(void) {
+    testProbeOrder();
+    testConfigure();
+    testUartBudget();
+    testLostAcks();
+    testNak();
+    testPowerCycle();
+    testWarmStart();
+    testTimeToFirstFix();
+    return TEST_RESULT();
+}
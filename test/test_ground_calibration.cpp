@@ -0,0 +1,122 @@
+/**
+ * @file test_ground_calibration.cpp
+ * @brief Convergence of the ground level calibration and the re-zero without AGL jump
+ *
+ * Seeded baro noise at different levels: a quiet sensor converges at
+ * GROUND_CAL_MIN_SAMPLES, typical noise somewhere between the limits with the standard
+ * error below GROUND_CAL_MAX_SEM_M, a disturbed start is closed at
+ * GROUND_CAL_MAX_SAMPLES. The start up samples are skipped. A re-zero at a new launch
+ * point keeps the previous ground until the new calibration is complete.
+ */
+
+#include "host_test.h"
+#include "ground_calibration.h"
+
+#define GROUND_M 420.0f
+
+static uint32_t randomState = 1;
+
+static float gaussian(void) {
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        randomState = randomState * 1664525U + 1013904223U;
+        sum += (randomState >> 8) / 16777216.0;
+    }
+    return (float)(sum - 6.0);
+}
+
+// samples until the calibration completes, 0 if it never does
+static uint16_t calibrate(GroundCalibration &calibration, float ground_m, float noise_m) {
+    for (uint16_t sample = 1; sample <= GROUND_CAL_SKIP_SAMPLES + GROUND_CAL_MAX_SAMPLES + 10; sample++) {
+        if (calibration.update(ground_m + noise_m * gaussian())) return sample;
+    }
+    return 0;
+}
+
+static void testConvergence(void) {
+    static const float noise_m[] = {0.01f, 0.1f, 0.2f, 0.3f, 1.0f};
+
+    printf("noise  samples  sem [cm]  error [cm]\n");
+    for (uint8_t i = 0; i < sizeof(noise_m) / sizeof(noise_m[0]); i++) {
+        GroundCalibration calibration;
+        randomState = 1;
+        CHECK(!calibration.isReady());
+        uint16_t samples = calibrate(calibration, GROUND_M, noise_m[i]);
+        float sem = calibration.getStandardError(), error = calibration.getGroundAltitude() - GROUND_M;
+        printf("%5.2f  %7u  %8.2f  %10.2f\n", noise_m[i], samples, sem * 100.0f, error * 100.0f);
+
+        CHECK(calibration.isReady());
+        CHECK(!calibration.isCalibrating());
+        CHECK_EQUAL(samples - GROUND_CAL_SKIP_SAMPLES, calibration.getSampleCount());
+        CHECK(calibration.getSampleCount() >= GROUND_CAL_MIN_SAMPLES);
+        CHECK(calibration.getSampleCount() <= GROUND_CAL_MAX_SAMPLES);
+        if (calibration.getSampleCount() < GROUND_CAL_MAX_SAMPLES) CHECK(sem < GROUND_CAL_MAX_SEM_M);
+        CHECK(fabsf(error) < 4.0f * sem);
+
+        if (noise_m[i] <= 0.01f) CHECK_EQUAL(GROUND_CAL_MIN_SAMPLES, calibration.getSampleCount());
+        if (noise_m[i] >= 1.0f) {       // disturbed: closed with the mean so far
+            CHECK_EQUAL(GROUND_CAL_MAX_SAMPLES, calibration.getSampleCount());
+            CHECK(sem > GROUND_CAL_MAX_SEM_M);
+        }
+
+        // fixed afterwards
+        float ground = calibration.getGroundAltitude();
+        CHECK(!calibration.update(GROUND_M + 100.0f));
+        CHECK_EQUAL(ground, calibration.getGroundAltitude());
+    }
+}
+
+static void testSkip(void) {
+    GroundCalibration calibration;
+
+    // sensor start up: the first samples are far off and must not count
+    for (uint8_t i = 0; i < GROUND_CAL_SKIP_SAMPLES; i++) CHECK(!calibration.update(GROUND_M - 50.0f));
+    CHECK_EQUAL(0, calibration.getSampleCount());
+    randomState = 1;
+    CHECK(calibrate(calibration, GROUND_M, 0.01f) > 0);
+    CHECK_NEAR(GROUND_M, calibration.getGroundAltitude(), 0.01);
+}
+
+static void testRezero(void) {
+    GroundCalibration calibration;
+    randomState = 7;
+    calibrate(calibration, GROUND_M, 0.1f);
+    float first = calibration.getGroundAltitude();
+
+    // moved to a launch point 5m higher, re-zero from the CLI / switch: AGL stays continuous
+    const float launch_m = GROUND_M + 5.0f;
+    calibration.rezero();
+    CHECK(calibration.isReady());
+    CHECK(calibration.isCalibrating());
+    CHECK_EQUAL(0, calibration.getSampleCount());
+    uint16_t samples = 0;
+    bool done = false;
+    while (!done && samples < GROUND_CAL_SKIP_SAMPLES + GROUND_CAL_MAX_SAMPLES) {
+        float altitude = launch_m + 0.1f * gaussian();
+        float agl = altitude - calibration.getGroundAltitude();
+        done = calibration.update(altitude);
+        samples++;
+        if (!done) {
+            CHECK_EQUAL(first, calibration.getGroundAltitude());
+            CHECK_NEAR(5.0, agl, 0.5);
+        }
+    }
+    CHECK(done);
+    CHECK(!calibration.isCalibrating());
+    CHECK(calibration.getSampleCount() >= GROUND_CAL_MIN_SAMPLES);
+    CHECK_NEAR(launch_m, calibration.getGroundAltitude(), GROUND_CAL_MAX_SEM_M * 4.0);
+
+    // re-zero before the first calibration is complete: nothing to keep, still not ready
+    GroundCalibration fresh;
+    fresh.update(GROUND_M);
+    fresh.rezero();
+    CHECK(!fresh.isReady());
+    CHECK(fresh.isCalibrating());
+}
+
+int main(void) {
+    testConvergence();
+    testSkip();
+    testRezero();
+    return TEST_RESULT();
+}
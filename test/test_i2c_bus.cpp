@@ -0,0 +1,319 @@
+/**
+ * @file test_i2c_bus.cpp
+ * @brief I2cBus queue, START handling, timeout and bus recovery on the HAL I2C mock
+ */
+
+#include "host_test.h"
+#include "i2c_bus.h"
+#include "i2c_mock.h"
+#include "timebase.h"
+#include <new>
+#include <string.h>
+
+#define SLAVE 0x76
+
+static uint32_t now_us = 0;
+
+// every clock read costs 1us - busy waits end and the mock STOP gets released
+extern "C" uint32_t timebase_micros(void) {
+    now_us++;
+    i2c_mock_tick(now_us);
+    return now_us;
+}
+
+static I2C_HandleTypeDef hi2c;
+static I2cBus *bus;
+static uint32_t callbacks;
+
+extern "C" void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *handle) {
+    bus->onTransferDone(handle, false);
+}
+
+extern "C" void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *handle) {
+    bus->onTransferDone(handle, false);
+}
+
+extern "C" void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *handle) {
+    bus->onTransferDone(handle, true);
+}
+
+static void countCallback(I2cTransaction *transaction) {
+    (void)transaction;
+    callbacks++;
+}
+
+static void setup(void) {
+    static uint8_t storage[sizeof(I2cBus)];
+    i2c_mock_reset(&hi2c, SLAVE);
+    now_us = 1000;
+    callbacks = 0;
+    bus = new (storage) I2cBus(&hi2c);
+}
+
+static void advance(uint32_t us) {
+    now_us += us;
+    i2c_mock_tick(now_us);
+}
+
+static I2cTransaction makeWrite(const uint8_t *data, uint8_t length) {
+    I2cTransaction transaction;
+    memset(&transaction, 0, sizeof(transaction));
+    transaction.address = SLAVE;
+    transaction.txData = data;
+    transaction.txLength = length;
+    transaction.callback = countCallback;
+    return transaction;
+}
+
+static void testWrite(void) {
+    static const uint8_t data[] = {0x06, 0x33};
+    setup();
+    I2cTransaction write = makeWrite(data, sizeof(data));
+
+    CHECK(bus->submit(&write));
+    CHECK_EQUAL(1, i2c_mock.logCount);          // started right away on an idle bus
+    CHECK_EQUAL(I2C_FIRST_AND_LAST_FRAME, i2c_mock.log[0].options);
+    CHECK_EQUAL(I2C_STATUS_BUSY, write.status);
+    CHECK(!bus->submit(&write));                // still pending
+    advance(200);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(I2C_STATUS_DONE, write.status);
+    CHECK_EQUAL(1, callbacks);
+    CHECK_EQUAL(0x33, i2c_mock.registers[0x06]);
+    CHECK(write.busTime_us >= 200);
+    CHECK(bus->isIdle());
+}
+
+static void testWriteRead(void) {
+    static const uint8_t reg = 0x10;
+    uint8_t rx[3] = {0};
+    setup();
+    i2c_mock.registers[0x10] = 0xA1;
+    i2c_mock.registers[0x11] = 0xB2;
+    i2c_mock.registers[0x12] = 0xC3;
+    I2cTransaction read = makeWrite(&reg, 1);
+    read.rxData = rx;
+    read.rxLength = sizeof(rx);
+
+    CHECK(bus->submit(&read));
+    CHECK_EQUAL(I2C_FIRST_FRAME, i2c_mock.log[0].options);     // no STOP before the read
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(2, i2c_mock.logCount);
+    CHECK(i2c_mock.log[1].read);
+    CHECK_EQUAL(I2C_LAST_FRAME, i2c_mock.log[1].options);     // repeated START
+    CHECK_EQUAL(I2C_STATUS_BUSY, read.status);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(I2C_STATUS_DONE, read.status);
+    CHECK_EQUAL(0xA1, rx[0]);
+    CHECK_EQUAL(0xB2, rx[1]);
+    CHECK_EQUAL(0xC3, rx[2]);
+}
+
+static void testBackToBack(void) {
+    static const uint8_t a[] = {0x01, 0x11};
+    static const uint8_t b[] = {0x02, 0x22};
+    setup();
+    I2cTransaction first = makeWrite(a, 2);
+    I2cTransaction second = makeWrite(b, 2);
+
+    bus->submit(&first);
+    bus->submit(&second);
+    CHECK_EQUAL(1, i2c_mock.logCount);
+    CHECK_EQUAL(I2C_STATUS_QUEUED, second.status);
+    // the STOP clears BUSY 5us after the interrupt: no wait there, the next START follows from schedule()
+    uint32_t before = now_us;
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK(now_us - before <= 5);            // no busy wait in the interrupt
+    CHECK_EQUAL(1, i2c_mock.logCount);
+    CHECK_EQUAL(I2C_STATUS_DONE, first.status);
+    CHECK_EQUAL(I2C_STATUS_BUSY, second.status);    // claimed, START pending
+    advance(5);
+    bus->schedule(now_us);
+    CHECK_EQUAL(2, i2c_mock.logCount);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(I2C_STATUS_DONE, second.status);
+    CHECK_EQUAL(0, i2c_mock.busyStarts);
+}
+
+static void testSlowStop(void) {
+    static const uint8_t a[] = {0x01, 0x11};
+    static const uint8_t b[] = {0x02, 0x22};
+    setup();
+    i2c_mock.stopDelay_us = 100;            // longer than I2C_BUS_STOP_WAIT_US
+    I2cTransaction first = makeWrite(a, 2);
+    I2cTransaction second = makeWrite(b, 2);
+
+    bus->submit(&first);
+    bus->submit(&second);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(1, i2c_mock.logCount);                        // START left to schedule()
+    CHECK_EQUAL(I2C_STATUS_BUSY, second.status);
+    uint32_t before = now_us;
+    bus->schedule(now_us);                  // bus still busy: bounded wait, no HAL call
+    CHECK(now_us - before <= I2C_BUS_STOP_WAIT_US + 10);
+    CHECK_EQUAL(1, i2c_mock.logCount);
+    advance(100);
+    bus->schedule(now_us);
+    CHECK_EQUAL(2, i2c_mock.logCount);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(I2C_STATUS_DONE, second.status);
+    CHECK_EQUAL(0, i2c_mock.busyStarts);
+}
+
+static void testNack(void) {
+    static const uint8_t data[] = {0x00};
+    setup();
+    I2cTransaction write = makeWrite(data, 1);
+    write.address = 0x55;                   // nobody there
+
+    bus->submit(&write);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(I2C_STATUS_NACK, write.status);
+    I2cBusStats stats;
+    bus->getStats(&stats, now_us);
+    CHECK_EQUAL(1, stats.errors);
+    CHECK_EQUAL(0, stats.timeouts);
+}
+
+static void testRefusedStart(void) {
+    static const uint8_t data[] = {0x03, 0x44};
+    setup();
+    I2cTransaction write = makeWrite(data, 2);
+
+    // handle busy for the first two attempts, then accepted by schedule()
+    i2c_mock.refuseStarts = 2;
+    bus->submit(&write);
+    CHECK_EQUAL(0, i2c_mock.logCount);
+    bus->schedule(now_us);
+    CHECK_EQUAL(0, i2c_mock.logCount);
+    bus->schedule(now_us);
+    CHECK_EQUAL(1, i2c_mock.logCount);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(I2C_STATUS_DONE, write.status);
+
+    // refused for good: the timeout applies to the start as well
+    i2c_mock.refuseStarts = 255;
+    bus->submit(&write);
+    for (int i = 0; i < 10; i++) {
+        advance(1000);
+        bus->schedule(now_us);
+    }
+    CHECK_EQUAL(I2C_STATUS_TIMEOUT, write.status);
+    CHECK_EQUAL(1, i2c_mock.inits);         // recovered
+    CHECK(bus->isIdle());
+}
+
+static void testStuckBus(void) {
+    static const uint8_t data[] = {0x04, 0x55};
+    setup();
+    I2cTransaction write = makeWrite(data, 2);
+    I2cTransaction next = makeWrite(data, 2);
+
+    // slave reset in the middle of a read: SDA low, BUSY set, 3 clocks to finish its byte
+    host_I2C1.SR2 |= I2C_SR2_BUSY;
+    i2c_mock.sdaHeldClocks = 3;
+    bus->submit(&write);
+    bus->submit(&next);
+    bus->schedule(now_us);
+    CHECK_EQUAL(0, i2c_mock.logCount);      // the HAL never sees the busy bus
+    CHECK_EQUAL(0, i2c_mock.busyStarts);
+    advance(I2C_BUS_TIMEOUT_US + 1);
+    bus->schedule(now_us);
+    CHECK_EQUAL(I2C_STATUS_TIMEOUT, write.status);
+    CHECK_EQUAL(1, i2c_mock.deinits);
+    CHECK_EQUAL(1, i2c_mock.inits);
+    CHECK_EQUAL(4, i2c_mock.sclClocks);     // 3 until SDA was released + the one of the STOP
+    CHECK_EQUAL(1, i2c_mock.stops);
+    // BUSY cleared: the queue carries on after the recovery
+    CHECK_EQUAL(1, i2c_mock.logCount);
+    CHECK_EQUAL(I2C_STATUS_BUSY, next.status);
+    CHECK(i2c_mock_complete(&hi2c, now_us));
+    CHECK_EQUAL(I2C_STATUS_DONE, next.status);
+    I2cBusStats stats;
+    bus->getStats(&stats, now_us);
+    CHECK_EQUAL(1, stats.timeouts);
+}
+
+static void testLostInterrupt(void) {
+    static const uint8_t data[] = {0x05, 0x66};
+    setup();
+    I2cTransaction write = makeWrite(data, 2);
+
+    bus->submit(&write);
+    advance(I2C_BUS_TIMEOUT_US / 2);
+    bus->schedule(now_us);
+    CHECK_EQUAL(I2C_STATUS_BUSY, write.status);
+    advance(I2C_BUS_TIMEOUT_US);
+    bus->schedule(now_us);
+    CHECK_EQUAL(I2C_STATUS_TIMEOUT, write.status);
+    CHECK_EQUAL(1, callbacks);
+    CHECK(!i2c_mock_complete(&hi2c, now_us));   // late interrupt after the reset does not complete it again
+    CHECK_EQUAL(1, callbacks);
+}
+
+static void testPeriodic(void) {
+    static const uint8_t reg = 0x00;
+    uint8_t rx[6];
+    setup();
+    I2cTransaction burst = makeWrite(&reg, 1);
+    burst.rxData = rx;
+    burst.rxLength = sizeof(rx);
+
+    CHECK(bus->addPeriodic(&burst, 10000));
+    for (int step = 0; step < 100; step++) {  // 100ms, bus answers within the step
+        advance(1000);
+        bus->schedule(now_us);
+        while (i2c_mock_complete(&hi2c, now_us)) {}
+    }
+    CHECK(callbacks >= 9 && callbacks <= 11);
+
+    // slave not answering for 50ms: no pile up, one transaction at a time
+    uint32_t before = i2c_mock.logCount;
+    for (int step = 0; step < 50; step++) {
+        advance(1000);
+        bus->schedule(now_us);
+    }
+    CHECK(i2c_mock.logCount - before <= 10);
+}
+
+static void testPeriodicSuspend(void) {
+    static const uint8_t reg = 0x00;
+    uint8_t rx[6];
+    setup();
+    I2cTransaction burst = makeWrite(&reg, 1);
+    burst.rxData = rx;
+    burst.rxLength = sizeof(rx);
+
+    bus->addPeriodic(&burst, 10000);
+    bus->schedule(now_us);
+    CHECK_EQUAL(1, i2c_mock.logCount);
+    bus->setPeriodicEnabled(&burst, false);
+    while (i2c_mock_complete(&hi2c, now_us)) {}     // the running one still completes
+    CHECK_EQUAL(I2C_STATUS_DONE, burst.status);
+    for (int step = 0; step < 50; step++) {
+        advance(1000);
+        bus->schedule(now_us);
+    }
+    CHECK_EQUAL(2, i2c_mock.logCount);
+    bus->setPeriodicEnabled(&burst, true);
+    bus->schedule(now_us);                  // resumed right away, no catch up burst
+    CHECK_EQUAL(3, i2c_mock.logCount);
+    while (i2c_mock_complete(&hi2c, now_us)) {}
+    bus->schedule(now_us);
+    CHECK_EQUAL(4, i2c_mock.logCount);
+}
+
+int main(void) {
+    testWrite();
+    testWriteRead();
+    testBackToBack();
+    testSlowStop();
+    testNack();
+    testRefusedStart();
+    testStuckBus();
+    testLostInterrupt();
+    testPeriodic();
+    testPeriodicSuspend();
+    CHECK_EQUAL(0, i2c_mock.maskedStarts);      // every HAL start ran with interrupts enabled
+    return TEST_RESULT();
+}
@@ -0,0 +1,260 @@
+/**
+ * @file test_my_serial.cpp
+ * @brief mySerial RX FIFO: circular RX DMA through a flash write stall, GNSS high-rate budget
+ *
+ * The USART and the DMA channel are host structs, the test plays the DMA: every byte of
+ * the line goes to the buffer at the transfer counter position, CNDTR counts down and
+ * reloads. Checked: the channel setup, CRSF RC frames at the ELRS 1000Hz packet rate
+ * read at the main loop cadence, and the same traffic across a 40ms flash erase stall
+ * without a read - every byte arrives in order.
+ *
+ * GNSS in high-rate mode: 25Hz NAV-PVT at 230400 baud through the RX interrupt path
+ * (one byte per RX complete callback) into the GNSS FIFO, emptied at a jittered main
+ * loop cadence with a long pass now and then. And the interrupt budget of USART3 at
+ * priority 1 against the priority 0 handlers.
+ */
+
+#include "host_test.h"
+#include "mySerial.h"
+#include "uart_config.h"
+#include "ublox_gnss_wrapper.h"
+#include "ubx_parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CRSF_FRAME_SIZE 26                  // RC channels packed: sync, length, type, 22 bytes, CRC
+#define HIGH_RATE_HZ 25
+
+static USART_TypeDef usart;
+static DMA_Channel_TypeDef dma;
+static UART_HandleTypeDef huart;
+
+// the 32 bit CMAR holds the low half of the host pointer: the allocations of init() resolve it
+static void *allocations[8];
+static uint8_t allocationCount = 0;
+
+void *operator new[](size_t size) {
+    void *memory = malloc(size);
+    if (allocationCount < 8) allocations[allocationCount++] = memory;
+    return memory;
+}
+
+void operator delete[](void *memory) noexcept {
+    free(memory);
+}
+
+static uint8_t *dmaBuffer(void) {
+    for (uint8_t i = 0; i < allocationCount; i++) {
+        if ((uint32_t)(uintptr_t)allocations[i] == dma.CMAR) return (uint8_t *)allocations[i];
+    }
+    return nullptr;
+}
+
+extern "C" {
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *handle) {
+    CLEAR_BIT(handle->Instance->CR3, USART_CR3_DMAR);
+    handle->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *handle, uint8_t *data, uint16_t size) {
+    (void)data;
+    (void)size;
+    handle->RxState = HAL_UART_STATE_BUSY_RX;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *handle, const uint8_t *data, uint16_t size) {
+    (void)handle;
+    (void)data;
+    (void)size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef *handle) {
+    (void)handle;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit_IT(UART_HandleTypeDef *handle) {
+    (void)handle;
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void) {
+    return 0;
+}
+}
+
+static void dmaReceive(uint8_t value) {
+    if (!(dma.CCR & DMA_CCR_EN) || !(usart.CR3 & USART_CR3_DMAR)) return;
+    uint8_t *buffer = dmaBuffer();
+    buffer[UART_CRSF_RX_FIFO_SIZE - dma.CNDTR] = value;
+    if (--dma.CNDTR == 0 && (dma.CCR & DMA_CCR_CIRC)) dma.CNDTR = UART_CRSF_RX_FIFO_SIZE;
+}
+
+static void setup(mySerial &serial) {
+    memset(&usart, 0, sizeof(usart));
+    memset(&dma, 0, sizeof(dma));
+    memset(&huart, 0, sizeof(huart));
+    huart.Instance = &usart;
+    allocationCount = 0;
+    serial.init(&huart, UART_CRSF_FIFO_SIZE, UART_CRSF_TX_BUF_SIZE, &dma, UART_CRSF_RX_FIFO_SIZE);
+}
+
+static void testDmaSetup(void) {
+    mySerial serial;
+    setup(serial);
+
+    CHECK_EQUAL((uint32_t)(uintptr_t)&usart.DR, dma.CPAR);
+    CHECK(dmaBuffer() != nullptr);
+    CHECK_EQUAL(UART_CRSF_RX_FIFO_SIZE, dma.CNDTR);
+    CHECK_EQUAL(DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN, dma.CCR);     // peripheral -> memory, bytes
+    CHECK(usart.CR3 & USART_CR3_DMAR);
+    CHECK(huart.RxState != HAL_UART_STATE_BUSY_RX);                     // no RX interrupt
+    CHECK_EQUAL(0, serial.available());
+
+    // restart (CRSF watchdog): FIFO empty, transfer from the start of the buffer again
+    dmaReceive(0x11);
+    dmaReceive(0x22);
+    CHECK_EQUAL(2, serial.available());
+    CHECK_EQUAL(0, serial.restart_RX());
+    CHECK_EQUAL(UART_CRSF_RX_FIFO_SIZE, dma.CNDTR);
+    CHECK(usart.CR3 & USART_CR3_DMAR);
+    CHECK_EQUAL(0, serial.available());
+    dmaReceive(0x33);
+    uint8_t byte = 0;
+    CHECK_EQUAL(1, serial.read(&byte, 1));
+    CHECK_EQUAL(0x33, byte);
+}
+
+// CRSF traffic at 1000 frames/s for duration_ms, read every 3ms unless stalled and at the end
+static void crsfTraffic(mySerial &serial, uint32_t duration_ms, uint32_t stallFrom_ms, uint32_t stallTo_ms,
+                        uint32_t *sent, uint32_t *received, uint32_t *mismatches) {
+    for (uint32_t now_ms = 0; now_ms < duration_ms; now_ms++) {
+        for (uint8_t i = 0; i < CRSF_FRAME_SIZE; i++, (*sent)++) dmaReceive((uint8_t)(*sent * 7 + (*sent >> 8)));
+        bool last = now_ms == duration_ms - 1;
+        if (!last && (now_ms % 3 != 2 || (now_ms >= stallFrom_ms && now_ms < stallTo_ms))) continue;
+        uint8_t data[64];
+        size_t length;
+        while ((length = serial.read(data, sizeof(data))) > 0) {
+            for (size_t i = 0; i < length; i++, (*received)++) {
+                if (data[i] != (uint8_t)(*received * 7 + (*received >> 8))) (*mismatches)++;
+            }
+        }
+    }
+}
+
+static void testFlashStall(void) {
+    mySerial serial;
+    uint32_t sent = 0, received = 0, mismatches = 0;
+    setup(serial);
+
+    // 1s of traffic, the flash page erase (40ms worst case) stalls the main loop after 500ms
+    crsfTraffic(serial, 1000, 500, 540, &sent, &received, &mismatches);
+    printf("CRSF 1000Hz, 40ms stall: %u bytes sent, %u received, %u wrong, FIFO %u bytes\n", (unsigned)sent,
+           (unsigned)received, (unsigned)mismatches, (unsigned)UART_CRSF_RX_FIFO_SIZE);
+    CHECK_EQUAL(sent, received);
+    CHECK_EQUAL(0, mismatches);
+    CHECK_EQUAL(sent, serial.getStats().rxBytes);
+    CHECK_EQUAL(0, serial.getStats().rxOverflows);
+    CHECK(40 * CRSF_FRAME_SIZE < UART_CRSF_RX_FIFO_SIZE);
+}
+
+static uint32_t lcg = 12345;
+
+static uint32_t nextRandom(uint32_t range) {
+    lcg = lcg * 1664525UL + 1013904223UL;
+    return (lcg >> 8) % range;
+}
+
+static void testGnssHighRate(void) {
+    mySerial serial;
+    UbxParser parser;
+    memset(&usart, 0, sizeof(usart));
+    memset(&huart, 0, sizeof(huart));
+    huart.Instance = &usart;
+    serial.init(&huart, UART_GNSS_FIFO_SIZE, UART_GNSS_TX_BUF_SIZE);
+    CHECK(huart.RxState == HAL_UART_STATE_BUSY_RX);                     // RX interrupt, no DMA
+
+    uint8_t frame[UBX_MAX_PAYLOAD + UBX_FRAME_OVERHEAD] = {0};
+    uint16_t length = UbxParser::buildFrame(frame, UBX_CLASS_NAV, UBX_NAV_PVT, frame + 6, UBX_MAX_PAYLOAD);
+    const double byte_us = 10e6 / GNSS_HIGH_RATE_BAUD;                  // 8N1
+    const uint32_t period_us = 1000000 / HIGH_RATE_HZ;
+
+    // main loop: a pass every 2..4ms (HAL_Delay(2) + the tasks), once a second a 30ms pass
+    // (a Wire transfer running into its 25ms timeout)
+    uint32_t frames = 0, reads = 0, longest_us = 0;
+    uint32_t next_read_us = 3000, last_read_us = 0;
+    for (uint32_t epoch = 0; epoch < 10 * HIGH_RATE_HZ; epoch++) {
+        for (uint16_t i = 0; i < length; i++) {
+            uint32_t now_us = epoch * period_us + (uint32_t)(i * byte_us);
+            while (next_read_us <= now_us) {
+                uint8_t data[64];
+                size_t count;
+                while ((count = serial.read(data, sizeof(data))) > 0) {
+                    for (size_t j = 0; j < count; j++) frames += parser.parse(data[j]);
+                }
+                if (next_read_us - last_read_us > longest_us) longest_us = next_read_us - last_read_us;
+                last_read_us = next_read_us;
+                reads++;
+                next_read_us += (reads % 300 == 0) ? 30000 : 2000 + nextRandom(2001);
+            }
+            serial.get_uart_rx_buffer()[0] = frame[i];                  // HAL_UART_RxCpltCallback
+            serial.set_ready_RX();
+            serial.receive();
+        }
+        frame[6] = (uint8_t)epoch;                                      // iTOW: a new checksum each epoch
+        length = UbxParser::buildFrame(frame, UBX_CLASS_NAV, UBX_NAV_PVT, frame + 6, UBX_MAX_PAYLOAD);
+    }
+    uint8_t data[64];
+    size_t count;
+    while ((count = serial.read(data, sizeof(data))) > 0) {
+        for (size_t j = 0; j < count; j++) frames += parser.parse(data[j]);
+    }
+
+    const SerialStats &stats = serial.getStats();
+    uint32_t fifoTime_ms = (uint32_t)((UART_GNSS_FIFO_SIZE - 1) / (double)(length * HIGH_RATE_HZ) * 1000);
+    printf("GNSS %u Hz at %u baud: %u frames, %u bytes, %u FIFO overflows, longest loop pass %u ms, FIFO holds %u ms\n",
+           HIGH_RATE_HZ, GNSS_HIGH_RATE_BAUD, (unsigned)frames, (unsigned)stats.rxBytes, (unsigned)stats.rxOverflows,
+           (unsigned)(longest_us / 1000), (unsigned)fifoTime_ms);
+    CHECK_EQUAL(0, stats.rxOverflows);
+    CHECK_EQUAL(10 * HIGH_RATE_HZ, frames);
+    CHECK_EQUAL(0, parser.getStats().checksumErrors);
+    CHECK_EQUAL(10 * HIGH_RATE_HZ * length, stats.rxBytes);
+    CHECK(longest_us >= 30000);
+}
+
+static void testInterruptBudget(void) {
+    // USART3 (GNSS) at preemption priority 1: RXNE must be served within one byte time or the
+    // next byte overruns. Worst case: every priority 0 handler becomes pending just before.
+    // Cycles at 72MHz, estimated from the handler code paths incl. the HAL, 18 cycles entry /
+    // exit each - to be confirmed with the DWT cycle counter on the board.
+    struct Handler {
+        const char *name;
+        uint32_t cycles;
+    };
+    static const Handler priority0[] = {
+        {"DMA1_Channel1 (ADC block sum, 64 scans x 2)", 900},
+        {"I2C1_EV (event + next transfer start)", 400},
+        {"I2C1_ER (error, bus recovery start)", 150},
+        {"USART1 (CRSF telemetry TX byte)", 100},
+        {"EXTI9_5 (PPS edge capture)", 60},
+    };
+    static const uint32_t usart3_cycles = 250;  // HAL RX, callback, FIFO push, re-arm
+    uint32_t cycles = usart3_cycles;
+    for (uint8_t i = 0; i < sizeof(priority0) / sizeof(priority0[0]); i++) cycles += priority0[i].cycles + 18;
+    double latency_us = cycles / 72.0;
+    double byte_us = 10e6 / GNSS_HIGH_RATE_BAUD;
+    printf("USART3 worst case RX latency %.1f us, byte time %.1f us at %u baud\n", latency_us, byte_us,
+           GNSS_HIGH_RATE_BAUD);
+    CHECK(latency_us < 0.75 * byte_us);
+}
+
+int main(void) {
+    testDmaSetup();
+    testFlashStall();
+    testGnssHighRate();
+    testInterruptBudget();
+    return TEST_RESULT();
+}
@@ -0,0 +1,264 @@
+/**
+ * @file test_nmea_parser.cpp
+ * @brief NMEA parser against golden sentences and the NMEA fallback of the GNSS wrapper
+ *
+ * The golden sentences are the NMEA 0183 reference examples and the u-blox protocol
+ * description examples with their published checksums. Checked: GGA / RMC / VTG decoding,
+ * hemispheres, empty fields, talker variants, and what is dropped (checksum, length,
+ * field count, missing checksum). Then a generic module (GnssModule without UBX) at
+ * 9600 / 4800 / 38400 baud in three sentence orders: found in NMEA mode and the merged
+ * GnssSnapshot of one fix.
+ */
+
+#include "host_test.h"
+#include "gnss_module.h"
+#include "nmea_parser.h"
+#include "ublox_gnss_wrapper.h"
+
+static uint32_t now_ms = 0;
+
+uint32_t millis(void) {
+    return now_ms;
+}
+
+uint32_t micros(void) {
+    return now_ms * 1000;
+}
+
+extern "C" uint32_t timebase_micros(void) {
+    return now_ms * 1000;
+}
+
+// feed a sentence, true if it completed one with a valid checksum
+static bool feed(NmeaParser &parser, const char *text) {
+    bool complete = false;
+    for (const char *c = text; *c; c++) complete |= parser.parse((uint8_t)*c);
+    return complete;
+}
+
+static void testGga(void) {
+    NmeaParser parser;
+    NmeaGga gga;
+
+    CHECK(feed(parser, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n"));
+    CHECK_EQUAL(NMEA_GGA, parser.getType());
+    CHECK(parser.decodeGga(&gga));
+    CHECK(gga.timeValid && gga.positionValid && gga.altitudeValid && gga.hDOPValid);
+    CHECK_EQUAL((12 * 3600 + 35 * 60 + 19) * 1000UL, gga.time_ms);
+    CHECK_EQUAL(481173000, gga.lat);
+    CHECK_EQUAL(115166667, gga.lon);        // 31 minutes / 60, rounded
+    CHECK_EQUAL(545400, gga.altitudeMSL);
+    CHECK_EQUAL(90, gga.hDOP);
+    CHECK_EQUAL(1, gga.quality);
+    CHECK_EQUAL(8, gga.numSV);
+
+    // u-blox: GN talker, 5 minute decimals, centiseconds
+    CHECK(feed(parser, "$GNGGA,092725.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,*45\r\n"));
+    CHECK(parser.decodeGga(&gga));
+    CHECK_EQUAL((9 * 3600 + 27 * 60 + 25) * 1000UL, gga.time_ms);
+    CHECK_EQUAL(472852332, gga.lat);
+    CHECK_EQUAL(85652650, gga.lon);
+    CHECK_EQUAL(499600, gga.altitudeMSL);
+    CHECK_EQUAL(101, gga.hDOP);
+
+    // south / west, 7 minute decimals, negative altitude, ms
+    CHECK(feed(parser, "$GLGGA,235959.999,3352.1234567,S,15112.7654321,W,2,12,0.55,-12.5,M,,,,*3E\r\n"));
+    CHECK(parser.decodeGga(&gga));
+    CHECK_EQUAL(86399999UL, gga.time_ms);
+    CHECK_EQUAL(-338687243, gga.lat);
+    CHECK_EQUAL(-1512127572, gga.lon);
+    CHECK_EQUAL(-12500, gga.altitudeMSL);
+    CHECK_EQUAL(55, gga.hDOP);
+    CHECK_EQUAL(2, gga.quality);
+    CHECK_EQUAL(12, gga.numSV);
+
+    // no fix yet: empty fields
+    CHECK(feed(parser, "$GPGGA,,,,,,0,00,99.99,,,,,,*48\r\n"));
+    CHECK(parser.decodeGga(&gga));
+    CHECK(!gga.timeValid && !gga.positionValid && !gga.altitudeValid);
+    CHECK(gga.hDOPValid);
+    CHECK_EQUAL(9999, gga.hDOP);
+    CHECK_EQUAL(0, gga.quality);
+    CHECK_EQUAL(0, gga.numSV);
+    NmeaRmc rmc;
+    CHECK(!parser.decodeRmc(&rmc));         // other type
+}
+
+static void testRmcVtg(void) {
+    NmeaParser parser;
+    NmeaRmc rmc;
+    NmeaVtg vtg;
+
+    CHECK(feed(parser, "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n"));
+    CHECK_EQUAL(NMEA_RMC, parser.getType());
+    CHECK(parser.decodeRmc(&rmc));
+    CHECK(rmc.active && rmc.timeValid && rmc.positionValid && rmc.speedValid && rmc.courseValid && rmc.dateValid);
+    CHECK_EQUAL(481173000, rmc.lat);
+    CHECK_EQUAL(115166667, rmc.lon);
+    CHECK_EQUAL(11524, rmc.speed);          // 22.4kn * 514.444
+    CHECK_EQUAL(8440000, rmc.course);
+    CHECK_EQUAL(23, rmc.day);
+    CHECK_EQUAL(3, rmc.month);
+    CHECK_EQUAL(0, rmc.mode);               // NMEA 2.2: no mode field
+
+    CHECK(feed(parser, "$GNRMC,083559.00,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A*49\r\n"));
+    CHECK(parser.decodeRmc(&rmc));
+    CHECK_EQUAL(2, rmc.speed);
+    CHECK_EQUAL(7752000, rmc.course);
+    CHECK_EQUAL(2002, rmc.year);
+    CHECK_EQUAL(12, rmc.month);
+    CHECK_EQUAL(9, rmc.day);
+    CHECK_EQUAL('A', rmc.mode);
+
+    CHECK(feed(parser, "$GPRMC,,V,,,,,,,,,,N*53\r\n"));
+    CHECK(parser.decodeRmc(&rmc));
+    CHECK(!rmc.active && !rmc.timeValid && !rmc.positionValid && !rmc.speedValid && !rmc.dateValid);
+    CHECK_EQUAL('N', rmc.mode);
+
+    CHECK(feed(parser, "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n"));
+    CHECK_EQUAL(NMEA_VTG, parser.getType());
+    CHECK(parser.decodeVtg(&vtg));
+    CHECK(vtg.speedValid && vtg.courseValid);
+    CHECK_EQUAL(5470000, vtg.course);       // true, not magnetic
+    CHECK_EQUAL(2829, vtg.speed);
+    CHECK_EQUAL(0, vtg.mode);
+
+    CHECK(feed(parser, "$GPVTG,77.52,T,,M,0.004,N,0.008,K,A*06\r\n"));
+    CHECK(parser.decodeVtg(&vtg));
+    CHECK_EQUAL(7752000, vtg.course);
+    CHECK_EQUAL(2, vtg.speed);
+    CHECK_EQUAL('A', vtg.mode);
+}
+
+static void testFraming(void) {
+    NmeaParser parser;
+
+    // proprietary and unknown sentences are valid, but no GGA / RMC / VTG
+    CHECK(feed(parser, "$PUBX,00,081350.00,4717.113210,N,00833.915187,E*0B\r\n"));
+    CHECK_EQUAL(NMEA_OTHER, parser.getType());
+    CHECK_EQUAL(0, strcmp("PUBX", parser.getField(0)));
+    CHECK_EQUAL(0, strcmp("", parser.getField(20)));
+    CHECK_EQUAL(1, parser.getStats().sentences);
+    CHECK(feed(parser, "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n"));
+    CHECK_EQUAL(NMEA_OTHER, parser.getType());
+
+    // checksum error
+    uint32_t errors = parser.getStats().checksumErrors;
+    CHECK(!feed(parser, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*46\r\n"));
+    CHECK_EQUAL(errors + 1, parser.getStats().checksumErrors);
+
+    // dropped: no checksum, too long (100 characters), too many fields (28), invalid checksum digit
+    uint32_t dropped = parser.getStats().dropped;
+    CHECK(!feed(parser, "$GPGGA,123519,4807.038,N\r\n"));
+    CHECK(!feed(parser, "$GPTXT,01,01,02,0123456789012345678901234567890123456789012345678901234567890123456789012345678901234*79\r\n"));
+    CHECK(!feed(parser, "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00,14,,,,15,,,*75\r\n"));
+    CHECK(!feed(parser, "$GPVTG,77.52,T,,M,0.004,N,0.008,K,A*0G\r\n"));
+    CHECK_EQUAL(dropped + 4, parser.getStats().dropped);
+
+    // '$' inside a sentence starts the next one (lost bytes)
+    CHECK(feed(parser, "$GPGGA,1235$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n"));
+    CHECK_EQUAL(NMEA_VTG, parser.getType());
+
+    // lower case hex
+    CHECK(feed(parser, "$GLGGA,235959.999,3352.1234567,S,15112.7654321,W,2,12,0.55,-12.5,M,,,,*3e\r\n"));
+    CHECK_EQUAL(NMEA_GGA, parser.getType());
+}
+
+// generic module: one fix per second, 2026-10-18 from 12:35:00 UTC
+static uint8_t sentenceOrder;
+
+static void genericOutput(GnssModule &module, uint32_t now_ms) {
+    char time[16], gga[96], rmc[96];
+    uint32_t second = now_ms / 1000;
+    snprintf(time, sizeof(time), "1235%02u.00", (unsigned)(second % 60));
+    snprintf(gga, sizeof(gga), "GNGGA,%s,4807.0381234,N,01131.0002,W,1,08,0.9,545.4,M,46.9,M,,", time);
+    snprintf(rmc, sizeof(rmc), "GPRMC,%s,A,4807.0381234,N,01131.0002,W,022.4,084.4,181026,003.1,W,A", time);
+    const char *vtg = "GPVTG,084.4,T,,M,022.4,N,041.5,K,A";
+    const char *gsa = "GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1";
+
+    switch (sentenceOrder) {
+    case 0:
+        module.sendNmea(rmc);
+        module.sendNmea(vtg);
+        module.sendNmea(gga);
+        module.sendNmea(gsa);
+        break;
+    case 1:
+        module.sendNmea(gga);
+        module.sendNmea(gsa);
+        module.sendNmea(rmc);
+        module.sendNmea(vtg);
+        break;
+    default:
+        module.sendNmea(gga);               // no RMC: no date
+        module.sendNmea(vtg);
+        break;
+    }
+}
+
+static void testFallback(uint32_t baud, uint8_t order) {
+    GnssModule module;
+    UbloxGNSSWrapper gnss(module);
+    module.reset(false, baud);
+    module.nmeaOutput = genericOutput;
+    sentenceOrder = order;
+    now_ms = 0;
+    gnss.begin();
+
+    int32_t found_ms = -1;
+    uint32_t sequence = 0, epochs = 0;
+    for (now_ms = 1; now_ms < 30000; now_ms++) {
+        module.step(now_ms);
+        if (now_ms % 10 != 0) continue;
+        gnss.update();
+        if (found_ms < 0 && gnss.isConfigured()) found_ms = (int32_t)now_ms;
+        if (gnss.getSequence() != sequence) {
+            sequence = gnss.getSequence();
+            epochs++;
+        }
+    }
+
+    GnssSnapshot snapshot;
+    CHECK(gnss.getSnapshot(&snapshot));
+    printf("%lu baud, order %u: %s after %ld ms, %lu epochs, iTOW %lu\n", (unsigned long)baud, order,
+           gnss.getStateName(), (long)found_ms, (unsigned long)epochs, (unsigned long)snapshot.iTOW);
+    CHECK_EQUAL(0, strcmp("nmea", gnss.getStateName()));
+    CHECK_EQUAL(baud, gnss.getBaudRate());
+    CHECK(found_ms > 0 && found_ms < 6 * GNSS_PROBE_TIMEOUT_MS + 100);
+    CHECK_EQUAL(0, module.logCount);        // nothing was configured
+    CHECK_NEAR((30000 - found_ms) / 1000, epochs, 1);   // one merged epoch per fix
+    CHECK_EQUAL(0, gnss.getNmeaStats().checksumErrors);
+
+    CHECK(snapshot.fixOK);
+    CHECK_EQUAL(3, snapshot.fixType);
+    CHECK_EQUAL(8, snapshot.numSV);
+    CHECK_EQUAL(481173021, snapshot.latitude);
+    CHECK_EQUAL(-115166700, snapshot.longitude);
+    CHECK_EQUAL(545400, snapshot.altitudeMSL);
+    CHECK_EQUAL(11524, snapshot.groundSpeed);
+    CHECK_EQUAL(8440000, snapshot.heading);
+    CHECK_EQUAL(90, snapshot.pDOP);
+    CHECK_EQUAL(90 * GNSS_NMEA_UERE_MM / 100, snapshot.hAcc);
+    CHECK_EQUAL(snapshot.hAcc * 3 / 2, snapshot.vAcc);
+    CHECK_EQUAL(29, snapshot.second);       // last fix 12:35:29
+    if (order < 2) {
+        // 2026-10-18 is a Sunday: time of day + leap seconds
+        CHECK(snapshot.timeValid);
+        CHECK_EQUAL(2026, snapshot.year);
+        CHECK_EQUAL(10, snapshot.month);
+        CHECK_EQUAL(18, snapshot.day);
+        CHECK_EQUAL((12 * 3600 + 35 * 60 + 29 + GNSS_NMEA_LEAP_SECONDS) * 1000UL, snapshot.iTOW);
+    } else {
+        CHECK(!snapshot.timeValid);
+    }
+}
+
+int main(void) {
+    testGga();
+    testRmcVtg();
+    testFraming();
+    testFallback(9600, 0);
+    testFallback(4800, 1);
+    testFallback(38400, 2);
+    return TEST_RESULT();
+}
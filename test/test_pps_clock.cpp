@@ -0,0 +1,181 @@
+/**
+ * @file test_pps_clock.cpp
+ * @brief Timepulse capture and PpsClock loop filter on a simulated drifting local clock
+ *
+ * Simulation: the local clock (timebase_micros()) runs LOCAL_PPM fast against GNSS time.
+ * Every GNSS second a pulse is captured with +-0.5us uniform jitter (other interrupts at
+ * the same priority), every 37th pulse is lost. Two NAV-PVT epochs per second are
+ * received 80ms after their epoch time. Checked: the EXTI capture path, lock and
+ * frequency estimate, the conversion error to GPS time between pulses, glitch
+ * rejection, restart after a gap and the acquisition with a preset frequency.
+ */
+
+#include "host_test.h"
+#include "pps_clock.h"
+#include "timebase.h"
+
+#define LOCAL_PPM 31.7
+#define LOCAL_START_US 123456789.0          // local time at the first simulated GNSS second
+#define TOW_START_MS 100000000UL            // GPS time of week of that second
+#define EPOCH_LATENCY_US 80000.0
+
+extern "C" void EXTI9_5_IRQHandler(void);
+
+// 72 cycles per us, the conversion of the real timebase without the SysTick part
+extern "C" uint32_t timebase_at_cycles(uint32_t cycles, uint16_t *fraction_ns) {
+    *fraction_ns = (uint16_t)((cycles % 72) * 1000 / 72);
+    return cycles / 72;
+}
+
+static uint32_t randomState = 48;
+
+static double uniform(void) {
+    randomState = randomState * 1664525U + 1013904223U;
+    return (randomState >> 8) / 16777216.0;
+}
+
+// local time in us (double) at a GNSS time in us after the start
+static double localAt(double gnss_us) {
+    return LOCAL_START_US + gnss_us * (1.0 + LOCAL_PPM * 1e-6);
+}
+
+static void addPulse(PpsClock *clock, double local_us) {
+    double floor_us = floor(local_us);
+    clock->addPulse((uint32_t)floor_us, (uint16_t)((local_us - floor_us) * 1000.0));
+}
+
+static void addEpochs(PpsClock *clock, int second) {
+    for (int epoch = 0; epoch < 2; epoch++) {
+        double gnss_us = second * 1e6 + epoch * 500000.0;
+        clock->addEpoch(TOW_START_MS + second * 1000 + epoch * 500, (uint32_t)localAt(gnss_us + EPOCH_LATENCY_US));
+    }
+}
+
+struct RunResult {
+    int lockedAfter_s;                      // -1 never
+    double rms_ns, max_ns;                  // conversion error once locked
+};
+
+static RunResult run(PpsClock *clock, int seconds, int firstSecond) {
+    RunResult result = {-1, 0, 0};
+    double squares = 0;
+    int count = 0;
+
+    for (int second = firstSecond; second < firstSecond + seconds; second++) {
+        if (second % 37 != 5) addPulse(clock, localAt(second * 1e6) + (uniform() - 0.5));
+        addEpochs(clock, second);
+        if (clock->isLocked() && result.lockedAfter_s < 0) result.lockedAfter_s = second - firstSecond;
+        if (!clock->isLocked()) continue;
+
+        // any timestamp between the pulses
+        double gnss_us = second * 1e6 + 1e6 * uniform();
+        uint32_t local = (uint32_t)floor(localAt(gnss_us));
+        double trueGnss_us = (local - LOCAL_START_US) / (1.0 + LOCAL_PPM * 1e-6);
+        uint64_t tow_ns;
+        CHECK(clock->toGnssTime(local, &tow_ns));
+        double error = (double)tow_ns - ((double)TOW_START_MS * 1e6 + trueGnss_us * 1e3);
+        squares += error * error;
+        if (fabs(error) > result.max_ns) result.max_ns = fabs(error);
+        count++;
+    }
+    result.rms_ns = count ? sqrt(squares / count) : 0;
+    return result;
+}
+
+static void testCapture(void) {
+    uint32_t timestamp_us;
+    uint16_t fraction_ns;
+
+    pps_capture_init();
+    CHECK(!pps_capture_read(&timestamp_us, &fraction_ns));
+
+    // edge 36 cycles (500ns) after 100ms, handler entry PPS_CAPTURE_LATENCY_CYCLES later
+    host_DWT.CYCCNT = 7200000 + 36 + PPS_CAPTURE_LATENCY_CYCLES;
+    host_EXTI.PR = PPS_GPIO_PIN;
+    EXTI9_5_IRQHandler();
+    CHECK(pps_capture_read(&timestamp_us, &fraction_ns));
+    CHECK_EQUAL(100000, timestamp_us);
+    CHECK_EQUAL(500, fraction_ns);
+    CHECK(!pps_capture_read(&timestamp_us, &fraction_ns));     // once per pulse
+
+    // another EXTI line of the shared vector: no pulse
+    host_EXTI.PR = GPIO_PIN_7;
+    EXTI9_5_IRQHandler();
+    CHECK(!pps_capture_read(&timestamp_us, &fraction_ns));
+}
+
+static void testDiscipline(void) {
+    PpsClock clock;
+    RunResult result = run(&clock, 300, 0);
+    const PpsClockStats &stats = clock.getStats();
+
+    printf("locked after %ds, frequency %ld ppb (true %.0f), error rms %.0f ns max %.0f ns\n", result.lockedAfter_s,
+           (long)clock.getFrequencyError_ppb(), LOCAL_PPM * 1000, result.rms_ns, result.max_ns);
+    printf("pulses %lu used %lu unlabeled %lu rejected %lu restarts %lu\n", (unsigned long)stats.pulses,
+           (unsigned long)stats.used, (unsigned long)stats.unlabeled, (unsigned long)stats.rejected,
+           (unsigned long)stats.restarts);
+    CHECK(clock.isLocked());
+    CHECK(result.lockedAfter_s > 0 && result.lockedAfter_s <= 10);
+    CHECK_NEAR(LOCAL_PPM * 1000, clock.getFrequencyError_ppb(), 300);
+    CHECK(result.rms_ns < 500);
+    CHECK(result.max_ns < 1500);
+    CHECK_EQUAL(0, stats.unlabeled);
+    CHECK_EQUAL(0, stats.rejected);
+    CHECK_EQUAL(1, stats.restarts);
+    CHECK_EQUAL(stats.pulses, stats.used + 1);  // the first pulse only anchors
+    // 1s local is 1s - 31.7us GNSS
+    CHECK_NEAR(1e6 / (1.0 + LOCAL_PPM * 1e-6), clock.toGnssInterval(1000000), 1.0);
+}
+
+static void testGlitch(void) {
+    PpsClock clock;
+    run(&clock, 60, 0);
+    CHECK(clock.isLocked());
+
+    // 50us late edge (noise on the line): rejected, lock regained within PPS_LOCK_PULSES
+    addPulse(&clock, localAt(60 * 1e6) + 50.0);
+    addEpochs(&clock, 60);
+    CHECK_EQUAL(1, clock.getStats().rejected);
+    CHECK(!clock.isLocked());
+    RunResult result = run(&clock, 30, 61);
+    CHECK(result.lockedAfter_s >= 0 && result.lockedAfter_s <= PPS_LOCK_PULSES + 1);
+    CHECK_EQUAL(1, clock.getStats().restarts);
+    CHECK(result.rms_ns < 500);
+}
+
+static void testGap(void) {
+    PpsClock clock;
+    run(&clock, 60, 0);
+
+    // module without fix for 20s: no pulses, no epochs - holdover, then a new acquisition
+    uint32_t local = (uint32_t)localAt(75 * 1e6);
+    clock.addEpoch(TOW_START_MS + 75000 + 200, local);     // a late epoch alone changes nothing but the lock
+    CHECK(!clock.isLocked());
+    uint64_t tow_ns;
+    CHECK(clock.toGnssTime(local, &tow_ns));                // holdover extrapolation: < 1us after 15s
+    CHECK_NEAR((double)TOW_START_MS * 1e6 + 75e9, (double)tow_ns, 1000.0);
+
+    RunResult result = run(&clock, 60, 80);
+    CHECK_EQUAL(2, clock.getStats().restarts);
+    CHECK(result.lockedAfter_s > 0 && result.lockedAfter_s <= 10);
+    CHECK_NEAR(LOCAL_PPM * 1000, clock.getFrequencyError_ppb(), 300);
+}
+
+static void testPreset(void) {
+    PpsClock plain, preset;
+    preset.presetFrequency(31000);
+
+    RunResult plainResult = run(&plain, 30, 0);
+    RunResult presetResult = run(&preset, 30, 0);
+    printf("lock: %ds without, %ds with preset frequency\n", plainResult.lockedAfter_s, presetResult.lockedAfter_s);
+    CHECK(presetResult.lockedAfter_s >= 0 && presetResult.lockedAfter_s < plainResult.lockedAfter_s);
+}
+
+int main(void) {
+    testCapture();
+    testDiscipline();
+    testGlitch();
+    testGap();
+    testPreset();
+    return TEST_RESULT();
+}
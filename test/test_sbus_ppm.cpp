@@ -0,0 +1,106 @@
+/**
+ * @file test_sbus_ppm.cpp
+ * @brief Golden SBUS frames and PPM slot tables
+ */
+
+#include "host_test.h"
+#include "ppm_output.h"
+#include "sbus_output.h"
+#include <string.h>
+
+static void checkFrame(const uint8_t *expected, const uint8_t *frame) {
+    for (uint8_t index = 0; index < SBUS_FRAME_SIZE; index++) {
+        if (expected[index] != frame[index]) {
+            printf("  frame byte %u: expected 0x%02X, got 0x%02X\n", index, expected[index], frame[index]);
+        }
+    }
+    CHECK(memcmp(expected, frame, SBUS_FRAME_SIZE) == 0);
+}
+
+static void testSbusValues(void) {
+    CHECK_EQUAL(0, sbus_us_to_value(0));
+    CHECK_EQUAL(0, sbus_us_to_value(880));
+    CHECK_EQUAL(172, sbus_us_to_value(988));
+    CHECK_EQUAL(992, sbus_us_to_value(1500));
+    CHECK_EQUAL(1811, sbus_us_to_value(2012));
+    CHECK_EQUAL(2047, sbus_us_to_value(2160));
+    CHECK_EQUAL(2046, sbus_us_to_value(2159));
+    CHECK_EQUAL(2047, sbus_us_to_value(2200));
+    CHECK_EQUAL(2047, sbus_us_to_value(3000));
+
+    // the receiver side decodes us = 880 + value * 5/8: never above the input, less than one step below
+    for (uint16_t us = 881; us < 2160; us++) {
+        uint32_t decoded_x8 = 880 * 8 + sbus_us_to_value(us) * 5;
+        CHECK(decoded_x8 <= us * 8U && decoded_x8 + 5 > us * 8U);
+    }
+}
+
+static void testSbusCenterFrame(void) {
+    // all channels 992 - the frame every receiver sends with centred sticks
+    static const uint8_t expected[SBUS_FRAME_SIZE] = {
+        0x0F, 0xE0, 0x03, 0x1F, 0xF8, 0xC0, 0x07, 0x3E, 0xF0, 0x81, 0x0F, 0x7C, 0xE0,
+        0x03, 0x1F, 0xF8, 0xC0, 0x07, 0x3E, 0xF0, 0x81, 0x0F, 0x7C, 0x00, 0x00};
+    uint16_t channels[SBUS_NUM_CHANNELS];
+    uint8_t frame[SBUS_FRAME_SIZE];
+
+    for (uint8_t channel = 0; channel < SBUS_NUM_CHANNELS; channel++) channels[channel] = 1500;
+    memset(frame, 0xAA, sizeof(frame));
+    CHECK_EQUAL(SBUS_FRAME_SIZE, sbus_encode_frame(frame, channels, 0));
+    checkFrame(expected, frame);
+}
+
+static void testSbusMixedFrame(void) {
+    // clamping at both ends, every bit position of the 11 bit packing, undefined flag bits dropped
+    static const uint16_t channels[SBUS_NUM_CHANNELS] = {
+        880, 988, 1000, 1200, 1400, 1500, 1600, 1800, 2012, 2100, 2200, 3000, 1100, 1300, 1700, 1900};
+    static const uint8_t expected[SBUS_FRAME_SIZE] = {
+        0x0F, 0x00, 0x60, 0x05, 0x30, 0x00, 0x04, 0x34, 0xF0, 0x01, 0x12, 0xB8, 0x13,
+        0x07, 0xFD, 0xFF, 0xFF, 0x0F, 0x16, 0x50, 0x81, 0x14, 0xCC, 0x0C, 0x00};
+    uint8_t frame[SBUS_FRAME_SIZE];
+
+    sbus_encode_frame(frame, channels, 0xF0 | SBUS_FLAG_FRAME_LOST | SBUS_FLAG_FAILSAFE);
+    checkFrame(expected, frame);
+}
+
+static void testPpmCenter(void) {
+    uint16_t channels[PPM_NUM_CHANNELS];
+    uint16_t slots[PPM_NUM_CHANNELS + 1];
+
+    for (uint8_t channel = 0; channel < PPM_NUM_CHANNELS; channel++) channels[channel] = 1500;
+    CHECK_EQUAL(PPM_NUM_CHANNELS + 1, ppm_encode_frame(slots, channels, PPM_NUM_CHANNELS));
+    for (uint8_t channel = 0; channel < PPM_NUM_CHANNELS; channel++) CHECK_EQUAL(1499, slots[channel]);
+    CHECK_EQUAL(PPM_FRAME_US - 8 * 1500 - 1, slots[PPM_NUM_CHANNELS]);   // sync 10500us
+}
+
+static void testPpmClamp(void) {
+    static const uint16_t channels[PPM_NUM_CHANNELS] = {0, 700, 800, 1000, 2000, 2200, 2300, 65535};
+    static const uint16_t expected[PPM_NUM_CHANNELS + 1] = {799, 799, 799, 999, 1999, 2199, 2199, 2199, 10499};
+    uint16_t slots[PPM_NUM_CHANNELS + 1];
+
+    ppm_encode_frame(slots, channels, PPM_NUM_CHANNELS);
+    for (uint8_t slot = 0; slot <= PPM_NUM_CHANNELS; slot++) CHECK_EQUAL(expected[slot], slots[slot]);
+}
+
+static void testPpmMinimumSync(void) {
+    // 12 x 2000us leave no room in the 22.5ms frame - the sync gap stays at its minimum
+    uint16_t channels[12];
+    uint16_t slots[13];
+
+    for (uint8_t channel = 0; channel < 12; channel++) channels[channel] = 2000;
+    CHECK_EQUAL(13, ppm_encode_frame(slots, channels, 12));
+    CHECK_EQUAL(PPM_MIN_SYNC_US - 1, slots[12]);
+
+    // 9 x 2000us = 18ms: the sync gap fills the frame up to 22.5ms
+    CHECK_EQUAL(10, ppm_encode_frame(slots, channels, 9));
+    CHECK_EQUAL(PPM_FRAME_US - 9 * 2000 - 1, slots[9]);
+}
+
+int main(void) {
+    testSbusValues();
+    testSbusCenterFrame();
+    testSbusMixedFrame();
+    testPpmCenter();
+    testPpmClamp();
+    testPpmMinimumSync();
+    return TEST_RESULT();
+}
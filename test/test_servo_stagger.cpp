@@ -0,0 +1,245 @@
+/**
+ * @file test_servo_stagger.cpp
+ * @brief Simulated servo load: in-phase against staggered timer groups (servo_timer_sync.h)
+ *
+ * Synthetic load on the bluepill outputs (TIM1: 4, TIM2: 2, TIM3: 4 servos). Every servo
+ * wakes up with its pulse: an inrush spike (2x the drive current, 150us decay) and a drive
+ * current for a load dependent time from the rising edge, both random per frame from a
+ * seeded generator. The BEC rail (5V, 80mOhm output resistance, 20us rail capacitor time
+ * constant) feeds the servos, the shunt sees the BEC input current plus the board itself.
+ *
+ * The same load sequence runs with all groups in phase (0 / 0) and with
+ * SERVO_PHASE_TIM2_US / SERVO_PHASE_TIM3_US. Compared: peak servo current, rail ripple and
+ * the bat_current noise - ADC samples of the shunt (6us sampling window, white noise),
+ * 64 per AdcSampler result, through BatteryMeasurement like in user_main.cpp. Both
+ * sampling modes of adc_trigger.h: triggered bursts (one result per frame) and free
+ * running scans (PPM builds).
+ *
+ * The staggered offsets are multiples of ADC_TRIGGER_PERIOD_US: the triggered bursts see
+ * the same load per frame, only in another trigger period - same noise as in phase. The
+ * bursts sit in the quiet window behind the pulses and read low under servo drive (bias).
+ */
+
+#include "host_test.h"
+#include "adc_sampler.h"
+#include "adc_trigger.h"
+#include "battery_measurement.h"
+#include "servo_timer_sync.h"
+#include "boards/board_bluepill.h"
+
+#define GROUPS 3
+#define FRAMES 150
+#define TRACE_US (FRAMES * SERVO_TIMER_PERIOD_US)
+#define DRIVE_MIN_A 0.15                    // drive current of a servo under load
+#define DRIVE_MAX_A 0.50
+#define DRIVE_MIN_US 1000                   // drive time from the rising edge
+#define DRIVE_MAX_US 6000
+#define INRUSH_FACTOR 2.0                   // spike on top of the drive current at the rising edge
+#define INRUSH_TAU_US 150.0
+#define IDLE_A 0.008
+#define BEC_VOLTAGE 5.0
+#define BEC_OUTPUT_OHMS 0.08
+#define BEC_EFFICIENCY 0.85
+#define RAIL_TAU_US 20.0
+#define BATTERY_VOLTAGE 8.4
+#define BOARD_MA 120.0                      // MCU, receiver, LEDs
+#define NOISE_COUNTS 4.0                    // white noise on the current sense, 1 sigma
+#define SAMPLE_WINDOW_US 6                  // 71.5 cycles at 12MHz
+
+// servo outputs per timer of a ServoOutputList
+template <uint8_t TimerId, typename List> struct OutputsOn;
+template <uint8_t TimerId, typename... Outs> struct OutputsOn<TimerId, ServoOutputList<Outs...> > {
+    static const uint8_t value = board_detail::CountOnTimer<TimerId, Outs...>::value;
+};
+
+static const uint8_t groupServos[GROUPS] = {OutputsOn<1, BoardServoOutputs>::value, OutputsOn<2, BoardServoOutputs>::value,
+                                            OutputsOn<3, BoardServoOutputs>::value};
+
+static uint32_t randomState = 12345;
+
+static double uniform(void) {
+    randomState = randomState * 1664525U + 1013904223U;
+    return (randomState >> 8) / 16777216.0;
+}
+
+static double gaussian(void) {
+    double sum = 0;
+    for (int i = 0; i < 12; i++) sum += uniform();
+    return sum - 6.0;
+}
+
+static float railCurrent[TRACE_US];     // servo current on the BEC rail per us
+
+// the servo load of all frames for the given group phases
+static void makeLoad(uint32_t tim2_phase_us, uint32_t tim3_phase_us) {
+    const uint32_t phase_us[GROUPS] = {0, tim2_phase_us, tim3_phase_us};
+
+    randomState = 12345;
+    for (uint32_t t = 0; t < TRACE_US; t++) railCurrent[t] = (float)(IDLE_A * BoardServoOutputs::size);
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        for (uint8_t group = 0; group < GROUPS; group++) {
+            for (uint8_t servo = 0; servo < groupServos[group]; servo++) {
+                double drive = DRIVE_MIN_A + (DRIVE_MAX_A - DRIVE_MIN_A) * uniform();
+                uint32_t length = DRIVE_MIN_US + (uint32_t)((DRIVE_MAX_US - DRIVE_MIN_US) * uniform());
+                uint32_t rise = frame * SERVO_TIMER_PERIOD_US + phase_us[group];
+                for (uint32_t dt = 0; dt < length && rise + dt < TRACE_US; dt++) {
+                    railCurrent[rise + dt] += (float)(drive * (1.0 + INRUSH_FACTOR * exp(-(double)dt / INRUSH_TAU_US)));
+                }
+            }
+        }
+    }
+}
+
+// shunt current in mA at time t
+static double batteryCurrent_mA(uint32_t t) {
+    return BOARD_MA + 1000.0 * railCurrent[t] * BEC_VOLTAGE / (BATTERY_VOLTAGE * BEC_EFFICIENCY);
+}
+
+// mean shunt current over the sampling window as an ADC result (counts << 4)
+static uint16_t sample(uint32_t start_us) {
+    static const double countsPerMa = 65536.0 / BAT_CURRENT_SCALE_Q16 / (1 << ADC_SAMPLER_RESULT_SHIFT);
+    double sum = 0;
+    for (uint32_t dt = 0; dt < SAMPLE_WINDOW_US; dt++) sum += batteryCurrent_mA(start_us + dt);
+    double counts = (sum / SAMPLE_WINDOW_US - BAT_CURRENT_OFFSET_MA) * countsPerMa + NOISE_COUNTS * gaussian();
+    return (uint16_t)(counts * (1 << ADC_SAMPLER_RESULT_SHIFT) + 0.5);
+}
+
+struct Load {
+    double peak_A;                          // servo current on the rail
+    double ripple_mV;                       // rail voltage peak to peak
+    double mean_mA;                         // true battery current
+};
+
+static Load measureLoad(void) {
+    Load load = {0, 0, 0};
+    double rail = BEC_VOLTAGE, minimum = BEC_VOLTAGE, maximum = 0;
+
+    for (uint32_t t = 0; t < TRACE_US; t++) {
+        double current = railCurrent[t];
+        if (current > load.peak_A) load.peak_A = current;
+        rail += (BEC_VOLTAGE - current * BEC_OUTPUT_OHMS - rail) / RAIL_TAU_US;
+        if (t >= SERVO_TIMER_PERIOD_US) {       // from the second frame: drive times reach over the frame end
+            if (rail < minimum) minimum = rail;
+            if (rail > maximum) maximum = rail;
+            load.mean_mA += batteryCurrent_mA(t);
+        }
+    }
+    load.ripple_mV = (maximum - minimum) * 1000.0;
+    load.mean_mA /= TRACE_US - SERVO_TIMER_PERIOD_US;
+    return load;
+}
+
+struct Noise {
+    double sigma_mA;                        // bat_current around its own mean
+    double bias_mA;                         // mean bat_current - true battery current
+};
+
+// bat_current over a sequence of AdcSampler results, the first 20 results let the IIR settle
+struct NoiseStatistics {
+    BatteryMeasurement battery;
+    uint16_t results[ADC_SAMPLER_RESULTS];
+    double sum, squares;
+    uint32_t count;
+
+    NoiseStatistics() : sum(0), squares(0), count(0) {
+        results[BAT_ADC_CHANNEL_VOLTAGE] = 0;
+        results[ADC_SAMPLER_VREFINT] = (uint16_t)BAT_VREFINT_NOMINAL;
+        results[ADC_SAMPLER_TEMPERATURE] = 0;
+    }
+
+    void add(uint32_t currentSum, uint32_t samples, uint32_t index) {
+        results[BAT_ADC_CHANNEL_CURRENT] = (uint16_t)(currentSum / samples);
+        battery.update(results);
+        if (index < 20) return;
+        double current = battery.getCurrent_mA();
+        sum += current;
+        squares += current * current;
+        count++;
+    }
+
+    Noise result(double true_mA) const {
+        Noise noise;
+        double mean = sum / count;
+        noise.sigma_mA = sqrt(squares / count - mean * mean);
+        noise.bias_mA = mean - true_mA;
+        return noise;
+    }
+};
+
+// ADC_TRIGGER_BURST_SCANS scans every ADC_TRIGGER_PERIOD_US, one result per servo frame
+static Noise runTriggered(double true_mA) {
+    NoiseStatistics statistics;
+
+    randomState = 777;
+    for (uint32_t frame = 1; frame < FRAMES; frame++) {
+        uint32_t sum = 0, samples = 0;
+        for (uint32_t trigger = 0; trigger < SERVO_TIMER_PERIOD_US / ADC_TRIGGER_PERIOD_US; trigger++) {
+            uint32_t burst = frame * SERVO_TIMER_PERIOD_US + trigger * ADC_TRIGGER_PERIOD_US + ADC_TRIGGER_PHASE_US;
+            for (uint32_t scan = 0; scan < ADC_TRIGGER_BURST_SCANS; scan++, samples++) {
+                sum += sample(burst + scan * ADC_TRIGGER_SCAN_US + ADC_TRIGGER_SCAN_US / 2);
+            }
+        }
+        statistics.add(sum, samples, frame);
+    }
+    return statistics.result(true_mA);
+}
+
+// continuous scans, ADC_SAMPLER_DECIMATION scans per result
+static Noise runFreeRunning(double true_mA) {
+    NoiseStatistics statistics;
+    uint32_t t = SERVO_TIMER_PERIOD_US + 3;
+
+    randomState = 777;
+    for (uint32_t index = 0; t + ADC_SAMPLER_DECIMATION * ADC_TRIGGER_SCAN_US < TRACE_US; index++) {
+        uint32_t sum = 0;
+        for (uint32_t scan = 0; scan < ADC_SAMPLER_DECIMATION; scan++, t += ADC_TRIGGER_SCAN_US) sum += sample(t);
+        statistics.add(sum, ADC_SAMPLER_DECIMATION, index);
+    }
+    return statistics.result(true_mA);
+}
+
+struct Comparison {
+    Load load;
+    Noise triggered;
+    Noise freeRunning;
+};
+
+static Comparison run(const char *name, uint32_t tim2_phase_us, uint32_t tim3_phase_us) {
+    Comparison result;
+
+    makeLoad(tim2_phase_us, tim3_phase_us);
+    result.load = measureLoad();
+    result.triggered = runTriggered(result.load.mean_mA);
+    result.freeRunning = runFreeRunning(result.load.mean_mA);
+    printf("%-10s %5.2fA %6.1fmV %7.1fmA | %5.1fmA %+6.1fmA | %5.1fmA %+6.1fmA\n", name, result.load.peak_A,
+           result.load.ripple_mV, result.load.mean_mA, result.triggered.sigma_mA, result.triggered.bias_mA,
+           result.freeRunning.sigma_mA, result.freeRunning.bias_mA);
+    return result;
+}
+
+static void testStagger(void) {
+    printf("groups: TIM1 %u, TIM2 %u, TIM3 %u servos\n", groupServos[0], groupServos[1], groupServos[2]);
+    printf("phases       peak  ripple  battery | triggered: sigma bias | free running: sigma bias\n");
+    Comparison inPhase = run("0/0", 0, 0);
+    Comparison staggered = run("configured", SERVO_PHASE_TIM2_US, SERVO_PHASE_TIM3_US);
+
+    // same load, only moved in time: same energy
+    CHECK(fabs(staggered.load.mean_mA - inPhase.load.mean_mA) < 0.01 * inPhase.load.mean_mA);
+
+    // the inrush spikes of the groups no longer add up
+    CHECK(staggered.load.peak_A < 0.6 * inPhase.load.peak_A);
+    CHECK(staggered.load.ripple_mV < 0.6 * inPhase.load.ripple_mV);
+
+    // the current is spread over the frame: less bat_current noise in free running mode
+    CHECK(staggered.freeRunning.sigma_mA < 0.8 * inPhase.freeRunning.sigma_mA);
+
+    // triggered: each frame result holds the same samples, only from other bursts
+    static_assert(SERVO_PHASE_TIM2_US % ADC_TRIGGER_PERIOD_US == 0 && SERVO_PHASE_TIM3_US % ADC_TRIGGER_PERIOD_US == 0,
+                  "phase offsets are not on the ADC trigger grid");
+    CHECK_NEAR(inPhase.triggered.sigma_mA, staggered.triggered.sigma_mA, 0.05 * inPhase.triggered.sigma_mA);
+}
+
+int main(void) {
+    testStagger();
+    return TEST_RESULT();
+}
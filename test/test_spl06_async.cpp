@@ -0,0 +1,143 @@
+/**
+ * @file test_spl06_async.cpp
+ * @brief SPL06-001 bring-up, compensation and burst suspend on the HAL I2C mock
+ *
+ * The mock slave is a register file with the SPL06 product ID, ready flags and a
+ * coefficient block. Checked: the bring-up sequence up to the periodic burst, the
+ * integer compensation against the datasheet formula in double, and that the burst
+ * slot is suspended while the sensor is lost and the bring-up is retried.
+ */
+
+#include "host_test.h"
+#include "i2c_bus.h"
+#include "i2c_mock.h"
+#include "spl06_async.h"
+#include "timebase.h"
+
+// datasheet coefficient values, table 4 scale factors for 16x pressure / single temperature
+static const int32_t C0 = 204, C1 = -261, C00 = 80672, C10 = -54139, C01 = -2848, C11 = 1215, C20 = -7301, C21 = 104, C30 = -1500;
+static const double KP = 253952.0, KT = 524288.0;
+
+static uint32_t now_us = 0;
+
+extern "C" uint32_t timebase_micros(void) {
+    now_us++;
+    i2c_mock_tick(now_us);
+    return now_us;
+}
+
+static I2C_HandleTypeDef hi2c;
+static I2cBus bus(&hi2c);
+static Spl06Async sensor(&bus);
+
+extern "C" void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *handle) {
+    bus.onTransferDone(handle, false);
+}
+
+extern "C" void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *handle) {
+    bus.onTransferDone(handle, false);
+}
+
+extern "C" void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *handle) {
+    bus.onTransferDone(handle, true);
+}
+
+static void put16(uint8_t *data, int32_t value) {
+    data[0] = (uint8_t)(value >> 8);
+    data[1] = (uint8_t)value;
+}
+
+static void put24(uint8_t *data, int32_t value) {
+    data[0] = (uint8_t)(value >> 16);
+    data[1] = (uint8_t)(value >> 8);
+    data[2] = (uint8_t)value;
+}
+
+static void sensorRegisters(int32_t p_raw, int32_t t_raw) {
+    uint8_t *r = i2c_mock.registers;
+    put24(&r[0x00], p_raw);
+    put24(&r[0x03], t_raw);
+    r[0x08] = 0xC0;                         // COEF_RDY | SENSOR_RDY
+    r[0x0D] = SPL06_PRODUCT_ID;
+    uint8_t *c = &r[0x10];
+    c[0] = (uint8_t)(C0 >> 4);
+    c[1] = (uint8_t)(((C0 & 0x0F) << 4) | ((C1 >> 8) & 0x0F));
+    c[2] = (uint8_t)C1;
+    c[3] = (uint8_t)(C00 >> 12);
+    c[4] = (uint8_t)(C00 >> 4);
+    c[5] = (uint8_t)(((C00 & 0x0F) << 4) | ((C10 >> 16) & 0x0F));
+    c[6] = (uint8_t)(C10 >> 8);
+    c[7] = (uint8_t)C10;
+    put16(&c[8], C01);
+    put16(&c[10], C11);
+    put16(&c[12], C20);
+    put16(&c[14], C21);
+    put16(&c[16], C30);
+    r[0x28] = 0x80;                         // coefficients of the external (MEMS) temperature sensor
+}
+
+// main loop step of 1ms, the bus answers within the step
+static void run(uint32_t ms, bool answer) {
+    for (uint32_t step = 0; step < ms; step++) {
+        now_us += 1000;
+        i2c_mock_tick(now_us);
+        bus.schedule(now_us);
+        sensor.update(now_us);
+        if (answer) {
+            while (i2c_mock_complete(&hi2c, now_us)) {}
+        }
+    }
+}
+
+static void testBringUp(void) {
+    const int32_t p_raw = -101234, t_raw = 154700;
+    i2c_mock_reset(&hi2c, SPL06_I2C_ADDRESS);
+    sensorRegisters(p_raw, t_raw);
+    now_us = 1000;
+    sensor.begin();
+
+    run(20, true);
+    CHECK(sensor.isRunning());
+    CHECK_EQUAL(0x80 | (SPL06_MEASUREMENT_RATE << 4) | SPL06_TEMPERATURE_OVERSAMPLING, i2c_mock.registers[0x07]);
+    CHECK_EQUAL(0x07, i2c_mock.registers[0x08]);
+    run(300, true);
+    Spl06Sample sample;
+    sensor.getSample(&sample);
+    CHECK(sample.sequence >= 2);
+
+    double p = p_raw / KP, t = t_raw / KT;
+    double pressure = C00 + p * (C10 + p * (C20 + p * C30)) + t * C01 + t * p * (C11 + p * C21);
+    double temperature = C0 * 0.5 + C1 * t;
+    printf("pressure %.3f Pa (double %.3f), temperature %d cC (double %.2f)\n", sample.pressure_q8 / 256.0, pressure,
+           sample.temperature_cC, temperature * 100.0);
+    CHECK_NEAR(pressure, sample.pressure_q8 / 256.0, 0.05);      // Q8 output, truncating shifts
+    CHECK_NEAR(temperature * 100.0, sample.temperature_cC, 1.0);
+}
+
+static void testSensorLost(void) {
+    // sensor gone: bursts fail, then only the bring-up probe once per SPL06_RETRY_US
+    uint8_t present = i2c_mock.slaveAddress;
+    i2c_mock.slaveAddress = 0x50;
+    run(SPL06_MAX_READ_ERRORS * SPL06_READ_PERIOD_US / 1000 + 200, true);
+    CHECK(!sensor.isRunning());
+    uint32_t before = i2c_mock.logCount;
+    run(3 * SPL06_RETRY_US / 1000, true);
+    uint32_t starts = i2c_mock.logCount - before;
+    printf("sensor lost: %u transfers in %u ms\n", starts, 3 * SPL06_RETRY_US / 1000);
+    CHECK(starts >= 2 && starts <= 4);      // the probes, no burst reads
+
+    // back: new bring-up, bursts resume
+    i2c_mock.slaveAddress = present;
+    i2c_mock.registers[0x08] = 0xC0;
+    run(SPL06_RETRY_US / 1000 + 50, true);
+    CHECK(sensor.isRunning());
+    uint32_t sequence = sensor.getSequence();
+    run(500, true);
+    CHECK(sensor.getSequence() - sequence >= 3);
+}
+
+int main(void) {
+    testBringUp();
+    testSensorLost();
+    return TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+/**
+ * @file test_vario_estimator.cpp
+ * @brief Kalman vario against the former IIR / differentiate / IIR chain on a synthetic trace
+ *
+ * Trace: 8Hz baro samples with timestamp jitter, 0.2m white altitude noise, level for
+ * 10s, a 2m/s climb for 20s, level again. The former chain (alpha 0.135755 on the
+ * altitude, difference, alpha 0.135755 on the vario) is run with the difference scaled
+ * by the real 8Hz rate instead of its hard coded x20, so only lag and noise are compared.
+ * Checked: the 90% rise time after the climb step, the steady climb value and the vario
+ * noise at rest, plus the restart after a sample gap.
+ */
+
+#include "host_test.h"
+#include "vario_estimator.h"
+
+#define SAMPLE_US 125000
+#define NOISE_M 0.2
+#define CLIMB_MS 2.0
+
+struct IirChain {
+    double altitude, previous, vario;
+    bool started;
+
+    IirChain() : altitude(0), previous(0), vario(0), started(false) {}
+
+    void update(double altitude_m, double rate_hz) {
+        static const double ALPHA = 0.135755, BETA = 1.0 - ALPHA;
+        if (!started) {
+            altitude = previous = altitude_m;
+            started = true;
+        }
+        altitude = ALPHA * altitude_m + BETA * altitude;
+        vario = ALPHA * (altitude - previous) * rate_hz + BETA * vario;
+        previous = altitude;
+    }
+};
+
+static uint32_t randomState = 1;
+
+static double gaussian(void) {
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        randomState = randomState * 1664525U + 1013904223U;
+        sum += (randomState >> 8) / 16777216.0;
+    }
+    return sum - 6.0;
+}
+
+static double trueAltitude(double t) {
+    if (t < 10.0) return 100.0;
+    if (t < 30.0) return 100.0 + CLIMB_MS * (t - 10.0);
+    return 100.0 + CLIMB_MS * 20.0;
+}
+
+struct Stats {
+    double sum, sum2;
+    int count;
+    double std(void) const { return sqrt(sum2 / count - (sum / count) * (sum / count)); }
+};
+
+static void testStepAndNoise(void) {
+    VarioEstimator kalman;
+    IirChain iir;
+    double riseKalman = -1, riseIir = -1, steadyKalman = 0, steadyIir = 0;
+    Stats restKalman = {0, 0, 0}, restIir = {0, 0, 0};
+    uint32_t timestamp_us = 0;
+
+    for (int sample = 0; sample < 8 * 60; sample++) {
+        double t = sample * (SAMPLE_US * 1e-6);
+        timestamp_us += SAMPLE_US + (sample % 3) * 2000;    // task jitter
+        double z = trueAltitude(t) + NOISE_M * gaussian();
+        kalman.update((float)z, timestamp_us);
+        iir.update(z, 1e6 / SAMPLE_US);
+
+        if (t > 10.0 && riseKalman < 0 && kalman.getVario() >= 0.9 * CLIMB_MS) riseKalman = t - 10.0;
+        if (t > 10.0 && riseIir < 0 && iir.vario >= 0.9 * CLIMB_MS) riseIir = t - 10.0;
+        if (t >= 25.0 && t < 30.0) {
+            steadyKalman += kalman.getVario() / 40.0;
+            steadyIir += iir.vario / 40.0;
+        }
+        if (t > 40.0) {
+            restKalman.sum += kalman.getVario();
+            restKalman.sum2 += kalman.getVario() * kalman.getVario();
+            restKalman.count++;
+            restIir.sum += iir.vario;
+            restIir.sum2 += iir.vario * iir.vario;
+            restIir.count++;
+        }
+    }
+    printf("90%% rise: kalman %.2fs, iir %.2fs\n", riseKalman, riseIir);
+    printf("steady climb: kalman %.2f, iir %.2f m/s (true %.2f)\n", steadyKalman, steadyIir, CLIMB_MS);
+    printf("noise at rest: kalman %.3f, iir %.3f m/s\n", restKalman.std(), restIir.std());
+
+    CHECK(riseKalman > 0 && riseKalman < 1.6);
+    CHECK(riseIir > 2.0 * riseKalman);
+    CHECK_NEAR(CLIMB_MS, steadyKalman, 0.1);
+    CHECK(restKalman.std() < 0.15);
+}
+
+static void testGapRestart(void) {
+    VarioEstimator kalman;
+    uint32_t timestamp_us = 0;
+
+    for (int sample = 0; sample < 80; sample++) {
+        timestamp_us += SAMPLE_US;
+        kalman.update(100.0f + 1.0f * sample * 0.125f, timestamp_us);
+    }
+    CHECK_NEAR(1.0, kalman.getVario(), 0.05);
+    // sensor away for 2s, back 50m lower: no 25m/s spike, filter starts at the new sample
+    timestamp_us += 2 * VARIO_MAX_DT_US;
+    kalman.update(60.0f, timestamp_us);
+    CHECK_NEAR(60.0, kalman.getAltitude(), 0.01);
+    CHECK_NEAR(0.0, kalman.getVario(), 0.01);
+}
+
+int main(void) {
+    testStepAndNoise();
+    testGapRestart();
+    return TEST_RESULT();
+}
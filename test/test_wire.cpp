@@ -0,0 +1,254 @@
+/**
+ * @file test_wire.cpp
+ * @brief Blocking TwoWire facade over the I2cBus on the HAL I2C mock
+ *
+ * The clock hook plays the I2C interrupt: a started transfer completes transferTime_us
+ * later while TwoWire waits. Checked: write, register read with repeated START, Arduino
+ * result codes (NACK, data too long, timeout with bus recovery), the wait for a
+ * transaction queued behind a sensor read, and setClock() on an idle bus only.
+ */
+
+#include "host_test.h"
+#include "i2c_bus.h"
+#include "i2c_mock.h"
+#include "stm32_arduino_compatibility.h"
+#include "timebase.h"
+#include <string.h>
+
+#define SLAVE 0x76
+
+I2C_HandleTypeDef hi2c1;
+I2cBus i2cBus(&hi2c1);                      // the bus Wire uses, like in user_main.cpp
+
+static uint32_t now_us = 0;
+static uint32_t transferTime_us = 200;
+static bool interruptLost = false;
+static uint32_t startCount = 0, started_us = 0;
+
+// every clock read costs 1us, a running transfer completes transferTime_us after its start
+extern "C" uint32_t timebase_micros(void) {
+    now_us++;
+    i2c_mock_tick(now_us);
+    if (i2c_mock.logCount != startCount) {
+        startCount = i2c_mock.logCount;
+        started_us = now_us;
+    }
+    if (i2c_mock.running && !interruptLost && now_us - started_us >= transferTime_us) i2c_mock_complete(&hi2c1, now_us);
+    return now_us;
+}
+
+extern "C" void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *handle) {
+    i2cBus.onTransferDone(handle, false);
+}
+
+extern "C" void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *handle) {
+    i2cBus.onTransferDone(handle, false);
+}
+
+extern "C" void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *handle) {
+    i2cBus.onTransferDone(handle, true);
+}
+
+uint32_t HAL_GetTick(void) {
+    return now_us / 1000;
+}
+
+static void setup(void) {
+    i2c_mock_reset(&hi2c1, SLAVE);
+    startCount = 0;
+    interruptLost = false;
+    transferTime_us = 200;
+    Wire.setWireTimeout();
+    Wire.clearWireTimeoutFlag();
+}
+
+static void testWriteAndRead(void) {
+    setup();
+
+    // write two registers
+    Wire.beginTransmission(SLAVE);
+    CHECK_EQUAL(1, Wire.write(0x06));
+    static const uint8_t values[] = {0x33, 0x44};
+    CHECK_EQUAL(2, Wire.write(values, sizeof(values)));
+    CHECK_EQUAL(0, Wire.endTransmission());
+    CHECK_EQUAL(1, i2c_mock.logCount);
+    CHECK_EQUAL(I2C_FIRST_AND_LAST_FRAME, i2c_mock.log[0].options);
+    CHECK_EQUAL(0x33, i2c_mock.registers[0x06]);
+    CHECK_EQUAL(0x44, i2c_mock.registers[0x07]);
+
+    // register address, repeated START, read: one bus transaction
+    i2c_mock.registers[0x10] = 0xA1;
+    i2c_mock.registers[0x11] = 0xB2;
+    i2c_mock.registers[0x12] = 0xC3;
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x10);
+    CHECK_EQUAL(0, Wire.endTransmission(false));
+    CHECK_EQUAL(1, i2c_mock.logCount);         // nothing on the bus yet
+    CHECK_EQUAL(3, Wire.requestFrom(SLAVE, 3));
+    CHECK_EQUAL(3, i2c_mock.logCount);
+    CHECK_EQUAL(I2C_FIRST_FRAME, i2c_mock.log[1].options);
+    CHECK(!i2c_mock.log[1].read);
+    CHECK_EQUAL(I2C_LAST_FRAME, i2c_mock.log[2].options);
+    CHECK(i2c_mock.log[2].read);
+    CHECK_EQUAL(3, Wire.available());
+    CHECK_EQUAL(0xA1, Wire.peek());
+    CHECK_EQUAL(0xA1, Wire.read());
+    CHECK_EQUAL(0xB2, Wire.read());
+    CHECK_EQUAL(0xC3, Wire.read());
+    CHECK_EQUAL(-1, Wire.read());
+    CHECK_EQUAL(0, Wire.available());
+
+    // read without register address continues at the slave pointer
+    CHECK_EQUAL(1, Wire.requestFrom(SLAVE, 1));
+    CHECK(i2c_mock.log[3].read);
+    CHECK_EQUAL(I2C_FIRST_AND_LAST_FRAME, i2c_mock.log[3].options);
+}
+
+static void testResultCodes(void) {
+    setup();
+
+    // NACK on the address
+    Wire.beginTransmission(SLAVE + 1);
+    Wire.write(0x00);
+    CHECK_EQUAL(2, Wire.endTransmission());
+    CHECK_EQUAL(0, Wire.requestFrom(SLAVE + 1, 2));
+    CHECK_EQUAL(0, Wire.available());
+
+    // data too long: nothing is sent
+    uint32_t starts = i2c_mock.logCount;
+    Wire.beginTransmission(SLAVE);
+    for (uint8_t index = 0; index < WIRE_BUFFER_SIZE; index++) CHECK_EQUAL(1, Wire.write(index));
+    CHECK_EQUAL(0, Wire.write(0xFF));
+    CHECK_EQUAL(1, Wire.endTransmission());
+    CHECK_EQUAL(starts, i2c_mock.logCount);
+    CHECK_EQUAL(4, Wire.endTransmission());    // no beginTransmission()
+
+    // endTransmission(false) followed by another write: the held write goes out first
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x20);
+    Wire.write(0x5A);
+    CHECK_EQUAL(0, Wire.endTransmission(false));
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x21);
+    Wire.write(0xA5);
+    CHECK_EQUAL(0, Wire.endTransmission());
+    CHECK_EQUAL(0x5A, i2c_mock.registers[0x20]);
+    CHECK_EQUAL(0xA5, i2c_mock.registers[0x21]);
+}
+
+static void testTimeout(void) {
+    setup();
+    interruptLost = true;
+    i2c_mock.sdaHeldClocks = 3;                 // slave stuck in a read byte
+
+    // the bus gives up after I2C_BUS_TIMEOUT_US, before the facade timeout
+    uint32_t start_us = now_us;
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x00);
+    CHECK_EQUAL(5, Wire.endTransmission());
+    uint32_t waited_us = now_us - start_us;
+    printf("lost interrupt: endTransmission() = 5 after %u us\n", (unsigned)waited_us);
+    CHECK(waited_us >= I2C_BUS_TIMEOUT_US && waited_us < WIRE_DEFAULT_TIMEOUT_US);
+    CHECK(Wire.getWireTimeoutFlag());
+    CHECK_EQUAL(1, i2c_mock.stops);             // bus recovered
+    CHECK_EQUAL(4, i2c_mock.sclClocks);         // 3 until SDA was released + the one of the STOP
+
+    // shorter facade timeout: the facade cancels and the bus recovers as well
+    Wire.clearWireTimeoutFlag();
+    Wire.setWireTimeout(1000);
+    start_us = now_us;
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x00);
+    CHECK_EQUAL(5, Wire.endTransmission());
+    waited_us = now_us - start_us;
+    CHECK(waited_us >= 1000 && waited_us < I2C_BUS_TIMEOUT_US);
+    CHECK(Wire.getWireTimeoutFlag());
+    CHECK_EQUAL(2, i2c_mock.stops);
+    CHECK(i2c_mock.deinits >= 2);
+    CHECK(i2cBus.isIdle());
+
+    // working again afterwards
+    interruptLost = false;
+    Wire.setWireTimeout();
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x30);
+    Wire.write(0x77);
+    CHECK_EQUAL(0, Wire.endTransmission());
+    CHECK_EQUAL(0x77, i2c_mock.registers[0x30]);
+}
+
+static void testQueued(void) {
+    // a sensor read of the I2cBus is running, the Wire transfer waits behind it
+    static const uint8_t address[] = {0x00};
+    static uint8_t data[6];
+    I2cTransaction sensor;
+    setup();
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.address = SLAVE;
+    sensor.txData = address;
+    sensor.txLength = 1;
+    sensor.rxData = data;
+    sensor.rxLength = sizeof(data);
+    CHECK(i2cBus.submit(&sensor));
+
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x40);
+    Wire.write(0x12);
+    CHECK_EQUAL(0, Wire.endTransmission());
+    CHECK_EQUAL(I2C_STATUS_DONE, sensor.status);
+    CHECK_EQUAL(3, i2c_mock.logCount);
+    CHECK_EQUAL(0x12, i2c_mock.registers[0x40]);
+
+    // queued behind a transfer that never completes: cancelled from the queue, nothing started
+    interruptLost = true;
+    CHECK(i2cBus.submit(&sensor));
+    Wire.setWireTimeout(1000);
+    Wire.beginTransmission(SLAVE);
+    Wire.write(0x41);
+    Wire.write(0x34);
+    CHECK_EQUAL(5, Wire.endTransmission());
+    CHECK_EQUAL(4, i2c_mock.logCount);
+    CHECK_EQUAL(0, i2c_mock.registers[0x41]);
+    CHECK_EQUAL(I2C_STATUS_BUSY, sensor.status);
+    interruptLost = false;
+    for (uint16_t step = 0; step < 1000 && sensor.status == I2C_STATUS_BUSY; step++) i2cBus.schedule(timebase_micros());
+    CHECK_EQUAL(I2C_STATUS_DONE, sensor.status);
+    CHECK(i2cBus.isIdle());
+}
+
+static void testClock(void) {
+    setup();
+    hi2c1.Init.ClockSpeed = 100000;
+
+    Wire.setClock(400000);
+    CHECK_EQUAL(400000, hi2c1.Init.ClockSpeed);
+    CHECK_EQUAL(I2C_DUTYCYCLE_2, hi2c1.Init.DutyCycle);
+    CHECK_EQUAL(1, i2c_mock.inits);
+    Wire.setClock(1000000);
+    CHECK_EQUAL(I2C_BUS_MAX_CLOCK_HZ, hi2c1.Init.ClockSpeed);
+
+    // a running sensor read completes first, the peripheral is never re-initialised under it
+    static const uint8_t address[] = {0x00};
+    static uint8_t data[2];
+    I2cTransaction sensor;
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.address = SLAVE;
+    sensor.txData = address;
+    sensor.txLength = 1;
+    sensor.rxData = data;
+    sensor.rxLength = sizeof(data);
+    CHECK(i2cBus.submit(&sensor));
+    Wire.setClock(100000);
+    CHECK_EQUAL(I2C_STATUS_DONE, sensor.status);
+    CHECK_EQUAL(100000, hi2c1.Init.ClockSpeed);
+    CHECK_EQUAL(3, i2c_mock.inits);
+}
+
+int main(void) {
+    testWriteAndRead();
+    testResultCodes();
+    testTimeout();
+    testQueued();
+    testClock();
+    return TEST_RESULT();
+}